@@ -0,0 +1,101 @@
+/*! \file archive.h
+ *  \brief Asset archive (.pak) reading
+ */
+
+#ifndef _ARCHIVE_H
+#define _ARCHIVE_H
+
+#include <gctypes.h>
+#include <stdio.h>
+
+#define PAK_MAGIC       0x4250414B /*< "BPAK" */
+#define PAK_VERSION     1
+#define PAK_NAME_LENGTH 32
+
+/* Entry methods */
+enum {
+	PAK_STORED = 0, /*< Data as is                         */
+	PAK_LZ     = 1  /*< LZ77 sequences (see bin2pak lz.cpp) */
+};
+
+/* File header, followed by the directory (sorted by name) */
+typedef struct {
+	u32 magic;      /*< PAK_MAGIC                   */
+	u16 version;    /*< PAK_VERSION                 */
+	u16 entryCount; /*< Entries in the directory    */
+	u32 dataOffset; /*< First entry data            */
+	u32 size;       /*< File size                   */
+} pakheader_t;
+
+typedef struct {
+	char name[PAK_NAME_LENGTH]; /*< File name, zero terminated                  */
+	u32  offset;                /*< From the file start, aligned (32 default)   */
+	u32  size;                  /*< Unpacked size                               */
+	u32  packedSize;            /*< Stored size                                 */
+	u32  margin;                /*< Extra buffer bytes to unpack in place       */
+	u32  checksum;              /*< FNV-1a of the unpacked data                 */
+	u8   method;                /*< PAK_STORED or PAK_LZ                        */
+	u8   reserved[3];
+} pakentry_t;
+
+/*! Open archive */
+typedef struct {
+	const pakheader_t* header;  /*< Header                                     */
+	const pakentry_t*  entries; /*< Directory                                  */
+	const u8*          data;    /*< Whole archive when in memory, else NULL    */
+	FILE*              file;    /*< Archive file when streamed, else NULL      */
+	void*              owned;   /*< Directory copy read from the file          */
+} pak_t;
+
+/*! \brief Open an archive already in memory (eg. linked in)
+ *  \param data Archive data, used in place and kept until PAK_close
+ *  \param size Archive size
+ *  \return Archive, NULL if the data isn't a supported archive
+ */
+pak_t* PAK_openMemory(const void* data, u32 size);
+
+/*! \brief Open an archive file, only its directory is loaded
+ *  \param path File path on a mounted device (eg. "sd:/hovercraft/assets.pak")
+ *  \return Archive, NULL if the file can't be opened or isn't a supported archive
+ */
+pak_t* PAK_openFile(const char* path);
+
+/*! \brief Close an archive (loaded entries stay valid)
+ *  \param pak Archive to close
+ */
+void PAK_close(pak_t* pak);
+
+/*! \brief Find an entry by name
+ *  \param pak  Archive
+ *  \param name File name the entry was packed from
+ *  \return Entry, NULL if there is none with that name
+ */
+const pakentry_t* PAK_find(pak_t* pak, const char* name);
+
+/*! \brief Buffer size needed to read an entry
+ *  \param pak   Archive
+ *  \param entry Entry to read
+ *  \return Bytes to allocate, a bit more than the entry size when reading from a
+ *          file (packed data is loaded at the end of the buffer and unpacked over itself)
+ */
+u32 PAK_bufferSize(const pak_t* pak, const pakentry_t* entry);
+
+/*! \brief Read and unpack an entry in a buffer
+ *  \param pak        Archive
+ *  \param entry      Entry to read
+ *  \param buffer     Destination, 32 byte aligned for data GX reads
+ *  \param bufferSize Buffer size, at least PAK_bufferSize
+ *  \return TRUE if the entry was read and unpacked (the buffer is flushed from the
+ *          data cache), FALSE on read errors or corrupt data
+ */
+BOOL PAK_read(pak_t* pak, const pakentry_t* entry, void* buffer, u32 bufferSize);
+
+/*! \brief Allocate a buffer and read an entry in it
+ *  \param pak  Archive
+ *  \param name File name the entry was packed from
+ *  \param size If not NULL, receives the entry size
+ *  \return 32 byte aligned data (tagged MEMTAG_ASSETS) to MEMTRACK_free() when done, NULL if it couldn't be loaded
+ */
+void* PAK_load(pak_t* pak, const char* name, u32* size);
+
+#endif
@@ -0,0 +1,95 @@
+/*! \file arena.h
+ *  \brief Arena and per-frame scratch allocators
+ *
+ *  An arena hands out 32 byte aligned blocks from one buffer and frees them
+ *  all at once on reset, so things that live exactly as long as a level (or a
+ *  streamed tile) don't fragment the heap. The scratch allocator is two such
+ *  buffers used on alternate frames: data from one frame stays valid through
+ *  the next (while the GPU may still read it), then its buffer is reused.
+ *
+ *  None of this is thread safe, only the main thread uses arenas and scratch.
+ *
+ *  Building with ALLOC_CHECK=1 wraps the heap functions: while the heap is
+ *  locked (ARENA_lockHeap), heap allocations on the locking thread print the
+ *  caller and stop the game.
+ */
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+#include <gctypes.h>
+
+#define ARENA_ALIGN 32
+
+typedef struct {
+	const char* name;   /*< Shown in reports                       */
+	u8*         base;   /*< Buffer (32 byte aligned)               */
+	u32         size;   /*< Buffer size                            */
+	u32         used;   /*< Bytes handed out since the last reset  */
+	u32         peak;   /*< Most bytes ever in use (high-water mark) */
+	u32         failed; /*< Allocations that didn't fit            */
+} arena_t;
+
+/*! \brief Setup an arena with a buffer from the heap
+ *  \param arena Arena to setup
+ *  \param name  Name for reports (kept)
+ *  \param tag   MEMTAG_* the buffer is counted in
+ *  \param size  Buffer size (rounded up to 32 bytes)
+ *  \return FALSE if there was no memory for the buffer
+ */
+BOOL ARENA_init(arena_t* arena, const char* name, u32 tag, u32 size);
+
+/*! \brief Setup an arena in a buffer owned by the caller
+ *  \param buffer Buffer, 32 byte aligned
+ *  \param size   Buffer size
+ */
+void ARENA_initBuffer(arena_t* arena, const char* name, void* buffer, u32 size);
+
+/*! \brief Allocate a 32 byte aligned block
+ *  \param arena Arena
+ *  \param size  Bytes
+ *  \return Block, NULL if it doesn't fit (counted in failed)
+ */
+void* ARENA_alloc(arena_t* arena, u32 size);
+
+/*! \brief Allocate a zeroed block, see ARENA_alloc
+ */
+void* ARENA_calloc(arena_t* arena, u32 count, u32 size);
+
+/*! \brief Free everything allocated from an arena (the peak is kept)
+ */
+void ARENA_reset(arena_t* arena);
+
+/*! \brief Print how much of an arena is used and its high-water mark
+ */
+void ARENA_report(const arena_t* arena);
+
+/*! \brief Setup the scratch buffers
+ *  \param size Bytes per frame
+ */
+void SCRATCH_init(u32 size);
+
+/*! \brief Start a frame, frees what was allocated two frames ago
+ */
+void SCRATCH_flip();
+
+/*! \brief Allocate a 32 byte aligned block, valid until the end of the next frame
+ *  \return Block, NULL if this frame's buffer is full
+ */
+void* SCRATCH_alloc(u32 size);
+
+/*! \brief Format a string in scratch memory, see SCRATCH_alloc
+ *  \return String, "" if it didn't fit
+ */
+char* SCRATCH_printf(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+/*! \brief Print the scratch high-water mark (most bytes used in one frame)
+ */
+void SCRATCH_report();
+
+/*! \brief Forbid heap allocations on the calling thread (ALLOC_CHECK builds)
+ *  \param locked TRUE during gameplay, FALSE while loading
+ */
+void ARENA_lockHeap(BOOL locked);
+
+#endif
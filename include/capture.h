@@ -0,0 +1,69 @@
+/*! \file capture.h
+ *  \brief GX command stream capture
+ *
+ *  Records everything the CPU sent to the GPU during one frame: the bytes the
+ *  frame wrote into the FIFO, where each split-screen view's commands end, and
+ *  every display list the frame called. The file goes to the SD card, the
+ *  host analyzer (tools/gxcap_src) decodes it into draw calls, state changes
+ *  and redundant writes.
+ *
+ *  Only builds with CAPTURE=1 can capture, otherwise the per frame calls
+ *  expand to nothing. A frame must fit in the FIFO (DEFAULT_FIFO_SIZE in gxutils.c).
+ */
+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+/* File layout, everything big endian:
+ *   captureheader_t, the stream, then per display list its address and size
+ *   (u32 each) and its bytes */
+#define CAPTURE_MAGIC     0x47584346 /*< "GXCF" */
+#define CAPTURE_VERSION   1
+#define CAPTURE_MAX_VIEWS 4
+
+/* Most different display lists kept from a frame */
+#define CAPTURE_MAX_LISTS 1024
+
+typedef struct {
+	unsigned int magic;                        /*< CAPTURE_MAGIC                               */
+	unsigned int version;                      /*< CAPTURE_VERSION                             */
+	unsigned int frame;                        /*< Capture number                              */
+	unsigned int viewCount;
+	unsigned int viewEnds[CAPTURE_MAX_VIEWS];  /*< Stream offset where each view's commands end */
+	unsigned int streamSize;
+	unsigned int listCount;
+} captureheader_t;
+
+#ifdef CAPTURE
+
+/*! \brief Capture the next frame
+ */
+void CAPTURE_request();
+
+/*! \brief A frame starts, call before anything is drawn
+ */
+void CAPTURE_begin();
+
+/*! \brief Mark the end of a view's commands
+ *  \param view Split-screen view, 0 to CAPTURE_MAX_VIEWS - 1
+ */
+void CAPTURE_view(unsigned int view);
+
+/*! \brief Check if this frame is being captured
+ */
+int CAPTURE_active();
+
+/*! \brief Write the frame to the SD card, once GXU_done returned
+ *  \return 1 if a file was written
+ */
+int CAPTURE_end();
+
+#else
+
+#define CAPTURE_request()
+#define CAPTURE_begin()
+#define CAPTURE_view(view)
+
+#endif
+
+#endif
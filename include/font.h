@@ -21,6 +21,17 @@ typedef struct {
 	GXColor color;
 } font_t;
 
+/*! Static text, compiled into a display list */
+typedef struct {
+	font_t* font;             /*< Font used to compile the text      */
+	char*   message;          /*< Compiled message (owned copy)      */
+	BOOL    center;           /*< Center the text                    */
+	void*   dispList;         /*< Display list with the glyph quads  */
+	u32     dispListSize;     /*< Real display list size             */
+	u32     dispListCapacity; /*< Allocated display list size        */
+	BOOL    queued;           /*< Drawn since it was compiled        */
+} text_t;
+
 /*! \brief Initialize font subsystem (requires GXU)
  */
 void FONT_init();
@@ -36,6 +47,17 @@ void FONT_init();
  */
 font_t* FONT_load(GXTexObj* texture, const char* chars, const u16 charWidth, const u16 charHeight, const u16 texSize, const f32 scale);
 
+/*! \brief Load a font from part of a texture (eg. an atlas slot)
+ *  \param texture    Texture holding the font image
+ *  \param rect       Where the font image is in the texture
+ *  \param chars      Character order (required for UV generation)
+ *  \param charWidth  Width of each character
+ *  \param charHeight Height of each character
+ *  \param texSize    Font image size (before packing)
+ *  \param scale      Font scaling
+ */
+font_t* FONT_loadRect(GXTexObj* texture, const uvrect_t* rect, const char* chars, const u16 charWidth, const u16 charHeight, const u16 texSize, const f32 scale);
+
 /*! \brief Draws a message using the provided font
  *  \param font    Font to use
  *  \param message Message to write
@@ -47,6 +69,33 @@ void FONT_draw(font_t* font, const char* message, f32 x, f32 y, BOOL center);
 
 void FONT_drawScroller(font_t* font, const char* message, f32 x, f32 y, f32 padding, f32 freq, f32 amplitude, f32 offset);
 
+/*! \brief Compile a message into a reusable text object
+ *  \param font    Font to use
+ *  \param message Message to write
+ *  \param center  Center the text
+ *  \return Pointer to the text object
+ */
+text_t* FONT_createText(font_t* font, const char* message, BOOL center);
+
+/*! \brief Change a text object's message (recompiles only if it differs)
+ *  Waits for the GPU if the text was drawn since it was last compiled
+ *  \param text    Text object to update
+ *  \param message New message
+ */
+void FONT_setText(text_t* text, const char* message);
+
+/*! \brief Draws a compiled text object (one display list call)
+ *  \param text Text object to draw
+ *  \param x    X coordinate
+ *  \param y    Y coordinate
+ */
+void FONT_drawText(text_t* text, f32 x, f32 y);
+
+/*! \brief Frees a text object (but not its font)
+ *  \param text Text object to destroy
+ */
+void FONT_freeText(text_t* text);
+
 /*! \brief Frees font data
  *  \param font Font structure to destroy
  */
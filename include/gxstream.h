@@ -0,0 +1,115 @@
+/*! \file gxstream.h
+ *  \brief Decoder for the GX command stream
+ *
+ *  Walks the commands the CPU sends to the GPU (what ends up in the FIFO and
+ *  in display lists): register loads of the command processor (CP), the
+ *  transform unit (XF) and the rasterizer/pixel engine (BP), display list
+ *  calls and draws. A draw's size depends on the vertex descriptor and format
+ *  set before it, so the CP registers that hold them are tracked as they go by.
+ *
+ *  Plain C with no SDK types, the capture (capture.c) uses it to find the
+ *  display lists a frame calls and the host analyzer (tools/gxcap_src) to
+ *  decode the whole capture. Everything in the stream is big endian.
+ */
+
+#ifndef _GXSTREAM_H
+#define _GXSTREAM_H
+
+/* Opcodes */
+#define GXS_OP_NOP          0x00
+#define GXS_OP_LOAD_CP      0x08
+#define GXS_OP_LOAD_XF      0x10
+#define GXS_OP_LOAD_INDX_A  0x20 /*< Position matrices from memory  */
+#define GXS_OP_LOAD_INDX_B  0x28 /*< Normal matrices from memory    */
+#define GXS_OP_LOAD_INDX_C  0x30 /*< Texture matrices from memory   */
+#define GXS_OP_LOAD_INDX_D  0x38 /*< Lights from memory             */
+#define GXS_OP_CALL_DL      0x40
+#define GXS_OP_METRICS      0x44
+#define GXS_OP_INVAL_VTX    0x48
+#define GXS_OP_LOAD_BP      0x61
+#define GXS_OP_DRAW         0x80 /*< 0x80-0xBF, primitive | format  */
+
+/* CP registers the vertex size depends on */
+#define GXS_CP_VCD_LO 0x50
+#define GXS_CP_VCD_HI 0x60
+#define GXS_CP_VAT_A  0x70 /*< + format */
+#define GXS_CP_VAT_B  0x80
+#define GXS_CP_VAT_C  0x90
+
+/* Command types */
+enum {
+	GXS_NOP       = 0,
+	GXS_CP        = 1, /*< address: register, value                          */
+	GXS_XF        = 2, /*< address: first XF address, count: words            */
+	GXS_XF_INDEX  = 3, /*< address: XF address, count: words, value: index    */
+	GXS_CALL_DL   = 4, /*< address: physical address, count: bytes            */
+	GXS_INVAL_VTX = 5,
+	GXS_BP        = 6, /*< address: register, value (24 bits)                 */
+	GXS_DRAW      = 7, /*< address: primitive, value: format, count: vertices */
+	GXS_OTHER     = 8  /*< One byte opcode with no payload (eg. metrics)      */
+};
+
+/* GXS_next results */
+enum {
+	GXS_END       = 0, /*< No more commands                                   */
+	GXS_OK        = 1,
+	GXS_TRUNCATED = -1, /*< Command goes past the end of the stream            */
+	GXS_UNKNOWN   = -2, /*< Not an opcode                                      */
+	GXS_NO_FORMAT = -3  /*< Draw before its vertex descriptor or format was set */
+};
+
+/*! Bytes to decode, offsets can wrap around a ring (eg. the FIFO) */
+typedef struct {
+	const unsigned char* base;
+	unsigned int         ring;   /*< Offsets wrap at this, the length for plain buffers */
+	unsigned int         start;  /*< Offset of the first byte                            */
+	unsigned int         length; /*< Bytes in the stream                                 */
+} gxbytes_t;
+
+/*! Vertex descriptor and formats, as far as the stream has set them */
+typedef struct {
+	unsigned int vcdLo, vcdHi;
+	unsigned int vat[8][3];
+	unsigned int known; /*< Bit 0 VCD lo, bit 1 VCD hi, bits 2 + format * 3 + group the VATs */
+} gxvtxstate_t;
+
+typedef struct {
+	unsigned int type;       /*< GXS_*                                     */
+	unsigned int opcode;
+	unsigned int offset;     /*< Of the opcode in the stream               */
+	unsigned int size;       /*< Bytes, payload included                   */
+	unsigned int address;    /*< See the command types                     */
+	unsigned int value;
+	unsigned int count;
+	unsigned int vertexSize; /*< Bytes per vertex of a draw                */
+} gxcommand_t;
+
+/*! \brief Read a byte, or a big endian 16 or 32 bit value, at an offset (wraps around the ring)
+ */
+unsigned int GXS_read8(const gxbytes_t* bytes, unsigned int offset);
+unsigned int GXS_read16(const gxbytes_t* bytes, unsigned int offset);
+unsigned int GXS_read32(const gxbytes_t* bytes, unsigned int offset);
+
+/*! \brief Setup bytes for a plain buffer
+ */
+void GXS_bytes(gxbytes_t* bytes, const void* data, unsigned int length);
+
+/*! \brief Forget the vertex state, draws can't be decoded until it's set again
+ */
+void GXS_reset(gxvtxstate_t* state);
+
+/*! \brief Bytes per vertex of a format with the current descriptor
+ *  \return Size, 0 if the descriptor or format isn't known yet
+ */
+unsigned int GXS_vertexSize(const gxvtxstate_t* state, unsigned int format);
+
+/*! \brief Decode the command at an offset and track the vertex state it sets
+ *  \param state   Vertex state, updated by CP loads
+ *  \param bytes   Stream
+ *  \param offset  Offset of the command, moved past it
+ *  \param command Decoded command
+ *  \return GXS_OK, GXS_END at the end of the stream, or an error (GXS_TRUNCATED...)
+ */
+int GXS_next(gxvtxstate_t* state, const gxbytes_t* bytes, unsigned int* offset, gxcommand_t* command);
+
+#endif
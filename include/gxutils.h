@@ -17,6 +17,12 @@ typedef struct {
 	Mtx44    perspectiveMtx; /*< Perspective Matrix */
 } camera_t;
 
+/*! Part of a texture in UVs, eg. an atlas slot (from the <id>Rect defines of textures.h) */
+typedef struct {
+	f32 u, v;          /*< Top left corner */
+	f32 width, height; /*< Size            */
+} uvrect_t;
+
 /* Frame time (1/60 or 1/50 depending on video mode) */
 f32 frameTime;
 
@@ -24,6 +30,12 @@ f32 frameTime;
  */
 void GXU_init();
 
+/*! \brief Open a TPL file to load textures from
+ *  \param data TPL data, texture objects use it in place so it has to stay loaded
+ *  \param size TPL size
+ */
+void GXU_openTPL(void* data, u32 size);
+
 void GXU_closeTPL();
 
 /*! \brief Load texture from Id
@@ -32,6 +44,21 @@ void GXU_closeTPL();
  */
 void GXU_loadTexture(s32 texId, GXTexObj* texObj);
 
+/*! \brief Load a texture object in a texture map, unless it is already there
+ *  \param texObj Texture object to load
+ *  \param mapId  Texture map (GX_TEXMAP0..GX_TEXMAP7)
+ *  \remarks Textures sharing an atlas page share one texture object, so drawing
+ *           them one after another doesn't reload anything. The cache is keyed by
+ *           pointer, GXU_openTPL, GXU_loadTexture and the start of every frame
+ *           reset it. Call GXU_invalidateTextures after changing a loaded texture
+ *           object any other way.
+ */
+void GXU_bindTexture(GXTexObj* texObj, u8 mapId);
+
+/*! \brief Forget which texture objects are loaded (next binds always load)
+ */
+void GXU_invalidateTextures();
+
 /*! \brief Set light color
  *  \param view View matrix
  *  \param lightColor Light color
@@ -61,6 +88,25 @@ f32 GXU_getAspectRatio();
  */
 void GXU_done();
 
+/*! \brief How long the last GXU_done waited
+ *  \param[out] gpuMicros   Waiting for the GPU to finish (GX_DrawDone)
+ *  \param[out] vsyncMicros Waiting for the retrace
+ */
+void GXU_frameWaits(u32* gpuMicros, u32* vsyncMicros);
+
+/*! \brief HUD counter source reading the GX performance counters
+ *
+ *  Counts triangles and vertices per view (GX_SetGPMetric) with a draw sync
+ *  token at the end of each view, so the GPU is never waited on. FIFO bytes
+ *  come from the CPU FIFO's write pointer, sampled at the start, after every
+ *  view and at the end of the frame. The FIFO is a ring, so the pointer can't
+ *  tell a stretch that went around it whole: a single view (or the overlay
+ *  after the last one) writing more than the FIFO size (256 KB) is counted a
+ *  lap short. Readings are complete once GXU_done returns.
+ *  \return Source for HUD_init (hudsource_t, see perfhud.h)
+ */
+const struct hudsource* GXU_metricSource();
+
 /*! \brief Setup player camera (including split screen mode)
  *  \param[in,out] camera      Camera to setup
  *  \param[in]     splitType   Type of split (total number of players)
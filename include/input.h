@@ -24,6 +24,20 @@
 #endif
 #define INPUT_GC_BTN_JUMP PAD_BUTTON_X
 
+/* Debug combos, held together (see INPUT_comboPressed) */
+#ifdef WII
+#define INPUT_WII_COMBO_TRACE (WPAD_BUTTON_MINUS | WPAD_BUTTON_DOWN)
+#define INPUT_WII_COMBO_HUD   (WPAD_BUTTON_MINUS | WPAD_BUTTON_UP)
+#define INPUT_WII_COMBO_CAPTURE (WPAD_BUTTON_MINUS | WPAD_BUTTON_LEFT)
+#else
+#define INPUT_WII_COMBO_TRACE 0
+#define INPUT_WII_COMBO_HUD   0
+#define INPUT_WII_COMBO_CAPTURE 0
+#endif
+#define INPUT_GC_COMBO_TRACE (PAD_TRIGGER_Z | PAD_BUTTON_DOWN)
+#define INPUT_GC_COMBO_HUD   (PAD_TRIGGER_Z | PAD_BUTTON_UP)
+#define INPUT_GC_COMBO_CAPTURE (PAD_TRIGGER_Z | PAD_BUTTON_LEFT)
+
 
 typedef enum {
 	INPUT_CONTROLLER_GAMECUBE = 0,  /*< Gamecube controller */
@@ -81,4 +95,11 @@ BOOL INPUT_jump(controller_t* controller);
  */
 BOOL INPUT_checkControllers();
 
+/*! \brief Checks if any controller just completed a button combo
+ *  \param gcCombo  Gamecube pad buttons (PAD_BUTTON_*) held together
+ *  \param wiiCombo Wiimote buttons (WPAD_BUTTON_*) held together, ignored on Gamecube
+ *  \return TRUE on the frame the last button of the combo went down, FALSE otherwise
+ */
+BOOL INPUT_comboPressed(u32 gcCombo, u32 wiiCombo);
+
 #endif
\ No newline at end of file
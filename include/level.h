@@ -0,0 +1,133 @@
+/*! \file level.h
+ *  \brief Level data (.blv made by obj2bin --level)
+ *
+ *  The file is used in place: arrays are stored as offsets that LEVEL_load
+ *  turns into pointers, everything else (ground heights, checkpoint spots)
+ *  was worked out by the tool. The terrain, its heightfield and the props are
+ *  cut in tiles (.btl) that are streamed in around the players (see world.h).
+ */
+
+#ifndef _LEVEL_H
+#define _LEVEL_H
+
+#include <gctypes.h>
+#include <ogc/gu.h>
+
+#define LEVEL_MAGIC       0x424C564C /*< "BLVL" */
+#define LEVEL_VERSION     2
+#define TILE_MAGIC        0x4254494C /*< "BTIL" */
+#define TILE_VERSION      1
+#define LEVEL_NAME_LENGTH 32
+
+/*! Height of heightfield samples with no terrain under them */
+#define LEVEL_NO_GROUND -1e30f
+
+/* How a heightfield cell is split in two triangles */
+#define LEVEL_SPLIT_FALLING 0 /*< Diagonal from sample (x, z) to (x + 1, z + 1) */
+#define LEVEL_SPLIT_RISING  1 /*< Diagonal from sample (x + 1, z) to (x, z + 1) */
+
+/* Object roles */
+enum {
+	LEVEL_ROLE_TERRAIN    = 0, /*< Cut in tiles, the heightfield is made from it    */
+	LEVEL_ROLE_WATER      = 1, /*< Drawn unlit, its height is the water level       */
+	LEVEL_ROLE_PROP       = 2, /*< Drawn lit, stored with the tile it stands on     */
+	LEVEL_ROLE_CHECKPOINT = 3  /*< Drawn additive, position is from the checkpoint  */
+};
+
+typedef struct {
+	char     model[LEVEL_NAME_LENGTH]; /*< Model entry name                            */
+	u32      role;                     /*< LEVEL_ROLE_*                                */
+	guVector position;                 /*< World position (checkpoint: offset from it at water level) */
+	guVector scale;                    /*< Scale                                       */
+	f32      spin;                     /*< Rotation around Y per second                */
+} levelobject_t;
+
+typedef struct {
+	guVector min; /*< Lowest corner  */
+	guVector max; /*< Highest corner */
+} levelarea_t;
+
+typedef struct {
+	f32 x; /*< World X */
+	f32 z; /*< World Z */
+} levelpoint_t;
+
+/*! Ground heights on a grid, each cell is two triangles */
+typedef struct {
+	f32  originX;  /*< World position of sample 0                          */
+	f32  originZ;
+	f32  cellSize; /*< Distance between samples                            */
+	u32  width;    /*< Samples along X                                     */
+	u32  depth;    /*< Samples along Z                                     */
+	f32* heights;  /*< [depth][width], LEVEL_NO_GROUND without terrain     */
+	s8*  normals;  /*< [depth][width][4], x y z * 127 and the LEVEL_SPLIT_* */
+} levelground_t;
+
+/*! Level, the loaded file itself */
+typedef struct {
+	u32            magic;           /*< LEVEL_MAGIC                         */
+	u16            version;         /*< LEVEL_VERSION                       */
+	u16            objectCount;
+	u32            size;            /*< File size                           */
+	levelobject_t* objects;         /*< Models placed in the level          */
+	u32            pickupCount;
+	guVector*      pickups;         /*< Pickup positions                    */
+	u32            spawnCount;
+	levelarea_t*   spawns;          /*< Areas players start in              */
+	u32            checkpointCount;
+	levelpoint_t*  checkpoints;     /*< Where the checkpoint can go         */
+	char           pickupModel[LEVEL_NAME_LENGTH];
+	f32            pickupSpin;      /*< Pickup rotation around Y per second */
+	f32            waterLevel;      /*< Nothing goes below it               */
+	guVector       camera;          /*< Spectator camera position           */
+	guVector       cameraTarget;    /*< Spectator camera target             */
+	f32            streamRadius;    /*< Tiles this close to a player are loaded */
+	u32            streamBudget;    /*< Most bytes of tiles loaded at once  */
+	u32            streamSlots;     /*< Most tiles loaded at once           */
+	char           tileName[LEVEL_NAME_LENGTH]; /*< Tile entries are "<tileName>_<x>_<z>.btl" */
+	f32            tileOriginX;     /*< Tile (x, z) covers origin + [x, x + 1) * tileSize */
+	f32            tileOriginZ;
+	f32            tileSize;
+	u32            tilesX;
+	u32            tilesZ;
+	u32*           tileSizes;       /*< [tilesZ][tilesX] entry size, 0 where there is no tile */
+} level_t;
+
+/*! Level tile, the loaded file itself */
+typedef struct {
+	u32            magic;           /*< TILE_MAGIC                          */
+	u16            version;         /*< TILE_VERSION                        */
+	u16            objectCount;
+	u32            size;            /*< File size                           */
+	levelobject_t* objects;         /*< Props standing on the tile          */
+	u8*            mesh;            /*< Terrain .bmb, positions from the ground origin (NULL if none) */
+	u32            meshSize;
+	char           terrain[LEVEL_NAME_LENGTH]; /*< Terrain model the mesh was cut from */
+	levelground_t  ground;          /*< Heightfield under the tile, edge samples are in both neighbours */
+} leveltile_t;
+
+/*! \brief Use a loaded .blv as level
+ *  \param data Whole file, kept until the level isn't needed (it's used in place)
+ *  \param size File size
+ *  \return Level (at data), NULL if the data isn't a valid level
+ */
+level_t* LEVEL_load(void* data, u32 size);
+
+/*! \brief Use a loaded .btl as level tile
+ *  \param data Whole file, kept while the tile is loaded (it's used in place)
+ *  \param size File size
+ *  \return Tile (at data), NULL if the data isn't a valid tile
+ */
+leveltile_t* LEVEL_loadTile(void* data, u32 size);
+
+/*! \brief Ground under a point
+ *  \param[in]  ground Heightfield (of a tile)
+ *  \param[in]  x      World X
+ *  \param[in]  z      World Z
+ *  \param[out] height Ground height
+ *  \param[out] normal Ground normal (NULL if you don't need it)
+ *  \return TRUE if there is ground there, FALSE outside the terrain (or the heightfield)
+ */
+BOOL LEVEL_ground(const levelground_t* ground, f32 x, f32 z, f32* height, guVector* normal);
+
+#endif
@@ -0,0 +1,85 @@
+/*! \file loader.h
+ *  \brief Background asset loading
+ *
+ *  Requests go through a lock-free queue to a loader thread that reads and
+ *  unpacks archive entries (and sets models up) while the game keeps drawing.
+ *  Each request returns a handle the game polls once a frame.
+ */
+
+#ifndef _LOADER_H
+#define _LOADER_H
+
+#include <gctypes.h>
+#include "archive.h"
+#include "arena.h"
+#include "model.h"
+
+/*! Requests that can wait in the queue */
+#define LOADER_QUEUE_SIZE 32
+
+/*! Handles that can be in use (requested and not released yet) */
+#define LOADER_HANDLES (LOADER_QUEUE_SIZE * 2)
+
+/*! Handle states */
+enum {
+	LOAD_PENDING = 0, /*< Queued or loading         */
+	LOAD_DONE    = 1, /*< Results are valid         */
+	LOAD_FAILED  = 2  /*< Missing or corrupt entry  */
+};
+
+/*! Load handle, the loader thread only writes the results before setting state */
+typedef struct {
+	u32      state; /*< LOAD_*                                              */
+	void*    data;  /*< Entry data (32 byte aligned, models use it in place), MEMTRACK_free it unless it's from an arena */
+	u32      size;  /*< Entry size                                          */
+	model_t* model; /*< Model, for LOADER_loadModel requests                */
+	arena_t* arena; /*< Arena data and model come from, NULL: the heap      */
+} loadhandle_t;
+
+/*! \brief Start the loader thread
+ *  \param pak Archive to load from, the loader thread reads it until LOADER_shutdown
+ *             (don't read entries of a file archive from another thread meanwhile)
+ */
+void LOADER_init(pak_t* pak);
+
+/*! \brief Wait for queued requests and stop the loader thread
+ */
+void LOADER_shutdown();
+
+/*! \brief Queue an entry to be loaded
+ *  \param name Entry name
+ *  \return Handle to poll, NULL if the queue is full or every handle is in use
+ */
+loadhandle_t* LOADER_load(const char* name);
+
+/*! \brief Queue a model to be loaded and set up
+ *  \param name Entry name of the .bmb
+ *  \return Handle to poll, NULL if the queue is full or every handle is in use
+ */
+loadhandle_t* LOADER_loadModel(const char* name);
+
+/*! \brief Queue a model to be loaded in an arena
+ *  \param arena Arena for the entry data and the model's tables (main thread only,
+ *               the buffer is taken now and the model set up by LOADER_poll)
+ *  \param name  Entry name of the .bmb
+ *  \return Handle to poll, NULL if the entry is missing, doesn't fit the arena,
+ *          the queue is full or every handle is in use
+ */
+loadhandle_t* LOADER_loadModelIn(arena_t* arena, const char* name);
+
+/*! \brief Check a request (main thread only)
+ *  \param handle Handle from LOADER_load, LOADER_loadModel or LOADER_loadModelIn
+ *  \return TRUE once it's finished (LOAD_DONE or LOAD_FAILED), the results can be read then
+ */
+BOOL LOADER_poll(loadhandle_t* handle);
+
+/*! \brief Free a finished handle (its data and model are kept)
+ *  \param handle Handle LOADER_poll said is finished
+ */
+void LOADER_release(loadhandle_t* handle);
+
+/*! \brief Requests the loader thread hasn't finished yet
+ */
+u32 LOADER_pending();
+
+#endif
@@ -0,0 +1,92 @@
+/*! \file memtrack.h
+ *  \brief Heap use per subsystem
+ *
+ *  Game code allocates through these wrappers instead of malloc and friends.
+ *  Every block is tagged with the subsystem it's for, and each tag keeps its
+ *  bytes in use, its peak and how many allocations the last frame made, so
+ *  hot-path mallocs show up. Memory that doesn't come from the wrappers (eg.
+ *  framebuffers) can be added by hand.
+ *
+ *  Plain C with no SDK types, the report reads the same on the console and in
+ *  a host build. The wrappers can be called from any thread.
+ */
+
+#ifndef _MEMTRACK_H
+#define _MEMTRACK_H
+
+/* Tags */
+enum {
+	MEMTAG_GX          = 0,  /*< GX FIFO                              */
+	MEMTAG_VIDEO       = 1,  /*< Framebuffers                         */
+	MEMTAG_TEXTURE     = 2,  /*< TPL data                             */
+	MEMTAG_MODEL       = 3,  /*< Model files and their tables         */
+	MEMTAG_OBJECT      = 4,  /*< Objects and sprites                  */
+	MEMTAG_LEVEL       = 5,  /*< Level, its tiles and arenas          */
+	MEMTAG_FONT        = 6,  /*< Fonts and texts                      */
+	MEMTAG_DISPLAYLIST = 7,  /*< Compiled display lists               */
+	MEMTAG_AUDIO       = 8,  /*< Music data                           */
+	MEMTAG_ASSETS      = 9,  /*< Archive, entries not claimed yet     */
+	MEMTAG_SCRATCH     = 10, /*< Per-frame scratch buffers            */
+	MEMTAG_COUNT       = 11
+};
+
+typedef struct {
+	const char*  name;      /*< Tag name                                */
+	unsigned int current;   /*< Bytes in use                            */
+	unsigned int peak;      /*< Most bytes ever in use                  */
+	unsigned int blocks;    /*< Blocks in use                           */
+	unsigned int lastFrame; /*< Allocations during the last frame       */
+	unsigned int worstFrame;/*< Most allocations during one frame       */
+} memtagstats_t;
+
+/*! \brief Allocate a tagged block (malloc)
+ *  \return Block, NULL if there's no memory
+ */
+void* MEMTRACK_alloc(unsigned int tag, unsigned int size);
+
+/*! \brief Allocate a zeroed tagged block (calloc)
+ */
+void* MEMTRACK_calloc(unsigned int tag, unsigned int count, unsigned int size);
+
+/*! \brief Allocate an aligned tagged block (memalign)
+ *  \param align Power of two
+ */
+void* MEMTRACK_memalign(unsigned int tag, unsigned int align, unsigned int size);
+
+/*! \brief Copy a string into a tagged block (strdup)
+ */
+char* MEMTRACK_strdup(unsigned int tag, const char* text);
+
+/*! \brief Free a block from the wrappers (free), NULL is ignored
+ */
+void MEMTRACK_free(void* block);
+
+/*! \brief Move a block to another tag (eg. a loaded entry once it's known to be a model)
+ */
+void MEMTRACK_retag(void* block, unsigned int tag);
+
+/*! \brief Count memory allocated some other way
+ *  \param size Bytes, negative once it's freed
+ */
+void MEMTRACK_add(unsigned int tag, int size);
+
+/*! \brief Start a new frame for the per-frame allocation counts
+ */
+void MEMTRACK_frame();
+
+/*! \brief Read a tag's numbers
+ */
+void MEMTRACK_stats(unsigned int tag, memtagstats_t* stats);
+
+/*! \brief Write the report as text, one line per tag (only uses characters the game font has)
+ *  \param buffer Where the text goes
+ *  \param size   Buffer size
+ *  \return Length of the text
+ */
+unsigned int MEMTRACK_format(char* buffer, unsigned int size);
+
+/*! \brief Print the report to the console
+ */
+void MEMTRACK_print();
+
+#endif
@@ -7,52 +7,171 @@
 
 #include <gctypes.h>
 #include <gccore.h>
+#include "arena.h"
 
+#define BMB_MAGIC   0x424D4246 /*< "BMBF" */
+#define BMB_VERSION 1
+
+/* Section types, sections of other types are skipped */
+enum {
+	BMB_SECTION_MESH        = 1, /*< binmesh_t                          */
+	BMB_SECTION_POSITIONS   = 2, /*< Position array                     */
+	BMB_SECTION_NORMALS     = 3, /*< Normal array                       */
+	BMB_SECTION_TEXCOORDS   = 4, /*< UV array                           */
+	BMB_SECTION_INDICES     = 5, /*< Reserved                           */
+	BMB_SECTION_BOUNDS      = 6, /*< binbounds_t                        */
+	BMB_SECTION_BVH         = 7, /*< Reserved                           */
+	BMB_SECTION_DISPLAYLIST = 8, /*< Precompiled primitives             */
+	BMB_SECTION_LOD         = 9, /*< Reserved                           */
+	BMB_SECTION_MATERIALS   = 10 /*< binmaterial_t table                */
+};
+
+/* File header, followed by the section table */
 typedef struct {
-	unsigned int vcount;  /*< Vertex count        */
-	unsigned int ncount;  /*< Normal count        */
-	unsigned int vtcount; /*< UV Coordinate count */
-	unsigned int fcount;  /*< Face/Index count    */
+	u32 magic;        /*< BMB_MAGIC                     */
+	u16 version;      /*< BMB_VERSION                   */
+	u16 sectionCount; /*< Entries in the section table  */
+	u32 submeshCount; /*< Submeshes                     */
+	u32 size;         /*< File size                     */
+	u32 reserved[4];
 } binheader_t;
 
+typedef struct {
+	u32 type;    /*< BMB_SECTION_*                          */
+	u32 submesh; /*< Submesh the section belongs to         */
+	u32 offset;  /*< From the file start, 32 byte aligned   */
+	u32 size;    /*< Payload size                           */
+} binsection_t;
+
+typedef struct {
+	unsigned int vcount;  /*< Vertex count                    */
+	unsigned int ncount;  /*< Normal count                    */
+	unsigned int vtcount; /*< UV Coordinate count             */
+	unsigned int fcount;  /*< Face/Index count                */
+	u8 posType, posFrac;  /*< Position format (GX_S16/GX_F32) */
+	u8 nrmType, nrmFrac;  /*< Normal format (GX_S8/GX_F32..)  */
+	u8 texType, texFrac;  /*< UV format (GX_U16/GX_F32..)     */
+	u16 material;         /*< Entry in the material table     */
+} binmesh_t;
+
+typedef struct {
+	char name[32];    /*< Material name                       */
+	char texture[32]; /*< Diffuse texture file name, or empty */
+} binmaterial_t;
+
+typedef struct {
+	guVector min; /*< Smallest position */
+	guVector max; /*< Largest position  */
+} binbounds_t;
+
+/* Same order as the vertex data in the display lists */
 typedef struct {
 	u16 vertex;
-	u16 uv;
 	u16 normal;
+	u16 uv;
 } index_t;
 
+/* A primitive read back from a display list */
+typedef struct {
+	u8        primitive; /*< GX_TRIANGLES or GX_TRIANGLESTRIP      */
+	u16       count;     /*< Vertices                              */
+	const u8* vertices;  /*< index_t each, not necessarily aligned */
+} primitive_t;
+
+typedef struct {
+	void* positions;
+	void* normals;
+	void* texcoords;
+
+	void* dispList;     /*< Precompiled primitives, in the model data */
+	u32   dispListSize; /*< Display list size                         */
+
+	const binbounds_t* bounds; /*< Bounding box (NULL if not in the file) */
+	u16 material;              /*< Material (texture) used               */
+
+	u8  positionType, positionFrac; /*< Position format (GX_S16, GX_F32..) */
+	u8  normalType, normalFrac;     /*< Normal format (GX_S8, GX_F32..)    */
+	u8  texcoordType, texcoordFrac; /*< UV format (GX_U16, GX_F32..)       */
+	f32 positionScale;  /*< Dequantization scale for positions */
+	f32 normalScale;    /*< Dequantization scale for normals   */
+} submesh_t;
+
 typedef struct {
-	GXTexObj* textureObject; /*< Texture Object	               */
-	void*     modelList;     /*< Storage for the display lists */
-	u32       modelListSize; /*< Real display list sizes       */
+	u32                  materialCount; /*< Materials, at least 1                    */
+	const binmaterial_t* materials;     /*< Material table (NULL if not in the file) */
+	GXTexObj**           textures;      /*< Texture of each material                 */
 
-	u32  modelFaceCount; /*< Amount of triangles */
-	f32* modelPositions;
-	f32* modelNormals;
-	f32* modelTexcoords;
-	index_t* modelIndices;
+	u32        modelFaceCount; /*< Amount of triangles                          */
+	u32        submeshCount;   /*< Parts with their own (16-bit indexed) arrays */
+	submesh_t* submeshes;
 } model_t;
 
 /*! \brief Create a new model from mesh data
  *	\param model_bmb Mesh data generated by obj2bin
- *	\return Pointer to model struct
+ *	\param size      Bytes of mesh data there are
+ *	\return Pointer to model struct, NULL if the data isn't a supported .bmb or is broken
+ */
+model_t* MODEL_setup(const u8* model_bmb, u32 size);
+
+/*! \brief Create a new model from mesh data, with its tables in an arena
+ *	\param arena     Arena (freed with it, don't MODEL_destroy the model), NULL for the heap
+ *	\param model_bmb Mesh data generated by obj2bin
+ *	\param size      Bytes of mesh data there are
+ *	\return Pointer to model struct, NULL if the data isn't a supported .bmb, is broken or the arena is full
  */
-model_t* MODEL_setup(const u8* model_bmb);
+model_t* MODEL_setupIn(arena_t* arena, const u8* model_bmb, u32 size);
 
 /*! \brief Destroy a model and free his allocated memory
  *	\param model Model to destroy
  */
 void MODEL_destroy(model_t* model);
 
-/*! \brief Render a model on screen (calls his Draw list)
+/*! \brief Render a model on screen (sets its arrays and calls the display lists)
  *	\param model Model to render
  */
 void MODEL_render(model_t* model);
 
-/*! \brief Set model's texture (1 texture per model currently supported)
+/*! \brief Read a position from a submesh's (possibly quantized) vertex data
+ *  \param[in]  submesh Submesh to read from
+ *  \param[in]  index   Position index
+ *  \param[out] out     Position as floats
+ */
+void MODEL_getPosition(submesh_t* submesh, u32 index, guVector* out);
+
+/*! \brief Read a normal from a submesh's (possibly quantized) vertex data
+ *  \param[in]  submesh Submesh to read from
+ *  \param[in]  index   Normal index
+ *  \param[out] out     Normal as floats
+ */
+void MODEL_getNormal(submesh_t* submesh, u32 index, guVector* out);
+
+/*! \brief Read the next primitive of a submesh's display list
+ *  \param[in]     submesh Submesh to read from
+ *  \param[in,out] cursor  Byte offset in the display list, start at 0
+ *  \param[out]    out     Primitive found
+ *  \return FALSE when there are no primitives left
+ */
+BOOL MODEL_nextPrimitive(submesh_t* submesh, u32* cursor, primitive_t* out);
+
+/*! \brief Get the indices of one vertex of a primitive
+ *  \param[in]  primitive Primitive from MODEL_nextPrimitive
+ *  \param[in]  vertex    Vertex number in the primitive
+ *  \param[out] out       Indices of the vertex
+ */
+void MODEL_getIndex(primitive_t* primitive, u32 vertex, index_t* out);
+
+/*! \brief Set the texture of every material of a model
  *  \param model Model to assign the texture to
  *  \param textureObject Texture object to assign
  */
 void MODEL_setTexture(model_t* model, GXTexObj* textureObject);
 
+/*! \brief Set the texture of one material of a model
+ *  \param model Model to assign the texture to
+ *  \param material Material name, as exported by obj2bin
+ *  \param textureObject Texture object to assign
+ *  \return FALSE if the model has no such material
+ */
+BOOL MODEL_setMaterialTexture(model_t* model, const char* material, GXTexObj* textureObject);
+
 #endif
@@ -32,6 +32,13 @@ typedef struct {
 */
 object_t* OBJECT_create(model_t* mesh);
 
+/*! \brief Create Object from mesh with default transforms in an arena
+*  \param arena Arena (freed with it, don't OBJECT_destroy the object), NULL for the heap
+*  \param mesh  Model to use
+*  \return Pointer to Object structure, NULL if the arena is full
+*/
+object_t* OBJECT_createIn(arena_t* arena, model_t* mesh);
+
 /*! \brief Create Object from mesh and basic transform data
  *  \param mesh     Model to use
  *  \param position Initial position in the world
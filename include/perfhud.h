@@ -0,0 +1,131 @@
+/*! \file perfhud.h
+ *  \brief Performance overlay: frame phases and GPU counters
+ *
+ *  The game reports how long each phase of a frame took, and a counter
+ *  source reports what the GPU did for each split-screen view (on the console
+ *  the GX performance counters, see GXU_metricSource). The last HUD_WINDOW
+ *  frames are kept for every number, and every HUD_REFRESH frames the text is
+ *  rebuilt with their min, average and max, so formatting stays out of most
+ *  frames.
+ *
+ *  The overlay times itself: the hud phase is everything it costs the CPU on
+ *  the console (bookkeeping, formatting, the text and per-view readouts),
+ *  while the GPU drawing its text shows up in the gpu wait.
+ *
+ *  Plain C with no SDK types, so the host tools can build it and drive it with
+ *  a stand-in source. The text only uses characters the game font has, and is
+ *  formatted with integers only: printing floats goes through newlib's dtoa,
+ *  which allocates, and the heap is locked during gameplay.
+ */
+
+#ifndef _PERFHUD_H
+#define _PERFHUD_H
+
+#define HUD_WINDOW        64  /*< Frames the min, avg and max are over      */
+#define HUD_REFRESH       15  /*< Frames between text updates               */
+#define HUD_MAX_VIEWS     4   /*< Split-screen views                        */
+#define HUD_VIEW_COUNTERS 2   /*< Source counters per view                  */
+#define HUD_TEXT_SIZE     1024
+
+/* Frame phases, times are in microseconds */
+enum {
+	HUD_PHASE_STREAM = 0, /*< Loads and tile streaming            */
+	HUD_PHASE_UPDATE = 1, /*< Players and world                   */
+	HUD_PHASE_RENDER = 2, /*< Building the views                  */
+	HUD_PHASE_HUD    = 3, /*< This overlay, its CPU side          */
+	HUD_PHASE_GPU    = 4, /*< Waiting for the GPU to finish       */
+	HUD_PHASE_VSYNC  = 5, /*< Waiting for the retrace             */
+	HUD_PHASE_COUNT  = 6
+};
+
+/* Counts the game adds up over a frame */
+enum {
+	HUD_COUNT_SPRITES = 0, /*< Sprites drawn                       */
+	HUD_COUNT_BATCHES = 1, /*< Sprite groups, one GX_Begin each    */
+	HUD_COUNT_COUNT   = 2
+};
+
+/*! What the source measured during a frame */
+typedef struct {
+	unsigned int views;                                        /*< Views with readings     */
+	unsigned int counters[HUD_MAX_VIEWS][HUD_VIEW_COUNTERS];   /*< Per view                */
+	unsigned int fifoBytes;                                    /*< Sent to the GPU         */
+} hudreadings_t;
+
+/*! Counter source, user is given back as is */
+typedef struct hudsource {
+	const char* name;                                /*< Shown in the title                 */
+	const char* counterNames[HUD_VIEW_COUNTERS];     /*< Lowercase letters only             */
+	/*! A frame starts */
+	void (*begin)(void* user);
+	/*! The commands of a view are all issued */
+	void (*endView)(void* user, unsigned int view);
+	/*! The frame is done (the GPU included), fill in its readings */
+	void (*collect)(void* user, hudreadings_t* readings);
+	void* user;
+} hudsource_t;
+
+/*! Last HUD_WINDOW values of a number */
+typedef struct {
+	unsigned int values[HUD_WINDOW];
+	unsigned int count; /*< Values stored, up to HUD_WINDOW */
+	unsigned int next;  /*< Where the next one goes         */
+} hudseries_t;
+
+typedef struct {
+	const hudsource_t* source;
+	unsigned int       views;                                      /*< Views in the last readings */
+	unsigned int       phaseTimes[HUD_PHASE_COUNT];                /*< This frame so far          */
+	unsigned int       frameCounts[HUD_COUNT_COUNT];               /*< This frame so far          */
+	hudseries_t        frame;                                      /*< Whole frame                */
+	hudseries_t        phases[HUD_PHASE_COUNT];
+	hudseries_t        fifo;
+	hudseries_t        counts[HUD_COUNT_COUNT];
+	hudseries_t        counters[HUD_MAX_VIEWS][HUD_VIEW_COUNTERS];
+	unsigned int       frames;                                     /*< Frames so far              */
+	char               text[HUD_TEXT_SIZE];                        /*< Last formatted text        */
+} perfhud_t;
+
+/*! \brief Min, average and max of the stored values (0 if there are none)
+ */
+void HUD_range(const hudseries_t* series, unsigned int* minValue, unsigned int* avgValue, unsigned int* maxValue);
+
+/*! \brief Setup a HUD with nothing measured yet
+ *  \param hud    HUD to setup
+ *  \param source Counter source (kept)
+ */
+void HUD_init(perfhud_t* hud, const hudsource_t* source);
+
+/*! \brief Start a frame, call before anything is drawn
+ */
+void HUD_begin(perfhud_t* hud);
+
+/*! \brief Mark the end of a view's commands
+ *  \param view Split-screen view, 0 to HUD_MAX_VIEWS - 1
+ */
+void HUD_endView(perfhud_t* hud, unsigned int view);
+
+/*! \brief Add time to a phase of the current frame
+ *  \param phase  HUD_PHASE_*
+ *  \param micros Microseconds
+ */
+void HUD_phase(perfhud_t* hud, unsigned int phase, unsigned int micros);
+
+/*! \brief Add to a count of the current frame
+ *  \param counter HUD_COUNT_*
+ *  \param value   Amount to add
+ */
+void HUD_count(perfhud_t* hud, unsigned int counter, unsigned int value);
+
+/*! \brief Write the text for the numbers stored so far
+ *  \return Length of the text
+ */
+unsigned int HUD_format(perfhud_t* hud);
+
+/*! \brief End a frame once the GPU is done with it, the text is rebuilt every HUD_REFRESH frames
+ *  \param frameMicros Time since the previous frame ended
+ *  \return 1 if the text changed
+ */
+int HUD_end(perfhud_t* hud, unsigned int frameMicros);
+
+#endif
@@ -0,0 +1,78 @@
+/*! \file profiler.h
+ *  \brief Scoped CPU timing markers
+ *
+ *  Spans are timed with the timebase on the console (a monotonic clock in a
+ *  host build) and stored in a fixed ring that keeps the last PROF_EVENTS of
+ *  them. PROF_dump writes the ring as Chrome trace events, so a frame can be
+ *  looked at as a timeline in chrome://tracing or Perfetto.
+ *
+ *  Only builds with PROFILE=1 record anything, otherwise the markers expand to
+ *  nothing and the ring isn't there. Markers can be used from any thread.
+ */
+
+#ifndef _PROFILER_H
+#define _PROFILER_H
+
+/* Spans kept, about ten a frame so a few seconds worth */
+#define PROF_EVENTS 4096
+
+/* Where the console dump goes, on the SD card's root */
+#define PROF_DUMP_FILE "hovercraft_trace.json"
+
+#ifdef PROFILE
+
+/*! Open span, see PROF_SCOPE */
+typedef struct {
+	const char*        name;  /*< Span name (kept, must be a literal) */
+	unsigned long long start; /*< PROF_now() when it opened          */
+} profscope_t;
+
+/*! \brief Current time, in ticks of the clock
+ */
+unsigned long long PROF_now();
+
+/*! \brief Store a span that ends now
+ *  \param name  Span name (kept, must be a literal)
+ *  \param start PROF_now() when it started
+ */
+void PROF_record(const char* name, unsigned long long start);
+
+/*! \brief Name the calling thread in the dump
+ *  \param name Thread name (kept)
+ */
+void PROF_nameThread(const char* name);
+
+/*! \brief Write the ring as Chrome trace event JSON, recording is paused meanwhile
+ *  \param path File to write, relative to the SD card's root on the console
+ *  \return Spans written, 0 if the file couldn't be written
+ */
+unsigned int PROF_dump(const char* path);
+
+void _PROF_leave(profscope_t* scope);
+
+#define _PROF_JOIN2(a, b) a##b
+#define _PROF_JOIN(a, b) _PROF_JOIN2(a, b)
+
+/*! \brief Time from here to the end of the enclosing block
+ *  \param name Span name, a literal
+ */
+#define PROF_SCOPE(name) \
+	profscope_t _PROF_JOIN(_profScope, __LINE__) __attribute__((cleanup(_PROF_leave))) = { name, PROF_now() }
+
+/*! \brief Time a span that isn't a block: PROF_BEGIN(wait); ... PROF_END(wait, "name");
+ */
+#define PROF_BEGIN(var) const unsigned long long _PROF_JOIN(_profStart_, var) = PROF_now()
+#define PROF_END(var, name) PROF_record(name, _PROF_JOIN(_profStart_, var))
+
+#define PROF_NAME_THREAD(name) PROF_nameThread(name)
+
+#else
+
+#define PROF_SCOPE(name)
+#define PROF_BEGIN(var)
+#define PROF_END(var, name)
+#define PROF_NAME_THREAD(name)
+
+#endif
+
+#endif
@@ -0,0 +1,19 @@
+/*! \file sdcard.h
+ *  \brief SD card access
+ *
+ *  The game reads its assets from the SD card, PROFILE and CAPTURE builds
+ *  write their traces and captures to it. The card is mounted once, by
+ *  whichever of them gets to it first.
+ */
+
+#ifndef _SDCARD_H
+#define _SDCARD_H
+
+#include <gctypes.h>
+
+/*! \brief Mount the SD card (and the other default devices) if it isn't yet
+ *  \return TRUE if the card can be used, a failed mount is tried again on the next call
+ */
+BOOL SD_mount();
+
+#endif
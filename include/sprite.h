@@ -9,32 +9,62 @@
 #include "gxutils.h"
 #include "object.h"
 
+/*! 2D affine transform (x' = xx*x + xy*y + tx, y' = yx*x + yy*y + ty) */
+typedef struct {
+	f32 xx, xy, tx;
+	f32 yx, yy, ty;
+} affine_t;
+
 typedef struct {
 	GXTexObj*   texture;
+	uvrect_t    uv;          /*< Part of the texture to draw (all of it by default) */
 	transform_t transform;
 	f32 width, height;
 	GXColor color;
+	f32      angle;       /*< 2D rotation (radians)                      */
+	affine_t affine;      /*< Batch 2D transform      (AUTO-GENERATED)   */
+	BOOL     affineDirty; /*< Dirty flag for affine recalculation        */
 } sprite_t;
 
+/*! Maximum number of sprites in a single batch */
+#define SPRITE_BATCH_MAX 256
+
+/*! Sprite batch, sprites sharing a texture are drawn with one GX_Begin */
+typedef struct {
+	sprite_t* sprites[SPRITE_BATCH_MAX]; /*< Queued sprites                  */
+	u16       count;                     /*< Number of queued sprites        */
+} spritebatch_t;
+
 /*! \brief Create empty sprite
 *  \return Pointer to newly sprite structure
 */
 sprite_t* SPRITE_create(f32 x, f32 y, f32 depth, f32 width, f32 height, GXTexObj* texture);
 
+/*! \brief Create empty sprite in an arena
+*  \param arena Arena (freed with it, don't SPRITE_free the sprite), NULL for the heap
+*  \return Pointer to newly sprite structure, NULL if the arena is full
+*/
+sprite_t* SPRITE_createIn(arena_t* arena, f32 x, f32 y, f32 depth, f32 width, f32 height, GXTexObj* texture);
+
 /*! \brief Frees a sprite
 *  \param sprite Sprite to destroy
 */
 void SPRITE_free(sprite_t* sprite);
 
-/*! \brief Assign a texture to a sprite, including offset/size
+/*! \brief Assign a whole texture to a sprite
 *  \param sprite     Sprite to assign texture to
 *  \param texture    Texture object to use
-*  \param position   UV offset/position
-*  \param texSize    UV total size
-*  \param spriteSize Sprite size in the texture
 */
 void SPRITE_setTexture(sprite_t* sprite, GXTexObj* texture);
 
+/*! \brief Assign part of a texture to a sprite (eg. an atlas slot)
+*  \param sprite  Sprite to assign texture to
+*  \param texture Texture object to use
+*  \param rect    Part of the texture to draw
+*  \remarks Sprites from the same atlas page share a texture, so they batch together
+*/
+void SPRITE_setTextureRect(sprite_t* sprite, GXTexObj* texture, const uvrect_t* rect);
+
 /*! \brief Renders a sprite on screen
 *  \param sprite Sprite to render
 */
@@ -58,4 +88,36 @@ void SPRITE_color(sprite_t* sprite, GXColor color);
 
 void SPRITE_scaleTo(sprite_t* sprite, const f32 sX, const f32 sY, const f32 sZ);
 
+/*! \brief Set a sprite's 2D rotation
+ *  \param sprite Sprite to rotate
+ *  \param angle  Angle in radians (around the sprite's top left corner)
+ */
+void SPRITE_rotateTo(sprite_t* sprite, const f32 angle);
+
+/*! \brief Start a new sprite batch (resets the queue)
+ *  \param batch Batch to start
+ */
+void SPRITE_batchBegin(spritebatch_t* batch);
+
+/*! \brief Queue a sprite in a batch, flushes the batch when full
+ *  \param batch  Batch to add the sprite to
+ *  \param sprite Sprite to queue
+ */
+void SPRITE_batchAdd(spritebatch_t* batch, sprite_t* sprite);
+
+/*! \brief Draw every queued sprite, grouped by texture
+ *  \param batch Batch to draw
+ *  \remarks Sprites are drawn in queue order, except that sprites queued one
+ *           after another at the same depth are grouped by texture (in queue
+ *           order inside each texture). Overlapping sprites with different
+ *           textures need different depths to keep their order.
+ */
+void SPRITE_batchEnd(spritebatch_t* batch);
+
+/*! \brief Groups and sprites every batch drew during the frame, then start counting the next one
+ *  \param batches Groups drawn (one GX_Begin each)
+ *  \param sprites Sprites drawn
+ */
+void SPRITE_frame(u32* batches, u32* sprites);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,83 @@
+/*! \file spsc.h
+ *  \brief Lock-free single producer, single consumer queue
+ *
+ *  One thread pushes, another pops, neither ever waits on a lock. Items are
+ *  copied in and out of a ring of fixed size slots. Plain C with no SDK types,
+ *  so the host tools can test it with real threads.
+ */
+
+#ifndef _SPSC_H
+#define _SPSC_H
+
+#include <string.h>
+
+/* Cache line size, head and tail get their own so the two threads don't share one */
+#define SPSC_LINE 32
+
+#ifdef _MSC_VER
+/* Aligned volatile accesses are acquire/release with MSVC on x86 */
+#define _SPSC_load(p)     (*(volatile unsigned int*) (p))
+#define _SPSC_store(p, v) (*(volatile unsigned int*) (p) = (v))
+#else
+#define _SPSC_load(p)     __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define _SPSC_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#endif
+
+/*! Queue, the counters run freely and wrap, slots are counter & mask */
+typedef struct {
+	unsigned int   head;                   /*< Items ever pushed (producer writes) */
+	unsigned char  headPad[SPSC_LINE - sizeof(unsigned int)];
+	unsigned int   tail;                   /*< Items ever popped (consumer writes) */
+	unsigned char  tailPad[SPSC_LINE - sizeof(unsigned int)];
+	unsigned int   mask;                   /*< Slot count - 1                      */
+	unsigned int   itemSize;               /*< Bytes per slot                      */
+	unsigned char* items;                  /*< Slots                               */
+} spscqueue_t;
+
+/*! \brief Setup an empty queue
+ *  \param queue    Queue to setup
+ *  \param items    Storage for capacity * itemSize bytes
+ *  \param capacity Slot count, a power of two
+ *  \param itemSize Size of an item
+ */
+static inline void SPSC_init(spscqueue_t* queue, void* items, unsigned int capacity, unsigned int itemSize) {
+	queue->head = 0;
+	queue->tail = 0;
+	queue->mask = capacity - 1;
+	queue->itemSize = itemSize;
+	queue->items = (unsigned char*) items;
+}
+
+/*! \brief Add an item (producer thread only)
+ *  \return 1 if it was added, 0 if the queue is full
+ */
+static inline int SPSC_push(spscqueue_t* queue, const void* item) {
+	const unsigned int head = queue->head;
+	if (head - _SPSC_load(&queue->tail) > queue->mask) return 0;
+
+	memcpy(queue->items + (head & queue->mask) * queue->itemSize, item, queue->itemSize);
+	/* The item is written before the consumer can see it */
+	_SPSC_store(&queue->head, head + 1);
+	return 1;
+}
+
+/*! \brief Take the oldest item (consumer thread only)
+ *  \return 1 if item was filled in, 0 if the queue is empty
+ */
+static inline int SPSC_pop(spscqueue_t* queue, void* item) {
+	const unsigned int tail = queue->tail;
+	if (_SPSC_load(&queue->head) == tail) return 0;
+
+	memcpy(item, queue->items + (tail & queue->mask) * queue->itemSize, queue->itemSize);
+	/* The slot is read before the producer can reuse it */
+	_SPSC_store(&queue->tail, tail + 1);
+	return 1;
+}
+
+/*! \brief Items in the queue (exact from either thread for its own end, a snapshot otherwise)
+ */
+static inline unsigned int SPSC_count(spscqueue_t* queue) {
+	return _SPSC_load(&queue->head) - _SPSC_load(&queue->tail);
+}
+
+#endif
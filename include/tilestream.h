@@ -0,0 +1,99 @@
+/*! \file tilestream.h
+ *  \brief Tile residency for worlds larger than memory
+ *
+ *  The world is a grid of tiles. Tiles closer than a radius to any of the
+ *  given points (players) are wanted. Each update requests the nearest wanted
+ *  tile that isn't loaded yet, within a byte budget and a fixed number of
+ *  slots. Tiles nobody wants anymore stay cached until their room is needed,
+ *  then the least recently wanted goes first. Nothing is kept per world tile,
+ *  so memory use only depends on the slot count and the budget.
+ *
+ *  Plain C with no SDK types, so the host tools can build and test it
+ *  headless. Loading itself is done by the callbacks.
+ */
+
+#ifndef _TILESTREAM_H
+#define _TILESTREAM_H
+
+#define STREAM_NONE 0xFFFFFFFF
+
+/* Slot states */
+enum {
+	STREAM_FREE     = 0, /*< Unused                                    */
+	STREAM_LOADING  = 1, /*< Requested, waiting for STREAM_loaded      */
+	STREAM_RESIDENT = 2, /*< Loaded                                    */
+	STREAM_FAILED   = 3  /*< Load failed, kept so it isn't retried     */
+};
+
+typedef struct {
+	unsigned int state;      /*< STREAM_*                                 */
+	int          x, z;       /*< Tile coordinates                         */
+	unsigned int size;       /*< Bytes charged to the budget              */
+	unsigned int lastWanted; /*< Last update it was in range of a point   */
+} streamslot_t;
+
+/*! Callbacks, user is given back as is */
+typedef struct {
+	/*! Bytes a tile needs, 0 if there is no such tile */
+	unsigned int (*size)(void* user, int x, int z);
+	/*! Start loading a tile in a slot, 0 if it can't be requested now */
+	int (*load)(void* user, unsigned int slot, int x, int z);
+	/*! Free a resident (or failed) tile */
+	void (*unload)(void* user, unsigned int slot, int x, int z);
+	void* user;
+} streamcallbacks_t;
+
+typedef struct {
+	float             originX;   /*< Tile (x, z) covers origin + [x, x + 1) * tileSize */
+	float             originZ;
+	float             tileSize;
+	int               tilesX;    /*< Grid size                                */
+	int               tilesZ;
+	float             radius;    /*< Residency radius around each point       */
+	unsigned int      budget;    /*< Max bytes loaded and loading             */
+	unsigned int      maxLoads;  /*< Requests in flight                       */
+	unsigned int      slotCount;
+	streamslot_t*     slots;
+	streamcallbacks_t callbacks;
+	unsigned int      used;      /*< Bytes loaded and loading                 */
+	unsigned int      loading;   /*< Requests in flight                       */
+	unsigned int      frame;     /*< Updates so far                           */
+	unsigned int      peak;      /*< Most bytes ever used                     */
+	unsigned int      starved;   /*< Updates where a wanted tile didn't fit   */
+} tilestream_t;
+
+/*! \brief Setup a streamer with every slot free
+ *  \param stream    Streamer to setup
+ *  \param slots     Storage for slotCount slots
+ *  \param slotCount Most tiles loaded (or loading) at once
+ *  \param budget    Most bytes loaded (or loading) at once
+ *  \param maxLoads  Most requests in flight
+ */
+void STREAM_init(tilestream_t* stream, float originX, float originZ, float tileSize, int tilesX, int tilesZ,
+				 float radius, streamslot_t* slots, unsigned int slotCount, unsigned int budget, unsigned int maxLoads,
+				 const streamcallbacks_t* callbacks);
+
+/*! \brief Slot holding a tile
+ *  \return Slot index, STREAM_NONE if the tile has none
+ */
+unsigned int STREAM_find(const tilestream_t* stream, int x, int z);
+
+/*! \brief Tile a world position is on
+ *  \return 0 if it's outside the grid
+ */
+int STREAM_tileAt(const tilestream_t* stream, float x, float z, int* tileX, int* tileZ);
+
+/*! \brief Request the tiles around the points, evicting unwanted ones to make room
+ *  \param stream     Streamer
+ *  \param points     World x, z pairs (players)
+ *  \param pointCount Number of points
+ */
+void STREAM_update(tilestream_t* stream, const float* points, unsigned int pointCount);
+
+/*! \brief Tell the streamer a requested tile finished loading
+ *  \param slot Slot given to the load callback
+ *  \param ok   0 if the load failed (the tile isn't retried while it stays in range)
+ */
+void STREAM_loaded(tilestream_t* stream, unsigned int slot, int ok);
+
+#endif
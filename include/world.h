@@ -0,0 +1,63 @@
+/*! \file world.h
+ *  \brief Level tiles streamed in around the players
+ *
+ *  Tiles near the given points are requested from the loader, tiles nobody
+ *  is near anymore are freed when their room is needed (see tilestream.h).
+ *  A tile brings its piece of the terrain, of the heightfield and its props.
+ */
+
+#ifndef _WORLD_H
+#define _WORLD_H
+
+#include <gctypes.h>
+#include <gccore.h>
+#include "level.h"
+#include "model.h"
+
+/*! Finds the model or texture of an entry name (NULL if there is none yet) */
+typedef model_t* (*worldmodelfn_t)(const char* name);
+typedef GXTexObj* (*worldtexturefn_t)(const char* name);
+
+/*! \brief Setup streaming for a level, nothing is loaded until WORLD_update
+ *  \param level       Level, kept while the world is used
+ *  \param findModel   Gives props their model
+ *  \param findTexture Gives terrain pieces the texture of the model they were cut from
+ */
+void WORLD_init(const level_t* level, worldmodelfn_t findModel, worldtexturefn_t findTexture);
+
+/*! \brief Pick up finished tiles and request the ones around the points
+ *  \param points     World x, z pairs (players, or the spectator camera target)
+ *  \param pointCount Number of points
+ *  \param deltaTime  Seconds since the last update (props spin)
+ */
+void WORLD_update(const f32* points, u32 pointCount, f32 deltaTime);
+
+/*! \brief Free the files of tiles unloaded this frame, call once the GPU is done with it (after GX_DrawDone)
+ */
+void WORLD_collect();
+
+/*! \brief Give props of loaded tiles their model again (call when models arrive)
+ */
+void WORLD_attachModels();
+
+/*! \brief Draw the terrain and props of loaded tiles
+ *  \param viewMtx View matrix
+ */
+void WORLD_render(Mtx viewMtx);
+
+/*! \brief Ground under a point, see LEVEL_ground
+ *  \return TRUE if there is ground there, FALSE outside the terrain or if its tile isn't loaded
+ */
+BOOL WORLD_ground(f32 x, f32 z, f32* height, guVector* normal);
+
+/*! \brief Whether WORLD_ground's answer for a point is final
+ *  \return FALSE while the tile under the point is still to be loaded, objects
+ *          over it should wait instead of falling through the missing ground
+ */
+BOOL WORLD_ready(f32 x, f32 z);
+
+/*! \brief Tiles loaded (or loading) and the bytes they use
+ */
+void WORLD_usage(u32* tiles, u32* bytes);
+
+#endif
@@ -0,0 +1,221 @@
+#include "archive.h"
+#include "memtrack.h"
+
+#include <string.h>
+#include <gccore.h>
+
+#define PAK_MIN_MATCH 4
+
+/* Unpack LZ sequences into exactly outSize bytes (same as lzDecompress in bin2pak)
+ * out may overlap in when in sits at the end of an outSize + margin buffer */
+static BOOL _PAK_unpack(const u8* in, u32 inSize, u8* out, u32 outSize) {
+	const u8* ip = in;
+	const u8* const inEnd = in + inSize;
+	u8* op = out;
+	u8* const outEnd = out + outSize;
+
+	for (;;) {
+		if (ip >= inEnd) return FALSE;
+		const u32 token = *ip++;
+
+		/* Literals (memmove, they may overlap when unpacking in place) */
+		u32 length = token >> 4;
+		if (length == 15) {
+			u32 more;
+			do {
+				if (ip >= inEnd) return FALSE;
+				more = *ip++;
+				length += more;
+			} while (more == 255);
+		}
+		if (length > (u32)(inEnd - ip) || length > (u32)(outEnd - op)) return FALSE;
+		memmove(op, ip, length);
+		op += length;
+		ip += length;
+		if (ip == inEnd) return op == outEnd;
+
+		/* Match */
+		if (inEnd - ip < 2) return FALSE;
+		const u32 offset = (ip[0] << 8) | ip[1];
+		ip += 2;
+		length = (token & 15) + PAK_MIN_MATCH;
+		if ((token & 15) == 15) {
+			u32 more;
+			do {
+				if (ip >= inEnd) return FALSE;
+				more = *ip++;
+				length += more;
+			} while (more == 255);
+		}
+		if (offset == 0 || offset > (u32)(op - out) || length > (u32)(outEnd - op)) return FALSE;
+
+		/* An overlapping match repeats its first offset bytes, each copy doubles
+		 * the run that can be copied next without overlap */
+		const u8* match = op - offset;
+		u32 run = offset;
+		while (length > run) {
+			memcpy(op, match, run);
+			op += run;
+			length -= run;
+			run <<= 1;
+		}
+		memcpy(op, match, length);
+		op += length;
+	}
+}
+
+static BOOL _PAK_checkHeader(const pakheader_t* header) {
+	if (header->magic != PAK_MAGIC || header->version != PAK_VERSION) {
+		printf("Error: Not a version %u archive\n", PAK_VERSION);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+/* Every entry's data has to be inside the archive, reads trust the directory after this */
+static BOOL _PAK_checkEntries(const pakheader_t* header, const pakentry_t* entries) {
+	u32 i;
+	for (i = 0; i < header->entryCount; i++) {
+		const pakentry_t* entry = &entries[i];
+		/* Packed data read from a file has to fit the entry's size + margin buffer too */
+		if (entry->offset > header->size || entry->packedSize > header->size - entry->offset
+			|| (entry->method == PAK_STORED && entry->packedSize != entry->size)
+			|| (entry->packedSize > entry->size && entry->packedSize - entry->size > entry->margin)) {
+			printf("Error: Archive entry %.*s is out of bounds\n", PAK_NAME_LENGTH, entry->name);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
+
+pak_t* PAK_openMemory(const void* data, u32 size) {
+	const pakheader_t* header = (const pakheader_t*) data;
+	if (size < sizeof(pakheader_t) || !_PAK_checkHeader(header) || header->size > size) return NULL;
+	if (sizeof(pakheader_t) + header->entryCount * sizeof(pakentry_t) > header->size) {
+		printf("Error: Archive directory is truncated\n");
+		return NULL;
+	}
+	if (!_PAK_checkEntries(header, (const pakentry_t*) (header + 1))) return NULL;
+
+	pak_t* pak = MEMTRACK_alloc(MEMTAG_ASSETS, sizeof(pak_t));
+	pak->header = header;
+	pak->entries = (const pakentry_t*) (header + 1);
+	pak->data = (const u8*) data;
+	pak->file = NULL;
+	pak->owned = NULL;
+	return pak;
+}
+
+pak_t* PAK_openFile(const char* path) {
+	FILE* file = fopen(path, "rb");
+	if (file == NULL) {
+		printf("Error: Can't open %s\n", path);
+		return NULL;
+	}
+
+	/* Header and directory are kept, entries are read when asked for */
+	pakheader_t header;
+	if (fread(&header, sizeof(header), 1, file) != 1 || !_PAK_checkHeader(&header)) {
+		fclose(file);
+		return NULL;
+	}
+	const u32 directorySize = sizeof(pakheader_t) + header.entryCount * sizeof(pakentry_t);
+	const long length = fseek(file, 0, SEEK_END) == 0 ? ftell(file) : -1;
+	if (length < 0 || header.size > (u32) length || directorySize > header.size || fseek(file, sizeof(header), SEEK_SET) != 0) {
+		printf("Error: %s is truncated\n", path);
+		fclose(file);
+		return NULL;
+	}
+	u8* directory = MEMTRACK_alloc(MEMTAG_ASSETS, directorySize);
+	memcpy(directory, &header, sizeof(header));
+	if ((header.entryCount > 0 && fread(directory + sizeof(header), sizeof(pakentry_t), header.entryCount, file) != header.entryCount)
+		|| !_PAK_checkEntries(&header, (const pakentry_t*) (directory + sizeof(header)))) {
+		MEMTRACK_free(directory);
+		fclose(file);
+		return NULL;
+	}
+
+	pak_t* pak = MEMTRACK_alloc(MEMTAG_ASSETS, sizeof(pak_t));
+	pak->header = (const pakheader_t*) directory;
+	pak->entries = (const pakentry_t*) (directory + sizeof(pakheader_t));
+	pak->data = NULL;
+	pak->file = file;
+	pak->owned = directory;
+	return pak;
+}
+
+void PAK_close(pak_t* pak) {
+	if (pak == NULL) return;
+	if (pak->file != NULL) fclose(pak->file);
+	MEMTRACK_free(pak->owned);
+	MEMTRACK_free(pak);
+}
+
+const pakentry_t* PAK_find(pak_t* pak, const char* name) {
+	/* The directory is sorted by name */
+	s32 low = 0, high = (s32) pak->header->entryCount - 1;
+	while (low <= high) {
+		const s32 middle = (low + high) / 2;
+		const int order = strncmp(name, pak->entries[middle].name, PAK_NAME_LENGTH);
+		if (order == 0) return &pak->entries[middle];
+		if (order < 0) high = middle - 1;
+		else low = middle + 1;
+	}
+	return NULL;
+}
+
+u32 PAK_bufferSize(const pak_t* pak, const pakentry_t* entry) {
+	/* From memory the entry is unpacked straight out of the archive */
+	const u32 size = pak->file != NULL ? entry->size + entry->margin : entry->size;
+	return (size + 31) & ~31;
+}
+
+BOOL PAK_read(pak_t* pak, const pakentry_t* entry, void* buffer, u32 bufferSize) {
+	if (bufferSize < PAK_bufferSize(pak, entry)) return FALSE;
+
+	u8* out = (u8*) buffer;
+	BOOL ok;
+	if (pak->file == NULL) {
+		const u8* packed = pak->data + entry->offset;
+		if (entry->method == PAK_STORED) {
+			memcpy(out, packed, entry->size);
+			ok = TRUE;
+		} else {
+			ok = entry->method == PAK_LZ && _PAK_unpack(packed, entry->packedSize, out, entry->size);
+		}
+	} else {
+		/* Packed data goes at the end of the buffer, the margin keeps unpacking
+		 * from overwriting what it hasn't read yet */
+		u8* packed = entry->method == PAK_STORED ? out : out + bufferSize - entry->packedSize;
+		ok = fseek(pak->file, entry->offset, SEEK_SET) == 0
+			&& fread(packed, 1, entry->packedSize, pak->file) == entry->packedSize;
+		if (ok && entry->method != PAK_STORED) {
+			ok = entry->method == PAK_LZ && _PAK_unpack(packed, entry->packedSize, out, entry->size);
+		}
+	}
+	if (!ok) {
+		printf("Error: Can't read %.*s from the archive\n", PAK_NAME_LENGTH, entry->name);
+		return FALSE;
+	}
+
+	/* GX reads main memory, not the CPU cache */
+	DCFlushRange(out, entry->size);
+	return TRUE;
+}
+
+void* PAK_load(pak_t* pak, const char* name, u32* size) {
+	const pakentry_t* entry = PAK_find(pak, name);
+	if (entry == NULL) {
+		printf("Error: No %s in the archive\n", name);
+		return NULL;
+	}
+
+	const u32 bufferSize = PAK_bufferSize(pak, entry);
+	void* buffer = MEMTRACK_memalign(MEMTAG_ASSETS, 32, bufferSize);
+	if (buffer == NULL || !PAK_read(pak, entry, buffer, bufferSize)) {
+		MEMTRACK_free(buffer);
+		return NULL;
+	}
+	if (size != NULL) *size = entry->size;
+	return buffer;
+}
@@ -0,0 +1,157 @@
+#include "arena.h"
+#include "memtrack.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <gccore.h>
+
+/* Scratch buffers, frames use them in turn */
+static arena_t scratch[2];
+static u32 scratchFrame = 0;
+
+static u32 _ARENA_round(u32 size) {
+	return (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+BOOL ARENA_init(arena_t* arena, const char* name, u32 tag, u32 size) {
+	size = _ARENA_round(size);
+	void* buffer = MEMTRACK_memalign(tag, ARENA_ALIGN, size);
+	if (buffer == NULL) {
+		printf("Error: No memory for the %s arena (%u bytes)\n", name, size);
+		ARENA_initBuffer(arena, name, NULL, 0);
+		return FALSE;
+	}
+	ARENA_initBuffer(arena, name, buffer, size);
+	return TRUE;
+}
+
+void ARENA_initBuffer(arena_t* arena, const char* name, void* buffer, u32 size) {
+	arena->name = name;
+	arena->base = (u8*) buffer;
+	arena->size = size;
+	arena->used = 0;
+	arena->peak = 0;
+	arena->failed = 0;
+}
+
+void* ARENA_alloc(arena_t* arena, u32 size) {
+	size = _ARENA_round(size);
+	if (size > arena->size - arena->used) {
+		arena->failed++;
+		printf("Error: %s arena full (%u of %u bytes, %u more asked)\n", arena->name, arena->used, arena->size, size);
+		return NULL;
+	}
+	void* block = arena->base + arena->used;
+	arena->used += size;
+	if (arena->used > arena->peak) arena->peak = arena->used;
+	return block;
+}
+
+void* ARENA_calloc(arena_t* arena, u32 count, u32 size) {
+	void* block = ARENA_alloc(arena, count * size);
+	if (block != NULL) memset(block, 0, count * size);
+	return block;
+}
+
+void ARENA_reset(arena_t* arena) {
+	arena->used = 0;
+}
+
+void ARENA_report(const arena_t* arena) {
+	printf("%s arena: %u of %u bytes used, peak %u, %u failed\n", arena->name, arena->used, arena->size, arena->peak, arena->failed);
+}
+
+void SCRATCH_init(u32 size) {
+	ARENA_init(&scratch[0], "scratch 0", MEMTAG_SCRATCH, size);
+	ARENA_init(&scratch[1], "scratch 1", MEMTAG_SCRATCH, size);
+}
+
+void SCRATCH_flip() {
+	scratchFrame ^= 1;
+	ARENA_reset(&scratch[scratchFrame]);
+}
+
+void* SCRATCH_alloc(u32 size) {
+	return ARENA_alloc(&scratch[scratchFrame], size);
+}
+
+char* SCRATCH_printf(const char* format, ...) {
+	arena_t* current = &scratch[scratchFrame];
+	char* text = (char*) current->base + current->used;
+	const u32 room = current->size - current->used;
+
+	va_list args;
+	va_start(args, format);
+	const int length = vsnprintf(text, room, format, args);
+	va_end(args);
+
+	/* Formatted in place, only claim it if it fit */
+	if (length < 0 || (u32) length >= room) {
+		current->failed++;
+		return "";
+	}
+	return SCRATCH_alloc(length + 1);
+}
+
+void SCRATCH_report() {
+	const u32 peak = scratch[0].peak > scratch[1].peak ? scratch[0].peak : scratch[1].peak;
+	printf("scratch: %u bytes per frame, peak %u, %u failed\n", scratch[0].size, peak, scratch[0].failed + scratch[1].failed);
+}
+
+#ifdef ALLOC_CHECK
+
+#include <reent.h>
+
+/* The Makefile links with --wrap for these, every heap allocation (newlib's
+ * malloc, calloc, memalign, strdup...) ends up in one of them */
+void* __real__malloc_r(struct _reent* r, size_t size);
+void* __real__calloc_r(struct _reent* r, size_t count, size_t size);
+void* __real__realloc_r(struct _reent* r, void* block, size_t size);
+void* __real__memalign_r(struct _reent* r, size_t align, size_t size);
+
+static lwp_t lockedThread = LWP_THREAD_NULL;
+static BOOL reporting = FALSE;
+
+/* Caller is the one of malloc() (or calloc()...), PowerPC always keeps the back chain */
+static void _ARENA_check(const char* function, size_t size, void* caller) {
+	if (lockedThread == LWP_THREAD_NULL || reporting || LWP_GetSelf() != lockedThread) return;
+
+	/* printf can allocate itself */
+	reporting = TRUE;
+	printf("Error: %s(%u) during gameplay, called from %p\n", function, (u32) size, caller);
+	abort();
+}
+
+void* __wrap__malloc_r(struct _reent* r, size_t size) {
+	_ARENA_check("malloc", size, __builtin_return_address(1));
+	return __real__malloc_r(r, size);
+}
+
+void* __wrap__calloc_r(struct _reent* r, size_t count, size_t size) {
+	_ARENA_check("calloc", count * size, __builtin_return_address(1));
+	return __real__calloc_r(r, count, size);
+}
+
+void* __wrap__realloc_r(struct _reent* r, void* block, size_t size) {
+	_ARENA_check("realloc", size, __builtin_return_address(1));
+	return __real__realloc_r(r, block, size);
+}
+
+void* __wrap__memalign_r(struct _reent* r, size_t align, size_t size) {
+	_ARENA_check("memalign", size, __builtin_return_address(1));
+	return __real__memalign_r(r, align, size);
+}
+
+void ARENA_lockHeap(BOOL locked) {
+	lockedThread = locked ? LWP_GetSelf() : LWP_THREAD_NULL;
+}
+
+#else
+
+void ARENA_lockHeap(BOOL locked) {
+	(void) locked;
+}
+
+#endif
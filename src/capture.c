@@ -0,0 +1,176 @@
+#include "capture.h"
+
+#ifdef CAPTURE
+
+#include <stdio.h>
+#include <string.h>
+#include <gccore.h>
+
+#include "gxstream.h"
+#include "sdcard.h"
+
+/* Where captures go, on the SD card's root */
+#define CAPTURE_FILE "hovercraft_frame_%u.gxc"
+
+typedef struct {
+	u32 address; /*< Physical address */
+	u32 size;
+} capturelist_t;
+
+static BOOL requested = FALSE, active = FALSE;
+static u32 captures = 0;
+
+/* The FIFO (read uncached) and the frame's bytes in it */
+static const u8* fifoBase = NULL;
+static u32 fifoSize = 0;
+static u32 fifoStart, fifoLast, written;
+static u32 viewCount, viewEnds[CAPTURE_MAX_VIEWS];
+
+static capturelist_t lists[CAPTURE_MAX_LISTS];
+static u32 listCount, listsDropped;
+
+/* Offset in the FIFO where the CPU writes next */
+static u32 _CAPTURE_fifoOffset() {
+	GXFifoObj fifo;
+	void *readPtr, *writePtr;
+
+	/* Push out what's still in the write gather pipe (padded with NOPs) */
+	GX_Flush();
+	GX_GetCPUFifo(&fifo);
+	GX_GetFifoPtrs(&fifo, &readPtr, &writePtr);
+	const u32 base = MEM_VIRTUAL_TO_PHYSICAL(GX_GetFifoBase(&fifo));
+	fifoBase = MEM_PHYSICAL_TO_K1(base);
+	fifoSize = GX_GetFifoSize(&fifo);
+	return MEM_VIRTUAL_TO_PHYSICAL(writePtr) - base;
+}
+
+/* Count what was written since the last mark, the FIFO is a ring */
+static void _CAPTURE_advance() {
+	const u32 offset = _CAPTURE_fifoOffset();
+	written += (offset + fifoSize - fifoLast) % fifoSize;
+	fifoLast = offset;
+}
+
+static void _CAPTURE_addList(u32 address, u32 size) {
+	u32 i;
+	for (i = 0; i < listCount; i++) {
+		if (lists[i].address == address && lists[i].size == size) return;
+	}
+	if (listCount == CAPTURE_MAX_LISTS) {
+		listsDropped++;
+		return;
+	}
+	lists[listCount].address = address;
+	lists[listCount].size = size;
+	listCount++;
+}
+
+/* Find the display lists a stream calls, lists can't call lists */
+static int _CAPTURE_walk(gxvtxstate_t* state, const gxbytes_t* bytes, BOOL inList) {
+	gxcommand_t command;
+	u32 offset = 0;
+	int result;
+	while ((result = GXS_next(state, bytes, &offset, &command)) == GXS_OK) {
+		if (command.type != GXS_CALL_DL || inList) continue;
+		_CAPTURE_addList(command.address, command.count);
+
+		/* State set in the list holds for the draws after it */
+		gxbytes_t list;
+		GXS_bytes(&list, MEM_PHYSICAL_TO_K1(command.address), command.count);
+		result = _CAPTURE_walk(state, &list, TRUE);
+		if (result != GXS_END) return result;
+	}
+	return result;
+}
+
+void CAPTURE_request() {
+	requested = TRUE;
+}
+
+void CAPTURE_begin() {
+	if (!requested) return;
+	requested = FALSE;
+	active = TRUE;
+	viewCount = 0;
+	written = 0;
+	fifoStart = fifoLast = _CAPTURE_fifoOffset();
+}
+
+void CAPTURE_view(unsigned int view) {
+	if (!active || view >= CAPTURE_MAX_VIEWS) return;
+	_CAPTURE_advance();
+	viewEnds[view] = written;
+	if (view + 1 > viewCount) viewCount = view + 1;
+}
+
+int CAPTURE_active() {
+	return active;
+}
+
+int CAPTURE_end() {
+	if (!active) return 0;
+	active = FALSE;
+	_CAPTURE_advance();
+
+	/* A frame that went around the whole FIFO overwrote its own start */
+	if (written >= fifoSize) {
+		printf("Error: Frame too big to capture (%u bytes, FIFO is %u)\n", written, fifoSize);
+		return 0;
+	}
+
+	gxbytes_t stream = { fifoBase, fifoSize, fifoStart, written };
+	gxvtxstate_t state;
+	GXS_reset(&state);
+	listCount = listsDropped = 0;
+	const int result = _CAPTURE_walk(&state, &stream, FALSE);
+	if (result != GXS_END) {
+		printf("Warning: Capture couldn't be decoded on the console (%d), display lists may be missing\n", result);
+	}
+	if (listsDropped > 0) {
+		printf("Warning: %u display lists left out of the capture\n", listsDropped);
+	}
+
+	if (!SD_mount()) {
+		printf("Error: No SD card for the capture\n");
+		return 0;
+	}
+	char name[32];
+	snprintf(name, sizeof(name), CAPTURE_FILE, captures);
+	FILE* file = fopen(name, "wb");
+	if (file == NULL) {
+		printf("Error: Can't write the capture to %s\n", name);
+		return 0;
+	}
+
+	captureheader_t header;
+	memset(&header, 0, sizeof(header));
+	header.magic = CAPTURE_MAGIC;
+	header.version = CAPTURE_VERSION;
+	header.frame = captures;
+	header.viewCount = viewCount;
+	memcpy(header.viewEnds, viewEnds, sizeof(u32) * viewCount);
+	header.streamSize = written;
+	header.listCount = listCount;
+	fwrite(&header, sizeof(header), 1, file);
+
+	/* Stream in up to two pieces, it can wrap around the end of the FIFO */
+	const u32 first = written < fifoSize - fifoStart ? written : fifoSize - fifoStart;
+	fwrite(fifoBase + fifoStart, 1, first, file);
+	fwrite(fifoBase, 1, written - first, file);
+
+	u32 i;
+	for (i = 0; i < listCount; i++) {
+		fwrite(&lists[i], sizeof(capturelist_t), 1, file);
+		fwrite(MEM_PHYSICAL_TO_K1(lists[i].address), 1, lists[i].size, file);
+	}
+
+	if (fclose(file) != 0) {
+		printf("Error: Can't write the capture to %s\n", name);
+		return 0;
+	}
+	printf("Capture: %u bytes, %u views, %u display lists written to %s\n", written, viewCount, listCount, name);
+	captures++;
+	return 1;
+}
+
+#endif
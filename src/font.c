@@ -2,19 +2,25 @@
 
 #include "mathutil.h"
 #include <string.h>
-#include <malloc.h>
+#include "memtrack.h"
 #include <math.h>
+#include <stdio.h>
 
 f32 fontRatio;
 
+/* Precomputed cosine period for scrollers (must be a power of two) */
+#define FONT_WAVE_SIZE 256
+static f32 fontWave[FONT_WAVE_SIZE];
+
 void _FONT_GenerateUV(font_t* font,
+	const uvrect_t* rect,
 	const char* chars,
 	const u16 charWidth,
 	const u16 charHeight,
 	const u16 texSize) {
 	/* Find out char count and allocate the quad UV array */
 	u16 charCount = strlen(chars);
-	font->charUV = malloc(sizeof(charuv_t)* charCount);
+	font->charUV = MEMTRACK_memalign(MEMTAG_FONT, 32, sizeof(charuv_t)* charCount);
 
 	f32 texRepr = 1.0f / texSize;
 
@@ -24,6 +30,11 @@ void _FONT_GenerateUV(font_t* font,
 	ps_float2Mul(uvSize, texRepr2, uvSize);
 	ps_float2Mul(uvStride, texRepr2, uvStride);
 
+	/* Glyphs are laid out in the font image, then moved into its rect of the texture */
+	f32 rectScale[2] = { rect->width, rect->height };
+	f32 glyphSize[2];
+	ps_float2Mul(uvSize, rectScale, glyphSize);
+
 	u16 i;
 	f32 x = 0, y = 0;
 	for (i = 0; i < charCount; i++) {
@@ -32,38 +43,50 @@ void _FONT_GenerateUV(font_t* font,
 			x = 0;
 		}
 
+		const f32 u = rect->u + x * rect->width;
+		const f32 v = rect->v + y * rect->height;
+
 		//TL
-		font->charUV[i].uvs[0] = x;
-		font->charUV[i].uvs[1] = y;
+		font->charUV[i].uvs[0] = u;
+		font->charUV[i].uvs[1] = v;
 		//BL
-		font->charUV[i].uvs[2] = x;
-		font->charUV[i].uvs[3] = y + uvSize[1];
+		font->charUV[i].uvs[2] = u;
+		font->charUV[i].uvs[3] = v + glyphSize[1];
 		//BR
-		font->charUV[i].uvs[4] = x + uvSize[0];
-		font->charUV[i].uvs[5] = y + uvSize[1];
+		font->charUV[i].uvs[4] = u + glyphSize[0];
+		font->charUV[i].uvs[5] = v + glyphSize[1];
 		//TR
-		font->charUV[i].uvs[6] = x + uvSize[0];
-		font->charUV[i].uvs[7] = y;
+		font->charUV[i].uvs[6] = u + glyphSize[0];
+		font->charUV[i].uvs[7] = v;
 
 		font->charIndex[(u8)chars[i]] = i;
 
 		x += uvStride[0];
 	}
+
+	/* charUV is used as the GX texcoord array, push it out of the cache */
+	DCFlushRange(font->charUV, sizeof(charuv_t)* charCount);
 }
 
-void _FONT_Prep(font_t* font) {
+void _FONT_VtxFormat() {
 	GX_ClearVtxDesc();
 	GX_SetVtxDesc(GX_VA_POS, GX_DIRECT);
-	GX_SetVtxDesc(GX_VA_TEX0, GX_DIRECT);
+	GX_SetVtxDesc(GX_VA_TEX0, GX_INDEX16);
 
-	GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_POS, GX_POS_XY, GX_F32, 0);
+	/* Integer pixel positions, UVs are fetched from the glyph UV array */
+	GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_POS, GX_POS_XY, GX_S16, 0);
 	GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_TEX0, GX_TEX_ST, GX_F32, 0);
+}
+
+void _FONT_Prep(font_t* font, f32 x, f32 y) {
+	_FONT_VtxFormat();
+	GX_SetArray(GX_VA_TEX0, font->charUV, 2 * sizeof(f32));
 
 	/* Set position to identity */
 	Mtx modelView;
 	guMtxIdentity(modelView);
 	GX_LoadNrmMtxImm(modelView, GX_PNMTX0); //dummies required
-	guMtxTransApply(modelView, modelView, 0, 0, -1); //0 isnt allowed, -1 is minimum TODO: sync with near plane value
+	guMtxTransApply(modelView, modelView, x, y, -1); //0 isnt allowed, -1 is minimum TODO: sync with near plane value
 	GX_LoadPosMtxImm(modelView, GX_PNMTX0);
 
 	/* Set color */
@@ -71,7 +94,7 @@ void _FONT_Prep(font_t* font) {
 	GX_SetChanMatColor(GX_COLOR0A0, font->color);
 
 	/* Set font texture */
-	GX_LoadTexObj(font->texture, GX_TEXMAP0);
+	GXU_bindTexture(font->texture, GX_TEXMAP0);
 
 	/* Lighting off, Alpha blend */
 	GX_SetNumChans(1);
@@ -83,102 +106,200 @@ void _FONT_Prep(font_t* font) {
 	GXU_2DMode();
 }
 
-void _FONT_Rect(font_t* font, u32 index, f32 x, f32 y) {
-	const f32 height = font->height * font->scale;
-	const f32 width = font->width * font->scale;
+void _FONT_Rect(u32 index, s16 x, s16 y, s16 width, s16 height) {
+	/* UV array holds 4 corners per glyph, in the same order as the quad */
+	const u16 uv = index << 2;
 
-	GX_Position2f32(x, y);
-	GX_TexCoord2f32(font->charUV[index].uvs[0], font->charUV[index].uvs[1]);
+	/* Top left */
+	GX_Position2s16(x, y);
+	GX_TexCoord1x16(uv);
 	/* Bottom left */
-	GX_Position2f32(x, y + height);
-	GX_TexCoord2f32(font->charUV[index].uvs[2], font->charUV[index].uvs[3]);
+	GX_Position2s16(x, y + height);
+	GX_TexCoord1x16(uv + 1);
 	/* Bottom right */
-	GX_Position2f32(x + width, y + height);
-	GX_TexCoord2f32(font->charUV[index].uvs[4], font->charUV[index].uvs[5]);
+	GX_Position2s16(x + width, y + height);
+	GX_TexCoord1x16(uv + 2);
 	/* Top right */
-	GX_Position2f32(x + width, y);
-	GX_TexCoord2f32(font->charUV[index].uvs[6], font->charUV[index].uvs[7]);
+	GX_Position2s16(x + width, y);
+	GX_TexCoord1x16(uv + 3);
 }
 
-void FONT_draw(font_t* font, const char* message, f32 x, f32 y, BOOL center) {
-	const u16 messagelength = strlen(message);
-	const char* msgpointer = message;
-	const f32 height = font->height * font->scale;
-	const f32 width = font->width * font->scale;
+u32 _FONT_GlyphCount(const char* message) {
+	u32 count = 0;
+	for (; *message != '\0'; message++) {
+		if (*message != '\n') count++;
+	}
+	return count;
+}
+
+void _FONT_Emit(font_t* font, const char* message, f32 x, f32 y, BOOL center) {
+	const u32 glyphCount = _FONT_GlyphCount(message);
+	const s16 height = font->height * font->scale;
+	const s16 width = font->width * font->scale;
+
+	if (glyphCount == 0) return;
 
-	_FONT_Prep(font);
+	/* All lines go in the same primitive */
+	GX_Begin(GX_QUADS, GX_VTXFMT0, 4 * glyphCount);
 
-	u16 charCount = 0, offset = 0;
-	f32 xoffset = 0, yoffset = 0, centeroffset = 0;
-	do {
-		charCount = strcspn(msgpointer, "\n"); //length till newline (exclusive)
+	const char* msgpointer = message;
+	s16 yy = y;
+	while (TRUE) {
+		u16 charCount = strcspn(msgpointer, "\n"); //length till newline (exclusive)
 
+		s16 xx = x;
 		if (center) {
-			centeroffset = -(charCount / 2) * width;
+			xx -= (charCount / 2) * width;
 		}
 
-		//Skip recurring
-		if (charCount > 0) {
-			GX_Begin(GX_QUADS, GX_VTXFMT0, 4 * charCount);
-			u16 i;
-			for (i = 0; i < charCount; i++) {
-				u8 index = font->charIndex[(u8)msgpointer[i]];
-				f32 xx = centeroffset + xoffset + x;
-				f32 yy = yoffset + y;
-
-				//Build vertices
-				_FONT_Rect(font, index, xx, yy);
-
-				xoffset += width;
-			}
-			GX_End();
+		u16 i;
+		for (i = 0; i < charCount; i++) {
+			u8 index = font->charIndex[(u8)msgpointer[i]];
+			_FONT_Rect(index, xx, yy, width, height);
+			xx += width;
 		}
 
-		// Newline
-		xoffset = 0;
-		yoffset += height;
+		if (msgpointer[charCount] == '\0') break;
 
+		// Newline
+		yy += height;
 		msgpointer += charCount + 1;
-		offset += charCount + 1;
-	} while (offset < messagelength);
+	}
+
+	GX_End();
+}
+
+void FONT_draw(font_t* font, const char* message, f32 x, f32 y, BOOL center) {
+	_FONT_Prep(font, 0, 0);
+	_FONT_Emit(font, message, x, y, center);
 }
 
 void FONT_drawScroller(font_t* font, const char* message, f32 x, f32 y, f32 padding, f32 freq, f32 amplitude, f32 progress) {
-	const u16 messagelength = strlen(message);
+	const u32 glyphCount = _FONT_GlyphCount(message);
+	const s16 height = font->height * font->scale;
+	const s16 width = font->width * font->scale;
+
+	/* Wave phase is kept in table steps */
+	const f32 waveStep = FONT_WAVE_SIZE / (2 * M_PI);
+	const f32 phaseStart = progress * waveStep;
+	const f32 phaseFreq = freq * waveStep;
+
+	if (glyphCount == 0) return;
+
+	_FONT_Prep(font, 0, 0);
+
+	GX_Begin(GX_QUADS, GX_VTXFMT0, 4 * glyphCount);
+
 	const char* msgpointer = message;
-	const f32 width = font->width * font->scale;
-
-	_FONT_Prep(font);
-
-	u16 charCount = 0, offset = 0;
-	f32 xoffset = 0;
-	do {
-		charCount = strcspn(msgpointer, "\n"); //length till newline (exclusive)
-
-											   //Skip recurring
-		if (charCount > 0) {
-			GX_Begin(GX_QUADS, GX_VTXFMT0, 4 * charCount);
-			u16 i;
-			for (i = 0; i < charCount; i++) {
-				u8 index = font->charIndex[(u8)msgpointer[i]];
-				f32 xx = xoffset + x + (i * padding);
-				f32 yy = y + cos(progress + i * freq) * amplitude;
-
-				//Build vertices
-				_FONT_Rect(font, index, xx, yy);
-
-				xoffset += width;
-			}
-			GX_End();
+	f32 xoffset = x;
+	while (TRUE) {
+		u16 charCount = strcspn(msgpointer, "\n"); //length till newline (exclusive)
+
+		u16 i;
+		for (i = 0; i < charCount; i++) {
+			u8 index = font->charIndex[(u8)msgpointer[i]];
+			s32 phase = phaseStart + i * phaseFreq;
+			f32 xx = xoffset + (i * padding);
+			f32 yy = y + fontWave[phase & (FONT_WAVE_SIZE - 1)] * amplitude;
+
+			//Build vertices
+			_FONT_Rect(index, xx, yy, width, height);
+
+			xoffset += width;
 		}
 
+		if (msgpointer[charCount] == '\0') break;
+
 		msgpointer += charCount + 1;
-		offset += charCount + 1;
-	} while (offset < messagelength);
+	}
+
+	GX_End();
+}
+
+void _FONT_CompileText(text_t* text) {
+	/* Count glyphs to size the list */
+	const u32 glyphCount = _FONT_GlyphCount(text->message);
+
+	/* 4 vertices (2 s16 position + u16 UV index) per glyph, 1 GX_Begin */
+	const u32 listSize = (glyphCount * 4 * 3 * sizeof(s16)) + 3;
+	/* Round up to nearest 32 multiplication */
+	const u32 dispSize = ((listSize + 31) >> 5) << 5;
+
+	/* A GX_CallDispList earlier in the frame may still read the list, let the GPU finish it */
+	if (text->queued) {
+		GX_DrawDone();
+		text->queued = FALSE;
+	}
+
+	/* Only grow the list, short texts reuse the old buffer */
+	if (dispSize > text->dispListCapacity) {
+		MEMTRACK_free(text->dispList);
+		text->dispList = MEMTRACK_memalign(MEMTAG_DISPLAYLIST, 32, dispSize);
+		text->dispListCapacity = dispSize;
+	}
+
+	text->dispListSize = 0;
+	if (glyphCount == 0) return;
+
+	memset(text->dispList, 0, text->dispListCapacity);
+	DCInvalidateRange(text->dispList, text->dispListCapacity);
+
+	GX_BeginDispList(text->dispList, text->dispListCapacity);
+	_FONT_Emit(text->font, text->message, 0, 0, text->center);
+	text->dispListSize = GX_EndDispList();
+
+	if (text->dispListSize == 0) {
+		printf("Error: Display list not big enough [%u]\n", text->dispListCapacity);
+	}
+}
+
+text_t* FONT_createText(font_t* font, const char* message, BOOL center) {
+	text_t* text = MEMTRACK_alloc(MEMTAG_FONT, sizeof(text_t));
+	text->font = font;
+	text->center = center;
+	text->message = NULL;
+	text->dispList = NULL;
+	text->dispListSize = 0;
+	text->dispListCapacity = 0;
+	text->queued = FALSE;
+
+	FONT_setText(text, message);
+	return text;
+}
+
+void FONT_setText(text_t* text, const char* message) {
+	/* Same text, keep the compiled list */
+	if (text->message != NULL && strcmp(text->message, message) == 0) return;
+
+	MEMTRACK_free(text->message);
+	text->message = MEMTRACK_strdup(MEMTAG_FONT, message);
+
+	_FONT_CompileText(text);
+}
+
+void FONT_drawText(text_t* text, f32 x, f32 y) {
+	if (text->dispListSize == 0) return;
+
+	/* Glyphs are compiled at the origin, the position matrix moves them */
+	_FONT_Prep(text->font, x, y);
+	GX_CallDispList(text->dispList, text->dispListSize);
+	text->queued = TRUE;
+}
+
+void FONT_freeText(text_t* text) {
+	if (text->queued) GX_DrawDone();
+	MEMTRACK_free(text->dispList);
+	MEMTRACK_free(text->message);
+	MEMTRACK_free(text);
 }
 
 void FONT_init() {
 	fontRatio = 1 / GXU_getAspectRatio();
+
+	u32 i;
+	for (i = 0; i < FONT_WAVE_SIZE; i++) {
+		fontWave[i] = cosf(i * (2 * M_PI / FONT_WAVE_SIZE));
+	}
 }
 
 font_t* FONT_load(GXTexObj* texture,
@@ -187,17 +308,29 @@ font_t* FONT_load(GXTexObj* texture,
 	const u16 charHeight,
 	const u16 texSize,
 	const f32 scale) {
-	font_t* font = malloc(sizeof(font_t));
+	const uvrect_t whole = { 0, 0, 1, 1 };
+	return FONT_loadRect(texture, &whole, chars, charWidth, charHeight, texSize, scale);
+}
+
+font_t* FONT_loadRect(GXTexObj* texture,
+	const uvrect_t* rect,
+	const char* chars,
+	const u16 charWidth,
+	const u16 charHeight,
+	const u16 texSize,
+	const f32 scale) {
+	font_t* font = MEMTRACK_alloc(MEMTAG_FONT, sizeof(font_t));
 	font->width = charWidth;
 	font->height = charHeight;
 	font->scale = scale;
 	font->color = (GXColor) { 0xFF, 0xFF, 0xFF, 0xFF };
+	memset(font->charIndex, 0, sizeof(font->charIndex));
 
 	font->texture = texture;
 	GX_InitTexObjWrapMode(texture, GX_CLAMP, GX_CLAMP);
 	GX_InitTexObjFilterMode(texture, GX_NEAR, GX_NEAR);
 
-	_FONT_GenerateUV(font, chars, charWidth, charHeight, texSize);
+	_FONT_GenerateUV(font, rect, chars, charWidth, charHeight, texSize);
 	return font;
 }
 
@@ -206,6 +339,6 @@ void FONT_color(font_t* font, GXColor color) {
 }
 
 void FONT_free(font_t* font) {
-	free(font->charUV);
-	free(font);
+	MEMTRACK_free(font->charUV);
+	MEMTRACK_free(font);
 }
\ No newline at end of file
@@ -1,31 +1,33 @@
 /* System and SDK libraries */
-#include <malloc.h>
 #include <gccore.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 /* Internal headers */
 #include "game.h"
 #include "model.h"
 #include "object.h"
 #include "font.h"
+#include "sprite.h"
 #include "audioutil.h"
 #include "gxutils.h"
 #include "mathutil.h"
-#include "raycast.h"
 #include "input.h"
+#include "archive.h"
+#include "loader.h"
+#include "level.h"
+#include "world.h"
+#include "arena.h"
+#include "memtrack.h"
+#include "profiler.h"
+#include "perfhud.h"
+#include "capture.h"
+#include "sdcard.h"
 
 /* Generated assets headers */
-#include "hovercraft_bmb.h"
-#include "plane_bmb.h"
-#include "terrain_bmb.h"
-#include "ray_bmb.h"
-#include "ring_bmb.h"
-#include "pickup_bmb.h"
 #include "textures.h"
 
-#include "menumusic_mod.h"
-#include "gamemusic_mod.h"
-
 player_t players[MAX_PLAYERS];
 u8 playerCount = 0;
 
@@ -33,12 +35,49 @@ u8 playerCount = 0;
 const f32 maxSpeed = 0.3f;
 guVector gravity;
 
-/* Model info */
-model_t *modelHover, *modelTerrain, *modelPlane, *modelRay, *modelRing, *modelPickup;
-object_t *objectTerrain, *objectPlane, *planeRay, *firstRing, *secondRing;
+/* Asset archive, read from the SD card next to the executable. Only its
+ * directory stays in memory, entries are unpacked when loaded */
+#define ASSETS_FILE "/apps/hovercraft/assets.pak"
+pak_t* assets;
+void* menuMusic = NULL;
 
-/* Texture vars */
-GXTexObj hoverGlobalTexObj, hoverShadeTexObj, terrainTexObj, waterTexObj, rayTexObj, ringTexObj, fontTexObj, pickupTexObj;
+/* Model info */
+model_t *modelHover, *modelPlane, *modelRay, *modelRing, *modelPickup;
+
+/* Level (used in place) and an object for each of its objects */
+level_t* level;
+object_t** levelObjects;
+
+/* Models, level objects and pickups live as long as the level, transient data
+ * (debug text) as long as a frame, gameplay itself doesn't touch the heap */
+#define LEVEL_ARENA_SIZE (64 * 1024)
+#define SCRATCH_SIZE     (16 * 1024)
+arena_t levelArena;
+
+/* Texture vars (ray, ring, pickup and font share the props atlas page) */
+GXTexObj hoverGlobalTexObj, hoverShadeTexObj, terrainTexObj, waterTexObj, propsTexObj, fontTexObj;
+
+/* Models streamed in by the loader thread while the spectator view is shown,
+ * level objects find theirs by name. The terrain comes in tiles (see world.h),
+ * only its texture is here */
+typedef struct {
+	const char*   name;    /*< Archive entry                */
+	model_t**     model;   /*< Set once loaded, NULL: not loaded here */
+	GXTexObj*     texture; /*< Texture to give it           */
+	loadhandle_t* load;    /*< Pending request, NULL after  */
+} modelload_t;
+
+static modelload_t modelLoads[] = {
+	{ "terrain.bmb",    NULL,          &terrainTexObj,     NULL },
+	{ "plane.bmb",      &modelPlane,   &waterTexObj,       NULL },
+	/* obj2bin moved their UVs into the atlas slots */
+	{ "ray.bmb",        &modelRay,     &propsTexObj,       NULL },
+	{ "ring.bmb",       &modelRing,    &propsTexObj,       NULL },
+	{ "pickup.bmb",     &modelPickup,  &propsTexObj,       NULL },
+	{ "hovercraft.bmb", &modelHover,   &hoverGlobalTexObj, NULL }
+};
+static const u32 modelLoadCount = sizeof(modelLoads) / sizeof(modelLoads[0]);
+loadhandle_t* musicLoad = NULL;
 
 /* Light */
 static GXColor lightColor[] = {
@@ -59,17 +98,8 @@ static GXColor playerColors[] = {
 camera_t spectatorCamera;
 Mtx spectatorView;
 
-/* Pickup points */
-static const guVector pickupPoints[] = {
-	{ 76, 7, 136 },
-	{ 90, 7, 59 },
-	{ 148, 7, 21 },
-	{ 200, 7, 82 },
-	{ 113, 22, 134 },
-	{ 6, 7, 136 }
-};
-static const int pickupPointsCount = sizeof(pickupPoints) / sizeof(pickupPoints[0]);
-pickup_t pickups[sizeof(pickupPoints) / sizeof(pickupPoints[0])];
+/* Pickups, one per level pickup position */
+pickup_t* pickups;
 
 f32 pickupTimeout = 10;
 
@@ -78,70 +108,103 @@ guVector checkpoint;
 BOOL isWaiting;
 
 font_t* font;
+text_t *textWaiting, *textScore;
+
+/* Performance overlay, toggled with Z + D-pad up (Minus + Up on a Wiimote) */
+static perfhud_t hud;
+static BOOL hudVisible = FALSE;
+static u64 hudMark, hudFrameStart;
+
+/* Sign, whole and hundredths of a value for "%s%d.%02d", printf's own float
+ * formatting allocates in newlib and the heap is locked during gameplay */
+#define _FIXED2(value) ((value) < 0 ? "-" : ""), abs((s32) ((value) * 100)) / 100, abs((s32) ((value) * 100)) % 100
 
 /* Util functions */
 void _moveCheckpoint();
+guVector _spawnPosition();
 void _createPlayers();
-void _getPickup(u8 playerId, u8 pickupId);
+void _pollLoads();
+model_t* _findModel(const char* name);
+GXTexObj* _findTexture(const char* name);
+void _attachModels();
+void _renderLevel(u32 role, Mtx viewMtx);
+void _getPickup(u8 playerId, u32 pickupId);
 void _setPlayerTEV();
 void _resetTEV();
+void _toggleHud();
+void _markHud(u32 phase);
+void _drawHud();
 
 void GAME_init() {
 	GXU_init();
 
+	assets = SD_mount() ? PAK_openFile(ASSETS_FILE) : NULL;
+	if (assets == NULL) {
+		printf("Error: Can't read the assets from " ASSETS_FILE " on the SD card\n");
+		exit(1);
+	}
+
+	/* Texture objects point in the TPL data, so it stays loaded */
+	u32 tplSize = 0;
+	void* tpl = PAK_load(assets, "textures.tpl", &tplSize);
+	MEMTRACK_retag(tpl, MEMTAG_TEXTURE);
+	GXU_openTPL(tpl, tplSize);
+
 	GXU_loadTexture(hovercraftGlobalTex, &hoverGlobalTexObj);
 	GXU_loadTexture(hovercraftShadeTex, &hoverShadeTexObj);
 	GXU_loadTexture(terrainTex, &terrainTexObj);
 	GXU_loadTexture(waterTex, &waterTexObj);
-	GXU_loadTexture(rayTex, &rayTexObj);
-	GXU_loadTexture(ringTex, &ringTexObj);
+	GXU_loadTexture(propsAtlas, &propsTexObj);
+	/* Same page, but point filtered for the font */
 	GXU_loadTexture(ubuntuFontTex, &fontTexObj);
-	GXU_loadTexture(pickupTex, &pickupTexObj);
-	GX_InitTexObjWrapMode(&fontTexObj, GX_CLAMP, GX_CLAMP); //Point filtering
 
 	GXU_closeTPL();
 
-	modelHover = MODEL_setup(hovercraft_bmb);
-	modelTerrain = MODEL_setup(terrain_bmb);
-	modelPlane = MODEL_setup(plane_bmb);
-	modelRay = MODEL_setup(ray_bmb);
-	modelRing = MODEL_setup(ring_bmb);
-	modelPickup = MODEL_setup(pickup_bmb);
-
-	MODEL_setTexture(modelHover, &hoverGlobalTexObj);
-	MODEL_setTexture(modelTerrain, &terrainTexObj);
-	MODEL_setTexture(modelPlane, &waterTexObj);
-	MODEL_setTexture(modelRay, &rayTexObj);
-	MODEL_setTexture(modelRing, &ringTexObj);
-	MODEL_setTexture(modelPickup, &pickupTexObj);
-
-	objectTerrain = OBJECT_create(modelTerrain);
-	OBJECT_scaleTo(objectTerrain, 200, 200, 200);
-
-	objectPlane = OBJECT_create(modelPlane);
-	OBJECT_scaleTo(objectPlane, 1000, 1, 1000);
-	OBJECT_moveTo(objectPlane, -500, 6.1f, -500);
-
-	planeRay = OBJECT_create(modelRay);
-	OBJECT_moveTo(planeRay, 0, 6.1f, 0);
-	OBJECT_scaleTo(planeRay, 1.5f, 4, 1.5f);
-
-	firstRing = OBJECT_create(modelRing);
-	secondRing = OBJECT_create(modelRing);
-	OBJECT_scaleTo(firstRing, 1.4f, 1, 1.4f);
-	OBJECT_scaleTo(secondRing, 1.7f, 0.7f, 1.7f);
+	/* The level is small and everything is placed from it, so it's loaded right away */
+	u32 levelSize = 0;
+	void* levelData = PAK_load(assets, "arena.blv", &levelSize);
+	MEMTRACK_retag(levelData, MEMTAG_LEVEL);
+	level = LEVEL_load(levelData, levelSize);
+	ARENA_init(&levelArena, "level", MEMTAG_LEVEL, LEVEL_ARENA_SIZE);
+	SCRATCH_init(SCRATCH_SIZE);
+
+	/* Models and music load in the background, objects are created empty and
+	 * get their model when it arrives (see _pollLoads) */
+	LOADER_init(assets);
+	u32 loadIndex;
+	for (loadIndex = 0; loadIndex < modelLoadCount; loadIndex++) {
+		if (modelLoads[loadIndex].model == NULL) continue;
+		modelLoads[loadIndex].load = LOADER_loadModelIn(&levelArena, modelLoads[loadIndex].name);
+	}
+	musicLoad = LOADER_load("menumusic.mod");
+
+	/* Terrain tiles and props are requested around the players (the spectator camera target until they join) */
+	WORLD_init(level, _findModel, _findTexture);
+
+	/* Level objects (checkpoint ones are placed by _moveCheckpoint) */
+	levelObjects = ARENA_alloc(&levelArena, sizeof(object_t*) * level->objectCount);
+	u32 objectIndex;
+	for (objectIndex = 0; objectIndex < level->objectCount; objectIndex++) {
+		const levelobject_t* entry = &level->objects[objectIndex];
+		object_t* object = OBJECT_createIn(&levelArena, NULL);
+		OBJECT_scaleTo(object, entry->scale.x, entry->scale.y, entry->scale.z);
+		OBJECT_moveTo(object, entry->position.x, entry->position.y, entry->position.z);
+		levelObjects[objectIndex] = object;
+	}
+	_moveCheckpoint();
 
 	/* Setup pickup points */
-	u8 pickupIndex;
-	for (pickupIndex = 0; pickupIndex < pickupPointsCount; pickupIndex++) {
+	pickups = ARENA_alloc(&levelArena, sizeof(pickup_t) * level->pickupCount);
+	u32 pickupIndex;
+	for (pickupIndex = 0; pickupIndex < level->pickupCount; pickupIndex++) {
 		pickup_t currentPickup;
 		currentPickup.enable = TRUE;
 		currentPickup.type = PICKUP_SOMETHING;
 
 		// Create the pickup object and move it to its position
-		object_t* pickupObject = OBJECT_create(modelPickup);
+		object_t* pickupObject = OBJECT_createIn(&levelArena, modelPickup);
 		currentPickup.object = pickupObject;
-		guVector pickupPosition = pickupPoints[pickupIndex];
+		guVector pickupPosition = level->pickups[pickupIndex];
 		OBJECT_moveTo(pickupObject, pickupPosition.x, pickupPosition.y, pickupPosition.z);
 
 		pickups[pickupIndex] = currentPickup;
@@ -150,15 +213,14 @@ void GAME_init() {
 	/* Setup spectator matrix */
 	GXU_setupCamera(&spectatorCamera, 1, 1);
 	GX_SetViewport(spectatorCamera.offsetLeft, spectatorCamera.offsetTop, spectatorCamera.width, spectatorCamera.height, 0, 1);
-	guVector spectatorPos = { -30, 40, -10 };
-	guVector targetPos = { 100, 0, 100 };
 	guVector spectatorUp = { 0, 1, 0 };
-	guLookAt(spectatorView, &spectatorPos, &spectatorUp, &targetPos);
+	guLookAt(spectatorView, &level->camera, &spectatorUp, &level->cameraTarget);
 
 	FONT_init();
-	font = FONT_load(&fontTexObj, " !,.0123456789:<>?ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz", 12, 22, 256, 1.f);
-
-	_moveCheckpoint();
+	const uvrect_t fontRect = { ubuntuFontTexRect };
+	font = FONT_loadRect(&fontTexObj, &fontRect, " !,.0123456789:<>?ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz", 12, 22, 256, 1.f);
+	textWaiting = FONT_createText(font, "Connect at least one controller\nPress START or A to play", TRUE);
+	textScore = FONT_createText(font, "Score: 0000", FALSE);
 
 	gravity = (guVector){ 0, -0.8f * frameTime, 0 };
 
@@ -188,6 +250,7 @@ void GAME_removePlayer(player_t* player) {
 }
 
 void GAME_updateWorld() {
+	PROF_SCOPE("GAME_updateWorld");
 	/* Check for collisions
 	 * To optimize and avoid glitches, collisions are calculated on the world loop
 	 * to both minimize physics getting in the way and assure that calculations
@@ -213,8 +276,8 @@ void GAME_updateWorld() {
 		}
 
 		/* Collisions with pickups */
-		u8 pickupId;
-		for (pickupId = 0; pickupId < pickupPointsCount; pickupId++) {
+		u32 pickupId;
+		for (pickupId = 0; pickupId < level->pickupCount; pickupId++) {
 			if (pickups[pickupId].enable == TRUE) {
 				distance = vecDistance(&actor->hovercraft->transform.position, &pickups[pickupId].object->transform.position);
 				if (distance < 2.f) {
@@ -229,8 +292,8 @@ void GAME_updateWorld() {
 	 * Each update loop should decrease the timeout by the delta time value and re-enable
 	 * the pickup when it reaches zero (or lower).
 	 */
-	u8 pickupId;
-	for (pickupId = 0; pickupId < pickupPointsCount; pickupId++) {
+	u32 pickupId;
+	for (pickupId = 0; pickupId < level->pickupCount; pickupId++) {
 		if (pickups[pickupId].enable == FALSE) {
 			pickups[pickupId].timeout -= frameTime;
 
@@ -242,6 +305,7 @@ void GAME_updateWorld() {
 }
 
 void GAME_updatePlayer(player_t* player) {
+	PROF_SCOPE("GAME_updatePlayer");
 	/* Data */
 	guVector acceleration = { 0, 0, 0 };
 	guVector jump = { 0, 0.3f, 0 };
@@ -251,6 +315,12 @@ void GAME_updatePlayer(player_t* player) {
 	guVector *playerForward = &player->hovercraft->transform.forward;
 	guVector forward, worldUp = { 0, 1, 0 };
 
+	/* Hold still until the ground under the player has loaded (eg. right after spawning) */
+	if (!WORLD_ready(position->x, position->z)) {
+		velocity->x = velocity->y = velocity->z = 0;
+		return;
+	}
+
 	/* Get input */
 	f32 rot = INPUT_steering(&player->controller) * .033f;
 	f32 accel = INPUT_acceleration(&player->controller) * .02f;
@@ -278,30 +348,21 @@ void GAME_updatePlayer(player_t* player) {
 	OBJECT_move(player->hovercraft, velocity->x, velocity->y, velocity->z);
 
 	/* Collision check*/
-	const f32 rayoffset = 200;
-	guVector raydir = { 0, -1, 0 };
-	guVector raypos = { 0, rayoffset, 0 };
-	guVector rayhit, normalhit;
-	guVecAdd(&raypos, position, &raypos);
-	f32 dist = 0;
-	f32 minHeight = objectPlane->transform.position.y;
+	guVector normalhit;
+	f32 height = 0;
+	f32 minHeight = level->waterLevel;
 	guQuaternion rotation;
 
-	/* Raycast track */
-	if (Raycast(objectTerrain, &raydir, &raypos, &dist, &normalhit)) {
-		/* Get hit position */
-		guVecScale(&raydir, &rayhit, dist);
-		guVecAdd(&rayhit, &raypos, &rayhit);
-		f32 height = rayhit.y;
-
-		if (dist < rayoffset) {
+	/* Ground under the player (heightfield of the tile it's on) */
+	if (WORLD_ground(position->x, position->z, &height, &normalhit)) {
+		if (height > position->y) {
 			/* Moved into the terrain, snap */
 			guVector f;
 			guVecCross(right, &normalhit, &f);
 			guVecNormalize(&f);
 			QUAT_lookat(&f, &normalhit, &rotation);
 			QUAT_slerp(&rotation, &player->hovercraft->transform.rotation, .9f, &rotation);
-			OBJECT_moveTo(player->hovercraft, rayhit.x, height, rayhit.z);
+			OBJECT_moveTo(player->hovercraft, position->x, height, position->z);
 
 			/* Since we hit the ground, reset the gravity */
 			player->isGrounded = TRUE;
@@ -315,7 +376,7 @@ void GAME_updatePlayer(player_t* player) {
 			QUAT_slerp(&rotation, &player->hovercraft->transform.rotation, .9f, &rotation);
 		}
 	} else {
-		/* Ray misses, we're up really high or on water, code below will make use*/
+		/* No ground (or its tile isn't loaded yet), we're over water, code below will make use*/
 		player->isGrounded = FALSE;
 
 		/* This should be avoided somehow */
@@ -337,52 +398,142 @@ void GAME_updatePlayer(player_t* player) {
 }
 
 void GAME_render() {
+	/* Scratch memory from two frames ago can go, allocations are counted per frame */
+	SCRATCH_flip();
+	MEMTRACK_frame();
+	/* Texture objects may have been reloaded or reused since the last frame */
+	GXU_invalidateTextures();
+
+	if (INPUT_comboPressed(INPUT_GC_COMBO_HUD, INPUT_WII_COMBO_HUD)) {
+		_toggleHud();
+	}
+	if (hudVisible) {
+		hudMark = gettime();
+		HUD_begin(&hud);
+	}
+#ifdef CAPTURE
+	if (INPUT_comboPressed(INPUT_GC_COMBO_CAPTURE, INPUT_WII_COMBO_CAPTURE)) {
+		CAPTURE_request();
+	}
+#endif
+	CAPTURE_begin();
+
+	/* Pick up what the loader finished */
+	_pollLoads();
+
+	/* Stream tiles around the players */
+	f32 streamPoints[MAX_PLAYERS * 2];
+	u32 streamPointCount = 0;
+	if (isWaiting) {
+		streamPoints[0] = level->cameraTarget.x;
+		streamPoints[1] = level->cameraTarget.z;
+		streamPointCount = 1;
+	} else {
+		u8 i;
+		for (i = 0; i < playerCount; i++) {
+			streamPoints[streamPointCount * 2] = players[i].hovercraft->transform.position.x;
+			streamPoints[streamPointCount * 2 + 1] = players[i].hovercraft->transform.position.z;
+			streamPointCount++;
+		}
+	}
+	WORLD_update(streamPoints, streamPointCount, frameTime);
+	_markHud(HUD_PHASE_STREAM);
+
 	/* Render time */
 	GX_SetNumChans(1);
 
 	/* Animate scene models */
-	OBJECT_rotate(firstRing, 0, 0.3f * frameTime, 0);
-	OBJECT_rotate(secondRing, 0, -0.2f * frameTime, 0);
+	u32 objectIndex;
+	for (objectIndex = 0; objectIndex < level->objectCount; objectIndex++) {
+		const f32 spin = level->objects[objectIndex].spin;
+		if (spin != 0) {
+			OBJECT_rotate(levelObjects[objectIndex], 0, spin * frameTime, 0);
+		}
+	}
 
 	/* Animate pickups */
-	u8 pickupId;
-	for (pickupId = 0; pickupId < pickupPointsCount; pickupId++) {
+	u32 pickupId;
+	for (pickupId = 0; pickupId < level->pickupCount; pickupId++) {
 		if (pickups[pickupId].enable == TRUE) {
-			OBJECT_rotate(pickups[pickupId].object, 0, 0.5f * frameTime, 0);
+			OBJECT_rotate(pickups[pickupId].object, 0, level->pickupSpin * frameTime, 0);
 		}
 	}
 
+	_markHud(HUD_PHASE_UPDATE);
+
 	/* Wait for controllers */
 	if (isWaiting) {
 		GX_LoadProjectionMtx(spectatorCamera.perspectiveMtx, GX_PERSPECTIVE);
 		GAME_renderView(spectatorView);
+		if (hudVisible) HUD_endView(&hud, 0);
+		CAPTURE_view(0);
 
 		GXRModeObj* rmode = GXU_getMode();
-		FONT_draw(font, "Connect at least one controller\nPress START or A to play", rmode->viWidth / 2, rmode->viHeight - 200, TRUE);
+		FONT_drawText(textWaiting, rmode->viWidth / 2, rmode->viHeight - 200);
+		_markHud(HUD_PHASE_RENDER);
 
-		if (INPUT_checkControllers()) {
+		/* Players need every model */
+		if (LOADER_pending() == 0 && INPUT_checkControllers()) {
 			_createPlayers();
 		}
 	} else {
 		u8 i;
 		for (i = 0; i < playerCount; i++) {
 			GAME_updatePlayer(&players[i]);
+			_markHud(HUD_PHASE_UPDATE);
 			GAME_renderPlayerView(&players[i]);
-			FONT_draw(font, "Score: 0000", 1, 1, FALSE);
-			char debugPos[30];
-			guVector* playerPosition = &(players[i].hovercraft->transform.position);
-			sprintf(debugPos, "X %.2f Y %.2f Z %.2f %lu", playerPosition->x, playerPosition->y, playerPosition->z, GXU_framerate());
-			//FONT_draw(font, debugPos, 1, 30, FALSE);
+			FONT_drawText(textScore, 1, 1);
+			_markHud(HUD_PHASE_RENDER);
+			if (hudVisible) {
+				guVector* playerPosition = &(players[i].hovercraft->transform.position);
+				const char* debugPos = SCRATCH_printf("X %s%d.%02d Y %s%d.%02d Z %s%d.%02d", _FIXED2(playerPosition->x),
+													  _FIXED2(playerPosition->y), _FIXED2(playerPosition->z));
+				FONT_draw(font, debugPos, 1, 30, FALSE);
+				HUD_endView(&hud, i);
+				_markHud(HUD_PHASE_HUD);
+			}
+			CAPTURE_view(i);
 		}
 	}
 
 	GAME_updateWorld();
+	_markHud(HUD_PHASE_UPDATE);
+	_drawHud();
 
 	/* Flip framebuffer */
 	GXU_done();
+	/* Nothing reads unloaded tiles anymore */
+	WORLD_collect();
+	u32 spriteBatches, sprites;
+	SPRITE_frame(&spriteBatches, &sprites);
+
+#ifdef CAPTURE
+	/* Writing the capture out needs the heap */
+	if (CAPTURE_active()) {
+		ARENA_lockHeap(FALSE);
+		CAPTURE_end();
+		ARENA_lockHeap(!isWaiting);
+	}
+#endif
+
+	/* Frame numbers, the GPU is done with it now */
+	if (hudVisible) {
+		u32 gpuWait, vsyncWait;
+		GXU_frameWaits(&gpuWait, &vsyncWait);
+		HUD_phase(&hud, HUD_PHASE_GPU, gpuWait);
+		HUD_phase(&hud, HUD_PHASE_VSYNC, vsyncWait);
+		HUD_count(&hud, HUD_COUNT_SPRITES, sprites);
+		HUD_count(&hud, HUD_COUNT_BATCHES, spriteBatches);
+		hudMark = gettime();
+		HUD_end(&hud, diff_usec(hudFrameStart, hudMark));
+		hudFrameStart = hudMark;
+		/* Counted in the next frame */
+		_markHud(HUD_PHASE_HUD);
+	}
 }
 
 void GAME_renderView(Mtx viewMtx) {
+	PROF_SCOPE("GAME_renderView");
 	/* Set default blend mode */
 	GX_SetBlendMode(GX_BM_BLEND, GX_BL_SRCALPHA, GX_BL_INVSRCALPHA, GX_LO_CLEAR);
 
@@ -392,8 +543,8 @@ void GAME_renderView(Mtx viewMtx) {
 	/* Enable Light */
 	GXU_setDirLight(viewMtx, lightColor, (guVector) { 0, 0, 1 }, 12.0f);
 
-	/* Draw terrain */
-	OBJECT_render(objectTerrain, viewMtx);
+	/* Draw terrain and props of the loaded tiles */
+	WORLD_render(viewMtx);
 
 	/* Setup TEV for player palettes */
 	_setPlayerTEV();
@@ -411,9 +562,10 @@ void GAME_renderView(Mtx viewMtx) {
 	_resetTEV();
 
 	/* Draw pickups */
-	for (i = 0; i < pickupPointsCount; i++) {
-		if (pickups[i].enable == TRUE) {
-			OBJECT_render(pickups[i].object, viewMtx);
+	u32 pickupId;
+	for (pickupId = 0; pickupId < level->pickupCount; pickupId++) {
+		if (pickups[pickupId].enable == TRUE) {
+			OBJECT_render(pickups[pickupId].object, viewMtx);
 		}
 	}
 
@@ -423,15 +575,13 @@ void GAME_renderView(Mtx viewMtx) {
 	GX_SetChanCtrl(GX_COLOR0A0, GX_DISABLE, GX_SRC_REG, GX_SRC_REG, GX_LIGHT0, GX_DF_CLAMP, GX_AF_NONE);
 
 	/* Draw water */
-	OBJECT_render(objectPlane, viewMtx);
+	_renderLevel(LEVEL_ROLE_WATER, viewMtx);
 
 	/* Special blend mode */
 	/* Disable Zbuf */
 	GX_SetZMode(GX_TRUE, GX_LEQUAL, GX_FALSE);
 	GX_SetBlendMode(GX_BM_BLEND, GX_BL_SRCALPHA, GX_BL_ONE, GX_LO_CLEAR);
-	OBJECT_render(planeRay, viewMtx);
-	OBJECT_render(firstRing, viewMtx);
-	OBJECT_render(secondRing, viewMtx);
+	_renderLevel(LEVEL_ROLE_CHECKPOINT, viewMtx);
 }
 
 void GAME_renderPlayerView(player_t* player) {
@@ -465,21 +615,13 @@ void GAME_renderPlayerView(player_t* player) {
 	guVecAdd(&camera->position, &camPos, &camPos);
 
 	/* Make sure the camera does not enter the ground */
-	const f32 rayoffset = 400;
-	guVector raydir = { 0, -1, 0 };
-	guVector raypos = { 0, rayoffset, 0 };
-	guVecAdd(&raypos, &camPos, &raypos);
-	guVector normalhit;
-	f32 dist = 0;
-	if (Raycast(objectTerrain, &raydir, &raypos, &dist, &normalhit)) {
-		if (dist < (rayoffset + cameraMinHeight)) {
-			/* the camera is lower then it should be, move up */
-			camPos.y += (rayoffset + cameraMinHeight) - dist;
-		}
-	} else {
-		if (camPos.y < cameraMinHeight) {
-			camPos.y = cameraMinHeight;
-		}
+	f32 groundHeight;
+	if (!WORLD_ground(camPos.x, camPos.z, &groundHeight, NULL)) {
+		groundHeight = 0;
+	}
+	if (camPos.y < groundHeight + cameraMinHeight) {
+		/* the camera is lower then it should be, move up */
+		camPos.y = groundHeight + cameraMinHeight;
 	}
 
 	/* Create camera matrix */
@@ -497,22 +639,27 @@ void GAME_renderPlayerView(player_t* player) {
 }
 
 void _moveCheckpoint() {
-	f32 distance = 0;
-	f32 minHeight = objectPlane->transform.position.y - 0.9f;
-	const f32 rayoffset = 200;
-	guVector raydir = { 0, -1, 0 };
-	guVector position;
-	while (rayoffset - distance > minHeight) {
-		position = (guVector) { fioraRand() * 200.f, rayoffset, fioraRand() * 200.f };
-		Raycast(objectTerrain, &raydir, &position, &distance, NULL);
-	}
-
-	checkpoint = (guVector) { position.x, 0, position.z };
-
-	OBJECT_moveTo(planeRay, checkpoint.x, objectPlane->transform.position.y + 4, checkpoint.z);
-	OBJECT_flush(planeRay);
-	OBJECT_moveTo(firstRing, checkpoint.x, objectPlane->transform.position.y + 0.5f, checkpoint.z);
-	OBJECT_moveTo(secondRing, checkpoint.x, objectPlane->transform.position.y + 0.5f, checkpoint.z);
+	/* obj2bin picked the spots where the ground is under shallow water */
+	if (level->checkpointCount == 0) return;
+	const levelpoint_t* spot = &level->checkpoints[(u32) (fioraRand() * level->checkpointCount)];
+	checkpoint = (guVector) { spot->x, 0, spot->z };
+
+	/* Checkpoint objects are placed relative to it, at water level */
+	u32 i;
+	for (i = 0; i < level->objectCount; i++) {
+		const levelobject_t* entry = &level->objects[i];
+		if (entry->role != LEVEL_ROLE_CHECKPOINT) continue;
+		OBJECT_moveTo(levelObjects[i], checkpoint.x + entry->position.x, level->waterLevel + entry->position.y, checkpoint.z + entry->position.z);
+	}
+}
+
+guVector _spawnPosition() {
+	const levelarea_t* area = &level->spawns[(u32) (fioraRand() * level->spawnCount)];
+	return (guVector) {
+		area->min.x + fioraRand() * (area->max.x - area->min.x),
+		area->min.y + fioraRand() * (area->max.y - area->min.y),
+		area->min.z + fioraRand() * (area->max.z - area->min.z)
+	};
 }
 
 void _createPlayers() {
@@ -520,7 +667,7 @@ void _createPlayers() {
 	u8 i;
 	for (i = 0; i < MAX_PLAYERS; i++) {
 		if (INPUT_isConnected(INPUT_CONTROLLER_GAMECUBE, i) == TRUE) {
-			guVector position = { fioraRand() * 200.f, 30.f, fioraRand() * 200.f };
+			guVector position = _spawnPosition();
 			controller_t controller = { INPUT_CONTROLLER_GAMECUBE, i, 0 };
 			GAME_createPlayer(controller, modelHover, position);
 		}
@@ -530,7 +677,7 @@ void _createPlayers() {
 	/* Check for Wiimotes */
 	for (i = WPAD_CHAN_0; i < WPAD_MAX_WIIMOTES; i++) {
 		if (INPUT_isConnected(INPUT_CONTROLLER_WIIMOTE, i) == TRUE) {
-			guVector position = { fioraRand() * 200.f, 30.f, fioraRand() * 200.f };
+			guVector position = _spawnPosition();
 			controller_t controller = { INPUT_CONTROLLER_WIIMOTE, i, 0 };
 			INPUT_getExpansion(&controller);
 			GAME_createPlayer(controller, modelHover, position);
@@ -545,10 +692,15 @@ void _createPlayers() {
 
 	isWaiting = FALSE;
 
-	AU_playMusic(menumusic_mod);
+	if (menuMusic != NULL) AU_playMusic(menuMusic);
+
+	/* Everything is loaded or streams into arenas from now on */
+	ARENA_report(&levelArena);
+	MEMTRACK_print();
+	ARENA_lockHeap(TRUE);
 }
 
-void _getPickup(u8 playerId, u8 pickupId) {
+void _getPickup(u8 playerId, u32 pickupId) {
 	/* Make pickup disappear */
 	pickups[pickupId].enable = FALSE;
 	pickups[pickupId].timeout = pickupTimeout;
@@ -586,7 +738,7 @@ void _setPlayerTEV() {
 	GX_SetZCompLoc(GX_TRUE);
 
 	// Load brightness texture into slot 1
-	GX_LoadTexObj(&hoverShadeTexObj, GX_TEXMAP1);
+	GXU_bindTexture(&hoverShadeTexObj, GX_TEXMAP1);
 }
 
 void _resetTEV() {
@@ -603,4 +755,95 @@ void _resetTEV() {
 
 	// Reset color to #fff
 	GX_SetChanMatColor(GX_COLOR0A0, (GXColor){ 0xff, 0xff, 0xff, 0xff });
-}
\ No newline at end of file
+}
+
+void _pollLoads() {
+	PROF_SCOPE("_pollLoads");
+	BOOL arrived = FALSE;
+	u32 i;
+	for (i = 0; i < modelLoadCount; i++) {
+		modelload_t* entry = &modelLoads[i];
+		if (entry->load == NULL || !LOADER_poll(entry->load)) continue;
+
+		/* Failed loads leave the model NULL, objects using it don't draw */
+		*entry->model = entry->load->model;
+		MODEL_setTexture(*entry->model, entry->texture);
+		LOADER_release(entry->load);
+		entry->load = NULL;
+		arrived = TRUE;
+	}
+	if (arrived) {
+		/* New models may be where freed ones were, their vertices can't come from the cache */
+		GX_InvVtxCache();
+		_attachModels();
+	}
+
+	if (musicLoad != NULL && LOADER_poll(musicLoad)) {
+		menuMusic = musicLoad->data;
+		MEMTRACK_retag(menuMusic, MEMTAG_AUDIO);
+		LOADER_release(musicLoad);
+		musicLoad = NULL;
+	}
+}
+
+model_t* _findModel(const char* name) {
+	u32 i;
+	for (i = 0; i < modelLoadCount; i++) {
+		if (modelLoads[i].model != NULL && strncmp(modelLoads[i].name, name, LEVEL_NAME_LENGTH) == 0) return *modelLoads[i].model;
+	}
+	return NULL;
+}
+
+GXTexObj* _findTexture(const char* name) {
+	u32 i;
+	for (i = 0; i < modelLoadCount; i++) {
+		if (strncmp(modelLoads[i].name, name, LEVEL_NAME_LENGTH) == 0) return modelLoads[i].texture;
+	}
+	return NULL;
+}
+
+void _attachModels() {
+	u32 i;
+	for (i = 0; i < level->objectCount; i++) {
+		levelObjects[i]->mesh = _findModel(level->objects[i].model);
+	}
+
+	model_t* pickupModel = _findModel(level->pickupModel);
+	for (i = 0; i < level->pickupCount; i++) {
+		pickups[i].object->mesh = pickupModel;
+	}
+	WORLD_attachModels();
+}
+
+void _renderLevel(u32 role, Mtx viewMtx) {
+	u32 i;
+	for (i = 0; i < level->objectCount; i++) {
+		if (level->objects[i].role == role) {
+			OBJECT_render(levelObjects[i], viewMtx);
+		}
+	}
+}
+
+void _toggleHud() {
+	hudVisible = !hudVisible;
+	if (hudVisible) {
+		HUD_init(&hud, GXU_metricSource());
+		hudFrameStart = gettime();
+	}
+}
+
+void _markHud(u32 phase) {
+	/* Charge the time since the last mark to a phase */
+	if (!hudVisible) return;
+	const u64 now = gettime();
+	HUD_phase(&hud, phase, diff_usec(hudMark, now));
+	hudMark = now;
+}
+
+void _drawHud() {
+	if (!hudVisible) return;
+	GXRModeObj* rmode = GXU_getMode();
+	GXU_SetViewport(0, 0, rmode->viWidth, rmode->viHeight, 0, 1);
+	FONT_draw(font, hud.text, 8, 60, FALSE);
+	_markHud(HUD_PHASE_HUD);
+}
@@ -0,0 +1,183 @@
+#include "gxstream.h"
+
+unsigned int GXS_read8(const gxbytes_t* bytes, unsigned int offset) {
+	return bytes->base[(bytes->start + offset) % bytes->ring];
+}
+
+unsigned int GXS_read16(const gxbytes_t* bytes, unsigned int offset) {
+	return GXS_read8(bytes, offset) << 8 | GXS_read8(bytes, offset + 1);
+}
+
+unsigned int GXS_read32(const gxbytes_t* bytes, unsigned int offset) {
+	return GXS_read16(bytes, offset) << 16 | GXS_read16(bytes, offset + 2);
+}
+
+void GXS_bytes(gxbytes_t* bytes, const void* data, unsigned int length) {
+	bytes->base = (const unsigned char*) data;
+	bytes->ring = length > 0 ? length : 1;
+	bytes->start = 0;
+	bytes->length = length;
+}
+
+void GXS_reset(gxvtxstate_t* state) {
+	state->vcdLo = state->vcdHi = 0;
+	state->known = 0;
+}
+
+static unsigned int _GXS_compSize(unsigned int format) {
+	/* u8, s8, u16, s16, f32 */
+	static const unsigned char sizes[8] = { 1, 1, 2, 2, 4, 0, 0, 0 };
+	return sizes[format & 7];
+}
+
+static unsigned int _GXS_colorSize(unsigned int format) {
+	/* RGB565, RGB8, RGBX8, RGBA4, RGBA6, RGBA8 */
+	static const unsigned char sizes[8] = { 2, 3, 4, 2, 3, 4, 0, 0 };
+	return sizes[format & 7];
+}
+
+unsigned int GXS_vertexSize(const gxvtxstate_t* state, unsigned int format) {
+	const unsigned int vatKnown = 7u << (2 + format * 3);
+	if ((state->known & 3) != 3 || (state->known & vatKnown) != vatKnown) return 0;
+
+	/* Where each texture coordinate's element count and type are: VAT group, shift */
+	static const unsigned char texFields[8][2] = {
+		{ 0, 21 }, { 1, 0 }, { 1, 9 }, { 1, 18 }, { 1, 27 }, { 2, 5 }, { 2, 14 }, { 2, 23 }
+	};
+	const unsigned int lo = state->vcdLo, hi = state->vcdHi;
+	const unsigned int* vat = state->vat[format];
+	unsigned int size = 0, i, mode;
+
+	/* Matrix indices */
+	size += lo & 1;
+	for (i = 0; i < 8; i++) {
+		size += (lo >> (1 + i)) & 1;
+	}
+
+	/* Position: XY or XYZ */
+	mode = (lo >> 9) & 3;
+	if (mode == 1) size += (vat[0] & 1 ? 3 : 2) * _GXS_compSize(vat[0] >> 1);
+	else if (mode > 1) size += mode - 1;
+
+	/* Normal: N or NBT, NBT can have an index per vector */
+	mode = (lo >> 11) & 3;
+	const unsigned int nbt = (vat[0] >> 9) & 1;
+	if (mode == 1) size += (nbt ? 9 : 3) * _GXS_compSize(vat[0] >> 10);
+	else if (mode > 1) size += (nbt && (vat[0] >> 31) ? 3 : 1) * (mode - 1);
+
+	/* Colors */
+	for (i = 0; i < 2; i++) {
+		mode = (lo >> (13 + i * 2)) & 3;
+		if (mode == 1) size += _GXS_colorSize(vat[0] >> (14 + i * 4));
+		else if (mode > 1) size += mode - 1;
+	}
+
+	/* Texture coordinates: S or ST */
+	for (i = 0; i < 8; i++) {
+		mode = (hi >> (i * 2)) & 3;
+		const unsigned int field = vat[texFields[i][0]] >> texFields[i][1];
+		if (mode == 1) size += (field & 1 ? 2 : 1) * _GXS_compSize(field >> 1);
+		else if (mode > 1) size += mode - 1;
+	}
+	return size;
+}
+
+int GXS_next(gxvtxstate_t* state, const gxbytes_t* bytes, unsigned int* offset, gxcommand_t* command) {
+	const unsigned int at = *offset;
+	if (at >= bytes->length) return GXS_END;
+
+	const unsigned int opcode = GXS_read8(bytes, at);
+	command->opcode = opcode;
+	command->offset = at;
+	command->address = command->value = command->count = command->vertexSize = 0;
+
+	if (opcode >= GXS_OP_DRAW) {
+		command->type = GXS_DRAW;
+		command->address = opcode & 0xF8;
+		command->value = opcode & 7;
+		if (at + 3 > bytes->length) return GXS_TRUNCATED;
+		command->count = GXS_read16(bytes, at + 1);
+		command->vertexSize = GXS_vertexSize(state, command->value);
+		if (command->vertexSize == 0) return GXS_NO_FORMAT;
+		command->size = 3 + command->count * command->vertexSize;
+	} else {
+		switch (opcode) {
+		case GXS_OP_NOP:
+			command->type = GXS_NOP;
+			command->size = 1;
+			break;
+		case GXS_OP_METRICS:
+			command->type = GXS_OTHER;
+			command->size = 1;
+			break;
+		case GXS_OP_INVAL_VTX:
+			command->type = GXS_INVAL_VTX;
+			command->size = 1;
+			break;
+		case GXS_OP_LOAD_CP:
+			command->type = GXS_CP;
+			command->size = 6;
+			if (at + 6 > bytes->length) return GXS_TRUNCATED;
+			command->address = GXS_read8(bytes, at + 1);
+			command->value = GXS_read32(bytes, at + 2);
+			break;
+		case GXS_OP_LOAD_XF:
+			command->type = GXS_XF;
+			if (at + 5 > bytes->length) return GXS_TRUNCATED;
+			command->value = GXS_read32(bytes, at + 1);
+			command->address = command->value & 0xFFFF;
+			command->count = (command->value >> 16) + 1;
+			command->size = 5 + command->count * 4;
+			break;
+		case GXS_OP_LOAD_INDX_A:
+		case GXS_OP_LOAD_INDX_B:
+		case GXS_OP_LOAD_INDX_C:
+		case GXS_OP_LOAD_INDX_D:
+			command->type = GXS_XF_INDEX;
+			command->size = 5;
+			if (at + 5 > bytes->length) return GXS_TRUNCATED;
+			command->value = GXS_read32(bytes, at + 1);
+			command->address = command->value & 0xFFF;
+			command->count = ((command->value >> 12) & 0xF) + 1;
+			command->value >>= 16;
+			break;
+		case GXS_OP_CALL_DL:
+			command->type = GXS_CALL_DL;
+			command->size = 9;
+			if (at + 9 > bytes->length) return GXS_TRUNCATED;
+			command->address = GXS_read32(bytes, at + 1);
+			command->count = GXS_read32(bytes, at + 5);
+			break;
+		case GXS_OP_LOAD_BP:
+			command->type = GXS_BP;
+			command->size = 5;
+			if (at + 5 > bytes->length) return GXS_TRUNCATED;
+			command->value = GXS_read32(bytes, at + 1);
+			command->address = command->value >> 24;
+			command->value &= 0xFFFFFF;
+			break;
+		default:
+			return GXS_UNKNOWN;
+		}
+	}
+	if (command->size > bytes->length - at) return GXS_TRUNCATED;
+
+	/* Vertex descriptor and formats */
+	if (command->type == GXS_CP) {
+		const unsigned int reg = command->address;
+		if ((reg & 0xF0) == GXS_CP_VCD_LO) {
+			state->vcdLo = command->value;
+			state->known |= 1;
+		} else if ((reg & 0xF0) == GXS_CP_VCD_HI) {
+			state->vcdHi = command->value;
+			state->known |= 2;
+		} else if (reg >= GXS_CP_VAT_A && reg < GXS_CP_VAT_C + 0x10 && (reg & 0x0F) < 8) {
+			const unsigned int format = reg & 7, group = (reg - GXS_CP_VAT_A) >> 4;
+			state->vat[format][group] = command->value;
+			state->known |= 1u << (2 + format * 3 + group);
+		}
+	}
+
+	*offset = at + command->size;
+	return GXS_OK;
+}
@@ -2,14 +2,13 @@
 
 /* SDK libs */
 #include <string.h>
-#include <malloc.h>
 #include <gccore.h>
 
 /* Internal libs */
 #include "sprite.h"
-
-/* Texture definition */
-#include "textures_tpl.h"
+#include "memtrack.h"
+#include "profiler.h"
+#include "perfhud.h"
 
 /* GX vars */
 #define DEFAULT_FIFO_SIZE	(256*1024)
@@ -21,9 +20,25 @@ void *gpfifo = NULL;
 f32 aspectRatio;
 Mtx44 orthographicMatrix;
 
+/* Time GXU_done spent waiting, in microseconds */
+static u32 gpuWait = 0, vsyncWait = 0;
+
+/* GX performance counters per view, the draw sync callback stores them */
+#define GXU_METRIC_TOKEN 0x4D00 /*< Draw sync token of view 0 */
+static struct {
+	u32   counters[HUD_MAX_VIEWS][HUD_VIEW_COUNTERS];
+	u32   views;     /*< Views the GPU got through this frame      */
+	u8*   fifoLast;  /*< CPU FIFO write pointer at the last sample */
+	u32   fifoBytes; /*< Written this frame up to the last sample  */
+	BOOL  setup;
+} metrics;
+
 /* Texture file */
 TPLFile TPLfile;
 
+/* Texture object loaded in each texture map */
+static GXTexObj* boundTextures[GX_MAX_TEXMAP];
+
 void GXU_init() {
 	VIDEO_Init();
 
@@ -36,6 +51,8 @@ void GXU_init() {
 	/* Allocate frame buffers */
 	xfb[0] = (u32 *)MEM_K0_TO_K1(SYS_AllocateFramebuffer(rmode));
 	xfb[1] = (u32 *)MEM_K0_TO_K1(SYS_AllocateFramebuffer(rmode));
+	MEMTRACK_add(MEMTAG_VIDEO, VIDEO_GetFrameBufferSize(rmode));
+	MEMTRACK_add(MEMTAG_VIDEO, VIDEO_GetFrameBufferSize(rmode));
 
 	/* Clean buffers */
 	VIDEO_ClearFrameBuffer(rmode, xfb[0], COLOR_BLACK);
@@ -65,7 +82,7 @@ void GXU_init() {
 	fbi ^= 1;
 
 	/* Init flipper */
-	gpfifo = MEM_K0_TO_K1(memalign(32, DEFAULT_FIFO_SIZE));
+	gpfifo = MEM_K0_TO_K1(MEMTRACK_memalign(MEMTAG_GX, 32, DEFAULT_FIFO_SIZE));
 	memset(gpfifo, 0, DEFAULT_FIFO_SIZE);
 	GX_Init(gpfifo, DEFAULT_FIFO_SIZE);
 
@@ -88,9 +105,6 @@ void GXU_init() {
 	/* Clear texture cache */
 	GX_InvalidateTexAll();
 
-	/* Open TPL file from memory (statically linked in) */
-	TPL_OpenTPLFromMemory(&TPLfile, (void *) textures_tpl, textures_tpl_size);
-
 	GX_SetNumTexGens(1);
 	GX_SetTexCoordGen(GX_TEXCOORD0, GX_TG_MTX2x4, GX_TG_TEX0, GX_IDENTITY);
 	GX_SetTevOrder(GX_TEVSTAGE0, GX_TEXCOORD0, GX_TEXMAP0, GX_COLOR0A0);
@@ -100,12 +114,30 @@ void GXU_init() {
 	GXU_SetViewport(0, 0, rmode->viWidth, rmode->viHeight, 0, 1);
 }
 
+void GXU_openTPL(void* data, u32 size) {
+	TPL_OpenTPLFromMemory(&TPLfile, data, size);
+	/* Texture objects loaded from it may be ones bound before */
+	GXU_invalidateTextures();
+}
+
 void GXU_closeTPL() {
 	TPL_CloseTPLFile(&TPLfile);
 }
 
 void GXU_loadTexture(s32 texId, GXTexObj* texObj) {
 	TPL_GetTexture(&TPLfile, texId, texObj);
+	GXU_invalidateTextures();
+}
+
+void GXU_bindTexture(GXTexObj* texObj, u8 mapId) {
+	if (boundTextures[mapId] == texObj) return;
+
+	GX_LoadTexObj(texObj, mapId);
+	boundTextures[mapId] = texObj;
+}
+
+void GXU_invalidateTextures() {
+	memset(boundTextures, 0, sizeof(boundTextures));
 }
 
 void GXU_done() {
@@ -114,7 +146,12 @@ void GXU_done() {
 	GX_SetColorUpdate(GX_TRUE);
 	GX_CopyDisp(xfb[fbi], GX_TRUE);
 
+	/* Waits for the GPU to finish the frame */
+	PROF_BEGIN(drawDone);
+	const u64 drawStart = gettime();
 	GX_DrawDone();
+	gpuWait = diff_usec(drawStart, gettime());
+	PROF_END(drawDone, "GX_DrawDone");
 
 	/* Flush and swap buffers */
 	VIDEO_SetNextFramebuffer(xfb[fbi]);
@@ -124,9 +161,84 @@ void GXU_done() {
 	}
 
 	VIDEO_Flush();
+	PROF_BEGIN(vsync);
+	const u64 vsyncStart = gettime();
 	VIDEO_WaitVSync();
+	vsyncWait = diff_usec(vsyncStart, gettime());
+	PROF_END(vsync, "VIDEO_WaitVSync");
 	fbi ^= 1;
 }
+
+void GXU_frameWaits(u32* gpuMicros, u32* vsyncMicros) {
+	*gpuMicros = gpuWait;
+	*vsyncMicros = vsyncWait;
+}
+
+/* Runs in the interrupt raised when the GPU reaches a view's token */
+static void _GXU_metricSync(u16 token) {
+	const u32 view = token - GXU_METRIC_TOKEN;
+	if (view >= HUD_MAX_VIEWS) return;
+	GX_ReadGPMetric(&metrics.counters[view][0], &metrics.counters[view][1]);
+	GX_ClearGPMetric();
+	if (view + 1 > metrics.views) metrics.views = view + 1;
+}
+
+/* Where the CPU writes commands next, and the FIFO size */
+static u8* _GXU_fifoWrite(u32* size) {
+	GXFifoObj fifo;
+	void *readPtr, *writePtr;
+	GX_GetCPUFifo(&fifo);
+	GX_GetFifoPtrs(&fifo, &readPtr, &writePtr);
+	*size = GX_GetFifoSize(&fifo);
+	return writePtr;
+}
+
+/* Count what was written since the last sample, the FIFO is a ring so a stretch
+ * that went around it whole would be a lap short: sampling every view keeps each
+ * stretch far below the FIFO size */
+static void _GXU_fifoSample() {
+	u32 size;
+	u8* fifoNow = _GXU_fifoWrite(&size);
+	metrics.fifoBytes += (fifoNow - metrics.fifoLast + size) % size;
+	metrics.fifoLast = fifoNow;
+}
+
+static void _GXU_metricBegin(void* user) {
+	(void) user;
+	if (!metrics.setup) {
+		GX_SetGPMetric(GX_PERF0_TRIANGLES, GX_PERF1_VERTICES);
+		GX_SetDrawSyncCallback(_GXU_metricSync);
+		metrics.setup = TRUE;
+	}
+	/* GXU_done waited for the GPU, nothing is in flight */
+	GX_ClearGPMetric();
+	metrics.views = 0;
+	u32 size;
+	metrics.fifoLast = _GXU_fifoWrite(&size);
+	metrics.fifoBytes = 0;
+}
+
+static void _GXU_metricEndView(void* user, unsigned int view) {
+	(void) user;
+	GX_SetDrawSync(GXU_METRIC_TOKEN + view);
+	_GXU_fifoSample();
+}
+
+static void _GXU_metricCollect(void* user, hudreadings_t* readings) {
+	(void) user;
+	memcpy(readings->counters, metrics.counters, sizeof(metrics.counters));
+	readings->views = metrics.views;
+
+	_GXU_fifoSample();
+	readings->fifoBytes = metrics.fifoBytes;
+}
+
+const hudsource_t* GXU_metricSource() {
+	static const hudsource_t source = {
+		"gx", { "tris", "verts" }, _GXU_metricBegin, _GXU_metricEndView, _GXU_metricCollect, NULL
+	};
+	return &source;
+}
 void GXU_setLight(Mtx view, GXColor lightColor, guVector lpos) {
 	GXLightObj lobj;
 
@@ -1,4 +1,5 @@
 #include "input.h"
+#include "profiler.h"
 #include <ogc/video.h>
 #include <math.h>
 
@@ -7,6 +8,7 @@ u32 _GCConnected, _Wiimotes;
 inline f32 _CLAMP(const f32 value, const f32 minVal, const f32 maxVal);
 
 void INPUT_update() {
+	PROF_SCOPE("INPUT_update");
 	_GCConnected = PAD_ScanPads();
 #ifdef WII
 	/* Read and process incoming wiimote data */
@@ -139,6 +141,31 @@ BOOL INPUT_checkControllers() {
 	return FALSE;
 }
 
+BOOL INPUT_comboPressed(u32 gcCombo, u32 wiiCombo) {
+	u8 i;
+	for (i = 0; i < 4; i++) {
+		if (INPUT_isConnected(INPUT_CONTROLLER_GAMECUBE, i) == TRUE) {
+			if ((PAD_ButtonsHeld(i) & gcCombo) == gcCombo && (PAD_ButtonsDown(i) & gcCombo) != 0) {
+				return TRUE;
+			}
+		}
+	}
+
+#ifdef WII
+	for (i = WPAD_CHAN_0; i < WPAD_MAX_WIIMOTES; i++) {
+		if (INPUT_isConnected(INPUT_CONTROLLER_WIIMOTE, i) == TRUE) {
+			if ((WPAD_ButtonsHeld(i) & wiiCombo) == wiiCombo && (WPAD_ButtonsDown(i) & wiiCombo) != 0) {
+				return TRUE;
+			}
+		}
+	}
+#else
+	(void) wiiCombo;
+#endif
+
+	return FALSE;
+}
+
 inline f32 _CLAMP(const f32 value, const f32 minVal, const f32 maxVal) {
 	return value < minVal ? minVal : value > maxVal ? maxVal : value;
 }
\ No newline at end of file
@@ -0,0 +1,107 @@
+#include "level.h"
+
+#include <stddef.h>
+#include <stdio.h>
+
+/* Turn an array offset into a pointer, NULL if the array isn't inside the file */
+static void* _LEVEL_array(u8* base, u32 size, const void* field, u32 count, u32 itemSize) {
+	const u32 offset = (u32) (size_t) field;
+	if (offset % 4 != 0 || offset > size || count > (size - offset) / itemSize) return NULL;
+	return base + offset;
+}
+
+level_t* LEVEL_load(void* data, u32 size) {
+	level_t* level = (level_t*) data;
+	if (data == NULL || size < sizeof(level_t) || level->magic != LEVEL_MAGIC || level->version != LEVEL_VERSION || level->size > size) {
+		printf("Error: Not a version %u level\n", LEVEL_VERSION);
+		return NULL;
+	}
+
+	u8* base = (u8*) data;
+	level->objects = _LEVEL_array(base, size, level->objects, level->objectCount, sizeof(levelobject_t));
+	level->pickups = _LEVEL_array(base, size, level->pickups, level->pickupCount, sizeof(guVector));
+	level->spawns = _LEVEL_array(base, size, level->spawns, level->spawnCount, sizeof(levelarea_t));
+	level->checkpoints = _LEVEL_array(base, size, level->checkpoints, level->checkpointCount, sizeof(levelpoint_t));
+	/* A grid whose tile count wraps around would pass the bounds check with a small count */
+	const BOOL gridFits = level->tilesZ == 0 || level->tilesX <= 0xFFFFFFFFu / level->tilesZ;
+	level->tileSizes = gridFits ? _LEVEL_array(base, size, level->tileSizes, level->tilesX * level->tilesZ, sizeof(u32)) : NULL;
+	if (level->objects == NULL || level->pickups == NULL || level->spawns == NULL || level->checkpoints == NULL
+		|| level->tileSizes == NULL || level->spawnCount == 0 || level->streamSlots == 0 || level->tileSize <= 0) {
+		printf("Error: Corrupt level\n");
+		return NULL;
+	}
+	return level;
+}
+
+leveltile_t* LEVEL_loadTile(void* data, u32 size) {
+	leveltile_t* tile = (leveltile_t*) data;
+	if (data == NULL || size < sizeof(leveltile_t) || tile->magic != TILE_MAGIC || tile->version != TILE_VERSION || tile->size > size) {
+		printf("Error: Not a version %u level tile\n", TILE_VERSION);
+		return NULL;
+	}
+
+	u8* base = (u8*) data;
+	levelground_t* ground = &tile->ground;
+	/* Same for a sample count that wraps around */
+	const BOOL samplesFit = ground->depth == 0 || ground->width <= 0xFFFFFFFFu / ground->depth;
+	const u32 samples = ground->width * ground->depth;
+	tile->objects = _LEVEL_array(base, size, tile->objects, tile->objectCount, sizeof(levelobject_t));
+	ground->heights = samplesFit ? _LEVEL_array(base, size, ground->heights, samples, sizeof(f32)) : NULL;
+	ground->normals = samplesFit ? _LEVEL_array(base, size, ground->normals, samples, 4) : NULL;
+	/* The mesh is a model used in place, it needs the alignment of a loaded entry */
+	const u32 mesh = (u32) (size_t) tile->mesh;
+	tile->mesh = mesh == 0 ? NULL : _LEVEL_array(base, size, tile->mesh, tile->meshSize, 1);
+	if (tile->objects == NULL || ground->heights == NULL || ground->normals == NULL
+		|| (mesh != 0 && (tile->mesh == NULL || mesh % 32 != 0))
+		|| ground->width < 2 || ground->depth < 2 || ground->cellSize <= 0) {
+		printf("Error: Corrupt level tile\n");
+		return NULL;
+	}
+	return tile;
+}
+
+BOOL LEVEL_ground(const levelground_t* ground, f32 x, f32 z, f32* height, guVector* normal) {
+	const f32 fx = (x - ground->originX) / ground->cellSize;
+	const f32 fz = (z - ground->originZ) / ground->cellSize;
+	if (fx < 0 || fz < 0 || fx > ground->width - 1 || fz > ground->depth - 1) return FALSE;
+
+	/* Cell and position in it, the far edges belong to the last cell */
+	u32 ix = (u32) fx, iz = (u32) fz;
+	if (ix > ground->width - 2) ix = ground->width - 2;
+	if (iz > ground->depth - 2) iz = ground->depth - 2;
+	const f32 tx = fx - ix, tz = fz - iz;
+
+	const u32 sample = iz * ground->width + ix;
+	const f32* h = &ground->heights[sample];
+	const f32 h00 = h[0], h10 = h[1], h01 = h[ground->width], h11 = h[ground->width + 1];
+	if (h00 == LEVEL_NO_GROUND || h10 == LEVEL_NO_GROUND || h01 == LEVEL_NO_GROUND || h11 == LEVEL_NO_GROUND) return FALSE;
+
+	/* Weights of the corners in the triangle of the cell the point is in */
+	const s8* n = &ground->normals[sample * 4];
+	f32 w00, w10, w01, w11;
+	if (n[3] == LEVEL_SPLIT_RISING) {
+		if (tx + tz <= 1) {
+			w00 = 1 - tx - tz; w10 = tx; w01 = tz; w11 = 0;
+		} else {
+			w00 = 0; w10 = 1 - tz; w01 = 1 - tx; w11 = tx + tz - 1;
+		}
+	} else {
+		if (tx >= tz) {
+			w00 = 1 - tx; w10 = tx - tz; w01 = 0; w11 = tz;
+		} else {
+			w00 = 1 - tz; w10 = 0; w01 = tz - tx; w11 = tx;
+		}
+	}
+	*height = w00 * h00 + w10 * h10 + w01 * h01 + w11 * h11;
+
+	if (normal != NULL) {
+		const s8* n10 = n + 4;
+		const s8* n01 = n + ground->width * 4;
+		const s8* n11 = n01 + 4;
+		normal->x = w00 * n[0] + w10 * n10[0] + w01 * n01[0] + w11 * n11[0];
+		normal->y = w00 * n[1] + w10 * n10[1] + w01 * n01[1] + w11 * n11[1];
+		normal->z = w00 * n[2] + w10 * n10[2] + w01 * n01[2] + w11 * n11[2];
+		guVecNormalize(normal);
+	}
+	return TRUE;
+}
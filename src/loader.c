@@ -0,0 +1,198 @@
+#include "loader.h"
+
+#include <string.h>
+#include <gccore.h>
+
+#include "spsc.h"
+#include "memtrack.h"
+#include "profiler.h"
+
+/* Below the main thread (64), so loading runs while it waits for the GPU and retrace */
+#define LOADER_PRIORITY   32
+#define LOADER_STACK_SIZE (32*1024)
+
+/* Request types */
+enum {
+	LOADER_REQ_DATA  = 0,
+	LOADER_REQ_MODEL = 1,
+	LOADER_REQ_QUIT  = 2
+};
+
+typedef struct {
+	u32               type;                  /*< LOADER_REQ_*                              */
+	char              name[PAK_NAME_LENGTH]; /*< Entry name                                */
+	loadhandle_t*     handle;                /*< Where results go                          */
+	const pakentry_t* entry;                 /*< Entry, when the buffer is handle->data    */
+	u32               bufferSize;            /*< Size of that buffer                       */
+} loadrequest_t;
+
+static pak_t* pak = NULL;
+static lwp_t thread = LWP_THREAD_NULL;
+static sem_t requestSem;
+
+/* Main thread pushes, loader thread pops */
+static spscqueue_t queue ATTRIBUTE_ALIGN(32);
+static loadrequest_t requests[LOADER_QUEUE_SIZE];
+
+/* Handles come from a pool, so requests made during gameplay don't touch the heap */
+static loadhandle_t handles[LOADER_HANDLES];
+static BOOL handleUsed[LOADER_HANDLES];
+
+/* Requests pushed (main thread) and finished (loader thread) */
+static u32 issued = 0;
+static u32 finished = 0;
+
+static void* _LOADER_thread(void* arg) {
+	(void) arg;
+	PROF_NAME_THREAD("loader");
+	loadrequest_t request;
+	for (;;) {
+		/* One post per push, so there is always an item after waking up */
+		LWP_SemWait(requestSem);
+		if (!SPSC_pop(&queue, &request)) continue;
+		if (request.type == LOADER_REQ_QUIT) break;
+
+		loadhandle_t* handle = request.handle;
+		BOOL ok;
+		PROF_BEGIN(load);
+		if (request.entry != NULL) {
+			/* Into the buffer the game took from an arena */
+			ok = PAK_read(pak, request.entry, handle->data, request.bufferSize);
+			handle->size = request.entry->size;
+			if (!ok) handle->data = NULL;
+		} else {
+			handle->data = PAK_load(pak, request.name, &handle->size);
+			ok = handle->data != NULL;
+		}
+		PROF_END(load, "PAK_load");
+		/* Arenas are the main thread's, LOADER_poll sets those models up */
+		if (ok && request.type == LOADER_REQ_MODEL && handle->arena == NULL) {
+			PROF_SCOPE("MODEL_setup");
+			handle->model = MODEL_setup(handle->data, handle->size);
+			if (handle->model == NULL) {
+				MEMTRACK_free(handle->data);
+				handle->data = NULL;
+				ok = FALSE;
+			} else {
+				MEMTRACK_retag(handle->data, MEMTAG_MODEL);
+			}
+		}
+
+		/* Results are written before the game can see the new state */
+		__atomic_store_n(&handle->state, ok ? LOAD_DONE : LOAD_FAILED, __ATOMIC_RELEASE);
+		__atomic_store_n(&finished, finished + 1, __ATOMIC_RELEASE);
+	}
+	return NULL;
+}
+
+static BOOL _LOADER_push(u32 type, const char* name, loadhandle_t* handle, const pakentry_t* entry, u32 bufferSize) {
+	loadrequest_t request;
+	request.type = type;
+	memset(request.name, 0, sizeof(request.name));
+	if (name != NULL) strncpy(request.name, name, PAK_NAME_LENGTH - 1);
+	request.handle = handle;
+	request.entry = entry;
+	request.bufferSize = bufferSize;
+	if (!SPSC_push(&queue, &request)) return FALSE;
+
+	issued++;
+	LWP_SemPost(requestSem);
+	return TRUE;
+}
+
+static loadhandle_t* _LOADER_request(u32 type, const char* name, arena_t* arena) {
+	u32 index;
+	for (index = 0; index < LOADER_HANDLES && handleUsed[index]; index++);
+	if (index == LOADER_HANDLES) {
+		printf("Error: No free load handle, %s not loaded\n", name);
+		return NULL;
+	}
+
+	/* The directory never changes, so it can be read here while the loader thread reads entries */
+	const pakentry_t* entry = NULL;
+	u32 bufferSize = 0;
+	void* buffer = NULL;
+	if (arena != NULL) {
+		entry = PAK_find(pak, name);
+		if (entry == NULL) {
+			printf("Error: No %s in the archive\n", name);
+			return NULL;
+		}
+		bufferSize = PAK_bufferSize(pak, entry);
+		buffer = ARENA_alloc(arena, bufferSize);
+		if (buffer == NULL) {
+			printf("Error: Arena %s is full, %s not loaded\n", arena->name, name);
+			return NULL;
+		}
+	}
+
+	loadhandle_t* handle = &handles[index];
+	handle->state = LOAD_PENDING;
+	handle->data = buffer;
+	handle->size = 0;
+	handle->model = NULL;
+	handle->arena = arena;
+	if (!_LOADER_push(type, name, handle, entry, bufferSize)) {
+		printf("Error: Load queue full, %s not loaded\n", name);
+		return NULL;
+	}
+	handleUsed[index] = TRUE;
+	return handle;
+}
+
+void LOADER_init(pak_t* archive) {
+	pak = archive;
+	SPSC_init(&queue, requests, LOADER_QUEUE_SIZE, sizeof(loadrequest_t));
+	LWP_SemInit(&requestSem, 0, LOADER_QUEUE_SIZE);
+	LWP_CreateThread(&thread, _LOADER_thread, NULL, NULL, LOADER_STACK_SIZE, LOADER_PRIORITY);
+}
+
+void LOADER_shutdown() {
+	if (thread == LWP_THREAD_NULL) return;
+
+	/* Wait for a free slot, the quit request goes after everything queued */
+	while (!_LOADER_push(LOADER_REQ_QUIT, NULL, NULL, NULL, 0)) {
+		LWP_YieldThread();
+	}
+	LWP_JoinThread(thread, NULL);
+	LWP_SemDestroy(requestSem);
+	thread = LWP_THREAD_NULL;
+}
+
+loadhandle_t* LOADER_load(const char* name) {
+	return _LOADER_request(LOADER_REQ_DATA, name, NULL);
+}
+
+loadhandle_t* LOADER_loadModel(const char* name) {
+	return _LOADER_request(LOADER_REQ_MODEL, name, NULL);
+}
+
+loadhandle_t* LOADER_loadModelIn(arena_t* arena, const char* name) {
+	return _LOADER_request(LOADER_REQ_MODEL, name, arena);
+}
+
+BOOL LOADER_poll(loadhandle_t* handle) {
+	const u32 state = __atomic_load_n(&handle->state, __ATOMIC_ACQUIRE);
+	if (state == LOAD_PENDING) return FALSE;
+
+	/* Models loaded in an arena are set up here, the first time the game sees them
+	 * (a failed entry's buffer stays in the arena until it's reset) */
+	if (state == LOAD_DONE && handle->arena != NULL && handle->model == NULL) {
+		PROF_SCOPE("MODEL_setup");
+		handle->model = MODEL_setupIn(handle->arena, handle->data, handle->size);
+		if (handle->model == NULL) {
+			handle->data = NULL;
+			handle->state = LOAD_FAILED;
+		}
+	}
+	return TRUE;
+}
+
+void LOADER_release(loadhandle_t* handle) {
+	handleUsed[handle - handles] = FALSE;
+}
+
+u32 LOADER_pending() {
+	/* The quit request is never finished, but then nobody asks anymore */
+	return issued - __atomic_load_n(&finished, __ATOMIC_ACQUIRE);
+}
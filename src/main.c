@@ -8,6 +8,7 @@
 #include "input.h"
 #include "audioutil.h"
 #include "mathutil.h"
+#include "profiler.h"
 
 BOOL isRunning;
 void OnResetCalled();
@@ -24,9 +25,18 @@ int main() {
 
 	AU_init();
 
+	PROF_NAME_THREAD("main");
+
 	isRunning = TRUE;
 	while (isRunning) {
+		PROF_SCOPE("frame");
 		INPUT_update();
+#ifdef PROFILE
+		/* Write the last few seconds out for chrome://tracing */
+		if (INPUT_comboPressed(INPUT_GC_COMBO_TRACE, INPUT_WII_COMBO_TRACE)) {
+			PROF_dump(PROF_DUMP_FILE);
+		}
+#endif
 		GAME_render();
 	}
 
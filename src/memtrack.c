@@ -0,0 +1,193 @@
+#include "memtrack.h"
+
+#include <malloc.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef GEKKO
+#include <gccore.h>
+#else
+#include <pthread.h>
+#endif
+
+/* In front of every block, the padding before it is at least this big */
+typedef struct {
+	unsigned int magic;  /*< MEMTRACK_MAGIC, catches frees of other blocks */
+	unsigned int tag;
+	unsigned int size;   /*< Bytes asked for                       */
+	unsigned int offset; /*< From the start of the heap block      */
+} memblock_t;
+
+#define MEMTRACK_MAGIC 0x4D54524B /*< "MTRK" */
+
+static const char* tagNames[MEMTAG_COUNT] = {
+	"gx fifo", "framebuffers", "textures", "models", "objects", "level",
+	"font", "display lists", "audio", "assets", "scratch"
+};
+
+typedef struct {
+	unsigned int current, peak, blocks;
+	unsigned int frame, lastFrame, worstFrame;
+} memtag_t;
+
+static memtag_t tags[MEMTAG_COUNT];
+
+/* Counters are shared with the loader thread */
+#ifdef GEKKO
+static unsigned int _MEMTRACK_lock() {
+	u32 level;
+	_CPU_ISR_Disable(level);
+	return level;
+}
+
+static void _MEMTRACK_unlock(unsigned int level) {
+	_CPU_ISR_Restore(level);
+}
+#else
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static unsigned int _MEMTRACK_lock() {
+	pthread_mutex_lock(&mutex);
+	return 0;
+}
+
+static void _MEMTRACK_unlock(unsigned int level) {
+	(void) level;
+	pthread_mutex_unlock(&mutex);
+}
+#endif
+
+static void _MEMTRACK_count(unsigned int tag, int size, int blocks, int allocs) {
+	const unsigned int level = _MEMTRACK_lock();
+	memtag_t* entry = &tags[tag];
+	entry->current += size;
+	entry->blocks += blocks;
+	entry->frame += allocs;
+	if (entry->current > entry->peak) entry->peak = entry->current;
+	_MEMTRACK_unlock(level);
+}
+
+static memblock_t* _MEMTRACK_header(void* block) {
+	memblock_t* header = (memblock_t*) block - 1;
+	if (header->magic != MEMTRACK_MAGIC) {
+		printf("Error: %p wasn't allocated with MEMTRACK\n", block);
+		return NULL;
+	}
+	return header;
+}
+
+void* MEMTRACK_memalign(unsigned int tag, unsigned int align, unsigned int size) {
+	if (align < sizeof(unsigned int) * 2) align = sizeof(unsigned int) * 2;
+	const unsigned int offset = (sizeof(memblock_t) + align - 1) & ~(align - 1);
+	unsigned char* raw = memalign(align, offset + size);
+	if (raw == NULL) return NULL;
+
+	memblock_t* header = (memblock_t*) (raw + offset) - 1;
+	header->magic = MEMTRACK_MAGIC;
+	header->tag = tag;
+	header->size = size;
+	header->offset = offset;
+	_MEMTRACK_count(tag, size, 1, 1);
+	return raw + offset;
+}
+
+void* MEMTRACK_alloc(unsigned int tag, unsigned int size) {
+	return MEMTRACK_memalign(tag, 0, size);
+}
+
+void* MEMTRACK_calloc(unsigned int tag, unsigned int count, unsigned int size) {
+	void* block = MEMTRACK_memalign(tag, 0, count * size);
+	if (block != NULL) memset(block, 0, count * size);
+	return block;
+}
+
+char* MEMTRACK_strdup(unsigned int tag, const char* text) {
+	const unsigned int length = strlen(text) + 1;
+	char* copy = MEMTRACK_memalign(tag, 0, length);
+	if (copy != NULL) memcpy(copy, text, length);
+	return copy;
+}
+
+void MEMTRACK_free(void* block) {
+	if (block == NULL) return;
+	memblock_t* header = _MEMTRACK_header(block);
+	if (header == NULL) return;
+
+	_MEMTRACK_count(header->tag, -(int) header->size, -1, 0);
+	header->magic = 0;
+	free((unsigned char*) block - header->offset);
+}
+
+void MEMTRACK_retag(void* block, unsigned int tag) {
+	if (block == NULL) return;
+	memblock_t* header = _MEMTRACK_header(block);
+	if (header == NULL || header->tag == tag) return;
+
+	_MEMTRACK_count(header->tag, -(int) header->size, -1, 0);
+	_MEMTRACK_count(tag, header->size, 1, 0);
+	header->tag = tag;
+}
+
+void MEMTRACK_add(unsigned int tag, int size) {
+	_MEMTRACK_count(tag, size, size > 0 ? 1 : -1, size > 0);
+}
+
+void MEMTRACK_frame() {
+	const unsigned int level = _MEMTRACK_lock();
+	unsigned int i;
+	for (i = 0; i < MEMTAG_COUNT; i++) {
+		memtag_t* entry = &tags[i];
+		entry->lastFrame = entry->frame;
+		if (entry->frame > entry->worstFrame) entry->worstFrame = entry->frame;
+		entry->frame = 0;
+	}
+	_MEMTRACK_unlock(level);
+}
+
+void MEMTRACK_stats(unsigned int tag, memtagstats_t* stats) {
+	const unsigned int level = _MEMTRACK_lock();
+	const memtag_t* entry = &tags[tag];
+	stats->name = tagNames[tag];
+	stats->current = entry->current;
+	stats->peak = entry->peak;
+	stats->blocks = entry->blocks;
+	stats->lastFrame = entry->lastFrame;
+	stats->worstFrame = entry->worstFrame;
+	_MEMTRACK_unlock(level);
+}
+
+unsigned int MEMTRACK_format(char* buffer, unsigned int size) {
+	unsigned int length = 0, total = 0, i;
+	int written = snprintf(buffer, size, "memory KB        now   peak blocks frame worst\n");
+	for (i = 0; i < MEMTAG_COUNT && written >= 0 && length + written < size; i++) {
+		length += written;
+		memtagstats_t stats;
+		MEMTRACK_stats(i, &stats);
+		total += stats.current;
+		written = snprintf(buffer + length, size - length, "%-14s %6u %6u %6u %5u %5u\n", stats.name,
+						   (stats.current + 512) / 1024, (stats.peak + 512) / 1024, stats.blocks, stats.lastFrame, stats.worstFrame);
+	}
+	if (written >= 0 && length + written < size) {
+		length += written;
+		written = snprintf(buffer + length, size - length, "%-14s %6u\n", "total", (total + 512) / 1024);
+	}
+#ifdef GEKKO
+	/* Whatever the SDK and libraries allocated themselves */
+	if (written >= 0 && length + written < size) {
+		length += written;
+		const struct mallinfo info = mallinfo();
+		const unsigned int untracked = (unsigned int) info.uordblks > total ? info.uordblks - total : 0;
+		written = snprintf(buffer + length, size - length, "%-14s %6u\n", "untracked", (untracked + 512) / 1024);
+	}
+#endif
+	if (written >= 0 && length + written < size) length += written;
+	/* Drop a line that was cut short */
+	if (size > 0) buffer[length] = '\0';
+	return length;
+}
+
+void MEMTRACK_print() {
+	char report[1024];
+	MEMTRACK_format(report, sizeof(report));
+	printf("%s", report);
+}
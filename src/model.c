@@ -1,98 +1,275 @@
 #include "model.h"
+#include "gxutils.h"
+#include "memtrack.h"
 
-#include <malloc.h>
 #include <string.h>
 #include <stdio.h>
 
-model_t* MODEL_setup(const u8* model_bmb) {
-	binheader_t* header = (binheader_t*) model_bmb;
+/* Size of a single component of the given GX type */
+static u32 _MODEL_compSize(u8 type) {
+	switch (type) {
+	case GX_U8:
+	case GX_S8:
+		return 1;
+	case GX_U16:
+	case GX_S16:
+		return 2;
+	default:
+		return 4;
+	}
+}
 
-	const u32 posOffset = sizeof(binheader_t);
-	const u32 nrmOffset = posOffset + (sizeof(f32)* header->vcount * 3);
-	const u32 texOffset = nrmOffset + (sizeof(f32)* header->ncount * 3);
-	const u32 indOffset = texOffset + (sizeof(f32)* header->vtcount * 2);
+/* Display list opcodes written by obj2bin */
+#define MODEL_DL_NOP     0x00
+#define MODEL_DL_VTXFMT  0x07
 
-	f32* positions = (f32*) (model_bmb + posOffset);
-	f32* normals = (f32*) (model_bmb + nrmOffset);
-	f32* texcoords = (f32*) (model_bmb + texOffset);
-	index_t* indices = (index_t*) (model_bmb + indOffset);
+model_t* MODEL_setup(const u8* model_bmb, u32 size) {
+	return MODEL_setupIn(NULL, model_bmb, size);
+}
 
-	/* Calculate cost */
-	const u32 indicesCount = header->fcount * 3;
-	const u32 indicesSize = indicesCount * sizeof(index_t); /* 3 indices per vertex index (p,n,t) that are u16 in size */
-	const u32 callSize = 89; /* Size of setup var */
-	/* Round up to nearest 32 multiplication */
-	const u32 dispSize = (((indicesSize + callSize + 63) >> 5) + 1) << 5;
+/* Check the header and section table against the bytes there are (as readBmb does in the tools),
+ * so a broken file can't make the setup write past its tables */
+static BOOL _MODEL_check(const u8* model_bmb, u32 size) {
+	const binheader_t* header = (const binheader_t*) model_bmb;
+	if (header == NULL || size < sizeof(binheader_t) || header->magic != BMB_MAGIC || header->version != BMB_VERSION) {
+		printf("Error: Not a version %u model file\n", BMB_VERSION);
+		return FALSE;
+	}
+	if (header->size > size || sizeof(binheader_t) + header->sectionCount * sizeof(binsection_t) > header->size) {
+		printf("Error: Truncated model file\n");
+		return FALSE;
+	}
 
-	/* Build display list */
-	/* Allocate and clear */
+	const binsection_t* sections = (const binsection_t*) (model_bmb + sizeof(binheader_t));
 	u32 i;
-	void* modelList = memalign(32, dispSize);
-	memset(modelList, 0, dispSize);
+	for (i = 0; i < header->sectionCount; i++) {
+		const binsection_t* section = &sections[i];
+		if (section->offset % 32 != 0 || section->offset > header->size || section->size > header->size - section->offset) {
+			printf("Error: Model section %u out of bounds\n", i);
+			return FALSE;
+		}
+		if (section->submesh >= header->submeshCount) {
+			printf("Error: Model section %u of a missing submesh\n", i);
+			return FALSE;
+		}
+		if ((section->type == BMB_SECTION_MESH && section->size < sizeof(binmesh_t))
+			|| (section->type == BMB_SECTION_BOUNDS && section->size < sizeof(binbounds_t))) {
+			printf("Error: Model section %u too small\n", i);
+			return FALSE;
+		}
+	}
+	return TRUE;
+}
 
-	/* Set buffer data */
-	DCInvalidateRange(modelList, dispSize);
-	GX_BeginDispList(modelList, dispSize);
+/* Model tables come from the arena, or the heap without one */
+static void* _MODEL_alloc(arena_t* arena, u32 count, u32 size) {
+	return arena != NULL ? ARENA_calloc(arena, count, size) : MEMTRACK_calloc(MEMTAG_MODEL, count, size);
+}
 
-	//GX_InvVtxCache();
-	GX_ClearVtxDesc();
-	GX_SetVtxDesc(GX_VA_POS, GX_INDEX16);
-	GX_SetVtxDesc(GX_VA_NRM, GX_INDEX16);
-	GX_SetVtxDesc(GX_VA_TEX0, GX_INDEX16);
+model_t* MODEL_setupIn(arena_t* arena, const u8* model_bmb, u32 size) {
+	if (!_MODEL_check(model_bmb, size)) return NULL;
+	const binheader_t* header = (const binheader_t*) model_bmb;
 
-	GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_POS, GX_POS_XYZ, GX_F32, 0);
-	GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_NRM, GX_NRM_XYZ, GX_F32, 0);
-	GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_TEX0, GX_TEX_ST, GX_F32, 0);
+	model_t* model = _MODEL_alloc(arena, 1, sizeof(model_t));
+	submesh_t* submeshes = _MODEL_alloc(arena, header->submeshCount, sizeof(submesh_t));
+	if (model == NULL || submeshes == NULL) {
+		if (arena == NULL) {
+			MEMTRACK_free(model);
+			MEMTRACK_free(submeshes);
+		}
+		return NULL;
+	}
+	model->materialCount = 1;
+	model->materials = NULL;
 
-	GX_SetArray(GX_VA_POS, (void*) positions, 3 * sizeof(f32));
-	GX_SetArray(GX_VA_NRM, (void*) normals, 3 * sizeof(f32));
-	GX_SetArray(GX_VA_TEX0, (void*) texcoords, 2 * sizeof(f32));
+	/* Everything is used in place, only the section table is read */
+	const binsection_t* sections = (const binsection_t*) (model_bmb + sizeof(binheader_t));
+	u32 faceCount = 0;
+	u32 i;
+	for (i = 0; i < header->sectionCount; i++) {
+		const binsection_t* section = &sections[i];
+		void* payload = (void*) (model_bmb + section->offset);
+		submesh_t* submesh = &submeshes[section->submesh];
 
-	/* Fill the list with indices */
-	GX_Begin(GX_TRIANGLES, GX_VTXFMT0, indicesCount);
-	for (i = 0; i < indicesCount; i++) {
-		index_t index = indices[i];
-		GX_Position1x16(index.vertex);
-		GX_Normal1x16(index.normal);
-		GX_TexCoord1x16(index.uv);
+		switch (section->type) {
+		case BMB_SECTION_MESH: {
+			const binmesh_t* mesh = (const binmesh_t*) payload;
+			submesh->positionType = mesh->posType;
+			submesh->positionFrac = mesh->posFrac;
+			submesh->normalType = mesh->nrmType;
+			submesh->normalFrac = mesh->nrmFrac;
+			submesh->texcoordType = mesh->texType;
+			submesh->texcoordFrac = mesh->texFrac;
+			submesh->positionScale = 1.f / (1 << mesh->posFrac);
+			submesh->normalScale = 1.f / (1 << mesh->nrmFrac);
+			submesh->material = mesh->material;
+			faceCount += mesh->fcount;
+			break;
+		}
+		case BMB_SECTION_POSITIONS:
+			submesh->positions = payload;
+			break;
+		case BMB_SECTION_NORMALS:
+			submesh->normals = payload;
+			break;
+		case BMB_SECTION_TEXCOORDS:
+			submesh->texcoords = payload;
+			break;
+		case BMB_SECTION_BOUNDS:
+			submesh->bounds = (const binbounds_t*) payload;
+			break;
+		case BMB_SECTION_MATERIALS:
+			model->materials = (const binmaterial_t*) payload;
+			model->materialCount = section->size / sizeof(binmaterial_t);
+			break;
+		case BMB_SECTION_DISPLAYLIST:
+			submesh->dispList = payload;
+			submesh->dispListSize = section->size;
+			break;
+		default:
+			break;
+		}
 	}
-	GX_End();
 
-	/* Close display list */
-	u32 modelListSize = GX_EndDispList();
-	if (modelListSize == 0) {
-		printf("Error: Display list not big enough [%u]\n", dispSize);
-		return NULL;
+	/* Files without a material table use one material for everything */
+	for (i = 0; i < header->submeshCount; i++) {
+		if (submeshes[i].material >= model->materialCount) {
+			submeshes[i].material = 0;
+		}
 	}
 
 	/* Return model info */
-	model_t* model = malloc(sizeof(model_t));
-	model->modelList = modelList;
-	model->modelListSize = modelListSize;
-
-	model->modelFaceCount = header->fcount;
-	model->modelPositions = positions;
-	model->modelNormals = normals;
-	model->modelTexcoords = texcoords;
-	model->modelIndices = indices;
+	model->textures = _MODEL_alloc(arena, model->materialCount, sizeof(GXTexObj*));
+	if (model->textures == NULL) {
+		if (arena == NULL) {
+			MEMTRACK_free(submeshes);
+			MEMTRACK_free(model);
+		}
+		return NULL;
+	}
+	model->modelFaceCount = faceCount;
+	model->submeshCount = header->submeshCount;
+	model->submeshes = submeshes;
 
 	return model;
 }
 
 void MODEL_destroy(model_t* model) {
-	free(model->modelList);
-	free(model);
+	MEMTRACK_free(model->submeshes);
+	MEMTRACK_free(model->textures);
+	MEMTRACK_free(model);
 }
 
 void MODEL_render(model_t* model) {
 	if (model == NULL) return;
-	if (model->textureObject != NULL) {
-		GX_LoadTexObj(model->textureObject, GX_TEXMAP0);
+
+	GX_ClearVtxDesc();
+	GX_SetVtxDesc(GX_VA_POS, GX_INDEX16);
+	GX_SetVtxDesc(GX_VA_NRM, GX_INDEX16);
+	GX_SetVtxDesc(GX_VA_TEX0, GX_INDEX16);
+
+	/* obj2bin groups submeshes by material, so each texture is loaded once */
+	u32 i, material = ~0;
+	for (i = 0; i < model->submeshCount; i++) {
+		submesh_t* submesh = &model->submeshes[i];
+
+		if (submesh->material != material) {
+			material = submesh->material;
+			if (model->textures[material] != NULL) {
+				GXU_bindTexture(model->textures[material], GX_TEXMAP0);
+			}
+		}
+
+		/* Fixed point formats are dequantized by GX (2^-frac) */
+		GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_POS, GX_POS_XYZ, submesh->positionType, submesh->positionFrac);
+		GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_NRM, GX_NRM_XYZ, submesh->normalType, submesh->normalFrac);
+		GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_TEX0, GX_TEX_ST, submesh->texcoordType, submesh->texcoordFrac);
+
+		GX_SetArray(GX_VA_POS, submesh->positions, 3 * _MODEL_compSize(submesh->positionType));
+		GX_SetArray(GX_VA_NRM, submesh->normals, 3 * _MODEL_compSize(submesh->normalType));
+		GX_SetArray(GX_VA_TEX0, submesh->texcoords, 2 * _MODEL_compSize(submesh->texcoordType));
+
+		GX_CallDispList(submesh->dispList, submesh->dispListSize);
+	}
+}
+
+/* Read 3 components of any GX type as floats */
+static void _MODEL_readVec(const void* data, u8 type, f32 scale, u32 index, guVector* out) {
+	switch (type) {
+	case GX_S8: {
+		const s8* v = (const s8*) data + index * 3;
+		out->x = v[0] * scale; out->y = v[1] * scale; out->z = v[2] * scale;
+		break;
+	}
+	case GX_U8: {
+		const u8* v = (const u8*) data + index * 3;
+		out->x = v[0] * scale; out->y = v[1] * scale; out->z = v[2] * scale;
+		break;
+	}
+	case GX_S16: {
+		const s16* v = (const s16*) data + index * 3;
+		out->x = v[0] * scale; out->y = v[1] * scale; out->z = v[2] * scale;
+		break;
 	}
-	GX_CallDispList(model->modelList, model->modelListSize);
+	case GX_U16: {
+		const u16* v = (const u16*) data + index * 3;
+		out->x = v[0] * scale; out->y = v[1] * scale; out->z = v[2] * scale;
+		break;
+	}
+	default:
+		*out = ((const guVector*) data)[index];
+		break;
+	}
+}
+
+void MODEL_getPosition(submesh_t* submesh, u32 index, guVector* out) {
+	_MODEL_readVec(submesh->positions, submesh->positionType, submesh->positionScale, index, out);
+}
+
+void MODEL_getNormal(submesh_t* submesh, u32 index, guVector* out) {
+	_MODEL_readVec(submesh->normals, submesh->normalType, submesh->normalScale, index, out);
+}
+
+BOOL MODEL_nextPrimitive(submesh_t* submesh, u32* cursor, primitive_t* out) {
+	const u8* list = (const u8*) submesh->dispList;
+
+	/* Skip the padding */
+	while (*cursor < submesh->dispListSize && list[*cursor] == MODEL_DL_NOP) {
+		(*cursor)++;
+	}
+	if (*cursor + 3 > submesh->dispListSize) {
+		return FALSE;
+	}
+
+	const u8* command = list + *cursor;
+	out->primitive = command[0] & ~MODEL_DL_VTXFMT;
+	out->count = (command[1] << 8) | command[2];
+	out->vertices = command + 3;
+	*cursor += 3 + out->count * sizeof(index_t);
+	return TRUE;
+}
+
+void MODEL_getIndex(primitive_t* primitive, u32 vertex, index_t* out) {
+	/* Vertices follow a 3 byte command, so they are only 1 byte aligned */
+	memcpy(out, primitive->vertices + vertex * sizeof(index_t), sizeof(index_t));
 }
 
 void MODEL_setTexture(model_t* model, GXTexObj* textureObject) {
 	if (model == NULL) return;
-	model->textureObject = textureObject;
+	u32 i;
+	for (i = 0; i < model->materialCount; i++) {
+		model->textures[i] = textureObject;
+	}
+}
+
+BOOL MODEL_setMaterialTexture(model_t* model, const char* material, GXTexObj* textureObject) {
+	if (model == NULL || model->materials == NULL) return FALSE;
+	u32 i;
+	for (i = 0; i < model->materialCount; i++) {
+		if (strncmp(model->materials[i].name, material, sizeof(model->materials[i].name)) == 0) {
+			model->textures[i] = textureObject;
+			return TRUE;
+		}
+	}
+	return FALSE;
 }
@@ -1,40 +1,54 @@
 #include "object.h"
 
-#include <malloc.h>
 #include "mathutil.h"
+#include "memtrack.h"
 
 /* Rebuild matrix on translate rather than setting dirty flag     *
  * Might be faster as we don't rebuild scale and rotation as well *
  * Can become a waste if we do more translations per frame        */
 #define TRANSLATE_DIRECT
 
+/* Set up a new object's transform */
+static object_t* _OBJECT_setup(object_t*          object,
+							   model_t*           mesh,
+							   const guVector     position,
+							   const guQuaternion rotation,
+							   const guVector     scale) {
+	if (object == NULL) return NULL;
+	object->mesh = mesh;
+
+	object->transform.position = position;
+	object->transform.rotation = rotation;
+	object->transform.scale = scale;
+	object->transform.dirty = TRUE;
+
+	MakeMatrix(&object->transform);
+
+	return object;
+}
+
 object_t* OBJECT_create(model_t* mesh) {
+	return OBJECT_createIn(NULL, mesh);
+}
+
+object_t* OBJECT_createIn(arena_t* arena, model_t* mesh) {
 	guVector position = { 0, 0, 0 }, scale = { 1, 1, 1 };
 	guQuaternion rotation;
 	EulerToQuaternion(&rotation, 0, 0, 0);
 
-	return OBJECT_createEx(mesh, position, rotation, scale);
+	object_t* object = arena != NULL ? ARENA_alloc(arena, sizeof(object_t)) : MEMTRACK_alloc(MEMTAG_OBJECT, sizeof(object_t));
+	return _OBJECT_setup(object, mesh, position, rotation, scale);
 }
 
 object_t* OBJECT_createEx(model_t*     mesh,
 						  const guVector     position,
 						  const guQuaternion rotation,
 						  const guVector     scale) {
-	object_t* object = malloc(sizeof(object_t));
-	object->mesh = mesh;
-
-	object->transform.position = position;
-	object->transform.rotation = rotation;
-	object->transform.scale = scale;
-	object->transform.dirty = TRUE;
-
-	MakeMatrix(&object->transform);
-
-	return object;
+	return _OBJECT_setup(MEMTRACK_alloc(MEMTAG_OBJECT, sizeof(object_t)), mesh, position, rotation, scale);
 }
 
 void OBJECT_destroy(object_t* object) {
-	free(object);
+	MEMTRACK_free(object);
 }
 
 void OBJECT_flush(object_t* object) {
@@ -0,0 +1,156 @@
+#include "perfhud.h"
+
+#include <stdio.h>
+
+/* Hundredths of a millisecond, rounded */
+#define _HUD_MILLIS(micros) ((micros) + 5) / 1000, ((micros) + 5) / 10 % 100
+
+static void _HUD_clear(hudseries_t* series) {
+	series->count = 0;
+	series->next = 0;
+}
+
+static void _HUD_push(hudseries_t* series, unsigned int value) {
+	series->values[series->next] = value;
+	series->next = (series->next + 1) % HUD_WINDOW;
+	if (series->count < HUD_WINDOW) series->count++;
+}
+
+void HUD_range(const hudseries_t* series, unsigned int* minValue, unsigned int* avgValue, unsigned int* maxValue) {
+	unsigned int i, low = ~0u, high = 0;
+	unsigned long long sum = 0;
+	for (i = 0; i < series->count; i++) {
+		const unsigned int value = series->values[i];
+		if (value < low) low = value;
+		if (value > high) high = value;
+		sum += value;
+	}
+	*minValue = series->count > 0 ? low : 0;
+	*avgValue = series->count > 0 ? (unsigned int) ((sum + series->count / 2) / series->count) : 0;
+	*maxValue = high;
+}
+
+void HUD_init(perfhud_t* hud, const hudsource_t* source) {
+	unsigned int i, j;
+	hud->source = source;
+	hud->views = 0;
+	hud->frames = 0;
+	_HUD_clear(&hud->frame);
+	_HUD_clear(&hud->fifo);
+	for (i = 0; i < HUD_PHASE_COUNT; i++) {
+		hud->phaseTimes[i] = 0;
+		_HUD_clear(&hud->phases[i]);
+	}
+	for (i = 0; i < HUD_COUNT_COUNT; i++) {
+		hud->frameCounts[i] = 0;
+		_HUD_clear(&hud->counts[i]);
+	}
+	for (i = 0; i < HUD_MAX_VIEWS; i++) {
+		for (j = 0; j < HUD_VIEW_COUNTERS; j++) {
+			_HUD_clear(&hud->counters[i][j]);
+		}
+	}
+	hud->text[0] = '\0';
+}
+
+void HUD_begin(perfhud_t* hud) {
+	hud->source->begin(hud->source->user);
+}
+
+void HUD_endView(perfhud_t* hud, unsigned int view) {
+	hud->source->endView(hud->source->user, view);
+}
+
+void HUD_phase(perfhud_t* hud, unsigned int phase, unsigned int micros) {
+	hud->phaseTimes[phase] += micros;
+}
+
+void HUD_count(perfhud_t* hud, unsigned int counter, unsigned int value) {
+	hud->frameCounts[counter] += value;
+}
+
+unsigned int HUD_format(perfhud_t* hud) {
+	static const char* phaseNames[HUD_PHASE_COUNT] = { "stream", "update", "render", "hud", "gpu wait", "vsync" };
+	static const char* countNames[HUD_COUNT_COUNT] = { "sprites", "sprite batches" };
+	char* buffer = hud->text;
+	const unsigned int size = sizeof(hud->text);
+	unsigned int low, avg, high, i, j, length = 0;
+	int written;
+
+	HUD_range(&hud->frame, &low, &avg, &high);
+	const unsigned int fps = avg > 0 ? (1000000 + avg / 2) / avg : 0;
+	written = snprintf(buffer, size, "%-8s %3u fps     min     avg     max\n", hud->source->name, fps);
+
+	/* Frame and phases in milliseconds */
+	for (i = 0; i <= HUD_PHASE_COUNT && written >= 0 && length + written < size; i++) {
+		length += written;
+		const hudseries_t* series = i == 0 ? &hud->frame : &hud->phases[i - 1];
+		HUD_range(series, &low, &avg, &high);
+		written = snprintf(buffer + length, size - length, "%-12s ms %4u.%02u %4u.%02u %4u.%02u\n", i == 0 ? "frame" : phaseNames[i - 1],
+						   _HUD_MILLIS(low), _HUD_MILLIS(avg), _HUD_MILLIS(high));
+	}
+	if (written >= 0 && length + written < size) {
+		length += written;
+		HUD_range(&hud->fifo, &low, &avg, &high);
+		written = snprintf(buffer + length, size - length, "%-12s KB %7u %7u %7u\n", "fifo", (low + 512) / 1024, (avg + 512) / 1024, (high + 512) / 1024);
+	}
+	for (i = 0; i < HUD_COUNT_COUNT && written >= 0 && length + written < size; i++) {
+		length += written;
+		HUD_range(&hud->counts[i], &low, &avg, &high);
+		written = snprintf(buffer + length, size - length, "%-15s %7u %7u %7u\n", countNames[i], low, avg, high);
+	}
+
+	/* Source counters per view */
+	for (i = 0; i < hud->views; i++) {
+		for (j = 0; j < HUD_VIEW_COUNTERS && written >= 0 && length + written < size; j++) {
+			length += written;
+			HUD_range(&hud->counters[i][j], &low, &avg, &high);
+			written = snprintf(buffer + length, size - length, "view %u %-8s %7u %7u %7u\n", i + 1, hud->source->counterNames[j], low, avg, high);
+		}
+	}
+	if (written >= 0 && length + written < size) length += written;
+
+	/* Drop a line that was cut short */
+	buffer[length] = '\0';
+	return length;
+}
+
+int HUD_end(perfhud_t* hud, unsigned int frameMicros) {
+	unsigned int i, j;
+	hudreadings_t readings;
+	readings.views = 0;
+	readings.fifoBytes = 0;
+	hud->source->collect(hud->source->user, &readings);
+	if (readings.views > HUD_MAX_VIEWS) readings.views = HUD_MAX_VIEWS;
+
+	/* Players came or went, old views' numbers don't apply anymore */
+	if (readings.views != hud->views) {
+		for (i = 0; i < HUD_MAX_VIEWS; i++) {
+			for (j = 0; j < HUD_VIEW_COUNTERS; j++) {
+				_HUD_clear(&hud->counters[i][j]);
+			}
+		}
+		hud->views = readings.views;
+	}
+
+	_HUD_push(&hud->frame, frameMicros);
+	_HUD_push(&hud->fifo, readings.fifoBytes);
+	for (i = 0; i < HUD_PHASE_COUNT; i++) {
+		_HUD_push(&hud->phases[i], hud->phaseTimes[i]);
+		hud->phaseTimes[i] = 0;
+	}
+	for (i = 0; i < HUD_COUNT_COUNT; i++) {
+		_HUD_push(&hud->counts[i], hud->frameCounts[i]);
+		hud->frameCounts[i] = 0;
+	}
+	for (i = 0; i < hud->views; i++) {
+		for (j = 0; j < HUD_VIEW_COUNTERS; j++) {
+			_HUD_push(&hud->counters[i][j], readings.counters[i][j]);
+		}
+	}
+
+	hud->frames++;
+	if (hud->frames % HUD_REFRESH != 0) return 0;
+	HUD_format(hud);
+	return 1;
+}
@@ -0,0 +1,146 @@
+#include "profiler.h"
+
+#ifdef PROFILE
+
+#include <stdio.h>
+
+#ifdef GEKKO
+#include <gccore.h>
+#include "sdcard.h"
+#else
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#define PROF_MAX_THREADS 8
+
+typedef struct {
+	const char*        name;
+	unsigned long      thread;
+	unsigned long long start, end;
+} profevent_t;
+
+typedef struct {
+	unsigned long thread;
+	const char*   name;
+} profthread_t;
+
+static profevent_t events[PROF_EVENTS];
+static profthread_t threads[PROF_MAX_THREADS];
+
+/* Spans ever stored (the next one goes to head % PROF_EVENTS) and named threads */
+static unsigned int head = 0;
+static unsigned int threadCount = 0;
+static unsigned int paused = 0;
+
+#ifdef GEKKO
+unsigned long long PROF_now() {
+	return gettime();
+}
+
+static unsigned long _PROF_thread() {
+	return LWP_GetSelf();
+}
+
+static double _PROF_micros(unsigned long long ticks) {
+	return ticks_to_nanosecs(ticks) / 1000.0;
+}
+#else
+unsigned long long PROF_now() {
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (unsigned long long) now.tv_sec * 1000000000ull + now.tv_nsec;
+}
+
+static unsigned long _PROF_thread() {
+	return (unsigned long) pthread_self();
+}
+
+static double _PROF_micros(unsigned long long nanos) {
+	return nanos / 1000.0;
+}
+#endif
+
+void PROF_record(const char* name, unsigned long long start) {
+	const unsigned long long end = PROF_now();
+	if (__atomic_load_n(&paused, __ATOMIC_RELAXED)) return;
+
+	/* Claiming the slot is the only shared step, the ring just wraps over old spans */
+	const unsigned int index = __atomic_fetch_add(&head, 1, __ATOMIC_RELAXED) % PROF_EVENTS;
+	profevent_t* event = &events[index];
+	event->name = name;
+	event->thread = _PROF_thread();
+	event->start = start;
+	event->end = end;
+}
+
+void _PROF_leave(profscope_t* scope) {
+	PROF_record(scope->name, scope->start);
+}
+
+void PROF_nameThread(const char* name) {
+	const unsigned int index = __atomic_fetch_add(&threadCount, 1, __ATOMIC_RELAXED);
+	if (index >= PROF_MAX_THREADS) return;
+	threads[index].thread = _PROF_thread();
+	threads[index].name = name;
+}
+
+unsigned int PROF_dump(const char* path) {
+#ifdef GEKKO
+	if (!SD_mount()) {
+		printf("Error: No SD card for the trace\n");
+		return 0;
+	}
+#endif
+	FILE* file = fopen(path, "w");
+	if (file == NULL) {
+		printf("Error: Can't write the trace to %s\n", path);
+		return 0;
+	}
+
+	/* Spans still being stored when recording stops may be half written, they're skipped below */
+	__atomic_store_n(&paused, 1, __ATOMIC_SEQ_CST);
+	const unsigned int total = __atomic_load_n(&head, __ATOMIC_SEQ_CST);
+	const unsigned int count = total < PROF_EVENTS ? total : PROF_EVENTS;
+	const unsigned int first = total - count;
+	unsigned int i;
+
+	/* Times are written from the oldest span on */
+	unsigned long long origin = ~0ull;
+	for (i = first; i != total; i++) {
+		const profevent_t* event = &events[i % PROF_EVENTS];
+		if (event->name != NULL && event->start < origin) origin = event->start;
+	}
+
+	fprintf(file, "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"hovercraft\"}}");
+	const unsigned int named = threadCount < PROF_MAX_THREADS ? threadCount : PROF_MAX_THREADS;
+	for (i = 0; i < named; i++) {
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%s\"}}",
+				threads[i].thread, threads[i].name);
+	}
+	unsigned int written = 0;
+	for (i = first; i != total; i++) {
+		const profevent_t* event = &events[i % PROF_EVENTS];
+		if (event->name == NULL || event->end < event->start) continue;
+		fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%.3f,\"dur\":%.3f}",
+				event->name, event->thread, _PROF_micros(event->start - origin), _PROF_micros(event->end - event->start));
+		written++;
+	}
+	fprintf(file, "\n]}\n");
+
+	/* Start over, so the next dump only has what came after this one */
+	for (i = 0; i < PROF_EVENTS; i++) {
+		events[i].name = NULL;
+	}
+	__atomic_store_n(&head, 0, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&paused, 0, __ATOMIC_SEQ_CST);
+
+	if (fclose(file) != 0) {
+		printf("Error: Can't write the trace to %s\n", path);
+		return 0;
+	}
+	printf("Trace: %u spans written to %s\n", written, path);
+	return written;
+}
+
+#endif
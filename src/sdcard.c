@@ -0,0 +1,12 @@
+#include "sdcard.h"
+
+#include <fat.h>
+
+static BOOL mounted = FALSE;
+
+BOOL SD_mount() {
+	if (!mounted) {
+		mounted = fatInitDefault();
+	}
+	return mounted;
+}
@@ -1,12 +1,22 @@
 #include "sprite.h"
 #include "mathutil.h"
-#include <malloc.h>
+#include "memtrack.h"
+#include <math.h>
+
+/* Drawn by all batches this frame */
+static u32 frameBatches = 0, frameSprites = 0;
 
 sprite_t* SPRITE_create(f32 x, f32 y, f32 depth, f32 width, f32 height, GXTexObj* texture) {
-	sprite_t* sprite = malloc(sizeof(sprite_t));
+	return SPRITE_createIn(NULL, x, y, depth, width, height, texture);
+}
+
+sprite_t* SPRITE_createIn(arena_t* arena, f32 x, f32 y, f32 depth, f32 width, f32 height, GXTexObj* texture) {
+	sprite_t* sprite = arena != NULL ? ARENA_alloc(arena, sizeof(sprite_t)) : MEMTRACK_alloc(MEMTAG_OBJECT, sizeof(sprite_t));
+	if (sprite == NULL) return NULL;
 	sprite->width = width;
 	sprite->height = height;
 	sprite->texture = texture;
+	sprite->uv = (uvrect_t) { 0, 0, 1, 1 };
 	sprite->color = (GXColor) { 0xff, 0xff, 0xff, 0xff };
 
 	guMtxIdentity(sprite->transform.matrix);
@@ -17,6 +27,8 @@ sprite_t* SPRITE_create(f32 x, f32 y, f32 depth, f32 width, f32 height, GXTexObj
 	EulerToQuaternion(&rotation, 0, 0, 0);
 	sprite->transform.rotation = rotation;
 	sprite->transform.dirty = TRUE;
+	sprite->angle = 0;
+	sprite->affineDirty = TRUE;
 
 	return sprite;
 }
@@ -27,6 +39,12 @@ void SPRITE_color(sprite_t* sprite, GXColor color) {
 
 void SPRITE_setTexture(sprite_t* sprite, GXTexObj* texture) {
 	sprite->texture = texture;
+	sprite->uv = (uvrect_t) { 0, 0, 1, 1 };
+}
+
+void SPRITE_setTextureRect(sprite_t* sprite, GXTexObj* texture, const uvrect_t* rect) {
+	sprite->texture = texture;
+	sprite->uv = *rect;
 }
 
 void SPRITE_flush(sprite_t* sprite) {
@@ -48,7 +66,7 @@ void SPRITE_render(sprite_t* sprite) {
 	GX_LoadNrmMtxImm(dummy, GX_PNMTX0); //No dummies required
 
 										/* Set sprite texture */
-	GX_LoadTexObj(sprite->texture, GX_TEXMAP0);
+	GXU_bindTexture(sprite->texture, GX_TEXMAP0);
 
 	/* Set color and disable lighting*/
 	GX_SetChanCtrl(GX_COLOR0A0, GX_DISABLE, GX_SRC_REG, GX_SRC_REG, GX_LIGHT0, GX_DF_CLAMP, GX_AF_NONE);
@@ -67,23 +85,24 @@ void SPRITE_render(sprite_t* sprite) {
 	/* Orthographic mode */
 	GXU_2DMode();
 
+	const uvrect_t* uv = &sprite->uv;
 	GX_Begin(GX_QUADS, GX_VTXFMT0, 4);
 
 	/* Top left */
 	GX_Position2f32(0, 0);
-	GX_TexCoord2f32(0, 0);
+	GX_TexCoord2f32(uv->u, uv->v);
 
 	/* Bottom left */
 	GX_Position2f32(0, sprite->height);
-	GX_TexCoord2f32(0, 1);
+	GX_TexCoord2f32(uv->u, uv->v + uv->height);
 
 	/* Bottom right */
 	GX_Position2f32(sprite->width, sprite->height);
-	GX_TexCoord2f32(1, 1);
+	GX_TexCoord2f32(uv->u + uv->width, uv->v + uv->height);
 
 	/* Top right */
 	GX_Position2f32(sprite->width, 0);
-	GX_TexCoord2f32(1, 0);
+	GX_TexCoord2f32(uv->u + uv->width, uv->v);
 
 	GX_End();
 }
@@ -94,6 +113,7 @@ void SPRITE_moveTo(sprite_t* sprite, const f32 tX, const f32 tY, const f32 tDept
 	t->position.y = tY;
 	t->position.z = tDepth;
 	t->dirty = TRUE;
+	sprite->affineDirty = TRUE;
 }
 
 void SPRITE_scaleTo(sprite_t* sprite, const f32 sX, const f32 sY, const f32 sZ) {
@@ -102,4 +122,136 @@ void SPRITE_scaleTo(sprite_t* sprite, const f32 sX, const f32 sY, const f32 sZ)
 	t->scale.y = sY;
 	t->scale.z = sZ;
 	t->dirty = TRUE;
-}
\ No newline at end of file
+	sprite->affineDirty = TRUE;
+}
+
+void SPRITE_rotateTo(sprite_t* sprite, const f32 angle) {
+	transform_t* t = &sprite->transform;
+	EulerToQuaternion(&t->rotation, 0, 0, angle);
+	sprite->angle = angle;
+	t->dirty = TRUE;
+	sprite->affineDirty = TRUE;
+}
+
+void _SPRITE_flushAffine(sprite_t* sprite) {
+	if (sprite->affineDirty == FALSE) return;
+
+	const transform_t* t = &sprite->transform;
+	affine_t* a = &sprite->affine;
+
+	/* Scale, Rotate, Translate (same order as MakeMatrix, minus the quaternion) */
+	f32 s = 0, c = 1;
+	if (sprite->angle != 0) {
+		s = sinf(sprite->angle);
+		c = cosf(sprite->angle);
+	}
+	a->xx = c * t->scale.x; a->xy = -s * t->scale.y; a->tx = t->position.x;
+	a->yx = s * t->scale.x; a->yy = c * t->scale.y;  a->ty = t->position.y;
+
+	sprite->affineDirty = FALSE;
+}
+
+void _SPRITE_batchVertex(const affine_t* a, const f32 x, const f32 y, const f32 depth, const GXColor color, const f32 u, const f32 v) {
+	GX_Position3f32(a->xx * x + a->xy * y + a->tx, a->yx * x + a->yy * y + a->ty, depth);
+	GX_Color4u8(color.r, color.g, color.b, color.a);
+	GX_TexCoord2f32(u, v);
+}
+
+void SPRITE_batchBegin(spritebatch_t* batch) {
+	batch->count = 0;
+}
+
+void SPRITE_batchAdd(spritebatch_t* batch, sprite_t* sprite) {
+	if (sprite->texture == NULL) return;
+
+	/* Full, draw what we have */
+	if (batch->count == SPRITE_BATCH_MAX) {
+		SPRITE_batchEnd(batch);
+	}
+
+	batch->sprites[batch->count++] = sprite;
+}
+
+void SPRITE_batchEnd(spritebatch_t* batch) {
+	const u16 count = batch->count;
+	sprite_t** sprites = batch->sprites;
+
+	batch->count = 0;
+	if (count == 0) return;
+
+	/* Group by texture inside each run of sprites at the same depth, runs stay
+	 * in queue order so layers still draw back to front (insertion sort keeps
+	 * queue order inside a group) */
+	u16 i, j, run = 0;
+	while (run < count) {
+		const f32 depth = sprites[run]->transform.position.z;
+		u16 runEnd = run + 1;
+		while (runEnd < count && sprites[runEnd]->transform.position.z == depth) runEnd++;
+
+		for (i = run + 1; i < runEnd; i++) {
+			sprite_t* current = sprites[i];
+			for (j = i; j > run && sprites[j - 1]->texture > current->texture; j--) {
+				sprites[j] = sprites[j - 1];
+			}
+			sprites[j] = current;
+		}
+		run = runEnd;
+	}
+
+	/* Transforms are applied on the CPU, load identity once */
+	Mtx identity;
+	guMtxIdentity(identity);
+	GX_LoadPosMtxImm(identity, GX_PNMTX0);
+	GX_LoadNrmMtxImm(identity, GX_PNMTX0);
+
+	/* Lighting off, material color comes from the vertices */
+	GX_SetNumChans(1);
+	GX_SetChanCtrl(GX_COLOR0A0, GX_DISABLE, GX_SRC_REG, GX_SRC_VTX, GX_LIGHT0, GX_DF_CLAMP, GX_AF_NONE);
+
+	/* Vtx descriptors reset and set */
+	GX_ClearVtxDesc();
+	GX_SetVtxDesc(GX_VA_POS, GX_DIRECT);
+	GX_SetVtxDesc(GX_VA_CLR0, GX_DIRECT);
+	GX_SetVtxDesc(GX_VA_TEX0, GX_DIRECT);
+	GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_POS, GX_POS_XYZ, GX_F32, 0);
+	GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_CLR0, GX_CLR_RGBA, GX_RGBA8, 0);
+	GX_SetVtxAttrFmt(GX_VTXFMT0, GX_VA_TEX0, GX_TEX_ST, GX_F32, 0);
+
+	/* Orthographic mode */
+	GXU_2DMode();
+
+	u16 first = 0;
+	while (first < count) {
+		GXTexObj* texture = sprites[first]->texture;
+
+		/* Find the end of this texture's group */
+		u16 last = first + 1;
+		while (last < count && sprites[last]->texture == texture) last++;
+
+		GXU_bindTexture(texture, GX_TEXMAP0);
+		GX_Begin(GX_QUADS, GX_VTXFMT0, 4 * (last - first));
+		for (i = first; i < last; i++) {
+			sprite_t* sprite = sprites[i];
+			_SPRITE_flushAffine(sprite);
+
+			const affine_t* a = &sprite->affine;
+			const uvrect_t* uv = &sprite->uv;
+			const f32 depth = sprite->transform.position.z;
+			_SPRITE_batchVertex(a, 0, 0, depth, sprite->color, uv->u, uv->v);
+			_SPRITE_batchVertex(a, 0, sprite->height, depth, sprite->color, uv->u, uv->v + uv->height);
+			_SPRITE_batchVertex(a, sprite->width, sprite->height, depth, sprite->color, uv->u + uv->width, uv->v + uv->height);
+			_SPRITE_batchVertex(a, sprite->width, 0, depth, sprite->color, uv->u + uv->width, uv->v);
+		}
+		GX_End();
+
+		frameBatches++;
+		frameSprites += last - first;
+		first = last;
+	}
+}
+
+void SPRITE_frame(u32* batches, u32* sprites) {
+	*batches = frameBatches;
+	*sprites = frameSprites;
+	frameBatches = frameSprites = 0;
+}
@@ -0,0 +1,167 @@
+#include "tilestream.h"
+
+void STREAM_init(tilestream_t* stream, float originX, float originZ, float tileSize, int tilesX, int tilesZ,
+				 float radius, streamslot_t* slots, unsigned int slotCount, unsigned int budget, unsigned int maxLoads,
+				 const streamcallbacks_t* callbacks) {
+	stream->originX = originX;
+	stream->originZ = originZ;
+	stream->tileSize = tileSize;
+	stream->tilesX = tilesX;
+	stream->tilesZ = tilesZ;
+	stream->radius = radius;
+	stream->budget = budget;
+	stream->maxLoads = maxLoads;
+	stream->slotCount = slotCount;
+	stream->slots = slots;
+	stream->callbacks = *callbacks;
+	stream->used = 0;
+	stream->loading = 0;
+	stream->frame = 0;
+	stream->peak = 0;
+	stream->starved = 0;
+	unsigned int i;
+	for (i = 0; i < slotCount; i++) {
+		slots[i].state = STREAM_FREE;
+	}
+}
+
+unsigned int STREAM_find(const tilestream_t* stream, int x, int z) {
+	unsigned int i;
+	for (i = 0; i < stream->slotCount; i++) {
+		const streamslot_t* slot = &stream->slots[i];
+		if (slot->state != STREAM_FREE && slot->x == x && slot->z == z) return i;
+	}
+	return STREAM_NONE;
+}
+
+int STREAM_tileAt(const tilestream_t* stream, float x, float z, int* tileX, int* tileZ) {
+	const float fx = (x - stream->originX) / stream->tileSize, fz = (z - stream->originZ) / stream->tileSize;
+	if (fx < 0 || fz < 0 || fx >= stream->tilesX || fz >= stream->tilesZ) return 0;
+	*tileX = (int) fx;
+	*tileZ = (int) fz;
+	return 1;
+}
+
+/* Squared distance from a point to a tile (0 inside it) */
+static float _STREAM_distance2(const tilestream_t* stream, int x, int z, float px, float pz) {
+	const float x0 = stream->originX + x * stream->tileSize, z0 = stream->originZ + z * stream->tileSize;
+	const float dx = px < x0 ? x0 - px : (px > x0 + stream->tileSize ? px - x0 - stream->tileSize : 0);
+	const float dz = pz < z0 ? z0 - pz : (pz > z0 + stream->tileSize ? pz - z0 - stream->tileSize : 0);
+	return dx * dx + dz * dz;
+}
+
+/* Squared distance from a tile to the nearest point */
+static float _STREAM_nearest(const tilestream_t* stream, int x, int z, const float* points, unsigned int pointCount) {
+	float best = -1;
+	unsigned int i;
+	for (i = 0; i < pointCount; i++) {
+		const float d = _STREAM_distance2(stream, x, z, points[i * 2], points[i * 2 + 1]);
+		if (best < 0 || d < best) best = d;
+	}
+	return best;
+}
+
+/* Free the least recently wanted slot nobody wants now, 0 if there is none */
+static int _STREAM_evict(tilestream_t* stream) {
+	unsigned int i, oldest = STREAM_NONE;
+	for (i = 0; i < stream->slotCount; i++) {
+		const streamslot_t* slot = &stream->slots[i];
+		if ((slot->state != STREAM_RESIDENT && slot->state != STREAM_FAILED) || slot->lastWanted == stream->frame) continue;
+		if (oldest == STREAM_NONE || slot->lastWanted < stream->slots[oldest].lastWanted) oldest = i;
+	}
+	if (oldest == STREAM_NONE) return 0;
+
+	streamslot_t* slot = &stream->slots[oldest];
+	stream->callbacks.unload(stream->callbacks.user, oldest, slot->x, slot->z);
+	stream->used -= slot->size;
+	slot->state = STREAM_FREE;
+	return 1;
+}
+
+/* Free slot, STREAM_NONE if they are all taken */
+static unsigned int _STREAM_freeSlot(const tilestream_t* stream) {
+	unsigned int i;
+	for (i = 0; i < stream->slotCount; i++) {
+		if (stream->slots[i].state == STREAM_FREE) return i;
+	}
+	return STREAM_NONE;
+}
+
+void STREAM_update(tilestream_t* stream, const float* points, unsigned int pointCount) {
+	stream->frame++;
+	const float radius2 = stream->radius * stream->radius;
+
+	/* Keep what's still in range */
+	unsigned int i;
+	for (i = 0; i < stream->slotCount; i++) {
+		streamslot_t* slot = &stream->slots[i];
+		if (slot->state == STREAM_FREE) continue;
+		if (_STREAM_nearest(stream, slot->x, slot->z, points, pointCount) <= radius2) slot->lastWanted = stream->frame;
+	}
+
+	/* Request the nearest missing tiles first, the ones under the players come before the rest */
+	while (stream->loading < stream->maxLoads) {
+		int bestX = 0, bestZ = 0;
+		unsigned int bestSize = 0;
+		float best = -1;
+		for (i = 0; i < pointCount; i++) {
+			const float px = points[i * 2], pz = points[i * 2 + 1];
+			int x0 = (int) ((px - stream->radius - stream->originX) / stream->tileSize) - 1;
+			int z0 = (int) ((pz - stream->radius - stream->originZ) / stream->tileSize) - 1;
+			int x1 = (int) ((px + stream->radius - stream->originX) / stream->tileSize) + 1;
+			int z1 = (int) ((pz + stream->radius - stream->originZ) / stream->tileSize) + 1;
+			if (x0 < 0) x0 = 0;
+			if (z0 < 0) z0 = 0;
+			if (x1 > stream->tilesX - 1) x1 = stream->tilesX - 1;
+			if (z1 > stream->tilesZ - 1) z1 = stream->tilesZ - 1;
+
+			int x, z;
+			for (z = z0; z <= z1; z++) {
+				for (x = x0; x <= x1; x++) {
+					const float d = _STREAM_distance2(stream, x, z, px, pz);
+					if (d > radius2 || (best >= 0 && d >= best) || STREAM_find(stream, x, z) != STREAM_NONE) continue;
+					const unsigned int size = stream->callbacks.size(stream->callbacks.user, x, z);
+					if (size == 0) continue;
+					best = d;
+					bestX = x;
+					bestZ = z;
+					bestSize = size;
+				}
+			}
+		}
+		if (best < 0) break;
+
+		/* Make room, only tiles nobody wants go */
+		unsigned int slot = _STREAM_freeSlot(stream);
+		while (slot == STREAM_NONE || stream->used + bestSize > stream->budget) {
+			if (!_STREAM_evict(stream)) {
+				stream->starved++;
+				return;
+			}
+			if (slot == STREAM_NONE) slot = _STREAM_freeSlot(stream);
+		}
+
+		if (!stream->callbacks.load(stream->callbacks.user, slot, bestX, bestZ)) break;
+		streamslot_t* entry = &stream->slots[slot];
+		entry->state = STREAM_LOADING;
+		entry->x = bestX;
+		entry->z = bestZ;
+		entry->size = bestSize;
+		entry->lastWanted = stream->frame;
+		stream->used += bestSize;
+		stream->loading++;
+		if (stream->used > stream->peak) stream->peak = stream->used;
+	}
+}
+
+void STREAM_loaded(tilestream_t* stream, unsigned int slot, int ok) {
+	streamslot_t* entry = &stream->slots[slot];
+	stream->loading--;
+	if (ok) {
+		entry->state = STREAM_RESIDENT;
+	} else {
+		entry->state = STREAM_FAILED;
+		stream->used -= entry->size;
+		entry->size = 0;
+	}
+}
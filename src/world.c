@@ -0,0 +1,228 @@
+#include "world.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "tilestream.h"
+#include "arena.h"
+#include "loader.h"
+#include "object.h"
+#include "memtrack.h"
+#include "profiler.h"
+
+/* Requests in flight, the loader queue is shared with the models and music */
+#define WORLD_MAX_LOADS 2
+
+/* Arena of each slot, for the terrain piece's model and the objects (about 20 props) */
+#define WORLD_SLOT_ARENA 4096
+
+/* What a slot of the streamer holds on the game side */
+typedef struct {
+	loadhandle_t* load;    /*< Pending request, NULL after          */
+	void*         data;    /*< Tile file, used in place             */
+	leveltile_t*  tile;    /*< Tile (at data), NULL if it failed    */
+	model_t*      model;   /*< Terrain piece, uses the file's mesh  */
+	object_t*     terrain; /*< Terrain piece at the ground origin   */
+	object_t**    props;   /*< One per tile object                  */
+	arena_t       arena;   /*< Model, objects, reset on unload      */
+} worldslot_t;
+
+static const level_t* level = NULL;
+static worldmodelfn_t findModel = NULL;
+static worldtexturefn_t findTexture = NULL;
+
+static tilestream_t stream;
+static streamslot_t* streamSlots = NULL;
+static worldslot_t* slots = NULL;
+
+/* Files of tiles unloaded this frame, the FIFO may still point at them until GX_DrawDone */
+static void** retired = NULL;
+static u32 retiredCount = 0;
+
+static unsigned int _WORLD_size(void* user, int x, int z) {
+	(void) user;
+	/* What PAK_load allocates for it */
+	const u32 size = level->tileSizes[z * level->tilesX + x];
+	return (size + 31) & ~31;
+}
+
+static int _WORLD_load(void* user, unsigned int slot, int x, int z) {
+	(void) user;
+	char name[PAK_NAME_LENGTH];
+	snprintf(name, sizeof(name), "%s_%d_%d.btl", level->tileName, x, z);
+	slots[slot].load = LOADER_load(name);
+	return slots[slot].load != NULL;
+}
+
+static void _WORLD_unload(void* user, unsigned int slot, int x, int z) {
+	(void) user;
+	(void) x;
+	(void) z;
+	worldslot_t* entry = &slots[slot];
+	/* A slot is unloaded at most once a frame, so there is always room */
+	if (retiredCount < stream.slotCount) {
+		retired[retiredCount++] = entry->data;
+	} else {
+		GX_DrawDone();
+		MEMTRACK_free(entry->data);
+	}
+	entry->data = NULL;
+	entry->tile = NULL;
+	entry->model = NULL;
+	entry->terrain = NULL;
+	entry->props = NULL;
+	ARENA_reset(&entry->arena);
+}
+
+/* Set up a tile that just arrived, FALSE if it can't be used */
+static BOOL _WORLD_setup(worldslot_t* entry) {
+	entry->tile = LEVEL_loadTile(entry->data, entry->load->size);
+	if (entry->tile == NULL) return FALSE;
+	const leveltile_t* tile = entry->tile;
+
+	/* Terrain piece, its positions start at the tile's ground origin */
+	arena_t* arena = &entry->arena;
+	if (tile->mesh != NULL) {
+		entry->model = MODEL_setupIn(arena, tile->mesh, tile->meshSize);
+		entry->terrain = entry->model != NULL ? OBJECT_createIn(arena, entry->model) : NULL;
+		if (entry->terrain == NULL) {
+			entry->tile = NULL;
+			return FALSE;
+		}
+		MODEL_setTexture(entry->model, findTexture(tile->terrain));
+		OBJECT_moveTo(entry->terrain, tile->ground.originX, 0, tile->ground.originZ);
+	}
+
+	entry->props = ARENA_alloc(arena, sizeof(object_t*) * tile->objectCount);
+	u32 i;
+	for (i = 0; i < tile->objectCount; i++) {
+		const levelobject_t* prop = &tile->objects[i];
+		object_t* object = entry->props != NULL ? OBJECT_createIn(arena, findModel(prop->model)) : NULL;
+		if (object == NULL) {
+			entry->tile = NULL;
+			return FALSE;
+		}
+		OBJECT_scaleTo(object, prop->scale.x, prop->scale.y, prop->scale.z);
+		OBJECT_moveTo(object, prop->position.x, prop->position.y, prop->position.z);
+		entry->props[i] = object;
+	}
+	return TRUE;
+}
+
+void WORLD_init(const level_t* worldLevel, worldmodelfn_t modelFn, worldtexturefn_t textureFn) {
+	level = worldLevel;
+	findModel = modelFn;
+	findTexture = textureFn;
+
+	streamSlots = MEMTRACK_alloc(MEMTAG_LEVEL, sizeof(streamslot_t) * level->streamSlots);
+	slots = MEMTRACK_calloc(MEMTAG_LEVEL, level->streamSlots, sizeof(worldslot_t));
+	retired = MEMTRACK_alloc(MEMTAG_LEVEL, sizeof(void*) * level->streamSlots);
+	retiredCount = 0;
+	u8* arenas = MEMTRACK_memalign(MEMTAG_LEVEL, ARENA_ALIGN, WORLD_SLOT_ARENA * level->streamSlots);
+	u32 i;
+	for (i = 0; i < level->streamSlots; i++) {
+		ARENA_initBuffer(&slots[i].arena, "tile", arenas + i * WORLD_SLOT_ARENA, WORLD_SLOT_ARENA);
+	}
+	const streamcallbacks_t callbacks = { _WORLD_size, _WORLD_load, _WORLD_unload, NULL };
+	STREAM_init(&stream, level->tileOriginX, level->tileOriginZ, level->tileSize, level->tilesX, level->tilesZ,
+				level->streamRadius, streamSlots, level->streamSlots, level->streamBudget, WORLD_MAX_LOADS, &callbacks);
+}
+
+void WORLD_update(const f32* points, u32 pointCount, f32 deltaTime) {
+	PROF_SCOPE("WORLD_update");
+	u32 i, j;
+	for (i = 0; i < stream.slotCount; i++) {
+		worldslot_t* entry = &slots[i];
+
+		/* Finished requests, a failed tile stays empty until it's out of range */
+		if (entry->load != NULL && LOADER_poll(entry->load)) {
+			entry->data = entry->load->data;
+			MEMTRACK_retag(entry->data, MEMTAG_LEVEL);
+			const BOOL ok = entry->load->state == LOAD_DONE && _WORLD_setup(entry);
+			LOADER_release(entry->load);
+			entry->load = NULL;
+			/* The file may be where an unloaded tile's vertices were */
+			if (ok) GX_InvVtxCache();
+			/* The streamer stops counting a failed tile, so nothing of it may stay (it was never drawn) */
+			if (!ok) {
+				MEMTRACK_free(entry->data);
+				entry->data = NULL;
+				entry->tile = NULL;
+				entry->model = NULL;
+				entry->terrain = NULL;
+				entry->props = NULL;
+				ARENA_reset(&entry->arena);
+			}
+			STREAM_loaded(&stream, i, ok);
+			continue;
+		}
+
+		/* Spin props */
+		if (entry->tile == NULL || streamSlots[i].state != STREAM_RESIDENT) continue;
+		for (j = 0; j < entry->tile->objectCount; j++) {
+			const f32 spin = entry->tile->objects[j].spin;
+			if (spin != 0) {
+				OBJECT_rotate(entry->props[j], 0, spin * deltaTime, 0);
+			}
+		}
+	}
+
+	STREAM_update(&stream, points, pointCount);
+}
+
+void WORLD_collect() {
+	u32 i;
+	for (i = 0; i < retiredCount; i++) {
+		MEMTRACK_free(retired[i]);
+	}
+	retiredCount = 0;
+}
+
+void WORLD_attachModels() {
+	u32 i, j;
+	for (i = 0; i < stream.slotCount; i++) {
+		const worldslot_t* entry = &slots[i];
+		if (entry->tile == NULL) continue;
+		for (j = 0; j < entry->tile->objectCount; j++) {
+			entry->props[j]->mesh = findModel(entry->tile->objects[j].model);
+		}
+	}
+}
+
+void WORLD_render(Mtx viewMtx) {
+	u32 i, j;
+	for (i = 0; i < stream.slotCount; i++) {
+		const worldslot_t* entry = &slots[i];
+		if (entry->tile == NULL) continue;
+		if (entry->terrain != NULL) OBJECT_render(entry->terrain, viewMtx);
+		for (j = 0; j < entry->tile->objectCount; j++) {
+			OBJECT_render(entry->props[j], viewMtx);
+		}
+	}
+}
+
+BOOL WORLD_ground(f32 x, f32 z, f32* height, guVector* normal) {
+	PROF_SCOPE("WORLD_ground");
+	int tileX, tileZ;
+	if (!STREAM_tileAt(&stream, x, z, &tileX, &tileZ)) return FALSE;
+	const u32 slot = STREAM_find(&stream, tileX, tileZ);
+	if (slot == STREAM_NONE || slots[slot].tile == NULL) return FALSE;
+	return LEVEL_ground(&slots[slot].tile->ground, x, z, height, normal);
+}
+
+BOOL WORLD_ready(f32 x, f32 z) {
+	int tileX, tileZ;
+	/* Outside the terrain and on tiles with nothing to load there is never ground */
+	if (!STREAM_tileAt(&stream, x, z, &tileX, &tileZ) || _WORLD_size(NULL, tileX, tileZ) == 0) return TRUE;
+	const u32 slot = STREAM_find(&stream, tileX, tileZ);
+	return slot != STREAM_NONE && streamSlots[slot].state != STREAM_LOADING;
+}
+
+void WORLD_usage(u32* tiles, u32* bytes) {
+	u32 i, count = 0;
+	for (i = 0; i < stream.slotCount; i++) {
+		count += streamSlots[i].state != STREAM_FREE;
+	}
+	*tiles = count;
+	*bytes = stream.used;
+}
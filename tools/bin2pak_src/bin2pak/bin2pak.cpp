@@ -0,0 +1,423 @@
+// bin2pak.cpp : Packs game assets in one archive the game loads entries from
+//
+
+#include "bin2pak.h"
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+// Default entry alignment, GX and DVD reads want 32
+#define DEFAULT_ALIGN 32
+
+// Default hash chain depth
+#define DEFAULT_LEVEL 32
+
+// Minimum time each benchmark pass is repeated for
+#define BENCH_SECONDS 0.25
+
+// Prototyping
+bool packFiles(const vector<string>& files, const string& outFile, unsigned int align, unsigned int level, bool store);
+bool readPak(const string& file, vector<unsigned char>& data, vector<pakentry_t>& entries);
+bool listPak(const string& file);
+bool checkPak(const string& file);
+bool benchFiles(const vector<string>& files, unsigned int level);
+
+int main(int argc, char* argv[]) {
+	vector<string> inFiles;
+	string outFilePath;
+	unsigned int align = DEFAULT_ALIGN, level = DEFAULT_LEVEL;
+
+	try {
+		po::options_description desc("Valid arguments");
+		desc.add_options()
+			("help", "produce help message")
+			("files", po::value<vector<string> >(&inFiles), "files to pack, entries are named after them without directories")
+			("output,o", po::value<string>(&outFilePath), "output archive")
+			("align,a", po::value<unsigned int>(&align), "entry data alignment (power of two, default 32)")
+			("level,l", po::value<unsigned int>(&level), "match search depth, higher packs smaller and slower (default 32)")
+			("store", "store every entry unpacked")
+			("list", po::value<string>(), "print the directory of an archive")
+			("check", po::value<string>(), "unpack every entry of an archive (also in place) and verify the checksums")
+			("bench", "time packing and unpacking of the input files")
+			;
+		po::positional_options_description positional;
+		positional.add("files", -1);
+
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+		po::notify(vm);
+
+		// Help
+		if (vm.count("help")) {
+			cout << desc << "\n";
+			return 0;
+		}
+
+		if (vm.count("list")) {
+			return listPak(vm["list"].as<string>()) ? 0 : 1;
+		}
+
+		if (vm.count("check")) {
+			return checkPak(vm["check"].as<string>()) ? 0 : 1;
+		}
+
+		if (inFiles.empty()) {
+			cout << "ERROR:\n  Missing input files.\n";
+			cout << desc << "\n";
+			return 1;
+		}
+
+		if (vm.count("bench")) {
+			return benchFiles(inFiles, level) ? 0 : 1;
+		}
+
+		if (align == 0 || (align & (align - 1)) != 0) {
+			cout << "ERROR:\n  Alignment must be a power of two.\n";
+			return 1;
+		}
+
+		if (outFilePath.empty()) {
+			cout << "ERROR:\n  Missing output argument.\n";
+			cout << desc << "\n";
+			return 1;
+		}
+
+		return packFiles(inFiles, outFilePath, align, level, vm.count("store") > 0) ? 0 : 1;
+	}
+	catch (exception& e) {
+		cerr << "error: " << e.what() << "\n";
+		return 1;
+	}
+	catch (...) {
+		cerr << "Exception of unknown type!\n";
+	}
+
+	return 1;
+}
+
+static bool readFile(const string& file, vector<unsigned char>& data) {
+	ifstream in(file.c_str(), ios::binary);
+	if (!in) {
+		return false;
+	}
+	in.seekg(0, ios::end);
+	data.resize((size_t)in.tellg());
+	in.seekg(0, ios::beg);
+	return data.empty() || in.read((char*)data.data(), data.size());
+}
+
+static string baseName(const string& path) {
+	const size_t slash = path.find_last_of("/\\");
+	return slash != string::npos ? path.substr(slash + 1) : path;
+}
+
+static unsigned int fnv1a(const unsigned char* data, size_t size) {
+	unsigned int hash = 2166136261u;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ data[i]) * 16777619u;
+	}
+	return hash;
+}
+
+static inline void putU32(unsigned char* p, unsigned int value) {
+	p[0] = (unsigned char)(value >> 24);
+	p[1] = (unsigned char)(value >> 16);
+	p[2] = (unsigned char)(value >> 8);
+	p[3] = (unsigned char)value;
+}
+
+static inline unsigned int getU32(const unsigned char* p) {
+	return ((unsigned int)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+static inline unsigned int alignTo(unsigned int value, unsigned int step) {
+	return (value + step - 1) / step * step;
+}
+
+static const char* methodName(unsigned int method) {
+	return method == PAK_LZ ? "lz" : "stored";
+}
+
+bool packFiles(const vector<string>& files, const string& outFile, unsigned int align, unsigned int level, bool store) {
+	// The game finds entries with a binary search on their names
+	vector<string> sorted(files);
+	sort(sorted.begin(), sorted.end(), [](const string& a, const string& b) { return baseName(a) < baseName(b); });
+
+	vector<pakentry_t> entries(sorted.size());
+	vector<vector<unsigned char> > payloads(sorted.size());
+	const unsigned int directoryEnd = PAK_HEADER_SIZE + PAK_ENTRY_SIZE * (unsigned int)sorted.size();
+	unsigned int offset = alignTo(directoryEnd, align);
+	for (size_t i = 0; i < sorted.size(); i++) {
+		pakentry_t& entry = entries[i];
+		entry.name = baseName(sorted[i]);
+		if (entry.name.size() >= PAK_NAME_LENGTH) {
+			cout << "Error, entry name " << entry.name << " is longer than " << PAK_NAME_LENGTH - 1 << " characters\n";
+			return false;
+		}
+		if (i > 0 && entry.name == entries[i - 1].name) {
+			cout << "Error, two files are named " << entry.name << "\n";
+			return false;
+		}
+
+		vector<unsigned char> data;
+		if (!readFile(sorted[i], data)) {
+			cout << "Error input file [" << sorted[i] << "] could not be read\n";
+			return false;
+		}
+		entry.size = (unsigned int)data.size();
+		entry.checksum = fnv1a(data.data(), data.size());
+		entry.method = PAK_STORED;
+		entry.margin = 0;
+
+		// Only keep the packed data if it's smaller
+		if (!store && !data.empty()) {
+			vector<unsigned char> packed;
+			lzCompress(data.data(), data.size(), level, packed);
+			if (packed.size() < data.size()) {
+				entry.method = PAK_LZ;
+				entry.margin = (unsigned int)lzMargin(packed.data(), packed.size(), data.size());
+				data.swap(packed);
+			}
+		}
+		entry.packedSize = (unsigned int)data.size();
+		entry.offset = offset;
+		offset = alignTo(offset + entry.packedSize, align);
+		payloads[i].swap(data);
+	}
+
+	// Header and directory
+	vector<unsigned char> archive(offset, 0);
+	putU32(&archive[0], PAK_MAGIC);
+	archive[4] = PAK_VERSION >> 8;
+	archive[5] = PAK_VERSION & 0xFF;
+	archive[6] = (unsigned char)(entries.size() >> 8);
+	archive[7] = (unsigned char)(entries.size() & 0xFF);
+	putU32(&archive[8], alignTo(directoryEnd, align));
+	putU32(&archive[12], offset);
+	for (size_t i = 0; i < entries.size(); i++) {
+		unsigned char* p = &archive[PAK_HEADER_SIZE + PAK_ENTRY_SIZE * i];
+		memcpy(p, entries[i].name.c_str(), entries[i].name.size());
+		putU32(p + PAK_NAME_LENGTH, entries[i].offset);
+		putU32(p + PAK_NAME_LENGTH + 4, entries[i].size);
+		putU32(p + PAK_NAME_LENGTH + 8, entries[i].packedSize);
+		putU32(p + PAK_NAME_LENGTH + 12, entries[i].margin);
+		putU32(p + PAK_NAME_LENGTH + 16, entries[i].checksum);
+		p[PAK_NAME_LENGTH + 20] = (unsigned char)entries[i].method;
+		if (!payloads[i].empty()) {
+			memcpy(&archive[entries[i].offset], payloads[i].data(), payloads[i].size());
+		}
+	}
+
+	FILE* outFileHandle = fopen(outFile.c_str(), "wb");
+	if (outFileHandle == NULL) {
+		cout << "Error output file [" << outFile << "] could not be opened\n";
+		return false;
+	}
+	const bool written = fwrite(archive.data(), 1, archive.size(), outFileHandle) == archive.size();
+	fclose(outFileHandle);
+	if (!written) {
+		cout << "Error writing [" << outFile << "]\n";
+		return false;
+	}
+
+	unsigned long long total = 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		total += entries[i].size;
+	}
+	cout << outFile << ": " << entries.size() << " entries, " << total << " -> " << archive.size() << " bytes\n";
+	return true;
+}
+
+bool readPak(const string& file, vector<unsigned char>& data, vector<pakentry_t>& entries) {
+	if (!readFile(file, data)) {
+		cout << "Error input file [" << file << "] could not be read\n";
+		return false;
+	}
+	if (data.size() < PAK_HEADER_SIZE || getU32(&data[0]) != PAK_MAGIC || ((data[4] << 8) | data[5]) != PAK_VERSION) {
+		cout << "Error, " << file << " is not a version " << PAK_VERSION << " archive\n";
+		return false;
+	}
+	const unsigned int count = (data[6] << 8) | data[7];
+	if (data.size() < PAK_HEADER_SIZE + (size_t)PAK_ENTRY_SIZE * count || getU32(&data[12]) != data.size()) {
+		cout << "Error, " << file << " is truncated\n";
+		return false;
+	}
+	entries.resize(count);
+	for (unsigned int i = 0; i < count; i++) {
+		const unsigned char* p = &data[PAK_HEADER_SIZE + PAK_ENTRY_SIZE * i];
+		pakentry_t& entry = entries[i];
+		entry.name.assign((const char*)p, strnlen((const char*)p, PAK_NAME_LENGTH));
+		entry.offset = getU32(p + PAK_NAME_LENGTH);
+		entry.size = getU32(p + PAK_NAME_LENGTH + 4);
+		entry.packedSize = getU32(p + PAK_NAME_LENGTH + 8);
+		entry.margin = getU32(p + PAK_NAME_LENGTH + 12);
+		entry.checksum = getU32(p + PAK_NAME_LENGTH + 16);
+		entry.method = p[PAK_NAME_LENGTH + 20];
+		if ((unsigned long long)entry.offset + entry.packedSize > data.size()) {
+			cout << "Error, entry " << entry.name << " is past the end of " << file << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+bool listPak(const string& file) {
+	vector<unsigned char> data;
+	vector<pakentry_t> entries;
+	if (!readPak(file, data, entries)) {
+		return false;
+	}
+	for (size_t i = 0; i < entries.size(); i++) {
+		const pakentry_t& entry = entries[i];
+		cout << left << setw(PAK_NAME_LENGTH) << entry.name << right
+			<< setw(8) << methodName(entry.method)
+			<< setw(10) << entry.size << setw(10) << entry.packedSize
+			<< fixed << setprecision(1) << setw(7) << (entry.size ? 100.0 * entry.packedSize / entry.size : 100.0) << "%"
+			<< "  offset " << entry.offset << "  margin " << entry.margin << "\n";
+	}
+	cout << entries.size() << " entries, " << data.size() << " bytes\n";
+	return true;
+}
+
+// Unpack an entry like the game does, from the archive and from the end of its own buffer
+static bool unpackEntry(const pakentry_t& entry, const unsigned char* packed, vector<unsigned char>& out, bool inPlace) {
+	if (entry.method == PAK_STORED) {
+		out.assign(packed, packed + entry.packedSize);
+		return entry.packedSize == entry.size;
+	}
+	if (entry.method != PAK_LZ) {
+		return false;
+	}
+	if (!inPlace) {
+		out.resize(entry.size);
+		return lzDecompress(packed, entry.packedSize, out.data(), entry.size);
+	}
+	vector<unsigned char> buffer(entry.size + entry.margin);
+	unsigned char* tail = buffer.data() + buffer.size() - entry.packedSize;
+	memcpy(tail, packed, entry.packedSize);
+	if (!lzDecompress(tail, entry.packedSize, buffer.data(), entry.size)) {
+		return false;
+	}
+	out.assign(buffer.begin(), buffer.begin() + entry.size);
+	return true;
+}
+
+bool checkPak(const string& file) {
+	vector<unsigned char> data;
+	vector<pakentry_t> entries;
+	if (!readPak(file, data, entries)) {
+		return false;
+	}
+	unsigned int failed = 0;
+	for (size_t i = 0; i < entries.size(); i++) {
+		const pakentry_t& entry = entries[i];
+		if (i > 0 && !(entries[i - 1].name < entry.name)) {
+			cout << entry.name << ": directory not sorted\n";
+			failed++;
+		}
+		for (int inPlace = 0; inPlace < 2; inPlace++) {
+			vector<unsigned char> out;
+			if (!unpackEntry(entry, data.data() + entry.offset, out, inPlace != 0)) {
+				cout << entry.name << ": corrupt " << methodName(entry.method) << " data" << (inPlace ? " (in place)" : "") << "\n";
+				failed++;
+				break;
+			}
+			if (fnv1a(out.data(), out.size()) != entry.checksum) {
+				cout << entry.name << ": checksum mismatch" << (inPlace ? " (in place)" : "") << "\n";
+				failed++;
+				break;
+			}
+		}
+	}
+	cout << entries.size() - min((size_t)failed, entries.size()) << " entries ok, " << failed << " errors\n";
+	return failed == 0;
+}
+
+// Run work until BENCH_SECONDS have passed, returns MB/s over size bytes per run
+template <typename Work>
+static double throughput(size_t size, Work work) {
+	typedef chrono::steady_clock clock;
+	unsigned int runs = 0;
+	const clock::time_point start = clock::now();
+	double seconds = 0;
+	do {
+		work();
+		runs++;
+		seconds = chrono::duration<double>(clock::now() - start).count();
+	} while (seconds < BENCH_SECONDS);
+	return (double)size * runs / seconds / (1024.0 * 1024.0);
+}
+
+bool benchFiles(const vector<string>& files, unsigned int level) {
+	cout << left << setw(24) << "file" << right << setw(10) << "size" << setw(10) << "packed" << setw(8) << "ratio"
+		<< setw(10) << "pack" << setw(10) << "unpack" << setw(10) << "in place" << setw(10) << "memcpy" << "  (MB/s)\n";
+
+	unsigned long long totalSize = 0, totalPacked = 0;
+	double unpackSeconds = 0, copySeconds = 0;
+	for (size_t i = 0; i < files.size(); i++) {
+		vector<unsigned char> data;
+		if (!readFile(files[i], data) || data.empty()) {
+			cout << "Error input file [" << files[i] << "] could not be read\n";
+			return false;
+		}
+
+		vector<unsigned char> packed;
+		const double packRate = throughput(data.size(), [&]() {
+			packed.clear();
+			lzCompress(data.data(), data.size(), level, packed);
+		});
+
+		pakentry_t entry;
+		entry.method = PAK_LZ;
+		entry.size = (unsigned int)data.size();
+		entry.packedSize = (unsigned int)packed.size();
+		entry.margin = (unsigned int)lzMargin(packed.data(), packed.size(), data.size());
+
+		vector<unsigned char> out(data.size());
+		bool ok = true;
+		const double unpackRate = throughput(data.size(), [&]() {
+			ok &= lzDecompress(packed.data(), packed.size(), out.data(), out.size());
+		});
+		ok &= out == data;
+
+		// In place, the packed copy is rewritten each run (the last one is timed too, it's a memcpy of packedSize)
+		vector<unsigned char> buffer(data.size() + entry.margin);
+		unsigned char* tail = buffer.data() + buffer.size() - packed.size();
+		const double inPlaceRate = throughput(data.size(), [&]() {
+			memcpy(tail, packed.data(), packed.size());
+			ok &= lzDecompress(tail, packed.size(), buffer.data(), data.size());
+		});
+		ok &= memcmp(buffer.data(), data.data(), data.size()) == 0;
+
+		const double copyRate = throughput(data.size(), [&]() {
+			memcpy(out.data(), data.data(), data.size());
+		});
+
+		if (!ok) {
+			cout << "Error, " << files[i] << " did not unpack to the same data\n";
+			return false;
+		}
+
+		totalSize += data.size();
+		totalPacked += packed.size();
+		unpackSeconds += data.size() / unpackRate;
+		copySeconds += data.size() / copyRate;
+		cout << left << setw(24) << baseName(files[i]) << right << setw(10) << data.size() << setw(10) << packed.size()
+			<< fixed << setprecision(1) << setw(7) << 100.0 * packed.size() / data.size() << "%"
+			<< setw(10) << packRate << setw(10) << unpackRate << setw(10) << inPlaceRate << setw(10) << copyRate << "\n";
+	}
+	cout << left << setw(24) << "total" << right << setw(10) << totalSize << setw(10) << totalPacked
+		<< fixed << setprecision(1) << setw(7) << 100.0 * totalPacked / totalSize << "%"
+		<< setw(10) << "" << setw(10) << totalSize / unpackSeconds << setw(10) << "" << setw(10) << totalSize / copySeconds << "\n";
+	return true;
+}
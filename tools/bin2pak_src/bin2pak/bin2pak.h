@@ -0,0 +1,46 @@
+#ifndef _BIN2PAK_H
+#define _BIN2PAK_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+// Archive layout, everything big endian (the console reads it in place):
+//   header, directory (one entry per file, sorted by name), entry data
+// Entry data starts on a multiple of the archive alignment, so stored entries
+// can be used where they are and reads from disc land on aligned offsets.
+// Keep in sync with include/archive.h
+#define PAK_MAGIC		0x4250414B	// "BPAK"
+#define PAK_VERSION		1
+#define PAK_NAME_LENGTH	32
+#define PAK_HEADER_SIZE	16
+#define PAK_ENTRY_SIZE	56
+
+// Entry methods
+#define PAK_STORED		0
+#define PAK_LZ			1
+
+typedef struct {
+	std::string		name;		// File name without directories
+	unsigned int	offset;		// From the start of the archive
+	unsigned int	size;		// Unpacked
+	unsigned int	packedSize;	// As stored
+	unsigned int	margin;		// Bytes past size a buffer needs to unpack in place
+	unsigned int	checksum;	// FNV-1a of the unpacked data
+	unsigned int	method;		// PAK_*
+} pakentry_t;
+
+// lz.cpp
+// Pack size bytes, chainDepth is how many earlier matches to try at each byte
+// (more is smaller and slower, unpacking speed doesn't change)
+void lzCompress(const unsigned char* in, size_t size, unsigned int chainDepth, std::vector<unsigned char>& out);
+
+// Unpack into exactly outSize bytes, returns false on corrupt data.
+// out may overlap in if in sits at the end of a buffer of outSize + lzMargin bytes.
+bool lzDecompress(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize);
+
+// Extra bytes past outSize so the packed data can be loaded at the end of the
+// output buffer and unpacked over itself
+size_t lzMargin(const unsigned char* in, size_t inSize, size_t outSize);
+
+#endif
@@ -0,0 +1,240 @@
+// lz.cpp : LZ77 packing for archive entries
+//
+// A packed entry is a list of sequences: a token byte (literal count in the high
+// nibble, match length - 4 in the low one, 15 meaning more length bytes follow,
+// each adding up to 255), the literals, then the match as a 16 bit big endian
+// offset back into the output. The last sequence only has literals.
+// Unpacking is plain copies without tables or bit reads, which suits the Gekko;
+// lzDecompress is the same code as _PAK_unpack in src/archive.c.
+
+#include "bin2pak.h"
+
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+#define MIN_MATCH	4
+#define MAX_OFFSET	65535
+#define HASH_BITS	16
+
+static inline unsigned int hash4(const unsigned char* p) {
+	const unsigned int v = p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+	return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Remainder of a length whose nibble is 15
+static void putLength(vector<unsigned char>& out, size_t length) {
+	while (length >= 255) {
+		out.push_back(255);
+		length -= 255;
+	}
+	out.push_back((unsigned char)length);
+}
+
+static void putSequence(vector<unsigned char>& out, const unsigned char* literals, size_t literalCount, size_t offset, size_t matchLength) {
+	const size_t matchCode = matchLength != 0 ? matchLength - MIN_MATCH : 0;
+	out.push_back((unsigned char)((min(literalCount, (size_t)15) << 4) | min(matchCode, (size_t)15)));
+	if (literalCount >= 15) {
+		putLength(out, literalCount - 15);
+	}
+	out.insert(out.end(), literals, literals + literalCount);
+	if (matchLength != 0) {
+		out.push_back((unsigned char)(offset >> 8));
+		out.push_back((unsigned char)(offset & 0xFF));
+		if (matchCode >= 15) {
+			putLength(out, matchCode - 15);
+		}
+	}
+}
+
+// Hash chains over every position seen so far
+typedef struct {
+	const unsigned char*	data;
+	size_t					size;
+	unsigned int			depth;
+	vector<int>				head;
+	vector<int>				prev;
+} matcher_t;
+
+static void insert(matcher_t& m, size_t p) {
+	if (p + MIN_MATCH > m.size) {
+		return;
+	}
+	const unsigned int h = hash4(m.data + p);
+	m.prev[p] = m.head[h];
+	m.head[h] = (int)p;
+}
+
+// Longest earlier match at p (0 if none is MIN_MATCH long)
+static size_t findMatch(const matcher_t& m, size_t p, size_t& offset) {
+	if (p + MIN_MATCH > m.size) {
+		return 0;
+	}
+	const size_t limit = m.size - p;
+	size_t best = 0;
+	int candidate = m.head[hash4(m.data + p)];
+	for (unsigned int tries = 0; candidate >= 0 && tries < m.depth; tries++) {
+		if (p - candidate > MAX_OFFSET) {
+			break;
+		}
+		// A longer match has to differ from the best one at its last byte first
+		if (m.data[candidate + best] == m.data[p + best]) {
+			size_t length = 0;
+			while (length < limit && m.data[candidate + length] == m.data[p + length]) {
+				length++;
+			}
+			if (length > best) {
+				best = length;
+				offset = p - candidate;
+				if (length == limit) {
+					break;
+				}
+			}
+		}
+		candidate = m.prev[candidate];
+	}
+	return best >= MIN_MATCH ? best : 0;
+}
+
+void lzCompress(const unsigned char* in, size_t size, unsigned int chainDepth, vector<unsigned char>& out) {
+	matcher_t m;
+	m.data = in;
+	m.size = size;
+	m.depth = max(chainDepth, 1u);
+	m.head.assign(1 << HASH_BITS, -1);
+	m.prev.assign(size, -1);
+
+	size_t p = 0, anchor = 0;
+	while (p < size) {
+		size_t offset = 0;
+		const size_t length = findMatch(m, p, offset);
+		insert(m, p);
+		if (length == 0) {
+			p++;
+			continue;
+		}
+
+		// Lazy matching: a longer match one byte on is worth a literal
+		size_t nextOffset = 0;
+		if (m.depth > 1 && findMatch(m, p + 1, nextOffset) > length) {
+			p++;
+			continue;
+		}
+
+		putSequence(out, in + anchor, p - anchor, offset, length);
+		for (size_t i = p + 1; i < p + length; i++) {
+			insert(m, i);
+		}
+		p += length;
+		anchor = p;
+	}
+	putSequence(out, in + anchor, size - anchor, 0, 0);
+}
+
+bool lzDecompress(const unsigned char* in, size_t inSize, unsigned char* out, size_t outSize) {
+	const unsigned char* ip = in;
+	const unsigned char* const inEnd = in + inSize;
+	unsigned char* op = out;
+	unsigned char* const outEnd = out + outSize;
+
+	for (;;) {
+		if (ip >= inEnd) {
+			return false;
+		}
+		const unsigned int token = *ip++;
+
+		// Literals (memmove, they may overlap when unpacking in place)
+		size_t length = token >> 4;
+		if (length == 15) {
+			unsigned int more;
+			do {
+				if (ip >= inEnd) {
+					return false;
+				}
+				more = *ip++;
+				length += more;
+			} while (more == 255);
+		}
+		if (length > (size_t)(inEnd - ip) || length > (size_t)(outEnd - op)) {
+			return false;
+		}
+		memmove(op, ip, length);
+		op += length;
+		ip += length;
+		if (ip == inEnd) {
+			return op == outEnd;
+		}
+
+		// Match
+		if (inEnd - ip < 2) {
+			return false;
+		}
+		const size_t offset = (ip[0] << 8) | ip[1];
+		ip += 2;
+		length = (token & 15) + MIN_MATCH;
+		if ((token & 15) == 15) {
+			unsigned int more;
+			do {
+				if (ip >= inEnd) {
+					return false;
+				}
+				more = *ip++;
+				length += more;
+			} while (more == 255);
+		}
+		if (offset == 0 || offset > (size_t)(op - out) || length > (size_t)(outEnd - op)) {
+			return false;
+		}
+		// An overlapping match repeats its first offset bytes, each copy doubles
+		// the run that can be copied next without overlap
+		const unsigned char* match = op - offset;
+		size_t run = offset;
+		while (length > run) {
+			memcpy(op, match, run);
+			op += run;
+			length -= run;
+			run <<= 1;
+		}
+		memcpy(op, match, length);
+		op += length;
+	}
+}
+
+size_t lzMargin(const unsigned char* in, size_t inSize, size_t outSize) {
+	// Packed data at the end of the buffer starts at outSize + margin - inSize,
+	// output must never pass the first unread byte: while literals are copied
+	// (they are read before they are written) and after each match
+	long long worst = 0;
+	size_t ip = 0, op = 0;
+	while (ip < inSize) {
+		const unsigned int token = in[ip++];
+		size_t length = token >> 4;
+		if (length == 15) {
+			unsigned int more;
+			do {
+				more = ip < inSize ? in[ip++] : 0;
+				length += more;
+			} while (more == 255);
+		}
+		worst = max(worst, (long long)op - (long long)ip);
+		ip += length;
+		op += length;
+		if (ip >= inSize) {
+			break;
+		}
+
+		ip += 2;
+		length = (token & 15) + MIN_MATCH;
+		if ((token & 15) == 15) {
+			unsigned int more;
+			do {
+				more = ip < inSize ? in[ip++] : 0;
+				length += more;
+			} while (more == 255);
+		}
+		op += length;
+		worst = max(worst, (long long)op - (long long)ip);
+	}
+	const long long margin = worst + (long long)inSize - (long long)outSize;
+	return margin > 0 ? (size_t)margin : 0;
+}
@@ -0,0 +1,380 @@
+// analyze.cpp : Decoding a capture into what each view sent to the GPU
+//
+// The stream is walked with the game's own decoder (src/gxstream.c), and
+// called display lists are decoded in place with the vertex state they were
+// called with. Every CP, XF and BP register is shadowed so a write that sets
+// the value a register already has shows up as redundant.
+
+#include "gxcap.h"
+extern "C" {
+#include "gxstream.h"
+}
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+using namespace std;
+
+// BP registers
+#define BP_MASK			0xFE	// Bits the next BP write changes
+#define BP_FULL_MASK	0xFFFFFF
+
+// XF memory
+#define XF_POS_END		0x400	// Position and texture matrices below
+#define XF_NORMAL_START	0x400
+#define XF_NORMAL_END	0x460
+
+// What the registers hold so far
+typedef struct {
+	gxvtxstate_t vtx;
+	map<unsigned int, unsigned int> cp, xf, bp;
+	unsigned int bpMask;
+	set<listkey_t> missing;		// Called lists that aren't in the capture
+} shadow_t;
+
+// BP writes that do something every time (copies, tokens, loads), never redundant
+static bool isBpTrigger(unsigned int reg) {
+	return reg == 0x45 || reg == 0x47 || reg == 0x48 || reg == 0x52 || reg == 0x57 || (reg >= 0x64 && reg <= 0x67) || reg == 0x69;
+}
+
+// Texture image addresses, writing one loads a texture
+static bool isBpTexture(unsigned int reg) {
+	return (reg >= 0x94 && reg <= 0x97) || (reg >= 0xB4 && reg <= 0xB7);
+}
+
+static bool isCpVcd(unsigned int reg) {
+	return (reg & 0xF0) == GXS_CP_VCD_LO || (reg & 0xF0) == GXS_CP_VCD_HI;
+}
+
+static bool isCpVat(unsigned int reg) {
+	return reg >= GXS_CP_VAT_A && reg < GXS_CP_VAT_C + 0x10 && (reg & 0x0F) < 8;
+}
+
+static string registerName(const char* unit, unsigned int reg, int digits) {
+	char name[16];
+	snprintf(name, sizeof(name), "%s 0x%0*X", unit, digits, reg);
+	return name;
+}
+
+// Set a shadowed register, true if it already had this value
+static bool shadowWrite(map<unsigned int, unsigned int>& registers, unsigned int reg, unsigned int value) {
+	map<unsigned int, unsigned int>::iterator known = registers.find(reg);
+	if (known != registers.end() && known->second == value) {
+		return true;
+	}
+	registers[reg] = value;
+	return false;
+}
+
+static void countCommand(const gxbytes_t& bytes, const gxcommand_t& command, bool inList, shadow_t& shadow, gxstats_t& stats, gxreport_t& report) {
+	stats.commands++;
+	switch (command.type) {
+	case GXS_NOP:
+		stats.nops++;
+		stats.nopBytes += command.size;
+		break;
+	case GXS_CP: {
+		stats.cpWrites++;
+		const bool redundant = shadowWrite(shadow.cp, command.address, command.value);
+		if (redundant) {
+			stats.cpRedundant++;
+			report.redundant[registerName("CP", command.address, 2)]++;
+		} else if (isCpVcd(command.address)) {
+			stats.vcdChanges++;
+		} else if (isCpVat(command.address)) {
+			stats.vatChanges++;
+		}
+		break;
+	}
+	case GXS_XF: {
+		stats.xfWrites++;
+		bool redundant = true;
+		for (unsigned int i = 0; i < command.count; i++) {
+			redundant = shadowWrite(shadow.xf, command.address + i, GXS_read32(&bytes, command.offset + 5 + i * 4)) && redundant;
+		}
+		if (redundant) {
+			stats.xfRedundant++;
+			report.redundant[registerName("XF", command.address, 4)]++;
+		}
+		if (command.address < XF_POS_END) {
+			stats.posMatrices++;
+		} else if (command.address >= XF_NORMAL_START && command.address < XF_NORMAL_END) {
+			stats.normalMatrices++;
+		}
+		break;
+	}
+	case GXS_XF_INDEX:
+		// Loaded from memory, the values aren't in the capture
+		stats.xfWrites++;
+		for (unsigned int i = 0; i < command.count; i++) {
+			shadow.xf.erase(command.address + i);
+		}
+		if (command.opcode == GXS_OP_LOAD_INDX_A) {
+			stats.posMatrices++;
+		} else if (command.opcode == GXS_OP_LOAD_INDX_B) {
+			stats.normalMatrices++;
+		}
+		break;
+	case GXS_BP: {
+		stats.bpWrites++;
+		const unsigned int reg = command.address;
+		if (reg == BP_MASK) {
+			shadow.bpMask = command.value;
+			break;
+		}
+		const unsigned int mask = shadow.bpMask;
+		shadow.bpMask = BP_FULL_MASK;
+		if (isBpTexture(reg)) {
+			stats.textureLoads++;
+		}
+		if (isBpTrigger(reg)) {
+			break;
+		}
+		map<unsigned int, unsigned int>::iterator known = shadow.bp.find(reg);
+		if (known == shadow.bp.end()) {
+			// Masked bits of a register never seen can't be compared later
+			if (mask == BP_FULL_MASK) {
+				shadow.bp[reg] = command.value;
+			}
+		} else if (shadowWrite(shadow.bp, reg, (known->second & ~mask) | (command.value & mask))) {
+			stats.bpRedundant++;
+			report.redundant[registerName("BP", reg, 2)]++;
+		}
+		break;
+	}
+	case GXS_DRAW:
+		stats.draws++;
+		stats.vertices += command.count;
+		stats.vertexBytes += (unsigned long long)command.count * command.vertexSize;
+		if (inList) {
+			stats.listDraws++;
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static const char* resultName(int result) {
+	switch (result) {
+	case GXS_TRUNCATED: return "command goes past the end";
+	case GXS_UNKNOWN: return "unknown opcode";
+	case GXS_NO_FORMAT: return "draw before its vertex format was set";
+	default: return "ok";
+	}
+}
+
+static void printCommand(const gxcommand_t& command, const string& part, bool inList) {
+	static const char* primitives[8] = { "quads", "quads2", "tris", "strip", "fan", "lines", "linestrip", "points" };
+	char line[128];
+	const char* prefix = inList ? "    > " : "";
+	switch (command.type) {
+	case GXS_NOP: snprintf(line, sizeof(line), "%snop", prefix); break;
+	case GXS_CP: snprintf(line, sizeof(line), "%sCP   0x%02X = 0x%08X", prefix, command.address, command.value); break;
+	case GXS_XF: snprintf(line, sizeof(line), "%sXF   0x%04X, %u words", prefix, command.address, command.count); break;
+	case GXS_XF_INDEX: snprintf(line, sizeof(line), "%sXF   0x%04X, %u words from index %u", prefix, command.address, command.count, command.value); break;
+	case GXS_CALL_DL: snprintf(line, sizeof(line), "%scall 0x%08X, %u bytes", prefix, command.address, command.count); break;
+	case GXS_INVAL_VTX: snprintf(line, sizeof(line), "%sinvalidate vertex cache", prefix); break;
+	case GXS_BP: snprintf(line, sizeof(line), "%sBP   0x%02X = 0x%06X", prefix, command.address, command.value); break;
+	case GXS_DRAW: snprintf(line, sizeof(line), "%sdraw %s, format %u, %u vertices of %u bytes", prefix, primitives[(command.address >> 3) & 7], command.value, command.count, command.vertexSize); break;
+	default: snprintf(line, sizeof(line), "%sopcode 0x%02X", prefix, command.opcode); break;
+	}
+	cout << hex << setfill('0') << setw(8) << command.offset << dec << setfill(' ') << "  " << left << setw(7) << part << right << line << "\n";
+}
+
+void analyzeCapture(const capture_t& capture, gxreport_t& report, bool listCommands) {
+	const captureheader_t& header = capture.header;
+	report.parts.assign(header.viewCount + 1, gxstats_t());
+	report.total = gxstats_t();
+	report.redundant.clear();
+	report.result = GXS_END;
+	report.errorOffset = 0;
+
+	shadow_t shadow;
+	GXS_reset(&shadow.vtx);
+	shadow.bpMask = BP_FULL_MASK;
+
+	gxbytes_t stream;
+	GXS_bytes(&stream, capture.stream.data(), (unsigned int)capture.stream.size());
+	gxcommand_t command;
+	unsigned int offset = 0, part = 0;
+	int result;
+	while ((result = GXS_next(&shadow.vtx, &stream, &offset, &command)) == GXS_OK) {
+		// Views are in order, whatever comes after the last one is the rest of the frame
+		while (part < header.viewCount && command.offset >= header.viewEnds[part]) {
+			part++;
+		}
+		const string partName = part < header.viewCount ? "view " + to_string(part + 1) : "rest";
+		gxstats_t& stats = report.parts[part];
+		if (listCommands) {
+			printCommand(command, partName, false);
+		}
+		countCommand(stream, command, false, shadow, stats, report);
+		if (command.type != GXS_CALL_DL) {
+			continue;
+		}
+
+		const listkey_t key(command.address, command.count);
+		stats.listCalls++;
+		stats.lists.insert(key);
+		stats.listBytes += command.count;
+		map<listkey_t, vector<unsigned char> >::const_iterator list = capture.lists.find(key);
+		if (list == capture.lists.end()) {
+			shadow.missing.insert(key);
+			continue;
+		}
+
+		// Lists run with the state they're called with, and what they set stays
+		gxbytes_t listBytes;
+		GXS_bytes(&listBytes, list->second.data(), (unsigned int)list->second.size());
+		gxcommand_t listCommand;
+		unsigned int listOffset = 0;
+		while ((result = GXS_next(&shadow.vtx, &listBytes, &listOffset, &listCommand)) == GXS_OK) {
+			if (listCommands) {
+				printCommand(listCommand, partName, true);
+			}
+			countCommand(listBytes, listCommand, true, shadow, stats, report);
+		}
+		if (result != GXS_END) {
+			report.result = result;
+			report.errorOffset = command.offset;
+			break;
+		}
+	}
+	if (result != GXS_END && report.result == GXS_END) {
+		report.result = result;
+		report.errorOffset = offset;
+	}
+	if (!shadow.missing.empty()) {
+		cout << "Warning: " << shadow.missing.size() << " called display lists are not in the capture\n";
+	}
+
+	// Frame totals
+	gxstats_t& total = report.total;
+	for (size_t i = 0; i < report.parts.size(); i++) {
+		const gxstats_t& stats = report.parts[i];
+		total.commands += stats.commands;
+		total.draws += stats.draws;
+		total.listDraws += stats.listDraws;
+		total.vertices += stats.vertices;
+		total.vertexBytes += stats.vertexBytes;
+		total.listCalls += stats.listCalls;
+		total.lists.insert(stats.lists.begin(), stats.lists.end());
+		total.listBytes += stats.listBytes;
+		total.posMatrices += stats.posMatrices;
+		total.normalMatrices += stats.normalMatrices;
+		total.textureLoads += stats.textureLoads;
+		total.vcdChanges += stats.vcdChanges;
+		total.vatChanges += stats.vatChanges;
+		total.cpWrites += stats.cpWrites;
+		total.xfWrites += stats.xfWrites;
+		total.bpWrites += stats.bpWrites;
+		total.cpRedundant += stats.cpRedundant;
+		total.xfRedundant += stats.xfRedundant;
+		total.bpRedundant += stats.bpRedundant;
+		total.nops += stats.nops;
+		total.nopBytes += stats.nopBytes;
+	}
+}
+
+static void printRow(const string& name, const vector<string>& values) {
+	cout << left << setw(18) << name << right;
+	for (size_t i = 0; i < values.size(); i++) {
+		cout << setw(11) << values[i];
+	}
+	cout << "\n";
+}
+
+static string number(unsigned long long value) {
+	return to_string(value);
+}
+
+static string ratio(unsigned long long value, unsigned long long over) {
+	if (over == 0) {
+		return "-";
+	}
+	char text[32];
+	snprintf(text, sizeof(text), "%.2f", (double)value / over);
+	return text;
+}
+
+static string percent(unsigned long long value, unsigned long long over) {
+	if (over == 0) {
+		return "-";
+	}
+	char text[32];
+	snprintf(text, sizeof(text), "%.1f%%", 100.0 * value / over);
+	return text;
+}
+
+void printReport(const capture_t& capture, const gxreport_t& report, unsigned int top) {
+	const captureheader_t& header = capture.header;
+	cout << "frame " << header.frame << ", " << capture.stream.size() << " bytes, " << header.viewCount << " views, "
+		<< capture.lists.size() << " display lists (" ;
+	size_t listBytes = 0;
+	for (map<listkey_t, vector<unsigned char> >::const_iterator list = capture.lists.begin(); list != capture.lists.end(); ++list) {
+		listBytes += list->second.size();
+	}
+	cout << listBytes << " bytes)\n\n";
+
+	vector<const gxstats_t*> columns;
+	vector<string> names;
+	for (size_t i = 0; i < report.parts.size(); i++) {
+		columns.push_back(&report.parts[i]);
+		names.push_back(i < header.viewCount ? "view " + to_string(i + 1) : "rest");
+	}
+	columns.push_back(&report.total);
+	names.push_back("total");
+	printRow("", names);
+
+	// One row per number, a column per part of the frame
+	#define REPORT_ROW(name, expression) { \
+		vector<string> values; \
+		for (size_t i = 0; i < columns.size(); i++) { const gxstats_t& s = *columns[i]; values.push_back(expression); } \
+		printRow(name, values); \
+	}
+	REPORT_ROW("commands", number(s.commands));
+	REPORT_ROW("draws", number(s.draws));
+	REPORT_ROW("  from lists", number(s.listDraws));
+	REPORT_ROW("vertices", number(s.vertices));
+	REPORT_ROW("vertex bytes", number(s.vertexBytes));
+	REPORT_ROW("  per vertex", ratio(s.vertexBytes, s.vertices));
+	REPORT_ROW("list calls", number(s.listCalls));
+	REPORT_ROW("  different", number(s.lists.size()));
+	REPORT_ROW("  calls per list", ratio(s.listCalls, s.lists.size()));
+	REPORT_ROW("  list bytes", number(s.listBytes));
+	REPORT_ROW("pos matrices", number(s.posMatrices));
+	REPORT_ROW("normal matrices", number(s.normalMatrices));
+	REPORT_ROW("texture loads", number(s.textureLoads));
+	REPORT_ROW("vcd changes", number(s.vcdChanges));
+	REPORT_ROW("vat changes", number(s.vatChanges));
+	REPORT_ROW("CP writes", number(s.cpWrites));
+	REPORT_ROW("  redundant", number(s.cpRedundant));
+	REPORT_ROW("XF writes", number(s.xfWrites));
+	REPORT_ROW("  redundant", number(s.xfRedundant));
+	REPORT_ROW("BP writes", number(s.bpWrites));
+	REPORT_ROW("  redundant", number(s.bpRedundant));
+	REPORT_ROW("redundant", percent(s.cpRedundant + s.xfRedundant + s.bpRedundant, s.cpWrites + s.xfWrites + s.bpWrites));
+	REPORT_ROW("nops", number(s.nops));
+	REPORT_ROW("  nop bytes", number(s.nopBytes));
+	#undef REPORT_ROW
+
+	if (top > 0 && !report.redundant.empty()) {
+		vector<pair<unsigned int, string> > registers;
+		for (map<string, unsigned int>::const_iterator reg = report.redundant.begin(); reg != report.redundant.end(); ++reg) {
+			registers.push_back(make_pair(reg->second, reg->first));
+		}
+		sort(registers.begin(), registers.end(), [](const pair<unsigned int, string>& a, const pair<unsigned int, string>& b) {
+			return a.first != b.first ? a.first > b.first : a.second < b.second;
+		});
+		cout << "\nmost redundant writes\n";
+		for (size_t i = 0; i < registers.size() && i < top; i++) {
+			cout << "  " << left << setw(10) << registers[i].second << right << setw(8) << registers[i].first << "\n";
+		}
+	}
+
+	if (report.result != GXS_END) {
+		cout << "\nError: decoding stopped at offset " << report.errorOffset << ", " << resultName(report.result) << "\n";
+	}
+}
@@ -0,0 +1,115 @@
+// capfile.cpp : Reading and writing the game's frame captures (include/capture.h)
+//
+// Everything in the file is big endian, the stream and lists are kept as the
+// GPU reads them and only the header and list entries are converted.
+
+#include "gxcap.h"
+
+#include <iostream>
+#include <cstdio>
+using namespace std;
+
+static unsigned int get32(const vector<unsigned char>& data, size_t offset) {
+	return (unsigned int)data[offset] << 24 | (unsigned int)data[offset + 1] << 16 | (unsigned int)data[offset + 2] << 8 | data[offset + 3];
+}
+
+static void put32(vector<unsigned char>& data, unsigned int value) {
+	data.push_back((unsigned char)(value >> 24));
+	data.push_back((unsigned char)(value >> 16));
+	data.push_back((unsigned char)(value >> 8));
+	data.push_back((unsigned char)value);
+}
+
+bool readCapture(const string& path, capture_t& capture) {
+	FILE* file = fopen(path.c_str(), "rb");
+	if (file == NULL) {
+		cout << "Error input file [" << path << "] could not be opened\n";
+		return false;
+	}
+	vector<unsigned char> data;
+	unsigned char buffer[65536];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		data.insert(data.end(), buffer, buffer + read);
+	}
+	fclose(file);
+
+	// Header, one word per field
+	const size_t headerWords = sizeof(captureheader_t) / 4;
+	if (data.size() < sizeof(captureheader_t)) {
+		cout << "Error [" << path << "] is too short for a capture\n";
+		return false;
+	}
+	unsigned int* fields = (unsigned int*)&capture.header;
+	for (size_t i = 0; i < headerWords; i++) {
+		fields[i] = get32(data, i * 4);
+	}
+	const captureheader_t& header = capture.header;
+	if (header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION) {
+		cout << "Error [" << path << "] is not a version " << CAPTURE_VERSION << " capture\n";
+		return false;
+	}
+	if (header.viewCount > CAPTURE_MAX_VIEWS) {
+		cout << "Error [" << path << "] has " << header.viewCount << " views\n";
+		return false;
+	}
+	for (unsigned int i = 0; i < header.viewCount; i++) {
+		if (header.viewEnds[i] > header.streamSize || (i > 0 && header.viewEnds[i] < header.viewEnds[i - 1])) {
+			cout << "Error [" << path << "] view " << i + 1 << " ends outside the stream\n";
+			return false;
+		}
+	}
+
+	size_t offset = sizeof(captureheader_t);
+	if (data.size() - offset < header.streamSize) {
+		cout << "Error [" << path << "] stream is cut short\n";
+		return false;
+	}
+	capture.stream.assign(data.begin() + offset, data.begin() + offset + header.streamSize);
+	offset += header.streamSize;
+
+	capture.lists.clear();
+	for (unsigned int i = 0; i < header.listCount; i++) {
+		if (data.size() - offset < 8 || data.size() - offset - 8 < get32(data, offset + 4)) {
+			cout << "Error [" << path << "] display list " << i << " is cut short\n";
+			return false;
+		}
+		const listkey_t key(get32(data, offset), get32(data, offset + 4));
+		offset += 8;
+		capture.lists[key].assign(data.begin() + offset, data.begin() + offset + key.second);
+		offset += key.second;
+	}
+	if (offset != data.size()) {
+		cout << "Warning: [" << path << "] has " << data.size() - offset << " bytes past the last display list\n";
+	}
+	return true;
+}
+
+bool writeCapture(const string& path, const capture_t& capture) {
+	vector<unsigned char> data;
+	captureheader_t header = capture.header;
+	header.streamSize = (unsigned int)capture.stream.size();
+	header.listCount = (unsigned int)capture.lists.size();
+	const unsigned int* fields = (const unsigned int*)&header;
+	for (size_t i = 0; i < sizeof(captureheader_t) / 4; i++) {
+		put32(data, fields[i]);
+	}
+	data.insert(data.end(), capture.stream.begin(), capture.stream.end());
+	for (map<listkey_t, vector<unsigned char> >::const_iterator list = capture.lists.begin(); list != capture.lists.end(); ++list) {
+		put32(data, list->first.first);
+		put32(data, (unsigned int)list->second.size());
+		data.insert(data.end(), list->second.begin(), list->second.end());
+	}
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (file == NULL) {
+		cout << "Error output file [" << path << "] could not be opened\n";
+		return false;
+	}
+	const bool written = fwrite(data.data(), 1, data.size(), file) == data.size();
+	if (fclose(file) != 0 || !written) {
+		cout << "Error output file [" << path << "] could not be written\n";
+		return false;
+	}
+	return true;
+}
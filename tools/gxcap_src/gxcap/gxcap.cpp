@@ -0,0 +1,67 @@
+// gxcap.cpp : Analyzer for the GX command streams the game captures (CAPTURE=1 builds)
+//
+
+#include "gxcap.h"
+extern "C" {
+#include "gxstream.h"
+}
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+#include <iostream>
+using namespace std;
+
+int main(int argc, char* argv[]) {
+	string inFilePath;
+	unsigned int top = 8;
+
+	try {
+		po::options_description desc("Valid arguments");
+		desc.add_options()
+			("help", "produce help message")
+			("input,i", po::value<string>(), "input capture (hovercraft_frame_N.gxc)")
+			("list", "print every command")
+			("top", po::value<unsigned int>(&top), "registers shown with the most redundant writes")
+			;
+
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+
+		// Help
+		if (vm.count("help")) {
+			cout << desc << "\n";
+			return 0;
+		}
+
+		// Arguments
+		if (vm.count("input")) {
+			inFilePath = vm["input"].as<string>();
+		} else {
+			cout << "ERROR:\n  Missing input argument.\n";
+			cout << desc << "\n";
+			return 1;
+		}
+
+		capture_t capture;
+		if (!readCapture(inFilePath, capture)) {
+			return 1;
+		}
+		gxreport_t report;
+		analyzeCapture(capture, report, vm.count("list") > 0);
+		if (vm.count("list")) {
+			cout << "\n";
+		}
+		printReport(capture, report, top);
+		return report.result == GXS_END ? 0 : 1;
+	}
+	catch (exception& e) {
+		cerr << "error: " << e.what() << "\n";
+		return 1;
+	}
+	catch (...) {
+		cerr << "Exception of unknown type!\n";
+	}
+	return 1;
+}
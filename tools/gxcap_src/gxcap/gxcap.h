@@ -0,0 +1,59 @@
+#ifndef _GXCAP_H
+#define _GXCAP_H
+
+#include <vector>
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+
+#include "capture.h"
+
+// A display list by physical address and size, the same address can be called with different sizes
+typedef std::pair<unsigned int, unsigned int> listkey_t;
+
+// A frame captured by the game (see include/capture.h), decoded to host endian
+typedef struct {
+	captureheader_t header;
+	std::vector<unsigned char> stream;
+	std::map<listkey_t, std::vector<unsigned char> > lists;
+} capture_t;
+
+// What one part of the frame (a view, the rest or all of it) sent to the GPU
+typedef struct {
+	unsigned int commands;			// In the stream and in called lists
+	unsigned int draws;
+	unsigned int listDraws;			// Draws that came from display lists
+	unsigned int vertices;
+	unsigned long long vertexBytes;
+	unsigned int listCalls;
+	std::set<listkey_t> lists;		// Different lists called
+	unsigned long long listBytes;	// Bytes of all the calls
+	unsigned int posMatrices;		// XF loads of position/texture matrices
+	unsigned int normalMatrices;
+	unsigned int textureLoads;		// Texture image addresses set
+	unsigned int vcdChanges;		// Vertex descriptor writes with a new value
+	unsigned int vatChanges;		// Vertex format writes with a new value
+	unsigned int cpWrites, xfWrites, bpWrites;
+	unsigned int cpRedundant, xfRedundant, bpRedundant;
+	unsigned int nops;
+	unsigned int nopBytes;
+} gxstats_t;
+
+typedef struct {
+	std::vector<gxstats_t> parts;					// One per view, then the rest of the frame
+	gxstats_t total;
+	std::map<std::string, unsigned int> redundant;	// Redundant writes per register ("BP 0x28"...)
+	int result;										// GXS_END unless decoding stopped early
+	unsigned int errorOffset;						// Where it stopped
+} gxreport_t;
+
+// capfile.cpp
+bool readCapture(const std::string& path, capture_t& capture);
+bool writeCapture(const std::string& path, const capture_t& capture);
+
+// analyze.cpp
+void analyzeCapture(const capture_t& capture, gxreport_t& report, bool listCommands);
+void printReport(const capture_t& capture, const gxreport_t& report, unsigned int top);
+
+#endif
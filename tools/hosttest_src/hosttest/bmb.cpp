@@ -0,0 +1,324 @@
+// bmb.cpp : Host test of the model pipeline (tools/obj2bin_src) through .bmb files
+//
+// A synthetic scene is converted the way obj2bin converts models and written to
+// a file with each set of options. The file is read back with the shared reader,
+// every submesh's display list decoded and its arrays unquantized, and the
+// triangles drawn must be the source triangles, winding included, within the
+// quantization error bounds.
+
+#include "hosttest.h"
+#include "obj2bin.h"
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+// Where the converted scene goes
+#define TEST_FILE "hosttest_bmb.bmb"
+
+// Positions sit within TEST_POS_JITTER of this grid, so a decoded one snaps to
+// the same point as its source
+#define TEST_POS_GRID 16.0f
+#define TEST_POS_JITTER 0.004f
+
+// One corner of a source triangle, texcoords as the file has them (v flipped)
+typedef struct {
+	float position[3];
+	float normal[3];
+	float texcoord[2];
+} testcorner_t;
+
+typedef vector<int> trianglekey_t;
+
+static float snap(float value) {
+	return floor(value * TEST_POS_GRID + 0.5f) / TEST_POS_GRID;
+}
+
+// Rolling terrain, enough vertices to split at a low index limit
+static void addGrid(sourcescene_t& scene, unsigned int cells, unsigned int material) {
+	sourcemesh_t mesh;
+	mesh.material = material;
+	for (unsigned int z = 0; z <= cells; z++) {
+		for (unsigned int x = 0; x <= cells; x++) {
+			const float px = x * 0.5f, pz = z * 0.5f;
+			const float jitter = ((x * 7 + z * 13) % 17 / 8.0f - 1.0f) * TEST_POS_JITTER;
+			const float py = snap(sin(px * 0.7f) * cos(pz * 0.4f) * 3.0f) + jitter;
+			const float dx = cos(px * 0.7f) * cos(pz * 0.4f) * 2.1f, dz = -sin(px * 0.7f) * sin(pz * 0.4f) * 1.2f;
+			const float length = sqrt(dx * dx + 1 + dz * dz);
+			const float position[3] = { px, py, pz }, normal[3] = { -dx / length, 1 / length, -dz / length };
+			mesh.positions.insert(mesh.positions.end(), position, position + 3);
+			mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+			mesh.texcoords.push_back((float)x / cells);
+			mesh.texcoords.push_back((float)z / cells);
+		}
+	}
+	for (unsigned int z = 0; z < cells; z++) {
+		for (unsigned int x = 0; x < cells; x++) {
+			const unsigned int v = z * (cells + 1) + x;
+			const unsigned int quad[6] = { v, v + cells + 1, v + 1, v + 1, v + cells + 1, v + cells + 2 };
+			mesh.triangles.insert(mesh.triangles.end(), quad, quad + 6);
+		}
+	}
+	scene.meshes.push_back(mesh);
+}
+
+// A box with hard edges (positions shared by corners with other normals), away from the grid
+static void addBox(sourcescene_t& scene, float y, unsigned int material) {
+	static const float axes[6][3] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+	sourcemesh_t mesh;
+	mesh.material = material;
+	for (unsigned int f = 0; f < 6; f++) {
+		const float* n = axes[f];
+		// Two axes across the face, u x v = n so the winding faces out
+		const float u[3] = { n[1] + n[2], n[2] + n[0], n[0] + n[1] };
+		const float v[3] = { n[1] * u[2] - n[2] * u[1], n[2] * u[0] - n[0] * u[2], n[0] * u[1] - n[1] * u[0] };
+		const unsigned int base = mesh.positions.size() / 3;
+		for (unsigned int c = 0; c < 4; c++) {
+			const float su = (c & 1) ? 1.0f : -1.0f, sv = (c & 2) ? 1.0f : -1.0f;
+			for (unsigned int k = 0; k < 3; k++) {
+				mesh.positions.push_back(n[k] + su * u[k] + sv * v[k] + (k == 1 ? y : 0));
+				mesh.normals.push_back(n[k]);
+			}
+			mesh.texcoords.push_back(su * 0.5f + 0.5f);
+			mesh.texcoords.push_back(sv * 0.5f + 0.5f);
+		}
+		const unsigned int quad[6] = { base, base + 1, base + 3, base, base + 3, base + 2 };
+		mesh.triangles.insert(mesh.triangles.end(), quad, quad + 6);
+	}
+	scene.meshes.push_back(mesh);
+}
+
+// Snapped positions of a triangle's corners
+static trianglekey_t snappedCorners(const testcorner_t* corners) {
+	trianglekey_t key(9);
+	for (unsigned int c = 0; c < 3; c++) {
+		for (unsigned int k = 0; k < 3; k++) {
+			key[c * 3 + k] = (int)floor(corners[c].position[k] * TEST_POS_GRID + 0.5f);
+		}
+	}
+	return key;
+}
+
+// Corner with the smallest snapped position, where the key starts
+static unsigned int firstCorner(const testcorner_t* corners) {
+	const trianglekey_t key = snappedCorners(corners);
+	unsigned int first = 0;
+	for (unsigned int c = 1; c < 3; c++) {
+		if (lexicographical_compare(key.begin() + c * 3, key.begin() + c * 3 + 3, key.begin() + first * 3, key.begin() + first * 3 + 3)) {
+			first = c;
+		}
+	}
+	return first;
+}
+
+// Triangle key: its snapped positions from the first corner on, so rotations of
+// a triangle share a key and the other winding doesn't
+static trianglekey_t makeKey(const testcorner_t* corners) {
+	trianglekey_t key = snappedCorners(corners);
+	rotate(key.begin(), key.begin() + firstCorner(corners) * 3, key.end());
+	return key;
+}
+
+// Source triangles by key, per material name
+static void sourceTriangles(const sourcescene_t& scene, map<string, map<trianglekey_t, vector<testcorner_t> > >& triangles) {
+	for (size_t mi = 0; mi < scene.meshes.size(); mi++) {
+		const sourcemesh_t& mesh = scene.meshes[mi];
+		const string name = scene.materials[mesh.material].name;
+		for (size_t ti = 0; ti < mesh.triangles.size(); ti += 3) {
+			vector<testcorner_t> corners(3);
+			for (unsigned int c = 0; c < 3; c++) {
+				const unsigned int v = mesh.triangles[ti + c];
+				memcpy(corners[c].position, &mesh.positions[v * 3], sizeof(float) * 3);
+				memcpy(corners[c].normal, &mesh.normals[v * 3], sizeof(float) * 3);
+				corners[c].texcoord[0] = mesh.texcoords[v * 2];
+				corners[c].texcoord[1] = 1.0f - mesh.texcoords[v * 2 + 1];
+			}
+			const trianglekey_t key = makeKey(&corners[0]);
+			rotate(corners.begin(), corners.begin() + firstCorner(&corners[0]), corners.end());
+			triangles[name][key] = corners;
+		}
+	}
+}
+
+typedef struct {
+	const char*	name;
+	bool		quantize;
+	bool		strips;
+	bool		vcache;
+	unsigned int maxIndex;
+} variant_t;
+
+typedef struct {
+	float			position;
+	float			normal;
+	float			texcoord;
+} testerror_t;
+
+// Read the file back and match every drawn triangle with its source, returns the number of problems
+static unsigned int checkFile(const sourcescene_t& scene, const convopts_t& opts, unsigned int& submeshes, testerror_t& worst) {
+	bmbfile_t bmb;
+	string error;
+	if (!readBmb(TEST_FILE, bmb, error)) {
+		cout << "can't read the file back: " << error << "\n";
+		return 1;
+	}
+	submeshes = bmb.header.submeshCount;
+
+	map<string, map<trianglekey_t, vector<testcorner_t> > > expected;
+	sourceTriangles(scene, expected);
+
+	unsigned int errors = 0, materialSize = 0;
+	const binmaterial_t* materials = (const binmaterial_t*)bmbSection(bmb, BMB_SECTION_MATERIALS, 0, &materialSize);
+	if (materials == NULL) {
+		return 1;
+	}
+	for (unsigned int si = 0; si < bmb.header.submeshCount; si++) {
+		binmesh_t info;
+		unsigned int posSize, nrmSize, texSize, dlSize, boundsSize;
+		const unsigned char* posData = bmbSection(bmb, BMB_SECTION_POSITIONS, si, &posSize);
+		const unsigned char* nrmData = bmbSection(bmb, BMB_SECTION_NORMALS, si, &nrmSize);
+		const unsigned char* texData = bmbSection(bmb, BMB_SECTION_TEXCOORDS, si, &texSize);
+		const unsigned char* dl = bmbSection(bmb, BMB_SECTION_DISPLAYLIST, si, &dlSize);
+		const unsigned char* boundsData = bmbSection(bmb, BMB_SECTION_BOUNDS, si, &boundsSize);
+		if (!bmbMeshInfo(bmb, si, info) || posData == NULL || nrmData == NULL || texData == NULL || dl == NULL || boundsData == NULL ||
+			info.material >= materialSize / sizeof(binmaterial_t) || info.vcount > opts.maxIndex + 1) {
+			cout << "submesh " << si << " is incomplete\n";
+			errors++;
+			continue;
+		}
+
+		vector<float> positions, normals, texcoords;
+		readQuantized(posData, info.vcount * 3, info.posType, info.posFrac, positions);
+		readQuantized(nrmData, info.ncount * 3, info.nrmType, info.nrmFrac, normals);
+		readQuantized(texData, info.vtcount * 2, info.texType, info.texFrac, texcoords);
+		vector<dlindex_t> triangles;
+		if (!decodeDisplayList(dl, dlSize, triangles) || triangles.size() != info.fcount * 3) {
+			cout << "submesh " << si << " display list doesn't decode\n";
+			errors++;
+			continue;
+		}
+		errors += !opts.quantize && (info.posType != COMP_F32 || info.nrmType != COMP_F32 || info.texType != COMP_F32);
+
+		// Bounds hold every position
+		binbounds_t bounds;
+		memcpy(&bounds, boundsData, sizeof(binbounds_t));
+		for (unsigned int k = 0; k < 3; k++) {
+			bounds.min[k] = EndianFixFloat(bounds.min[k]);
+			bounds.max[k] = EndianFixFloat(bounds.max[k]);
+		}
+
+		map<trianglekey_t, vector<testcorner_t> >& source = expected[materials[info.material].name];
+		for (size_t ti = 0; ti < triangles.size(); ti += 3) {
+			testcorner_t drawn[3];
+			for (unsigned int c = 0; c < 3; c++) {
+				const dlindex_t& index = triangles[ti + c];
+				if (index.position >= info.vcount || index.normal >= info.ncount || index.texcoord >= info.vtcount) {
+					return errors + 1;
+				}
+				memcpy(drawn[c].position, &positions[index.position * 3], sizeof(float) * 3);
+				memcpy(drawn[c].normal, &normals[index.normal * 3], sizeof(float) * 3);
+				memcpy(drawn[c].texcoord, &texcoords[index.texcoord * 2], sizeof(float) * 2);
+			}
+
+			// Same positions in the same winding, each triangle once
+			const trianglekey_t key = makeKey(drawn);
+			map<trianglekey_t, vector<testcorner_t> >::iterator found = source.find(key);
+			if (found == source.end()) {
+				errors++;
+				continue;
+			}
+			const unsigned int first = firstCorner(drawn);
+			for (unsigned int c = 0; c < 3; c++) {
+				const testcorner_t& expect = found->second[c];
+				const testcorner_t& actual = drawn[(first + c) % 3];
+				for (unsigned int k = 0; k < 3; k++) {
+					worst.position = max(worst.position, fabs(actual.position[k] - expect.position[k]));
+					worst.normal = max(worst.normal, fabs(actual.normal[k] - expect.normal[k]));
+					errors += actual.position[k] < bounds.min[k] - opts.posError || actual.position[k] > bounds.max[k] + opts.posError;
+				}
+				for (unsigned int k = 0; k < 2; k++) {
+					worst.texcoord = max(worst.texcoord, fabs(actual.texcoord[k] - expect.texcoord[k]));
+				}
+			}
+			source.erase(found);
+		}
+	}
+
+	// Every source triangle drawn
+	for (map<string, map<trianglekey_t, vector<testcorner_t> > >::const_iterator it = expected.begin(); it != expected.end(); ++it) {
+		errors += (unsigned int)it->second.size();
+	}
+	return errors;
+}
+
+bool testBmb(const testconfig_t& config) {
+	(void)config;
+	sourcescene_t scene;
+	scene.materials.push_back(makeMaterial("ground", "textures/ground.png"));
+	scene.materials.push_back(makeMaterial("crate", "crate.png"));
+	scene.materials.push_back(makeMaterial("unused", ""));
+	addGrid(scene, 40, 0);
+	addBox(scene, 20.0f, 1);
+	addBox(scene, 24.0f, 0);
+
+	static const variant_t variants[] = {
+		{ "default",		true,	true,	true,	MAX_INDEX },
+		{ "split",			true,	true,	true,	300 },
+		{ "float",			false,	true,	true,	MAX_INDEX },
+		{ "no strips",		true,	false,	true,	MAX_INDEX },
+		{ "no vcache",		true,	true,	false,	300 },
+	};
+
+	unsigned int failed = 0;
+	cout << "variant       submeshes   bytes  pos error  nrm error   uv error  errors\n";
+	for (size_t vi = 0; vi < sizeof(variants) / sizeof(variants[0]); vi++) {
+		const variant_t& variant = variants[vi];
+		convopts_t opts;
+		opts.quantize = variant.quantize;
+		opts.posError = 0.0005f;
+		opts.nrmError = 0.008f;
+		opts.uvError = 0.0005f;
+		opts.strips = variant.strips;
+		opts.vcache = variant.vcache;
+		opts.cacheSize = 16;
+		opts.nrmMerge = 0.001f;
+		opts.maxIndex = variant.maxIndex;
+		opts.fastObj = true;
+
+		ostringstream log;
+		unsigned int errors = 0, submeshes = 0, bytes = 0;
+		testerror_t worst = { 0, 0, 0 };
+		if (!saveBinfile(TEST_FILE, scene, opts, log)) {
+			cout << log.str();
+			errors++;
+		} else {
+			errors += checkFile(scene, opts, submeshes, worst);
+			FILE* file = fopen(TEST_FILE, "rb");
+			if (file != NULL) {
+				fseek(file, 0, SEEK_END);
+				bytes = (unsigned int)ftell(file);
+				fclose(file);
+			}
+		}
+		remove(TEST_FILE);
+
+		// Quantization and normal merging stay within their bounds
+		const float slack = 1e-6f;
+		errors += worst.position > opts.posError + slack;
+		errors += worst.normal > opts.nrmError + opts.nrmMerge + slack;
+		errors += worst.texcoord > opts.uvError + slack;
+		errors += variant.maxIndex < MAX_INDEX && submeshes < 4;
+
+		cout << left << setw(12) << variant.name << right << setw(11) << submeshes << setw(8) << bytes << scientific << setprecision(2)
+			 << setw(11) << worst.position << setw(11) << worst.normal << setw(11) << worst.texcoord << fixed << setw(8) << errors
+			 << (errors == 0 ? "  ok" : "  FAILED") << "\n";
+		failed += errors > 0;
+	}
+	return failed == 0;
+}
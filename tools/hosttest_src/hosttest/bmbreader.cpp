@@ -0,0 +1,282 @@
+// bmbreader.cpp : Host test of the shared .bmb reader (tools/obj2bin_src/obj2bin/bmbfile.h)
+//
+// Containers are written with writeBmb and read back with readBmb, bmbSection
+// and bmbMeshInfo. Then a good file is broken one way at a time and the reader
+// must refuse it with the matching error, and checkBinfile must refuse files
+// whose container is fine but whose meshes don't add up.
+
+#include "hosttest.h"
+#include "obj2bin.h"
+
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstring>
+using namespace std;
+
+// Where the test containers go
+#define TEST_FILE "hosttest_reader.bmb"
+
+// Section type no reader knows
+#define TEST_SECTION_UNKNOWN 99
+
+static void set32(vector<unsigned char>& data, size_t offset, unsigned int value) {
+	for (int b = 0; b < 4; b++) {
+		data[offset + b] = (unsigned char)(value >> ((3 - b) * 8));
+	}
+}
+
+static unsigned int get32(const vector<unsigned char>& data, size_t offset) {
+	return (unsigned int)data[offset] << 24 | (unsigned int)data[offset + 1] << 16 | (unsigned int)data[offset + 2] << 8 | data[offset + 3];
+}
+
+static bool writeBytes(const vector<unsigned char>& data) {
+	FILE* file = fopen(TEST_FILE, "wb");
+	if (file == NULL) {
+		return false;
+	}
+	const bool written = data.empty() || fwrite(&data[0], 1, data.size(), file) == data.size();
+	fclose(file);
+	return written;
+}
+
+static bmbpayload_t makeMesh(unsigned int submesh, const binmesh_t& info) {
+	binmesh_t swapped = info;
+	swapped.vcount = EndianFixInt(info.vcount);
+	swapped.ncount = EndianFixInt(info.ncount);
+	swapped.vtcount = EndianFixInt(info.vtcount);
+	swapped.fcount = EndianFixInt(info.fcount);
+	swapped.material = EndianFixShort(info.material);
+	bmbpayload_t payload = { BMB_SECTION_MESH, submesh };
+	const unsigned char* bytes = (const unsigned char*)&swapped;
+	payload.data.assign(bytes, bytes + sizeof(binmesh_t));
+	return payload;
+}
+
+// One float triangle, with an index past the arrays if asked
+static void makeTriangleModel(vector<bmbpayload_t>& payloads, const binmesh_t& info, unsigned int badIndex) {
+	const float positions[9] = { 0, 0, 0, 1, 0, 0, 0, 0, 1 }, normal[3] = { 0, 1, 0 }, texcoord[2] = { 0.5f, 0.5f };
+	bmbpayload_t pos = { BMB_SECTION_POSITIONS, 0 }, nrm = { BMB_SECTION_NORMALS, 0 }, tex = { BMB_SECTION_TEXCOORDS, 0 };
+	const quantization_t floats = { COMP_F32, 0, 0 };
+	writeQuantized(pos.data, positions, 9, floats);
+	writeQuantized(nrm.data, normal, 3, floats);
+	writeQuantized(tex.data, texcoord, 2, floats);
+
+	vector<dlindex_t> corners(3);
+	for (unsigned int c = 0; c < 3; c++) {
+		corners[c].position = c;
+		corners[c].normal = 0;
+		corners[c].texcoord = c == 2 ? badIndex : 0;
+	}
+	bmbpayload_t dl = { BMB_SECTION_DISPLAYLIST, 0 };
+	encodeDisplayList(dl.data, vector<unsigned int>(), 1, corners);
+
+	bmbpayload_t materials = { BMB_SECTION_MATERIALS, 0 };
+	const binmaterial_t material = makeMaterial("plain", "");
+	const unsigned char* bytes = (const unsigned char*)&material;
+	materials.data.assign(bytes, bytes + sizeof(binmaterial_t));
+
+	payloads.push_back(makeMesh(0, info));
+	payloads.push_back(pos);
+	payloads.push_back(nrm);
+	payloads.push_back(tex);
+	payloads.push_back(dl);
+	payloads.push_back(materials);
+}
+
+// A container read back as written, returns the number of problems
+static unsigned int checkRoundTrip(vector<unsigned char>& good) {
+	unsigned int errors = 0;
+	binmesh_t info0, info1;
+	memset(&info0, 0, sizeof(binmesh_t));
+	memset(&info1, 0, sizeof(binmesh_t));
+	info0.vcount = 70000;
+	info0.ncount = 3;
+	info0.vtcount = 0x01020304;
+	info0.fcount = 12;
+	info0.posType = COMP_S16;
+	info0.posFrac = 10;
+	info0.material = 0x0102;
+	info1.vcount = 1;
+	info1.nrmType = COMP_S8;
+	info1.nrmFrac = 6;
+
+	// Sizes that aren't multiples of the alignment, an empty one and one of an unknown type
+	vector<bmbpayload_t> payloads;
+	payloads.push_back(makeMesh(0, info0));
+	bmbpayload_t positions = { BMB_SECTION_POSITIONS, 1 }, empty = { BMB_SECTION_NORMALS, 1 }, unknown = { TEST_SECTION_UNKNOWN, 0 };
+	for (unsigned int i = 0; i < 45; i++) {
+		positions.data.push_back((unsigned char)(i * 5 + 1));
+	}
+	unknown.data.assign(33, 0xA5);
+	payloads.push_back(positions);
+	payloads.push_back(empty);
+	payloads.push_back(unknown);
+	payloads.push_back(makeMesh(1, info1));
+
+	if (!writeBmb(TEST_FILE, 2, payloads)) {
+		return 1;
+	}
+	bmbfile_t bmb;
+	string error;
+	if (!readBmb(TEST_FILE, bmb, error)) {
+		cout << "good container refused: " << error << "\n";
+		return 1;
+	}
+	good = bmb.data;
+
+	errors += bmb.header.magic != BMB_MAGIC || bmb.header.version != BMB_VERSION || bmb.header.submeshCount != 2;
+	errors += bmb.header.sectionCount != payloads.size() || bmb.sections.size() != payloads.size() || bmb.header.size != bmb.data.size();
+	errors += get32(bmb.data, 0) != BMB_MAGIC;
+	for (size_t i = 0; i < bmb.sections.size(); i++) {
+		const binsection_t& section = bmb.sections[i];
+		errors += section.offset % BMB_ALIGN != 0 || section.offset < sizeof(binheader_t) + payloads.size() * sizeof(binsection_t);
+		errors += section.type != payloads[i].type || section.submesh != payloads[i].submesh || section.size != payloads[i].data.size();
+		errors += i > 0 && section.offset < bmb.sections[i - 1].offset + bmb.sections[i - 1].size;
+	}
+
+	// Sections by type and submesh, payloads as written
+	unsigned int size = 0;
+	const unsigned char* data = bmbSection(bmb, BMB_SECTION_POSITIONS, 1, &size);
+	errors += data == NULL || size != positions.data.size() || memcmp(data, &positions.data[0], size) != 0;
+	data = bmbSection(bmb, TEST_SECTION_UNKNOWN, 0, &size);
+	errors += data == NULL || size != unknown.data.size() || memcmp(data, &unknown.data[0], size) != 0;
+	size = 1;
+	errors += bmbSection(bmb, BMB_SECTION_NORMALS, 1, &size) == NULL || size != 0;
+	errors += bmbSection(bmb, BMB_SECTION_POSITIONS, 0, NULL) != NULL;
+	errors += bmbSection(bmb, BMB_SECTION_BOUNDS, 1, NULL) != NULL;
+
+	// Mesh info back in host order
+	binmesh_t read0, read1, missing;
+	errors += !bmbMeshInfo(bmb, 0, read0) || memcmp(&read0, &info0, sizeof(binmesh_t)) != 0;
+	errors += !bmbMeshInfo(bmb, 1, read1) || memcmp(&read1, &info1, sizeof(binmesh_t)) != 0;
+	errors += bmbMeshInfo(bmb, 2, missing);
+
+	// Material names: path dropped, cut to fit with room for the terminator
+	const binmaterial_t material = makeMaterial(string(40, 'm'), "C:\\art\\textures/rock.png");
+	errors += strcmp(material.texture, "rock.png") != 0;
+	errors += strnlen(material.name, sizeof(material.name)) != sizeof(material.name) - 1;
+	errors += strcmp(bmbSectionName(BMB_SECTION_DISPLAYLIST), "displaylist") != 0 || strcmp(bmbSectionName(TEST_SECTION_UNKNOWN), "unknown") != 0;
+
+	cout << "container: " << bmb.sections.size() << " sections, " << bmb.data.size() << " bytes, " << errors << " errors\n";
+	return errors;
+}
+
+typedef struct {
+	const char*	name;
+	const char*	error;		// What readBmb must say
+} breakage_t;
+
+// Broken copies of a good container, each must be refused for its reason
+static unsigned int checkBroken(const vector<unsigned char>& good) {
+	static const breakage_t breakages[] = {
+		{ "no file",				"unable to open file" },
+		{ "empty",					"file too small" },
+		{ "header cut short",		"file too small" },
+		{ "bad magic",				"not a .bmb file (bad magic)" },
+		{ "next version",			"unsupported version" },
+		{ "last byte missing",		"truncated file" },
+		{ "extra byte",				"truncated file" },
+		{ "table past the end",		"truncated file" },
+		{ "misaligned section",		"misaligned section" },
+		{ "section past the end",	"section out of bounds" },
+		{ "section after the end",	"section out of bounds" },
+		{ "size wraps around",		"section out of bounds" },
+		{ "missing submesh",		"section of a missing submesh" }
+	};
+	const size_t table = sizeof(binheader_t);
+
+	unsigned int errors = 0;
+	for (size_t i = 0; i < sizeof(breakages) / sizeof(breakages[0]); i++) {
+		vector<unsigned char> data = good;
+		switch (i) {
+		case 0:	remove(TEST_FILE); break;
+		case 1:	data.clear(); break;
+		case 2:	data.resize(sizeof(binheader_t) - 1); break;
+		case 3:	data[3] ^= 0x20; break;
+		case 4:	data[5]++; break;
+		case 5:	data.pop_back(); break;
+		case 6:	data.push_back(0); break;
+		case 7:	data[6] = 0xFF; data[7] = 0xFF; break;
+		case 8:	set32(data, table + 8, get32(data, table + 8) + 4); break;
+		case 9:	set32(data, table + 12, (unsigned int)data.size() - get32(data, table + 8) + 1); break;
+		case 10: set32(data, table + 8, ((unsigned int)data.size() + BMB_ALIGN) & ~(BMB_ALIGN - 1)); break;
+		case 11: set32(data, table + 12, 0xFFFFFFF0u); break;
+		case 12: set32(data, table + 4, 2); break;
+		}
+		if (i > 0 && !writeBytes(data)) {
+			return errors + 1;
+		}
+
+		bmbfile_t bmb;
+		string error;
+		const bool read = readBmb(TEST_FILE, bmb, error);
+		const bool refused = !read && error == breakages[i].error;
+		if (!refused) {
+			cout << breakages[i].name << ": " << (read ? "read" : error) << ", expected " << breakages[i].error << "\n";
+			errors++;
+		}
+	}
+	cout << "broken containers: " << sizeof(breakages) / sizeof(breakages[0]) << " checked, " << errors << " errors\n";
+	return errors;
+}
+
+typedef struct {
+	const char*	name;
+	bool		valid;
+} model_t;
+
+// Good containers holding models that don't add up, checkBinfile must refuse them
+static unsigned int checkModels() {
+	static const model_t models[] = {
+		{ "one triangle",			true },
+		{ "more positions",			false },
+		{ "more faces",				false },
+		{ "index past the arrays",	false },
+		{ "missing material",		false },
+		{ "no mesh info",			false },
+		{ "no display list",		false }
+	};
+
+	unsigned int errors = 0;
+	for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); i++) {
+		binmesh_t info;
+		memset(&info, 0, sizeof(binmesh_t));
+		info.vcount = 3;
+		info.ncount = 1;
+		info.vtcount = 1;
+		info.fcount = 1;
+		info.posType = info.nrmType = info.texType = COMP_F32;
+		switch (i) {
+		case 1: info.vcount = 4; break;
+		case 2: info.fcount = 2; break;
+		case 4: info.material = 1; break;
+		}
+
+		vector<bmbpayload_t> payloads;
+		makeTriangleModel(payloads, info, i == 3 ? 1 : 0);
+		if (i == 5 || i == 6) {
+			payloads.erase(payloads.begin() + (i == 5 ? 0 : 4));
+		}
+		ostringstream log;
+		const bool valid = writeBmb(TEST_FILE, 1, payloads) && checkBinfile(TEST_FILE, false, log);
+		if (valid != models[i].valid) {
+			cout << models[i].name << ": " << (valid ? "accepted" : "refused") << "\n" << log.str();
+			errors++;
+		}
+	}
+	cout << "models: " << sizeof(models) / sizeof(models[0]) << " checked, " << errors << " errors\n";
+	return errors;
+}
+
+bool testBmbReader(const testconfig_t& config) {
+	(void)config;
+	vector<unsigned char> good;
+	unsigned int errors = checkRoundTrip(good);
+	if (!good.empty()) {
+		errors += checkBroken(good);
+	}
+	errors += checkModels();
+	remove(TEST_FILE);
+	return errors == 0;
+}
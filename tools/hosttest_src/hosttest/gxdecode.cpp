@@ -0,0 +1,286 @@
+// gxdecode.cpp : Host test of the GX command decoder (src/gxstream.c)
+//
+// A synthetic capture, built the way the game's GX calls write commands, goes
+// through a file and the analyzer of tools/gxcap_src, which must find what it
+// was made of. The same stream is then decoded as the console does, from a
+// ring with the frame wrapping around its end like it can in the FIFO.
+
+#include "hosttest.h"
+#include "gxcap.h"
+extern "C" {
+#include "gxstream.h"
+}
+
+#include <iostream>
+#include <cstdio>
+using namespace std;
+
+// Where the capture goes through a file
+#define TEST_FILE "hosttest_gxstream.gxc"
+#define TEST_TOP 8
+
+// Commands as the game's GX calls write them
+static void put8(vector<unsigned char>& out, unsigned int value) {
+	out.push_back((unsigned char)value);
+}
+
+static void put16(vector<unsigned char>& out, unsigned int value) {
+	put8(out, value >> 8);
+	put8(out, value);
+}
+
+static void put32(vector<unsigned char>& out, unsigned int value) {
+	put16(out, value >> 16);
+	put16(out, value);
+}
+
+static void loadCp(vector<unsigned char>& out, unsigned int reg, unsigned int value) {
+	put8(out, GXS_OP_LOAD_CP);
+	put8(out, reg);
+	put32(out, value);
+}
+
+static void loadXf(vector<unsigned char>& out, unsigned int address, unsigned int count, unsigned int seed) {
+	put8(out, GXS_OP_LOAD_XF);
+	put32(out, (count - 1) << 16 | address);
+	for (unsigned int i = 0; i < count; i++) {
+		put32(out, seed + i);
+	}
+}
+
+static void loadBp(vector<unsigned char>& out, unsigned int reg, unsigned int value) {
+	put8(out, GXS_OP_LOAD_BP);
+	put32(out, reg << 24 | value);
+}
+
+static void draw(vector<unsigned char>& out, unsigned int primitive, unsigned int vertices, unsigned int vertexSize) {
+	put8(out, primitive);
+	put16(out, vertices);
+	for (unsigned int i = 0; i < vertices * vertexSize; i++) {
+		put8(out, i);
+	}
+}
+
+static void callList(vector<unsigned char>& out, unsigned int address, unsigned int size) {
+	put8(out, GXS_OP_CALL_DL);
+	put32(out, address);
+	put32(out, size);
+}
+
+static unsigned int checkStats(const string& name, const gxstats_t& actual, const gxstats_t& expected) {
+	unsigned int errors = 0;
+	#define CHECK_FIELD(field) \
+		if (actual.field != expected.field) { \
+			cout << name << " " #field ": " << actual.field << ", expected " << expected.field << "\n"; \
+			errors++; \
+		}
+	CHECK_FIELD(commands);
+	CHECK_FIELD(draws);
+	CHECK_FIELD(listDraws);
+	CHECK_FIELD(vertices);
+	CHECK_FIELD(vertexBytes);
+	CHECK_FIELD(listCalls);
+	CHECK_FIELD(lists.size());
+	CHECK_FIELD(listBytes);
+	CHECK_FIELD(posMatrices);
+	CHECK_FIELD(normalMatrices);
+	CHECK_FIELD(textureLoads);
+	CHECK_FIELD(vcdChanges);
+	CHECK_FIELD(vatChanges);
+	CHECK_FIELD(cpWrites);
+	CHECK_FIELD(xfWrites);
+	CHECK_FIELD(bpWrites);
+	CHECK_FIELD(cpRedundant);
+	CHECK_FIELD(xfRedundant);
+	CHECK_FIELD(bpRedundant);
+	CHECK_FIELD(nops);
+	CHECK_FIELD(nopBytes);
+	#undef CHECK_FIELD
+	return errors;
+}
+
+// Decode a stream from a plain buffer and from a ring it wraps around in,
+// every command must come out the same, returns the number of problems
+static unsigned int checkRing(const vector<unsigned char>& stream) {
+	unsigned int errors = 0;
+	const unsigned int length = (unsigned int)stream.size();
+	for (unsigned int start = length / 2; start < length; start += length / 7 + 1) {
+		// Starts past the middle of a ring a bit bigger than the stream, so it wraps
+		const unsigned int ringSize = length + 16;
+		vector<unsigned char> ringBytes(ringSize, 0xFF);
+		for (unsigned int i = 0; i < length; i++) {
+			ringBytes[(start + i) % ringSize] = stream[i];
+		}
+		gxbytes_t plain, wrapped = { &ringBytes[0], ringSize, start, length };
+		GXS_bytes(&plain, &stream[0], length);
+
+		gxvtxstate_t plainState, wrappedState;
+		GXS_reset(&plainState);
+		GXS_reset(&wrappedState);
+		unsigned int plainOffset = 0, wrappedOffset = 0, commands = 0;
+		int plainResult, wrappedResult;
+		do {
+			gxcommand_t plainCommand, wrappedCommand;
+			plainResult = GXS_next(&plainState, &plain, &plainOffset, &plainCommand);
+			wrappedResult = GXS_next(&wrappedState, &wrapped, &wrappedOffset, &wrappedCommand);
+			if (plainResult != wrappedResult || plainOffset != wrappedOffset) {
+				errors++;
+				break;
+			}
+			if (plainResult == GXS_OK) {
+				commands++;
+				errors += plainCommand.type != wrappedCommand.type || plainCommand.size != wrappedCommand.size ||
+					plainCommand.address != wrappedCommand.address || plainCommand.value != wrappedCommand.value ||
+					plainCommand.count != wrappedCommand.count || plainCommand.vertexSize != wrappedCommand.vertexSize;
+			}
+		} while (plainResult == GXS_OK);
+		errors += plainResult != GXS_END;
+		cout << "ring of " << ringSize << " bytes from " << start << ": " << commands << " commands\n";
+	}
+	return errors;
+}
+
+bool testGxStream(const testconfig_t& config) {
+	(void)config;
+	// Position XYZ f32, color RGBA8 and texture ST f32: 24 bytes a vertex, 14 with an indexed position
+	const unsigned int vcdDirect = 1 << 9 | 1 << 13, vcdIndexed = 3 << 9 | 1 << 13;
+	const unsigned int vat = 1 | 4 << 1 | 5 << 14 | 1 << 21 | 4 << 22;
+	const unsigned int listAddress = 0x00800000;
+
+	// Called twice, sets the same things the second time
+	vector<unsigned char> list;
+	loadCp(list, GXS_CP_VCD_LO, vcdIndexed);
+	loadBp(list, 0x28, 0x000123);
+	draw(list, 0x98, 6, 14);
+
+	capture_t capture = capture_t();
+	capture.header.magic = CAPTURE_MAGIC;
+	capture.header.version = CAPTURE_VERSION;
+	capture.header.frame = 7;
+	capture.header.viewCount = 2;
+	vector<unsigned char>& stream = capture.stream;
+
+	// View 1: vertex format, matrices, a texture set twice, two draws and padding
+	loadCp(stream, GXS_CP_VCD_LO, vcdDirect);
+	loadCp(stream, GXS_CP_VCD_HI, 1);
+	loadCp(stream, GXS_CP_VAT_A, vat);
+	loadCp(stream, GXS_CP_VAT_B, 0);
+	loadCp(stream, GXS_CP_VAT_C, 0);
+	loadXf(stream, 0x000, 12, 100);
+	loadXf(stream, 0x400, 9, 200);
+	loadBp(stream, 0x94, 0x001000);
+	draw(stream, 0x90, 3, 24);
+	loadBp(stream, 0x94, 0x001000);
+	draw(stream, 0x80, 4, 24);
+	for (int i = 0; i < 5; i++) {
+		put8(stream, GXS_OP_NOP);
+	}
+	capture.header.viewEnds[0] = (unsigned int)stream.size();
+
+	// View 2: the descriptor and a matrix again, a new matrix and one list called twice
+	loadCp(stream, GXS_CP_VCD_LO, vcdDirect);
+	loadXf(stream, 0x000, 12, 100);
+	loadXf(stream, 0x00C, 12, 300);
+	callList(stream, listAddress, (unsigned int)list.size());
+	callList(stream, listAddress, (unsigned int)list.size());
+	capture.header.viewEnds[1] = (unsigned int)stream.size();
+
+	// Rest: a masked write that changes nothing, one that does, and tokens (always written)
+	loadBp(stream, 0xFE, 0x0000FF);
+	loadBp(stream, 0x28, 0xAB0123);
+	loadBp(stream, 0x28, 0x000124);
+	loadBp(stream, 0x48, 0x00004D);
+	loadBp(stream, 0x48, 0x00004D);
+	capture.lists[listkey_t(listAddress, (unsigned int)list.size())] = list;
+
+	const unsigned int listSize = (unsigned int)list.size();
+	gxstats_t expected[3] = { gxstats_t(), gxstats_t(), gxstats_t() };
+	gxstats_t& view1 = expected[0];
+	view1.commands = 16;
+	view1.draws = 2;
+	view1.vertices = 7;
+	view1.vertexBytes = 7 * 24;
+	view1.posMatrices = 1;
+	view1.normalMatrices = 1;
+	view1.textureLoads = 2;
+	view1.vcdChanges = 2;
+	view1.vatChanges = 3;
+	view1.cpWrites = 5;
+	view1.xfWrites = 2;
+	view1.bpWrites = 2;
+	view1.bpRedundant = 1;
+	view1.nops = 5;
+	view1.nopBytes = 5;
+	gxstats_t& view2 = expected[1];
+	view2.commands = 11;
+	view2.draws = 2;
+	view2.listDraws = 2;
+	view2.vertices = 12;
+	view2.vertexBytes = 12 * 14;
+	view2.listCalls = 2;
+	view2.lists.insert(listkey_t(listAddress, listSize));
+	view2.listBytes = 2 * listSize;
+	view2.posMatrices = 2;
+	view2.vcdChanges = 1;
+	view2.cpWrites = 3;
+	view2.cpRedundant = 2;
+	view2.xfWrites = 2;
+	view2.xfRedundant = 1;
+	view2.bpWrites = 2;
+	view2.bpRedundant = 1;
+	gxstats_t& rest = expected[2];
+	rest.commands = 5;
+	rest.bpWrites = 5;
+	rest.bpRedundant = 1;
+
+	// Through a file and back
+	unsigned int errors = 0;
+	capture_t loaded;
+	if (!writeCapture(TEST_FILE, capture) || !readCapture(TEST_FILE, loaded)) {
+		return false;
+	}
+	remove(TEST_FILE);
+	errors += loaded.stream != capture.stream || loaded.lists != capture.lists;
+	errors += loaded.header.frame != capture.header.frame || loaded.header.viewCount != capture.header.viewCount;
+	errors += loaded.header.viewEnds[0] != capture.header.viewEnds[0] || loaded.header.viewEnds[1] != capture.header.viewEnds[1];
+
+	gxreport_t report;
+	analyzeCapture(loaded, report, false);
+	printReport(loaded, report, TEST_TOP);
+	errors += report.result != GXS_END;
+	errors += report.parts.size() != 3;
+	const char* names[3] = { "view 1", "view 2", "rest" };
+	for (size_t i = 0; i < report.parts.size() && i < 3; i++) {
+		errors += checkStats(names[i], report.parts[i], expected[i]);
+	}
+	errors += report.total.commands != 32 || report.total.draws != 4 || report.total.lists.size() != 1;
+	errors += report.redundant["CP 0x50"] != 2 || report.redundant["XF 0x0000"] != 1 || report.redundant["BP 0x94"] != 1 || report.redundant["BP 0x28"] != 2;
+	errors += report.redundant.size() != 4;
+
+	// The frame wrapping around the FIFO decodes the same
+	errors += checkRing(capture.stream);
+
+	// A draw before any vertex format, and a byte that isn't an opcode
+	vector<unsigned char> bad;
+	draw(bad, 0x90, 3, 24);
+	put8(bad, 0x01);
+	gxbytes_t badBytes;
+	GXS_bytes(&badBytes, &bad[0], (unsigned int)bad.size());
+	gxvtxstate_t badState;
+	GXS_reset(&badState);
+	gxcommand_t badCommand;
+	unsigned int badOffset = 0;
+	errors += GXS_next(&badState, &badBytes, &badOffset, &badCommand) != GXS_NO_FORMAT;
+	badOffset = (unsigned int)bad.size() - 1;
+	errors += GXS_next(&badState, &badBytes, &badOffset, &badCommand) != GXS_UNKNOWN;
+
+	// A stream cut in the middle of a command stops the decoding there
+	capture_t cut = loaded;
+	cut.stream.resize(cut.stream.size() - 2);
+	gxreport_t cutReport;
+	analyzeCapture(cut, cutReport, false);
+	errors += cutReport.result != GXS_TRUNCATED || cutReport.errorOffset != cut.stream.size() - 3;
+
+	cout << "\n" << errors << " errors" << (errors == 0 ? "  ok" : "  FAILED") << "\n";
+	return errors == 0;
+}
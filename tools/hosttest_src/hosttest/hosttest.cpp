@@ -0,0 +1,108 @@
+// hosttest.cpp : Host tests of the game code that doesn't need the console
+//
+// Runs every suite, or the ones named on the command line, and fails if any of
+// them does. The suites use the game's own headers and sources.
+
+#include "hosttest.h"
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+#include <iostream>
+using namespace std;
+
+typedef struct {
+	const char*	name;
+	const char*	description;
+	bool		(*run)(const testconfig_t& config);
+} testsuite_t;
+
+static const testsuite_t suites[] = {
+	{ "queue",	"loader queue (include/spsc.h) between two threads",	testQueue },
+	{ "stream",	"tile streamer (src/tilestream.c) on synthetic worlds",	testStream },
+	{ "hud",	"performance overlay (src/perfhud.c) with a stand-in counter source",	testHud },
+	{ "gxstream",	"GX command decoder (src/gxstream.c) on a synthetic capture",	testGxStream },
+	{ "bmb",	"model pipeline (tools/obj2bin_src) through .bmb files and back",	testBmb },
+	{ "bmbreader",	"shared .bmb reader on good, broken and inconsistent files",	testBmbReader },
+	{ "objreader",	"obj2bin's OBJ reader on files with known meshes",	testObjReader },
+#ifndef _MSC_VER
+	// The game's C sources use pthreads and GCC builtins on the host, the Makefile builds them
+	{ "memtrack",	"heap tracker (src/memtrack.c) and its report",	testMemtrack },
+	{ "profiler",	"timing markers (src/profiler.c) written as a Chrome trace",	testProfiler }
+#endif
+};
+static const unsigned int suiteCount = sizeof(suites) / sizeof(suites[0]);
+
+int main(int argc, char* argv[]) {
+	vector<string> names;
+	testconfig_t config;
+	config.items = 200000;
+	config.frames = 3000;
+
+	try {
+		po::options_description desc("Valid arguments");
+		desc.add_options()
+			("help", "produce help message")
+			("suites", po::value<vector<string> >(&names), "suites to run, all of them if none is given")
+			("list", "list the suites")
+			("items", po::value<unsigned int>(&config.items), "items pushed through the queue (default 200000)")
+			("frames", po::value<unsigned int>(&config.frames), "frames each simulation runs (default 3000)")
+			("trace", po::value<string>(&config.trace), "keep the profiler suite's trace in this file")
+			;
+		po::positional_options_description positional;
+		positional.add("suites", -1);
+
+		po::variables_map vm;
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+		po::notify(vm);
+
+		// Help
+		if (vm.count("help")) {
+			cout << desc << "\n";
+			return 0;
+		}
+
+		if (vm.count("list")) {
+			for (unsigned int i = 0; i < suiteCount; i++) {
+				cout << suites[i].name << ": " << suites[i].description << "\n";
+			}
+			return 0;
+		}
+
+		for (size_t i = 0; i < names.size(); i++) {
+			unsigned int s;
+			for (s = 0; s < suiteCount && names[i] != suites[s].name; s++);
+			if (s == suiteCount) {
+				cout << "ERROR:\n  Unknown suite " << names[i] << ".\n";
+				return 1;
+			}
+		}
+
+		unsigned int run = 0, failed = 0;
+		for (unsigned int i = 0; i < suiteCount; i++) {
+			bool selected = names.empty();
+			for (size_t n = 0; n < names.size(); n++) {
+				selected |= names[n] == suites[i].name;
+			}
+			if (!selected) {
+				continue;
+			}
+
+			cout << "== " << suites[i].name << ": " << suites[i].description << "\n";
+			const bool passed = suites[i].run(config);
+			cout << "== " << suites[i].name << (passed ? " ok" : " FAILED") << "\n\n";
+			run++;
+			failed += !passed;
+		}
+		cout << run << " suites, " << failed << " failed\n";
+		return failed == 0 ? 0 : 1;
+	}
+	catch (exception& e) {
+		cerr << "error: " << e.what() << "\n";
+		return 1;
+	}
+	catch (...) {
+		cerr << "Exception of unknown type!\n";
+		return 1;
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef _HOSTTEST_H
+#define _HOSTTEST_H
+
+#include <vector>
+#include <string>
+
+// Sizes the suites run with, from the command line
+typedef struct {
+	unsigned int	items;		// Items pushed through the queue
+	unsigned int	frames;		// Frames the streamer runs on each synthetic world
+	std::string		trace;		// Where the profiler's trace is kept, none if empty
+} testconfig_t;
+
+// Suites, each prints what it checked and returns false if anything failed
+
+// Loader queue (include/spsc.h) between two threads
+bool testQueue(const testconfig_t& config);
+
+// Tile streamer (src/tilestream.c) over synthetic worlds, its bookkeeping
+// and memory budget are checked every frame
+bool testStream(const testconfig_t& config);
+
+// Performance overlay (src/perfhud.c) fed by a stand-in counter source, its
+// numbers, its text and what it costs per frame are checked
+bool testHud(const testconfig_t& config);
+
+// GX command decoder (src/gxstream.c) on a synthetic capture, through a
+// file and the analyzer (tools/gxcap_src), and from a wrapping ring
+bool testGxStream(const testconfig_t& config);
+
+// Model pipeline (tools/obj2bin_src) on a synthetic scene, written as .bmb with
+// each set of options and decoded back to the source triangles
+bool testBmb(const testconfig_t& config);
+
+// Shared .bmb reader (tools/obj2bin_src) on containers written for it, broken
+// ones it must refuse, and models checkBinfile must refuse
+bool testBmbReader(const testconfig_t& config);
+
+// obj2bin's OBJ reader (--fast-obj) on files with known meshes, floats it must
+// read like strtof and faces it must refuse
+bool testObjReader(const testconfig_t& config);
+
+// Heap tracker (src/memtrack.c) built for the host, its counts per tag and per
+// frame from several threads, and the report the game draws and prints
+bool testMemtrack(const testconfig_t& config);
+
+// Timing markers (src/profiler.c) built for the host with PROFILE, frames and
+// loads from two threads written as a Chrome trace and read back
+bool testProfiler(const testconfig_t& config);
+
+#endif
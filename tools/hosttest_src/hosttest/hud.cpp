@@ -0,0 +1,247 @@
+// hud.cpp : Headless test of the game's performance overlay (src/perfhud.c)
+//
+// A stand-in for the GX counter source makes up per-view triangle and vertex
+// counts, and frames come with made up phase times and sprite counts while
+// players join and leave. The HUD's min, average and max are checked against the values it was
+// fed, its text against what the game font can draw, what fits on screen and
+// the numbers it stands for, and its own bookkeeping is timed.
+
+#include "hosttest.h"
+extern "C" {
+#include "perfhud.h"
+}
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <cmath>
+using namespace std;
+
+// What the overlay can use: the game font's characters, drawn at (8, 60) in 12x22 glyphs on 640x480
+#define TEST_FONT_CHARS		" !,.0123456789:<>?ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz\n"
+#define TEST_COLUMNS		52
+#define TEST_ROWS			19
+#define TEST_PLAYER_FRAMES	300		// Frames between players joining or leaving
+#define TEST_MAX_MICROS		20.0	// Average HUD cost per frame (host time)
+
+typedef struct {
+	unsigned int	frame;
+	unsigned int	views;		// Views marked this frame
+	unsigned int	errors;
+} standin_t;
+
+static unsigned int hashFrame(unsigned int frame, unsigned int salt) {
+	unsigned int h = frame * 2654435761u ^ salt * 40503u;
+	h ^= h >> 15;
+	h *= 0x2c1b3c6du;
+	h ^= h >> 12;
+	return h;
+}
+
+static unsigned int standinCounter(unsigned int frame, unsigned int view, unsigned int counter) {
+	const unsigned int base = counter == 0 ? 20000 : 45000;
+	return base + view * 1000 + hashFrame(frame, view * 2 + counter) % 5000;
+}
+
+static void standinBegin(void* user) {
+	standin_t* standin = (standin_t*)user;
+	standin->views = 0;
+}
+
+static void standinEndView(void* user, unsigned int view) {
+	standin_t* standin = (standin_t*)user;
+	if (view != standin->views) {
+		standin->errors++;
+	}
+	standin->views++;
+}
+
+static void standinCollect(void* user, hudreadings_t* readings) {
+	standin_t* standin = (standin_t*)user;
+	readings->views = standin->views;
+	for (unsigned int view = 0; view < standin->views; view++) {
+		for (unsigned int counter = 0; counter < HUD_VIEW_COUNTERS; counter++) {
+			readings->counters[view][counter] = standinCounter(standin->frame, view, counter);
+		}
+	}
+	readings->fifoBytes = 24 * 1024 + hashFrame(standin->frame, 99) % 8192;
+}
+
+// Compare a series with the last values pushed into it
+static unsigned int checkRange(const hudseries_t& series, const deque<unsigned int>& values) {
+	unsigned int low, avg, high;
+	HUD_range(&series, &low, &avg, &high);
+	if (values.empty()) {
+		return low != 0 || avg != 0 || high != 0;
+	}
+	unsigned int expectLow = ~0u, expectHigh = 0;
+	unsigned long long sum = 0;
+	for (size_t i = 0; i < values.size(); i++) {
+		expectLow = min(expectLow, values[i]);
+		expectHigh = max(expectHigh, values[i]);
+		sum += values[i];
+	}
+	const unsigned int expectAvg = (unsigned int)((sum + values.size() / 2) / values.size());
+	return low != expectLow || avg != expectAvg || high != expectHigh;
+}
+
+static void remember(deque<unsigned int>& values, unsigned int value) {
+	values.push_back(value);
+	if (values.size() > HUD_WINDOW) {
+		values.pop_front();
+	}
+}
+
+// Check the text can be drawn and fits, returns the number of problems
+static unsigned int checkText(const char* text, unsigned int views) {
+	unsigned int errors = 0, rows = 0, column = 0;
+	const string allowed = TEST_FONT_CHARS;
+	for (const char* c = text; *c != '\0'; c++) {
+		if (allowed.find(*c) == string::npos) {
+			errors++;
+		}
+		if (*c == '\n') {
+			rows++;
+			column = 0;
+		} else if (++column > TEST_COLUMNS) {
+			errors++;
+		}
+	}
+	// Title, frame, phases, fifo, frame counts and the counters of each view
+	const unsigned int expected = 3 + HUD_PHASE_COUNT + HUD_COUNT_COUNT + views * HUD_VIEW_COUNTERS;
+	return errors + (rows != expected) + (rows > TEST_ROWS);
+}
+
+// Check the millisecond rows read back as the numbers they were written from,
+// to the hundredth, returns the number of problems
+static unsigned int checkMillis(const perfhud_t& hud) {
+	unsigned int errors = 0;
+	istringstream text(hud.text);
+	string line;
+	getline(text, line);
+	for (unsigned int i = 0; i <= HUD_PHASE_COUNT; i++) {
+		if (!getline(text, line) || line.size() < 16 || line.compare(13, 2, "ms") != 0) {
+			return errors + 1;
+		}
+		unsigned int values[3];
+		HUD_range(i == 0 ? &hud.frame : &hud.phases[i - 1], &values[0], &values[1], &values[2]);
+		istringstream numbers(line.substr(15));
+		for (unsigned int j = 0; j < 3; j++) {
+			double shown;
+			if (!(numbers >> shown) || fabs(shown - values[j] / 1000.0) > 0.0051) {
+				errors++;
+			}
+		}
+	}
+	return errors;
+}
+
+bool testHud(const testconfig_t& config) {
+	const unsigned int frames = config.frames;
+	standin_t standin = { 0, 0, 0 };
+	const hudsource_t source = { "host", { "tris", "verts" }, standinBegin, standinEndView, standinCollect, &standin };
+	static perfhud_t hud;
+	HUD_init(&hud, &source);
+
+	cout << "window " << HUD_WINDOW << " frames, text every " << HUD_REFRESH << " frames, HUD state " << sizeof(perfhud_t) << " bytes\n";
+
+	deque<unsigned int> frameValues, phaseValues[HUD_PHASE_COUNT], countValues[HUD_COUNT_COUNT];
+	deque<unsigned int> counterValues[HUD_MAX_VIEWS][HUD_VIEW_COUNTERS];
+	unsigned int errors = 0, refreshes = 0, lastViews = 0;
+	double total = 0, worst = 0;
+	string sample;
+	for (standin.frame = 1; standin.frame <= frames; standin.frame++) {
+		// One to four players, changing every so often
+		const unsigned int views = 1 + (standin.frame / TEST_PLAYER_FRAMES) % HUD_MAX_VIEWS;
+		unsigned int phases[HUD_PHASE_COUNT], busy = 0;
+		for (unsigned int i = 0; i < HUD_PHASE_COUNT; i++) {
+			phases[i] = 100 + hashFrame(standin.frame, 10 + i) % (i == HUD_PHASE_RENDER ? 4000 * views : 1500);
+			busy += phases[i];
+		}
+		const unsigned int frameMicros = busy < 16683 ? 16683 : 33367;
+		// Each view draws a few sprite batches
+		const unsigned int batches = views * (1 + hashFrame(standin.frame, 20) % 4);
+		const unsigned int sprites = batches * 3 + hashFrame(standin.frame, 21) % 50;
+		if (views != lastViews) {
+			for (unsigned int i = 0; i < HUD_MAX_VIEWS; i++) {
+				for (unsigned int j = 0; j < HUD_VIEW_COUNTERS; j++) {
+					counterValues[i][j].clear();
+				}
+			}
+			lastViews = views;
+		}
+
+		// What the game does in a frame, the render phase is split per view like GAME_render does
+		const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		HUD_begin(&hud);
+		for (unsigned int i = 0; i < HUD_PHASE_COUNT; i++) {
+			if (i != HUD_PHASE_RENDER) {
+				HUD_phase(&hud, i, phases[i]);
+			}
+		}
+		for (unsigned int view = 0; view < views; view++) {
+			HUD_phase(&hud, HUD_PHASE_RENDER, phases[HUD_PHASE_RENDER] / views + (view == 0 ? phases[HUD_PHASE_RENDER] % views : 0));
+			HUD_endView(&hud, view);
+		}
+		// Added up as they're drawn, like SPRITE_frame's totals would be
+		HUD_count(&hud, HUD_COUNT_SPRITES, sprites / 2);
+		HUD_count(&hud, HUD_COUNT_SPRITES, sprites - sprites / 2);
+		HUD_count(&hud, HUD_COUNT_BATCHES, batches);
+		const int refreshed = HUD_end(&hud, frameMicros);
+		const double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+		total += micros;
+		worst = max(worst, micros);
+
+		remember(frameValues, frameMicros);
+		for (unsigned int i = 0; i < HUD_PHASE_COUNT; i++) {
+			remember(phaseValues[i], phases[i]);
+		}
+		remember(countValues[HUD_COUNT_SPRITES], sprites);
+		remember(countValues[HUD_COUNT_BATCHES], batches);
+		for (unsigned int view = 0; view < views; view++) {
+			for (unsigned int counter = 0; counter < HUD_VIEW_COUNTERS; counter++) {
+				remember(counterValues[view][counter], standinCounter(standin.frame, view, counter));
+			}
+		}
+
+		// Every number against what it was fed
+		errors += hud.views != views;
+		errors += checkRange(hud.frame, frameValues);
+		for (unsigned int i = 0; i < HUD_PHASE_COUNT; i++) {
+			errors += checkRange(hud.phases[i], phaseValues[i]);
+		}
+		for (unsigned int i = 0; i < HUD_COUNT_COUNT; i++) {
+			errors += checkRange(hud.counts[i], countValues[i]);
+		}
+		for (unsigned int view = 0; view < HUD_MAX_VIEWS; view++) {
+			for (unsigned int counter = 0; counter < HUD_VIEW_COUNTERS; counter++) {
+				errors += checkRange(hud.counters[view][counter], counterValues[view][counter]);
+			}
+		}
+
+		if (refreshed) {
+			refreshes++;
+			errors += (standin.frame % HUD_REFRESH) != 0;
+			errors += checkText(hud.text, views);
+			errors += checkMillis(hud);
+			if (views == HUD_MAX_VIEWS) {
+				sample = hud.text;
+			}
+		} else {
+			errors += (standin.frame % HUD_REFRESH) == 0;
+		}
+	}
+	errors += standin.errors;
+
+	if (!sample.empty()) {
+		cout << sample;
+	}
+	const double average = frames > 0 ? total / frames : 0;
+	const bool passed = errors == 0 && average <= TEST_MAX_MICROS;
+	cout << frames << " frames, " << refreshes << " text updates, " << fixed << setprecision(2)
+		<< average << " us per frame (worst " << worst << " us), " << errors << " errors" << (passed ? "  ok" : "  FAILED") << "\n";
+	return passed;
+}
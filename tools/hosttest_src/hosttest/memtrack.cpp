@@ -0,0 +1,219 @@
+// memtrack.cpp : Host build of the game's heap tracker (src/memtrack.c)
+//
+// The tracker is compiled from the game's source, its wrappers are checked for
+// what they hand out and what they count per tag, from several threads too,
+// and per-frame allocation counts are checked over made up frames. Its report
+// is checked against the numbers and the game font, then printed the way the
+// game prints it when it quits.
+
+#include "hosttest.h"
+extern "C" {
+#include "memtrack.h"
+}
+
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <thread>
+using namespace std;
+
+// What the report can use: the game font's characters
+#define TEST_FONT_CHARS		" !,.0123456789:<>?ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz\n"
+#define TEST_THREADS		4
+#define TEST_THREAD_ALLOCS	20000
+
+static bool sameStats(unsigned int tag, unsigned int current, unsigned int peak, unsigned int blocks) {
+	memtagstats_t stats;
+	MEMTRACK_stats(tag, &stats);
+	return stats.current == current && stats.peak == peak && stats.blocks == blocks;
+}
+
+// Blocks come back aligned, zeroed and copied, each tag counts its own
+static unsigned int checkWrappers() {
+	unsigned int errors = 0;
+	void* plain = MEMTRACK_alloc(MEMTAG_OBJECT, 100);
+	void* aligned = MEMTRACK_memalign(MEMTAG_DISPLAYLIST, 32, 1000);
+	void* wide = MEMTRACK_memalign(MEMTAG_GX, 256, 4096);
+	unsigned char* zeroed = (unsigned char*) MEMTRACK_calloc(MEMTAG_SCRATCH, 50, 4);
+	char* text = MEMTRACK_strdup(MEMTAG_FONT, "Press A to join");
+
+	errors += plain == NULL || ((uintptr_t) plain & 7) != 0;
+	errors += aligned == NULL || ((uintptr_t) aligned & 31) != 0;
+	errors += wide == NULL || ((uintptr_t) wide & 255) != 0;
+	errors += zeroed == NULL || text == NULL || strcmp(text, "Press A to join") != 0;
+	for (unsigned int i = 0; zeroed != NULL && i < 200; i++) {
+		errors += zeroed[i] != 0;
+	}
+	// Blocks are written up to their end
+	memset(plain, 0xAA, 100);
+	memset(aligned, 0xAA, 1000);
+	memset(wide, 0xAA, 4096);
+
+	errors += !sameStats(MEMTAG_OBJECT, 100, 100, 1) + !sameStats(MEMTAG_DISPLAYLIST, 1000, 1000, 1);
+	errors += !sameStats(MEMTAG_GX, 4096, 4096, 1) + !sameStats(MEMTAG_SCRATCH, 200, 200, 1);
+	errors += !sameStats(MEMTAG_FONT, 16, 16, 1);
+
+	// Retagging moves the block, the peak of where it went follows
+	MEMTRACK_retag(aligned, MEMTAG_MODEL);
+	errors += !sameStats(MEMTAG_DISPLAYLIST, 0, 1000, 0) + !sameStats(MEMTAG_MODEL, 1000, 1000, 1);
+
+	// Memory from elsewhere, eg. the framebuffers
+	MEMTRACK_add(MEMTAG_VIDEO, 614400);
+	MEMTRACK_add(MEMTAG_VIDEO, 614400);
+	errors += !sameStats(MEMTAG_VIDEO, 1228800, 1228800, 2);
+	MEMTRACK_add(MEMTAG_VIDEO, -614400);
+	errors += !sameStats(MEMTAG_VIDEO, 614400, 1228800, 1);
+	MEMTRACK_add(MEMTAG_VIDEO, -614400);
+
+	MEMTRACK_free(plain);
+	MEMTRACK_free(aligned);
+	MEMTRACK_free(wide);
+	MEMTRACK_free(zeroed);
+	MEMTRACK_free(text);
+	MEMTRACK_free(NULL);
+	errors += !sameStats(MEMTAG_OBJECT, 0, 100, 0) + !sameStats(MEMTAG_MODEL, 0, 1000, 0);
+	errors += !sameStats(MEMTAG_GX, 0, 4096, 0) + !sameStats(MEMTAG_SCRATCH, 0, 200, 0);
+	errors += !sameStats(MEMTAG_FONT, 0, 16, 0) + !sameStats(MEMTAG_VIDEO, 0, 1228800, 0);
+
+	// A block that didn't come from the wrappers is refused, its tag is left alone
+	vector<unsigned int> foreign(8, 0);
+	cout << "freeing and retagging a block from elsewhere, the tracker refuses both:\n";
+	MEMTRACK_free(&foreign[4]);
+	MEMTRACK_retag(&foreign[4], MEMTAG_LEVEL);
+	errors += !sameStats(MEMTAG_LEVEL, 0, 0, 0);
+	cout << "wrappers: " << errors << " errors\n";
+	return errors;
+}
+
+// Allocations are counted per frame, the worst frame is kept
+static unsigned int checkFrames() {
+	static const unsigned int perFrame[] = { 3, 0, 12, 5, 0 };
+	const unsigned int frames = sizeof(perFrame) / sizeof(perFrame[0]);
+	unsigned int errors = 0, worst = 0;
+	MEMTRACK_frame();
+	for (unsigned int f = 0; f < frames; f++) {
+		for (unsigned int i = 0; i < perFrame[f]; i++) {
+			MEMTRACK_free(MEMTRACK_alloc(MEMTAG_LEVEL, 64));
+		}
+		// Frees and retags aren't allocations
+		void* kept = MEMTRACK_alloc(MEMTAG_ASSETS, 32);
+		MEMTRACK_retag(kept, MEMTAG_TEXTURE);
+		MEMTRACK_free(kept);
+		MEMTRACK_frame();
+
+		if (perFrame[f] > worst) worst = perFrame[f];
+		memtagstats_t level, assets, texture;
+		MEMTRACK_stats(MEMTAG_LEVEL, &level);
+		MEMTRACK_stats(MEMTAG_ASSETS, &assets);
+		MEMTRACK_stats(MEMTAG_TEXTURE, &texture);
+		errors += level.lastFrame != perFrame[f] || level.worstFrame != worst;
+		errors += assets.lastFrame != 1 || texture.lastFrame != 0;
+		errors += level.current != 0 || level.blocks != 0;
+	}
+	cout << "frames: " << frames << " frames, " << errors << " errors\n";
+	return errors;
+}
+
+// Game and loader threads allocate at once, the counters must end where they started
+static unsigned int checkThreads() {
+	memtagstats_t before;
+	MEMTRACK_stats(MEMTAG_MODEL, &before);
+	vector<thread> threads;
+	vector<unsigned int> failed(TEST_THREADS, 0);
+	for (unsigned int t = 0; t < TEST_THREADS; t++) {
+		threads.push_back(thread([t, &failed]() {
+			vector<void*> blocks;
+			for (unsigned int i = 0; i < TEST_THREAD_ALLOCS; i++) {
+				void* block = MEMTRACK_alloc(t & 1 ? MEMTAG_MODEL : MEMTAG_ASSETS, 16 + (i * 7 + t) % 200);
+				failed[t] += block == NULL;
+				if (block != NULL) blocks.push_back(block);
+				if (blocks.size() > 64) {
+					MEMTRACK_retag(blocks.front(), MEMTAG_MODEL);
+					MEMTRACK_free(blocks.front());
+					blocks.erase(blocks.begin());
+				}
+			}
+			for (size_t i = 0; i < blocks.size(); i++) {
+				MEMTRACK_free(blocks[i]);
+			}
+		}));
+	}
+	unsigned int errors = 0;
+	for (unsigned int t = 0; t < TEST_THREADS; t++) {
+		threads[t].join();
+		errors += failed[t];
+	}
+	memtagstats_t model, assets;
+	MEMTRACK_stats(MEMTAG_MODEL, &model);
+	MEMTRACK_stats(MEMTAG_ASSETS, &assets);
+	errors += model.current != before.current || model.blocks != before.blocks;
+	errors += assets.current != 0 || assets.blocks != 0;
+	cout << "threads: " << TEST_THREADS << " x " << TEST_THREAD_ALLOCS << " allocations, " << errors << " errors\n";
+	return errors;
+}
+
+// The report has a line per tag with their numbers, and never ends on a cut line
+static unsigned int checkReport(unsigned int* lines) {
+	unsigned int errors = 0;
+	char report[1024];
+	const unsigned int length = MEMTRACK_format(report, sizeof(report));
+	errors += length != strlen(report) || strspn(report, TEST_FONT_CHARS) != length;
+
+	string text(report);
+	*lines = 0;
+	for (size_t start = 0, end; (end = text.find('\n', start)) != string::npos; start = end + 1) {
+		const string line = text.substr(start, end - start);
+		if (*lines > 0 && *lines <= MEMTAG_COUNT) {
+			memtagstats_t stats;
+			MEMTRACK_stats(*lines - 1, &stats);
+			char expected[64];
+			snprintf(expected, sizeof(expected), "%-14s %6u %6u %6u %5u %5u", stats.name, (stats.current + 512) / 1024,
+					 (stats.peak + 512) / 1024, stats.blocks, stats.lastFrame, stats.worstFrame);
+			errors += line != expected;
+		}
+		(*lines)++;
+	}
+	errors += *lines != MEMTAG_COUNT + 2 || text.compare(text.size() - 1, 1, "\n") != 0;
+
+	// Shorter buffers keep whole lines only
+	for (unsigned int size = 0; size < length + 2; size += 7) {
+		vector<char> small(size + 1, '#');
+		const unsigned int cut = MEMTRACK_format(small.data(), size);
+		errors += small[size] != '#';
+		if (size == 0) continue;
+		errors += cut >= size || strlen(small.data()) != cut || text.compare(0, cut, small.data()) != 0;
+		errors += cut > 0 && small[cut - 1] != '\n';
+	}
+	return errors;
+}
+
+bool testMemtrack(const testconfig_t& config) {
+	(void)config;
+	unsigned int errors = checkWrappers();
+	errors += checkFrames();
+	errors += checkThreads();
+
+	// What the game holds in game, roughly, for the report
+	vector<void*> blocks;
+	MEMTRACK_add(MEMTAG_VIDEO, 2 * 640 * 480 * 2);
+	blocks.push_back(MEMTRACK_memalign(MEMTAG_GX, 32, 256 * 1024));
+	blocks.push_back(MEMTRACK_memalign(MEMTAG_TEXTURE, 32, 700 * 1024));
+	blocks.push_back(MEMTRACK_memalign(MEMTAG_MODEL, 32, 1200 * 1024));
+	blocks.push_back(MEMTRACK_memalign(MEMTAG_FONT, 32, 24 * 1024));
+	blocks.push_back(MEMTRACK_memalign(MEMTAG_DISPLAYLIST, 32, 48 * 1024));
+	blocks.push_back(MEMTRACK_alloc(MEMTAG_AUDIO, 900 * 1024));
+	MEMTRACK_frame();
+	unsigned int lines;
+	const unsigned int reportErrors = checkReport(&lines);
+	cout << "report: " << lines << " lines, " << reportErrors << " errors\n";
+	errors += reportErrors;
+	MEMTRACK_print();
+
+	for (size_t i = 0; i < blocks.size(); i++) {
+		MEMTRACK_free(blocks[i]);
+	}
+	MEMTRACK_add(MEMTAG_VIDEO, -2 * 640 * 480 * 2);
+	return errors == 0;
+}
@@ -0,0 +1,258 @@
+// objreader.cpp : Host test of obj2bin's OBJ reader (tools/obj2bin_src/obj2bin/objparse.cpp)
+//
+// Small files are read and checked against meshes built by hand following
+// parseObj's rules: one mesh per object/group and material, vertices
+// numbered by first use, polygons split as fans, DefaultMaterial before any
+// usemtl. Floats are checked against strtof, bad faces must be refused, and
+// the reader is timed on a synthetic grid.
+
+#include "hosttest.h"
+#include "obj2bin.h"
+
+#include <iostream>
+#include <iomanip>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <chrono>
+using namespace std;
+
+// Where the test files go, the library is found next to the model
+#define TEST_FILE		"hosttest_obj.obj"
+#define TEST_LIBRARY	"hosttest_obj.mtl"
+#define TEST_FLOATS		20000
+#define TEST_BENCH_FACES 200000
+
+static bool writeText(const char* file, const string& text) {
+	FILE* out = fopen(file, "wb");
+	if (out == NULL) {
+		return false;
+	}
+	const bool written = fwrite(text.data(), 1, text.size(), out) == text.size();
+	fclose(out);
+	return written;
+}
+
+// A mesh built by hand: positions/texcoords/normals as 1 based OBJ indices per vertex (0 for none)
+typedef struct {
+	unsigned int				material;
+	vector<unsigned int>		corners;	// 3 per vertex: v, vt, vn
+	vector<unsigned int>		triangles;
+} expectmesh_t;
+
+static unsigned int checkMesh(const sourcemesh_t& mesh, const expectmesh_t& expect, const float* v, const float* vt, const float* vn) {
+	const size_t vertices = expect.corners.size() / 3;
+	vector<float> positions, normals, texcoords;
+	for (size_t i = 0; i < vertices; i++) {
+		const unsigned int p = expect.corners[i * 3], t = expect.corners[i * 3 + 1], n = expect.corners[i * 3 + 2];
+		for (unsigned int k = 0; k < 3; k++) {
+			positions.push_back(v[(p - 1) * 3 + k]);
+			normals.push_back(n > 0 ? vn[(n - 1) * 3 + k] : 0.0f);
+		}
+		for (unsigned int k = 0; k < 2; k++) {
+			texcoords.push_back(t > 0 ? vt[(t - 1) * 2 + k] : 0.0f);
+		}
+	}
+	return (mesh.material != expect.material) + (mesh.positions != positions) + (mesh.normals != normals) +
+		   (mesh.texcoords != texcoords) + (mesh.triangles != expect.triangles);
+}
+
+// Objects, groups, materials switched back and forth, fans, relative and missing indices
+static unsigned int checkScene() {
+	static const float v[] = { 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 2, 0.5f, -0.25f };
+	static const float vt[] = { 0, 0, 1, 0, 1, 1 };
+	static const float vn[] = { 0, 0, 1 };
+	const string model =
+		"# test scene\n"
+		"mtllib " TEST_LIBRARY "\n"
+		"v 0 0 0\nv 1 0 0\nv 1.0 1 0\nv 0 1. 0\nv 2 0.5 -0.25\n"
+		"vt 0 0\nvt 1 0\nvt 1 1\n"
+		"vn 0 0 1\n"
+		"f 1 2 3\n"
+		"o boat\n"
+		"usemtl hull\n"
+		"f 1/1/1 2/2/1 3/3/1 4/1/1\n"
+		"usemtl sail\n"
+		"f -5/1 -4/2 -1/3\n"
+		"usemtl hull\r\n"
+		"\tf 3/3/1  4/1/1 5//1 \r\n"
+		"g deck\r\n"
+		"f 1 2 3 4 5\n";
+	const string library =
+		"newmtl hull\n"
+		"map_Kd textures\\hull.png\n"
+		"newmtl sail\n"
+		"Kd 1 1 1\n"
+		"map_Kd /art/sail.png\r\n"
+		"newmtl unused\n"
+		"map_Kd unused.png\n";
+	if (!writeText(TEST_FILE, model) || !writeText(TEST_LIBRARY, library)) {
+		return 1;
+	}
+
+	sourcescene_t scene;
+	string error;
+	const bool parsed = parseObj(TEST_FILE, scene, error);
+	remove(TEST_LIBRARY);
+	if (!parsed) {
+		cout << "scene refused: " << error << "\n";
+		return 1;
+	}
+
+	// Before any object and material, boat/hull (used twice), boat/sail, deck/hull
+	expectmesh_t expect[4];
+	const unsigned int corners0[] = { 1, 0, 0, 2, 0, 0, 3, 0, 0 };
+	const unsigned int corners1[] = { 1, 1, 1, 2, 2, 1, 3, 3, 1, 4, 1, 1, 5, 0, 1 };
+	const unsigned int corners2[] = { 1, 1, 0, 2, 2, 0, 5, 3, 0 };
+	const unsigned int corners3[] = { 1, 0, 0, 2, 0, 0, 3, 0, 0, 4, 0, 0, 5, 0, 0 };
+	const unsigned int triangles0[] = { 0, 1, 2 };
+	const unsigned int triangles1[] = { 0, 1, 2, 0, 2, 3, 2, 3, 4 };
+	const unsigned int triangles3[] = { 0, 1, 2, 0, 2, 3, 0, 3, 4 };
+	expect[0].material = 0;
+	expect[0].corners.assign(corners0, corners0 + 9);
+	expect[0].triangles.assign(triangles0, triangles0 + 3);
+	expect[1].material = 1;
+	expect[1].corners.assign(corners1, corners1 + 15);
+	expect[1].triangles.assign(triangles1, triangles1 + 9);
+	expect[2].material = 2;
+	expect[2].corners.assign(corners2, corners2 + 9);
+	expect[2].triangles.assign(triangles0, triangles0 + 3);
+	expect[3].material = 1;
+	expect[3].corners.assign(corners3, corners3 + 15);
+	expect[3].triangles.assign(triangles3, triangles3 + 9);
+
+	unsigned int errors = scene.meshes.size() != 4;
+	for (size_t i = 0; i < scene.meshes.size() && i < 4; i++) {
+		const unsigned int meshErrors = checkMesh(scene.meshes[i], expect[i], v, vt, vn);
+		if (meshErrors > 0) {
+			cout << "mesh " << i << " differs\n";
+		}
+		errors += meshErrors;
+	}
+
+	// Materials in order of first use, textures without their path
+	static const char* names[] = { "DefaultMaterial", "hull", "sail" };
+	static const char* textures[] = { "", "hull.png", "sail.png" };
+	errors += scene.materials.size() != 3;
+	for (size_t i = 0; i < scene.materials.size() && i < 3; i++) {
+		errors += strcmp(scene.materials[i].name, names[i]) != 0 || strcmp(scene.materials[i].texture, textures[i]) != 0;
+	}
+	cout << "scene: " << scene.meshes.size() << " meshes, " << scene.materials.size() << " materials, " << errors << " errors\n";
+	return errors;
+}
+
+// Floats the way exporters write them, each must read as strtof reads it
+static unsigned int checkFloats() {
+	static const char* fixed[] = { "0", "-0", "1e3", "-2.5E-3", "+7", "3.14159265358979", "123456789012345678901234",
+								   "1e-40", "0.000000000000000000000000000000000000012", "6.5e38", "inf", "-nan", "0x1p3" };
+	const unsigned int fixedCount = sizeof(fixed) / sizeof(fixed[0]);
+	vector<string> values(fixed, fixed + fixedCount);
+	unsigned int seed = 12345;
+	while (values.size() < TEST_FLOATS) {
+		seed = seed * 1103515245u + 12345u;
+		const double magnitude = ((seed >> 8) % 20000) / 1000.0 - 10.0;
+		seed = seed * 1103515245u + 12345u;
+		char text[32];
+		snprintf(text, sizeof(text), (seed & 1) ? "%.9g" : "%.6f", ((seed >> 9) % 2000000 / 1000000.0 - 1.0) * pow(10.0, magnitude));
+		values.push_back(text);
+	}
+	while (values.size() % 3 != 0) {
+		values.push_back("0.5");
+	}
+
+	// One triangle per three positions, so every vertex is a new one in order
+	string model;
+	for (size_t i = 0; i < values.size(); i += 3) {
+		model += "v " + values[i] + " " + values[i + 1] + " " + values[i + 2] + "\n";
+	}
+	for (size_t i = 0; i + 3 <= values.size() / 3; i += 3) {
+		char face[64];
+		snprintf(face, sizeof(face), "f %u %u %u\n", (unsigned int)i + 1, (unsigned int)i + 2, (unsigned int)i + 3);
+		model += face;
+	}
+	if (!writeText(TEST_FILE, model)) {
+		return 1;
+	}
+	sourcescene_t scene;
+	string error;
+	if (!parseObj(TEST_FILE, scene, error) || scene.meshes.size() != 1) {
+		cout << "floats refused: " << error << "\n";
+		return 1;
+	}
+
+	unsigned int errors = 0;
+	const vector<float>& positions = scene.meshes[0].positions;
+	for (size_t i = 0; i < positions.size() && i < values.size(); i++) {
+		const float expect = strtof(values[i].c_str(), NULL);
+		if (memcmp(&positions[i], &expect, sizeof(float)) != 0 && !(expect != expect && positions[i] != positions[i])) {
+			if (errors < 5) {
+				cout << values[i] << " read as " << setprecision(9) << positions[i] << ", strtof gives " << expect << "\n";
+			}
+			errors++;
+		}
+	}
+	errors += positions.size() != (values.size() / 9) * 9;
+	cout << "floats: " << positions.size() << " read, " << errors << " differ from strtof\n";
+	return errors;
+}
+
+// Faces that can't be read, each must be refused
+static unsigned int checkBadFaces() {
+	static const char* faces[] = { "f 1 2 4", "f 0 1 2", "f 1 -4 2", "f 1 x 2" };
+	unsigned int errors = 0;
+	for (size_t i = 0; i < sizeof(faces) / sizeof(faces[0]); i++) {
+		const string model = string("v 0 0 0\nv 1 0 0\nv 0 1 0\n") + faces[i] + "\n";
+		sourcescene_t scene;
+		string error;
+		if (!writeText(TEST_FILE, model)) {
+			return errors + 1;
+		}
+		if (parseObj(TEST_FILE, scene, error)) {
+			cout << faces[i] << ": read\n";
+			errors++;
+		} else if (error != "bad face on line 4") {
+			cout << faces[i] << ": " << error << "\n";
+			errors++;
+		}
+	}
+	sourcescene_t scene;
+	string error;
+	remove(TEST_FILE);
+	errors += parseObj(TEST_FILE, scene, error) || error != "unable to open file";
+	cout << "bad faces: " << errors << " errors\n";
+	return errors;
+}
+
+// Throughput on a synthetic grid, for reference (nothing to compare with here)
+static void timeParser() {
+	if (!writeSyntheticObj(TEST_FILE, TEST_BENCH_FACES)) {
+		return;
+	}
+	FILE* in = fopen(TEST_FILE, "rb");
+	fseek(in, 0, SEEK_END);
+	const double megabytes = ftell(in) / (1024.0 * 1024.0);
+	fclose(in);
+
+	sourcescene_t scene;
+	string error;
+	const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	const bool parsed = parseObj(TEST_FILE, scene, error);
+	const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	remove(TEST_FILE);
+	if (parsed) {
+		cout << "grid: " << TEST_BENCH_FACES << " triangles, " << fixed << setprecision(1) << megabytes << " MB in "
+			 << setprecision(3) << seconds << " s (" << setprecision(0) << megabytes / seconds << " MB/s)\n";
+	}
+}
+
+bool testObjReader(const testconfig_t& config) {
+	(void)config;
+	unsigned int errors = checkScene();
+	errors += checkFloats();
+	errors += checkBadFaces();
+	timeParser();
+	remove(TEST_FILE);
+	return errors == 0;
+}
@@ -0,0 +1,221 @@
+// profiler.cpp : Host build of the game's timing markers (src/profiler.c)
+//
+// The profiler is compiled from the game's source as a PROFILE=1 build. Made up
+// frames are timed with the game's span names while a loader thread times its
+// loads, and the trace is written the way the game writes it. The file has to
+// be Chrome trace JSON with every span, nested spans inside their parents and
+// both threads named. The ring has to keep only its newest spans and start
+// over after a dump. --trace keeps the file, to open in chrome://tracing.
+
+#include "hosttest.h"
+// The suite is a PROFILE=1 build, like src/profiler.c is compiled here
+#define PROFILE
+extern "C" {
+#include "profiler.h"
+}
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <thread>
+#include <atomic>
+using namespace std;
+
+#define TEST_FILE		"hosttest_trace.json"
+#define TEST_FRAMES		60
+#define TEST_LOADS		20
+#define TEST_SLACK		0.002	// Rounding of the written times, in microseconds
+
+typedef struct {
+	string			name;
+	unsigned long	thread;
+	double			start, duration;
+} tracespan_t;
+
+// Something to time, host nanoseconds
+static void spin(unsigned long long nanos) {
+	const unsigned long long start = PROF_now();
+	while (PROF_now() - start < nanos);
+}
+
+// One frame the way main.c and game.c mark it
+static void runFrame() {
+	PROF_SCOPE("frame");
+	{
+		PROF_SCOPE("INPUT_update");
+		spin(2000);
+	}
+	for (unsigned int player = 0; player < 2; player++) {
+		PROF_SCOPE("GAME_updatePlayer");
+		spin(5000);
+	}
+	{
+		PROF_SCOPE("GAME_updateWorld");
+		PROF_SCOPE("WORLD_update");
+		spin(10000);
+	}
+	for (unsigned int view = 0; view < 2; view++) {
+		PROF_SCOPE("GAME_renderView");
+		spin(20000);
+	}
+	PROF_BEGIN(drawDone);
+	spin(8000);
+	PROF_END(drawDone, "GX_DrawDone");
+}
+
+// Reads the trace back, false if it isn't laid out the way PROF_dump writes it
+static bool readTrace(const char* path, vector<tracespan_t>& spans, map<unsigned long, string>& threads) {
+	ifstream in(path);
+	string line;
+	if (!getline(in, line) || line != "{\"traceEvents\":[") {
+		return false;
+	}
+	if (!getline(in, line) || line.compare(0, 30, "{\"name\":\"process_name\",\"ph\":\"M") != 0) {
+		return false;
+	}
+	bool closed = false;
+	while (getline(in, line)) {
+		if (closed) {
+			return false;
+		}
+		if (line == "]}") {
+			closed = true;
+			continue;
+		}
+		if (line.size() > 0 && line[line.size() - 1] == ',') {
+			line.erase(line.size() - 1);
+		}
+		char name[64];
+		unsigned long thread;
+		double start, duration;
+		int used = 0;
+		if (sscanf(line.c_str(), "{\"name\":\"%63[^\"]\",\"ph\":\"X\",\"pid\":1,\"tid\":%lu,\"ts\":%lf,\"dur\":%lf}%n",
+				   name, &thread, &start, &duration, &used) == 4 && used == (int) line.size()) {
+			tracespan_t span = { name, thread, start, duration };
+			spans.push_back(span);
+		} else if (sscanf(line.c_str(), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%lu,\"args\":{\"name\":\"%63[^\"]\"}}%n",
+						  &thread, name, &used) == 2 && used == (int) line.size()) {
+			threads[thread] = name;
+		} else {
+			return false;
+		}
+	}
+	return closed;
+}
+
+static bool inside(const tracespan_t& span, const tracespan_t& parent) {
+	return span.start >= parent.start - TEST_SLACK &&
+		   span.start + span.duration <= parent.start + parent.duration + TEST_SLACK;
+}
+
+// Frames and loads from two threads, written as a trace
+static unsigned int checkTrace(const char* path) {
+	unsigned int errors = 0;
+	PROF_NAME_THREAD("main");
+	atomic<bool> running(true);
+	thread loader([&running]() {
+		PROF_NAME_THREAD("loader");
+		for (unsigned int i = 0; i < TEST_LOADS && running; i++) {
+			PROF_BEGIN(load);
+			spin(30000);
+			PROF_END(load, "PAK_load");
+			PROF_SCOPE("MODEL_setup");
+			spin(10000);
+		}
+	});
+	for (unsigned int f = 0; f < TEST_FRAMES; f++) {
+		runFrame();
+	}
+	running = false;
+	loader.join();
+
+	// Per frame: frame, input, 2 players, world and its update, 2 views, GX_DrawDone
+	const unsigned int frameSpans = TEST_FRAMES * 9;
+	const unsigned int written = PROF_dump(path);
+	vector<tracespan_t> spans;
+	map<unsigned long, string> threads;
+	if (!readTrace(path, spans, threads)) {
+		cout << "trace: " << path << " isn't a trace\n";
+		return 1;
+	}
+
+	map<string, unsigned int> counts;
+	unsigned long mainThread = 0, loaderThread = 0;
+	double first = 1e30;
+	for (size_t i = 0; i < spans.size(); i++) {
+		counts[spans[i].name]++;
+		if (spans[i].start < first) first = spans[i].start;
+		if (spans[i].name == "frame") mainThread = spans[i].thread;
+		if (spans[i].name == "PAK_load") loaderThread = spans[i].thread;
+		errors += spans[i].duration < 0.0;
+	}
+	const unsigned int loads = counts["PAK_load"];
+	errors += written != spans.size() || written != frameSpans + loads * 2 || first != 0.0;
+	errors += counts["frame"] != TEST_FRAMES || counts["GAME_renderView"] != TEST_FRAMES * 2;
+	errors += loads == 0 || counts["MODEL_setup"] != loads;
+	errors += threads.size() != 2 || mainThread == loaderThread;
+	errors += threads[mainThread] != "main" || threads[loaderThread] != "loader";
+
+	// Each of the main thread's spans is inside one frame, the world update inside its caller
+	unsigned int outside = 0;
+	for (size_t i = 0; i < spans.size(); i++) {
+		const tracespan_t& span = spans[i];
+		if (span.thread != mainThread || span.name == "frame") {
+			errors += span.thread != loaderThread && span.thread != mainThread;
+			continue;
+		}
+		unsigned int parents = 0;
+		for (size_t p = 0; p < spans.size(); p++) {
+			const string& parent = spans[p].name;
+			const bool expected = parent == "frame" || (span.name == "WORLD_update" && parent == "GAME_updateWorld");
+			parents += expected && inside(span, spans[p]);
+		}
+		outside += parents != (span.name == "WORLD_update" ? 2u : 1u);
+	}
+	errors += outside;
+	cout << "trace: " << written << " spans (" << TEST_FRAMES << " frames, " << loads << " loads), " << outside
+		 << " outside their parent, " << errors << " errors\n";
+	return errors;
+}
+
+// The ring keeps the newest spans, a dump starts it over
+static unsigned int checkRing() {
+	unsigned int errors = 0;
+	static const char* names[] = { "old", "new" };
+	for (unsigned int i = 0; i < PROF_EVENTS + 100; i++) {
+		PROF_record(names[i >= 100], PROF_now());
+	}
+	const unsigned int full = PROF_dump(TEST_FILE);
+	vector<tracespan_t> spans;
+	map<unsigned long, string> threads;
+	errors += full != PROF_EVENTS || !readTrace(TEST_FILE, spans, threads) || spans.size() != PROF_EVENTS;
+	for (size_t i = 0; i < spans.size(); i++) {
+		errors += spans[i].name != "new";
+	}
+
+	spans.clear();
+	PROF_record("after", PROF_now());
+	const unsigned int after = PROF_dump(TEST_FILE);
+	errors += after != 1 || !readTrace(TEST_FILE, spans, threads) || spans.size() != 1 || spans[0].name != "after";
+	spans.clear();
+	errors += PROF_dump(TEST_FILE) != 0 || !readTrace(TEST_FILE, spans, threads) || !spans.empty();
+	remove(TEST_FILE);
+	cout << "ring: " << PROF_EVENTS + 100 << " spans kept " << full << ", " << errors << " errors\n";
+	return errors;
+}
+
+bool testProfiler(const testconfig_t& config) {
+	unsigned int errors = checkRing();
+	const string path = config.trace.empty() ? TEST_FILE : config.trace;
+	errors += checkTrace(path.c_str());
+	if (config.trace.empty()) {
+		remove(TEST_FILE);
+	} else {
+		cout << "trace kept in " << config.trace << "\n";
+	}
+	return errors == 0;
+}
@@ -0,0 +1,76 @@
+// queue.cpp : The loader's request queue (include/spsc.h) with real threads
+//
+// A producer thread pushes numbered items while the main thread pops them,
+// through queues from one slot (full or empty all the time) to many. Items have
+// to come out whole and in order, and the queue has to end empty.
+
+#include "hosttest.h"
+#include "spsc.h"
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <cstring>
+using namespace std;
+
+// Bigger than a word so a torn copy shows up
+typedef struct {
+	unsigned int	sequence;
+	unsigned char	payload[28];
+} queueitem_t;
+
+static void fillItem(queueitem_t& item, unsigned int sequence) {
+	item.sequence = sequence;
+	for (unsigned int i = 0; i < sizeof(item.payload); i++) {
+		item.payload[i] = (unsigned char)(sequence * 31 + i);
+	}
+}
+
+bool testQueue(const testconfig_t& config) {
+	const unsigned int count = config.items;
+
+	// A one slot queue is full or empty all the time, the big one lets the producer run ahead
+	static const unsigned int capacities[] = { 1, 2, 32, 1024 };
+	bool passed = true;
+	for (size_t c = 0; c < sizeof(capacities) / sizeof(capacities[0]); c++) {
+		const unsigned int capacity = capacities[c];
+		vector<queueitem_t> storage(capacity);
+		spscqueue_t queue;
+		SPSC_init(&queue, storage.data(), capacity, sizeof(queueitem_t));
+
+		const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		thread producer([&]() {
+			queueitem_t item;
+			for (unsigned int i = 0; i < count; i++) {
+				fillItem(item, i);
+				while (!SPSC_push(&queue, &item)) {
+					this_thread::yield();
+				}
+			}
+		});
+
+		unsigned int errors = 0;
+		queueitem_t item, expected;
+		for (unsigned int i = 0; i < count; i++) {
+			while (!SPSC_pop(&queue, &item)) {
+				this_thread::yield();
+			}
+			fillItem(expected, i);
+			if (memcmp(&item, &expected, sizeof(item)) != 0) {
+				errors++;
+			}
+		}
+		producer.join();
+		const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+		if (SPSC_count(&queue) != 0) {
+			errors++;
+		}
+		cout << "capacity " << setw(4) << capacity << ": " << count << " items, " << errors << " errors, "
+			<< fixed << setprecision(1) << count / seconds / 1e6 << " M items/s\n";
+		passed &= errors == 0;
+	}
+	return passed;
+}
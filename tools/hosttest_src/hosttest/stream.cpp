@@ -0,0 +1,226 @@
+// stream.cpp : Headless test of the game's tile streamer (src/tilestream.c)
+//
+// Players wander over synthetic worlds of growing size while loads finish a
+// few frames after they are requested (and sometimes fail). Every frame the
+// streamer's books are checked against what the callbacks saw, and the bytes
+// in use against the budget. Tile sizes come from a hash of the coordinates,
+// so even the largest world costs nothing to describe.
+
+#include "hosttest.h"
+extern "C" {
+#include "tilestream.h"
+}
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+using namespace std;
+
+// Streaming setup, the budget holds about what four players need at once
+#define TEST_TILE_SIZE		50.0f
+#define TEST_RADIUS			75.0f
+#define TEST_SLOTS			96
+#define TEST_BUDGET			(3 * 1024 * 1024)
+#define TEST_MAX_LOADS		2
+#define TEST_MIN_TILE		(16 * 1024)
+#define TEST_MAX_TILE		(64 * 1024)
+#define TEST_LATENCY		8		// Most frames a load takes
+#define TEST_PLAYERS		4
+#define TEST_SPEED			1.0f	// World units per frame
+#define TEST_WARMUP			120		// Frames before players are expected to have ground
+
+typedef struct {
+	unsigned int	slot;
+	int				x, z;
+	unsigned int	ready;	// Frame it finishes on
+	bool			ok;
+} simload_t;
+
+typedef struct {
+	unsigned int	state;	// STREAM_* as the callbacks saw it
+	int				x, z;
+} simslot_t;
+
+typedef struct {
+	int					tilesX, tilesZ;
+	unsigned int		frame;
+	vector<simload_t>	queue;
+	vector<simslot_t>	slots;
+	unsigned int		loads;
+	unsigned int		unloads;
+	unsigned int		errors;
+} simworld_t;
+
+static unsigned int hashTile(int x, int z, unsigned int salt) {
+	unsigned int h = (unsigned int)x * 73856093u ^ (unsigned int)z * 19349663u ^ salt * 83492791u;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return h;
+}
+
+static unsigned int simSize(void* user, int x, int z) {
+	(void)user;
+	// One tile in eight is open sea with nothing to load
+	const unsigned int h = hashTile(x, z, 1);
+	if (h % 8 == 0) {
+		return 0;
+	}
+	return TEST_MIN_TILE + h % (TEST_MAX_TILE - TEST_MIN_TILE);
+}
+
+static int simLoad(void* user, unsigned int slot, int x, int z) {
+	simworld_t* world = (simworld_t*)user;
+	simslot_t& entry = world->slots[slot];
+	if (entry.state != STREAM_FREE || x < 0 || z < 0 || x >= world->tilesX || z >= world->tilesZ) {
+		world->errors++;
+	}
+	entry.state = STREAM_LOADING;
+	entry.x = x;
+	entry.z = z;
+	const unsigned int h = hashTile(x, z, world->frame);
+	const simload_t load = { slot, x, z, world->frame + 1 + h % TEST_LATENCY, h % 50 != 0 };
+	world->queue.push_back(load);
+	world->loads++;
+	return 1;
+}
+
+static void simUnload(void* user, unsigned int slot, int x, int z) {
+	simworld_t* world = (simworld_t*)user;
+	simslot_t& entry = world->slots[slot];
+	if ((entry.state != STREAM_RESIDENT && entry.state != STREAM_FAILED) || entry.x != x || entry.z != z) {
+		world->errors++;
+	}
+	entry.state = STREAM_FREE;
+	world->unloads++;
+}
+
+// Compare the streamer with what the callbacks saw, returns the number of problems
+static unsigned int checkStream(const tilestream_t& stream, const simworld_t& world) {
+	unsigned int errors = 0, used = 0, loading = 0;
+	for (unsigned int i = 0; i < stream.slotCount; i++) {
+		const streamslot_t& slot = stream.slots[i];
+		if (slot.state != world.slots[i].state) {
+			errors++;
+		}
+		if (slot.state == STREAM_FREE) {
+			continue;
+		}
+		if (slot.x != world.slots[i].x || slot.z != world.slots[i].z) {
+			errors++;
+		}
+		used += slot.size;
+		loading += slot.state == STREAM_LOADING;
+		for (unsigned int j = i + 1; j < stream.slotCount; j++) {
+			if (stream.slots[j].state != STREAM_FREE && stream.slots[j].x == slot.x && stream.slots[j].z == slot.z) {
+				errors++;
+			}
+		}
+	}
+	if (used != stream.used || stream.used > stream.budget) {
+		errors++;
+	}
+	if (loading != stream.loading || stream.loading > stream.maxLoads || loading != world.queue.size()) {
+		errors++;
+	}
+	return errors;
+}
+
+static bool runWorld(int tiles, unsigned int frames) {
+	simworld_t world;
+	world.tilesX = world.tilesZ = tiles;
+	world.frame = 0;
+	world.slots.resize(TEST_SLOTS);
+	for (size_t i = 0; i < world.slots.size(); i++) {
+		world.slots[i].state = STREAM_FREE;
+	}
+	world.loads = world.unloads = world.errors = 0;
+
+	vector<streamslot_t> slots(TEST_SLOTS);
+	const streamcallbacks_t callbacks = { simSize, simLoad, simUnload, &world };
+	tilestream_t stream;
+	STREAM_init(&stream, 0, 0, TEST_TILE_SIZE, tiles, tiles, TEST_RADIUS, slots.data(), TEST_SLOTS, TEST_BUDGET, TEST_MAX_LOADS, &callbacks);
+
+	// Players start apart and drift, turning a little every frame
+	const float extent = tiles * TEST_TILE_SIZE;
+	float points[TEST_PLAYERS * 2], headings[TEST_PLAYERS];
+	for (int p = 0; p < TEST_PLAYERS; p++) {
+		points[p * 2] = extent * (0.2f + 0.6f * (hashTile(p, 0, 7) % 1000) / 1000.0f);
+		points[p * 2 + 1] = extent * (0.2f + 0.6f * (hashTile(p, 1, 7) % 1000) / 1000.0f);
+		headings[p] = (hashTile(p, 2, 7) % 628) / 100.0f;
+	}
+
+	unsigned int covered = 0, checked = 0;
+	for (world.frame = 1; world.frame <= frames; world.frame++) {
+		for (int p = 0; p < TEST_PLAYERS; p++) {
+			headings[p] += ((int)(hashTile(p, world.frame, 3) % 201) - 100) / 1000.0f;
+			float& x = points[p * 2];
+			float& z = points[p * 2 + 1];
+			x += cos(headings[p]) * TEST_SPEED;
+			z += sin(headings[p]) * TEST_SPEED;
+			// Bounce off the world edges
+			if (x < 0 || x >= extent) {
+				headings[p] = 3.14159265f - headings[p];
+				x = min(max(x, 0.0f), extent - 0.01f);
+			}
+			if (z < 0 || z >= extent) {
+				headings[p] = -headings[p];
+				z = min(max(z, 0.0f), extent - 0.01f);
+			}
+		}
+
+		STREAM_update(&stream, points, TEST_PLAYERS);
+
+		// Finish the loads that are due
+		for (size_t i = 0; i < world.queue.size();) {
+			const simload_t load = world.queue[i];
+			if (load.ready > world.frame) {
+				i++;
+				continue;
+			}
+			world.queue.erase(world.queue.begin() + i);
+			world.slots[load.slot].state = load.ok ? STREAM_RESIDENT : STREAM_FAILED;
+			STREAM_loaded(&stream, load.slot, load.ok);
+		}
+
+		world.errors += checkStream(stream, world);
+
+		// The tile under each player should be there once things settled
+		if (world.frame > TEST_WARMUP) {
+			for (int p = 0; p < TEST_PLAYERS; p++) {
+				int x, z;
+				if (!STREAM_tileAt(&stream, points[p * 2], points[p * 2 + 1], &x, &z) || simSize(NULL, x, z) == 0) {
+					continue;
+				}
+				const unsigned int slot = STREAM_find(&stream, x, z);
+				checked++;
+				covered += slot != STREAM_NONE && stream.slots[slot].state != STREAM_LOADING;
+			}
+		}
+	}
+
+	const double coverage = checked > 0 ? 100.0 * covered / checked : 100.0;
+	const bool passed = world.errors == 0 && stream.peak <= TEST_BUDGET && coverage >= 99.0;
+	cout << setw(5) << tiles << "x" << left << setw(5) << tiles << right << setw(9) << stream.peak / 1024 << " KB"
+		<< setw(8) << world.loads << setw(8) << world.unloads << setw(8) << stream.starved
+		<< fixed << setprecision(2) << setw(8) << coverage << "%" << setw(8) << world.errors
+		<< (passed ? "  ok" : "  FAILED") << "\n";
+	return passed;
+}
+
+bool testStream(const testconfig_t& config) {
+	const unsigned int frames = config.frames;
+	cout << "budget " << TEST_BUDGET / 1024 << " KB, " << TEST_SLOTS << " slots, radius " << TEST_RADIUS << ", "
+		<< TEST_PLAYERS << " players, streamer state " << sizeof(tilestream_t) + TEST_SLOTS * sizeof(streamslot_t) << " bytes\n";
+	cout << "      world        peak   loads  unload starved  ground  errors\n";
+
+	// Bigger worlds only spread the players out, the peak has to stay under the budget
+	static const int sizes[] = { 4, 16, 64, 256, 4096 };
+	bool passed = true;
+	for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		passed &= runWorld(sizes[i], frames);
+	}
+	return passed;
+}
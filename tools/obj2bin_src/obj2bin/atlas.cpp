@@ -0,0 +1,90 @@
+// atlas.cpp : Texture atlas UV remapping
+//
+// png2tpl packs textures into atlas pages and lists where each one went
+// ("file page x y width height pageWidth pageHeight" per line). Materials using
+// one of those textures get their UVs squeezed into the slot, so the model
+// draws from the page without knowing about it.
+
+#include "obj2bin.h"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+using namespace std;
+
+bool readAtlasMap(const string& file, atlasmap_t& atlas, string& error) {
+	ifstream in(file.c_str());
+	if (!in) {
+		error = "unable to open " + file;
+		return false;
+	}
+	string line;
+	unsigned int number = 0;
+	while (getline(in, line)) {
+		number++;
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		istringstream fields(line);
+		string texture;
+		atlasslot_t slot;
+		if (!(fields >> texture >> slot.page >> slot.x >> slot.y >> slot.width >> slot.height >> slot.pageWidth >> slot.pageHeight)
+			|| slot.pageWidth == 0 || slot.pageHeight == 0) {
+			ostringstream where;
+			where << file << ":" << number << ": bad atlas slot";
+			error = where.str();
+			return false;
+		}
+		atlas[texture] = slot;
+	}
+	return true;
+}
+
+bool applyAtlas(sourcescene_t& scene, const atlasmap_t& atlas, ostream& log) {
+	for (unsigned int material = 0; material < scene.materials.size(); material++) {
+		binmaterial_t& entry = scene.materials[material];
+		const string texture(entry.texture, strnlen(entry.texture, sizeof(entry.texture)));
+		const atlasmap_t::const_iterator found = atlas.find(texture);
+		if (found == atlas.end()) {
+			continue;
+		}
+		const atlasslot_t& slot = found->second;
+
+		// The page clamps, a texture that tiles can't go in it (half a texel of slack for UVs on the edge)
+		const float slackU = 0.5f / slot.width, slackV = 0.5f / slot.height;
+		for (size_t mi = 0; mi < scene.meshes.size(); mi++) {
+			const sourcemesh_t& mesh = scene.meshes[mi];
+			if (mesh.material != material) {
+				continue;
+			}
+			for (size_t i = 0; i < mesh.texcoords.size(); i += 2) {
+				const float u = mesh.texcoords[i], v = mesh.texcoords[i + 1];
+				if (u < -slackU || u > 1 + slackU || v < -slackV || v > 1 + slackV) {
+					log << "Error, material '" << entry.name << "' repeats " << texture << " (uv " << u << ", " << v
+						<< "), it can't use atlas " << slot.page << "\n";
+					return false;
+				}
+			}
+		}
+
+		// Texcoords are still as in the file (v up), the slot is in texels from the top left
+		const float offsetU = (float)slot.x / slot.pageWidth, scaleU = (float)slot.width / slot.pageWidth;
+		const float offsetT = (float)slot.y / slot.pageHeight, scaleT = (float)slot.height / slot.pageHeight;
+		for (size_t mi = 0; mi < scene.meshes.size(); mi++) {
+			sourcemesh_t& mesh = scene.meshes[mi];
+			if (mesh.material != material) {
+				continue;
+			}
+			for (size_t i = 0; i < mesh.texcoords.size(); i += 2) {
+				mesh.texcoords[i] = offsetU + mesh.texcoords[i] * scaleU;
+				mesh.texcoords[i + 1] = 1.0f - (offsetT + (1.0f - mesh.texcoords[i + 1]) * scaleT);
+			}
+		}
+
+		log << "atlas: material '" << entry.name << "' " << texture << " -> " << slot.page << " at " << slot.x << "," << slot.y << "\n";
+		memset(entry.texture, 0, sizeof(entry.texture));
+		strncpy(entry.texture, slot.page.c_str(), sizeof(entry.texture) - 1);
+	}
+	return true;
+}
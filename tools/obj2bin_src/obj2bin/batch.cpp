@@ -0,0 +1,391 @@
+// batch.cpp : Parallel conversion of many models with an on-disk cache
+//
+// Models come from manifests (one "model.obj [output.bmb]" per line, paths
+// relative to the manifest) or directories (every .obj in them). Each model is
+// keyed by a hash of its content, the .mtl files it loads and the converter
+// options; models whose output was written with the same key are skipped.
+
+#include "obj2bin.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+using namespace std;
+
+// Bump when the output changes for the same input and options
+#define CACHE_VERSION 1
+
+#define CACHE_DEFAULT_NAME "obj2bin.cache"
+
+typedef enum {
+	JOB_FAILED,
+	JOB_CONVERTED,
+	JOB_UP_TO_DATE
+} jobstatus_t;
+
+typedef struct {
+	string			input;
+	string			output;
+	string			key;		// Content and options hash, empty if the input couldn't be read
+	jobstatus_t		status;
+	string			log;		// Converter output, shown when the job fails
+	double			seconds;
+} batchjob_t;
+
+// 64-bit FNV-1a
+typedef unsigned long long hash_t;
+#define HASH_SEED 14695981039346656037ULL
+
+static hash_t hashBytes(hash_t hash, const void* data, size_t size) {
+	const unsigned char* bytes = (const unsigned char*)data;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+static hash_t hashString(hash_t hash, const string& text) {
+	// Length first so concatenations can't collide
+	const unsigned int length = text.size();
+	hash = hashBytes(hash, &length, sizeof(length));
+	return hashBytes(hash, text.data(), text.size());
+}
+
+static bool readFile(const string& path, vector<char>& data) {
+	FILE* in = fopen(path.c_str(), "rb");
+	if (in == NULL) {
+		return false;
+	}
+	data.clear();
+	char buffer[1 << 16];
+	size_t read;
+	while ((read = fread(buffer, 1, sizeof(buffer), in)) > 0) {
+		data.insert(data.end(), buffer, buffer + read);
+	}
+	fclose(in);
+	return true;
+}
+
+static bool fileExists(const string& path) {
+	FILE* in = fopen(path.c_str(), "rb");
+	if (in == NULL) {
+		return false;
+	}
+	fclose(in);
+	return true;
+}
+
+static string directoryOf(const string& path) {
+	const size_t slash = path.find_last_of("/\\");
+	return slash != string::npos ? path.substr(0, slash + 1) : string();
+}
+
+static string joinPath(const string& directory, const string& path) {
+	if (directory.empty() || path.empty() || path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':')) {
+		return path;
+	}
+	const char last = directory[directory.size() - 1];
+	return (last == '/' || last == '\\') ? directory + path : directory + "/" + path;
+}
+
+static bool isObj(const string& name) {
+	if (name.size() < 4) {
+		return false;
+	}
+	string extension = name.substr(name.size() - 4);
+	transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == ".obj";
+}
+
+// Every .obj directly in a directory, sorted, false if it isn't a directory
+static bool listDirectory(const string& directory, vector<string>& files) {
+#ifdef _WIN32
+	WIN32_FIND_DATAA entry;
+	HANDLE find = FindFirstFileA(joinPath(directory, "*").c_str(), &entry);
+	if (find == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	do {
+		if (!(entry.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) && isObj(entry.cFileName)) {
+			files.push_back(joinPath(directory, entry.cFileName));
+		}
+	} while (FindNextFileA(find, &entry));
+	FindClose(find);
+#else
+	DIR* dir = opendir(directory.c_str());
+	if (dir == NULL) {
+		return false;
+	}
+	struct dirent* entry;
+	while ((entry = readdir(dir)) != NULL) {
+		const string path = joinPath(directory, entry->d_name);
+		struct stat st;
+		if (isObj(entry->d_name) && stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+			files.push_back(path);
+		}
+	}
+	closedir(dir);
+#endif
+	sort(files.begin(), files.end());
+	return true;
+}
+
+static string defaultOutput(const string& input, const string& outDir) {
+	const size_t slash = input.find_last_of("/\\");
+	const string name = slash != string::npos ? input.substr(slash + 1) : input;
+	const string bmb = name.substr(0, name.size() - 4) + ".bmb";
+	return outDir.empty() ? directoryOf(input) + bmb : joinPath(outDir, bmb);
+}
+
+// Add the models of a directory or manifest
+static bool addSource(const string& source, const batchopts_t& batch, vector<batchjob_t>& jobs) {
+	batchjob_t job;
+	job.status = JOB_FAILED;
+	job.seconds = 0;
+
+	vector<string> models;
+	if (listDirectory(source, models)) {
+		for (size_t i = 0; i < models.size(); i++) {
+			job.input = models[i];
+			job.output = defaultOutput(models[i], batch.outDir);
+			jobs.push_back(job);
+		}
+		return true;
+	}
+
+	ifstream manifest(source.c_str());
+	if (!manifest) {
+		cerr << "Error, " << source << " is neither a directory nor a manifest\n";
+		return false;
+	}
+	const string base = directoryOf(source);
+	string line;
+	unsigned int number = 0;
+	while (getline(manifest, line)) {
+		number++;
+		const size_t comment = line.find('#');
+		if (comment != string::npos) {
+			line.erase(comment);
+		}
+		istringstream fields(line);
+		string input, output, extra;
+		if (!(fields >> input)) {
+			continue;
+		}
+		fields >> output;
+		if (fields >> extra || !isObj(input)) {
+			cerr << "Error, " << source << ":" << number << ": expected \"model.obj [output.bmb]\"\n";
+			return false;
+		}
+		job.input = joinPath(base, input);
+		job.output = output.empty() ? defaultOutput(job.input, batch.outDir) : joinPath(batch.outDir.empty() ? base : batch.outDir, output);
+		jobs.push_back(job);
+	}
+	return true;
+}
+
+// Everything that changes the output for a given input
+static hash_t optionsHash(const convopts_t& opts) {
+	ostringstream text;
+	text << "cache " << CACHE_VERSION << " bmb " << BMB_VERSION
+		 << " quantize " << opts.quantize << " pos " << opts.posError << " nrm " << opts.nrmError << " uv " << opts.uvError
+		 << " strips " << opts.strips << " vcache " << opts.vcache << " size " << opts.cacheSize
+		 << " merge " << opts.nrmMerge << " index " << opts.maxIndex << " fast " << opts.fastObj;
+	for (atlasmap_t::const_iterator slot = opts.atlas.begin(); slot != opts.atlas.end(); ++slot) {
+		const atlasslot_t& a = slot->second;
+		text << " atlas " << slot->first << " " << a.page << " " << a.x << " " << a.y << " " << a.width << " " << a.height
+			 << " " << a.pageWidth << " " << a.pageHeight;
+	}
+	return hashString(HASH_SEED, text.str());
+}
+
+// Hash a model and the material libraries it loads, empty if it can't be read
+static string modelKey(const string& input, hash_t options) {
+	vector<char> data;
+	if (!readFile(input, data)) {
+		return string();
+	}
+	hash_t hash = hashBytes(options, data.data(), data.size());
+
+	// Material libraries, present or not (appearing later has to change the key)
+	const string base = directoryOf(input);
+	const char* p = data.data();
+	const char* end = p + data.size();
+	while (p < end) {
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		if (eol == NULL) {
+			eol = end;
+		}
+		if (eol - p > 7 && memcmp(p, "mtllib", 6) == 0 && (p[6] == ' ' || p[6] == '\t')) {
+			istringstream names(string(p + 7, eol));
+			string name;
+			vector<char> library;
+			while (names >> name) {
+				const bool found = readFile(joinPath(base, name), library);
+				hash = hashString(hash, name);
+				hash = found ? hashBytes(hash, library.data(), library.size()) : hashString(hash, "missing");
+			}
+		}
+		p = eol + 1;
+	}
+
+	char text[17];
+	sprintf(text, "%016llx", hash);
+	return text;
+}
+
+// Cache file: one "<key> <output>" per line
+static void loadCache(const string& file, map<string, string>& cache) {
+	ifstream in(file.c_str());
+	string line;
+	while (getline(in, line)) {
+		const size_t space = line.find(' ');
+		if (space != string::npos) {
+			cache[line.substr(space + 1)] = line.substr(0, space);
+		}
+	}
+}
+
+static bool saveCache(const string& file, const map<string, string>& cache) {
+	// Written aside and moved over, an interrupted run can't leave half a cache
+	const string temporary = file + ".tmp";
+	{
+		ofstream out(temporary.c_str());
+		for (map<string, string>::const_iterator it = cache.begin(); it != cache.end(); ++it) {
+			out << it->second << " " << it->first << "\n";
+		}
+		if (!out) {
+			return false;
+		}
+	}
+#ifdef _WIN32
+	return MoveFileExA(temporary.c_str(), file.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return rename(temporary.c_str(), file.c_str()) == 0;
+#endif
+}
+
+// Run work(i) for every i < count on a pool of threads
+static void runParallel(size_t count, unsigned int threads, const function<void(size_t)>& work) {
+	atomic<size_t> next(0);
+	vector<thread> pool;
+	for (unsigned int t = 0; t < threads; t++) {
+		pool.push_back(thread([&]() {
+			for (size_t i = next++; i < count; i = next++) {
+				work(i);
+			}
+		}));
+	}
+	for (size_t t = 0; t < pool.size(); t++) {
+		pool[t].join();
+	}
+}
+
+bool convertBatch(const batchopts_t& batch, const convopts_t& opts) {
+	const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+	vector<batchjob_t> jobs;
+	for (size_t i = 0; i < batch.sources.size(); i++) {
+		if (!addSource(batch.sources[i], batch, jobs)) {
+			return false;
+		}
+	}
+
+	// Two models writing the same file would race
+	set<string> outputs;
+	for (size_t i = 0; i < jobs.size(); i++) {
+		if (!outputs.insert(jobs[i].output).second) {
+			cerr << "Error, more than one model writes " << jobs[i].output << "\n";
+			return false;
+		}
+	}
+
+	const string cacheFile = !batch.cacheFile.empty() ? batch.cacheFile :
+							 joinPath(batch.outDir.empty() ? "." : batch.outDir, CACHE_DEFAULT_NAME);
+	map<string, string> cache;
+	loadCache(cacheFile, cache);
+
+	unsigned int threads = batch.jobs > 0 ? batch.jobs : thread::hardware_concurrency();
+	threads = max(1u, min(threads, (unsigned int)jobs.size()));
+	cout << jobs.size() << " models, " << threads << " threads\n";
+
+	const hash_t options = optionsHash(opts);
+	mutex reportLock;
+	unsigned int done = 0;
+	runParallel(jobs.size(), threads, [&](size_t index) {
+		batchjob_t& job = jobs[index];
+		const chrono::steady_clock::time_point jobStart = chrono::steady_clock::now();
+
+		job.key = modelKey(job.input, options);
+		map<string, string>::const_iterator cached = cache.find(job.output);
+		if (job.key.empty()) {
+			job.log = "Error, unable to read " + job.input + "\n";
+		} else if (!batch.force && cached != cache.end() && cached->second == job.key && fileExists(job.output)) {
+			job.status = JOB_UP_TO_DATE;
+		} else {
+			ostringstream log;
+			if (convertModel(job.input, job.output, opts, log)) {
+				job.status = JOB_CONVERTED;
+			} else {
+				// Don't leave a broken file for the next build to pick up
+				remove(job.output.c_str());
+			}
+			job.log = log.str();
+		}
+		job.seconds = chrono::duration<double>(chrono::steady_clock::now() - jobStart).count();
+
+		lock_guard<mutex> lock(reportLock);
+		done++;
+		cout << "[" << done << "/" << jobs.size() << "] " << job.input << ": ";
+		if (job.status == JOB_UP_TO_DATE) {
+			cout << "up to date\n";
+		} else if (job.status == JOB_CONVERTED) {
+			cout << "converted in " << job.seconds << " s\n";
+		} else {
+			cout << "FAILED\n";
+			cerr << job.log;
+		}
+		cout.flush();
+	});
+
+	unsigned int converted = 0, upToDate = 0, failed = 0;
+	for (size_t i = 0; i < jobs.size(); i++) {
+		switch (jobs[i].status) {
+		case JOB_CONVERTED:
+			cache[jobs[i].output] = jobs[i].key;
+			converted++;
+			break;
+		case JOB_UP_TO_DATE:
+			upToDate++;
+			break;
+		default:
+			cache.erase(jobs[i].output);
+			failed++;
+			break;
+		}
+	}
+	if (!saveCache(cacheFile, cache)) {
+		cerr << "Warning, unable to write " << cacheFile << "\n";
+	}
+
+	cout << converted << " converted, " << upToDate << " up to date, " << failed << " failed in "
+		 << chrono::duration<double>(chrono::steady_clock::now() - start).count() << " s\n";
+	return failed == 0;
+}
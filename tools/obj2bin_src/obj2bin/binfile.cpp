@@ -0,0 +1,430 @@
+// binfile.cpp : Writing converted models as .bmb and checking them back
+//
+// Each material's meshes are merged, reordered for the vertex cache, split to
+// keep indices in u16 range, stripified, quantized and encoded as display
+// lists. The file is then read back the way tools and the game see it.
+
+#include "obj2bin.h"
+
+#include <ostream>
+#include <cstring>
+#include <algorithm>
+using namespace std;
+
+static quantization_t pickFormat(const char* name, const vector<float>& values, int stream, float maxError, const convopts_t& opts, ostream& log) {
+	quantization_t q = { COMP_F32, 0, 0 };
+	if (opts.quantize) {
+		q = chooseQuantization(values.data(), values.size(), stream, maxError);
+	}
+
+	log << name << ": " << componentName(q.type);
+	if (q.type != COMP_F32) {
+		log << " (" << (int)q.frac << " frac bits, max error " << q.error << ", bound " << maxError << ")";
+	}
+	log << "\n";
+	return q;
+}
+
+// Map a vertex sequence to indices into one attribute array. With firstUse the
+// array is reordered so entries appear in the order the sequence needs them.
+static vector<unsigned int> packStream(const vector<unsigned int>& order, const vector<unsigned int>& attributeOf,
+									   vector<float>& values, unsigned int components, bool firstUse) {
+	const unsigned int count = values.size() / components;
+	vector<unsigned int> indices(order.size());
+	for (unsigned int ii = 0; ii < order.size(); ii++) {
+		indices[ii] = attributeOf[order[ii]];
+	}
+	if (!firstUse) {
+		return indices;
+	}
+
+	vector<unsigned int> remap = firstUseOrder(indices, count);
+	vector<float> sorted(values.size());
+	for (unsigned int i = 0; i < count; i++) {
+		for (unsigned int c = 0; c < components; c++) {
+			sorted[remap[i] * components + c] = values[i * components + c];
+		}
+	}
+	values.swap(sorted);
+
+	for (unsigned int ii = 0; ii < indices.size(); ii++) {
+		indices[ii] = remap[indices[ii]];
+	}
+	return indices;
+}
+
+// Canonical triangle (rotated to start at its smallest corner) made of the attribute values
+typedef vector<float> corner_t;
+typedef vector<corner_t> triangle_t;
+
+static triangle_t makeTriangle(const meshdata_t& mesh, const dlindex_t* c) {
+	triangle_t t(3);
+	for (unsigned int k = 0; k < 3; k++) {
+		t[k].insert(t[k].end(), mesh.positions.begin() + c[k].position * 3, mesh.positions.begin() + c[k].position * 3 + 3);
+		t[k].insert(t[k].end(), mesh.normals.begin() + c[k].normal * 3, mesh.normals.begin() + c[k].normal * 3 + 3);
+		t[k].insert(t[k].end(), mesh.texcoords.begin() + c[k].texcoord * 2, mesh.texcoords.begin() + c[k].texcoord * 2 + 2);
+	}
+	rotate(t.begin(), min_element(t.begin(), t.end()), t.end());
+	return t;
+}
+
+// Decode the display list and check it draws exactly the source triangles, winding included
+static bool verifyDisplayList(const vector<unsigned char>& displayList, const meshdata_t& source, const meshdata_t& packed) {
+	vector<dlindex_t> decoded;
+	if (!decodeDisplayList(displayList.data(), displayList.size(), decoded)) {
+		return false;
+	}
+	if (decoded.size() != source.triangles.size()) {
+		return false;
+	}
+
+	vector<triangle_t> expected, drawn;
+	for (size_t i = 0; i < source.triangles.size(); i += 3) {
+		dlindex_t c[3];
+		for (unsigned int k = 0; k < 3; k++) {
+			const unsigned int v = source.triangles[i + k];
+			c[k].position = source.positionOf[v];
+			c[k].normal = source.normalOf[v];
+			c[k].texcoord = source.texcoordOf[v];
+		}
+		expected.push_back(makeTriangle(source, c));
+	}
+	for (size_t i = 0; i < decoded.size(); i += 3) {
+		for (unsigned int k = 0; k < 3; k++) {
+			if (decoded[i + k].position >= packed.positions.size() / 3 ||
+				decoded[i + k].normal >= packed.normals.size() / 3 ||
+				decoded[i + k].texcoord >= packed.texcoords.size() / 2) {
+				return false;
+			}
+		}
+		drawn.push_back(makeTriangle(packed, &decoded[i]));
+	}
+
+	sort(expected.begin(), expected.end());
+	sort(drawn.begin(), drawn.end());
+	return expected == drawn;
+}
+
+// Final index order, strips first then loose triangles
+static vector<unsigned int> stripOrder(const striplist_t& strips) {
+	vector<unsigned int> order;
+	for (unsigned int si = 0; si < strips.strips.size(); si++) {
+		order.insert(order.end(), strips.strips[si].begin(), strips.strips[si].end());
+	}
+	order.insert(order.end(), strips.triangles.begin(), strips.triangles.end());
+	return order;
+}
+
+// Add one submesh's sections (info, arrays, bounds and display list)
+static bool writeSubmesh(vector<bmbpayload_t>& out, unsigned int submesh, unsigned short material, meshdata_t& mesh, const convopts_t& opts, ostream& log) {
+	const meshdata_t source = mesh;
+	// Make object to save
+	binmesh_t		binHeader;
+	const unsigned int triCount = mesh.triangles.size() / 3;
+
+	// Counting time
+	memset(&binHeader, 0, sizeof(binmesh_t));
+	binHeader.vcount = mesh.positions.size() / 3;
+	binHeader.ncount = mesh.normals.size() / 3;
+	binHeader.vtcount = mesh.texcoords.size() / 2;
+	binHeader.fcount = triCount;
+	binHeader.material = material;
+
+	log << "vertices: " << mesh.vertexCount << "\n";
+	log << "positions: " << binHeader.vcount << "\n";
+	log << "normals: " << binHeader.ncount << "\n";
+	log << "texcoords: " << binHeader.vtcount << "\n";
+	log << "faces: " << binHeader.fcount << "\n";
+
+	striplist_t strips;
+	vector<unsigned int> order;
+	if (opts.strips) {
+		strips = stripify(mesh.triangles, 0);
+		order = stripOrder(strips);
+		if (opts.vcache) {
+			// Strips that follow the cache order within a cache's worth of
+			// triangles, kept if they miss less than the longest strips
+			striplist_t cacheStrips = stripify(mesh.triangles, opts.cacheSize);
+			vector<unsigned int> cacheOrder = stripOrder(cacheStrips);
+			const float longestACMR = measureACMR(order, triCount, opts.cacheSize);
+			const float cacheACMR = measureACMR(cacheOrder, triCount, opts.cacheSize);
+			log << "ACMR (cache " << opts.cacheSize << "): " << longestACMR << " longest strips, " << cacheACMR << " cache ordered strips\n";
+			if (cacheACMR < longestACMR) {
+				strips.strips.swap(cacheStrips.strips);
+				strips.triangles.swap(cacheStrips.triangles);
+				order.swap(cacheOrder);
+			}
+		}
+	} else {
+		strips.triangles = mesh.triangles;
+		order = stripOrder(strips);
+	}
+	log << "ACMR (cache " << opts.cacheSize << "): " << measureACMR(order, triCount, opts.cacheSize) << " written\n";
+
+	// Per-corner indices into each array, arrays sorted by first use if optimizing
+	vector<unsigned int> positionIndices = packStream(order, mesh.positionOf, mesh.positions, 3, opts.vcache);
+	vector<unsigned int> normalIndices = packStream(order, mesh.normalOf, mesh.normals, 3, opts.vcache);
+	vector<unsigned int> texcoordIndices = packStream(order, mesh.texcoordOf, mesh.texcoords, 2, opts.vcache);
+
+	// Pick vertex formats
+	quantization_t posQ = pickFormat("position format", mesh.positions, STREAM_POSITION, opts.posError, opts, log);
+	quantization_t nrmQ = pickFormat("normal format", mesh.normals, STREAM_NORMAL, opts.nrmError, opts, log);
+	quantization_t texQ = pickFormat("texcoord format", mesh.texcoords, STREAM_TEXCOORD, opts.uvError, opts, log);
+	binHeader.posType = posQ.type;
+	binHeader.posFrac = posQ.frac;
+	binHeader.nrmType = nrmQ.type;
+	binHeader.nrmFrac = nrmQ.frac;
+	binHeader.texType = texQ.type;
+	binHeader.texFrac = texQ.frac;
+
+	const unsigned int floatSize = (binHeader.vcount * 3 + binHeader.ncount * 3 + binHeader.vtcount * 2) * sizeof(float);
+	const unsigned int sharedSize = mesh.vertexCount * 8 * sizeof(float);
+
+	// Streams, each in its own section
+	bmbpayload_t positions = { BMB_SECTION_POSITIONS, submesh };
+	bmbpayload_t normals = { BMB_SECTION_NORMALS, submesh };
+	bmbpayload_t texcoords = { BMB_SECTION_TEXCOORDS, submesh };
+	writeQuantized(positions.data, mesh.positions.data(), mesh.positions.size(), posQ);
+	writeQuantized(normals.data, mesh.normals.data(), mesh.normals.size(), nrmQ);
+	writeQuantized(texcoords.data, mesh.texcoords.data(), mesh.texcoords.size(), texQ);
+	const size_t vertexSize = positions.data.size() + normals.data.size() + texcoords.data.size();
+
+	log << "vertex data: " << vertexSize << " bytes (" << floatSize << " as floats, "
+		 << sharedSize << " as floats with one index for all attributes)\n";
+
+	unsigned int stripIndices = 0;
+	vector<unsigned int> stripLengths;
+	for (unsigned int si = 0; si < strips.strips.size(); si++) {
+		stripLengths.push_back(strips.strips[si].size());
+		stripIndices += strips.strips[si].size();
+	}
+	const unsigned int looseCount = strips.triangles.size() / 3;
+
+	const unsigned int outIndices = stripIndices + looseCount * 3;
+	log << "indices: " << mesh.triangles.size() << " -> " << outIndices
+		 << " (" << stripLengths.size() << " strips, " << looseCount << " loose triangles, "
+		 << (100 - (outIndices * 100) / (mesh.triangles.size() > 0 ? mesh.triangles.size() : 1)) << "% fewer)\n";
+
+	vector<dlindex_t> corners(order.size());
+	for (unsigned int ii = 0; ii < order.size(); ii++) {
+		corners[ii].position = positionIndices[ii];
+		corners[ii].normal = normalIndices[ii];
+		corners[ii].texcoord = texcoordIndices[ii];
+	}
+	bmbpayload_t displayList = { BMB_SECTION_DISPLAYLIST, submesh };
+	encodeDisplayList(displayList.data, stripLengths, looseCount, corners);
+
+	if (!verifyDisplayList(displayList.data, source, mesh)) {
+		log << "Error, display list doesn't decode to the source triangles\n";
+		return false;
+	}
+	log << "display list: " << displayList.data.size() << " bytes (decoded and verified)\n";
+
+	// Bounds of the unquantized positions
+	binbounds_t bounds;
+	for (unsigned int c = 0; c < 3; c++) {
+		bounds.min[c] = bounds.max[c] = mesh.positions.empty() ? 0 : mesh.positions[c];
+	}
+	for (size_t i = 0; i < mesh.positions.size(); i++) {
+		const unsigned int c = i % 3;
+		bounds.min[c] = min(bounds.min[c], mesh.positions[i]);
+		bounds.max[c] = max(bounds.max[c], mesh.positions[i]);
+	}
+	bmbpayload_t boundsSection = { BMB_SECTION_BOUNDS, submesh };
+	for (unsigned int c = 0; c < 3; c++) {
+		bounds.min[c] = EndianFixFloat(bounds.min[c]);
+		bounds.max[c] = EndianFixFloat(bounds.max[c]);
+	}
+	const unsigned char* boundsBytes = (const unsigned char*)&bounds;
+	boundsSection.data.assign(boundsBytes, boundsBytes + sizeof(binbounds_t));
+
+	// Fix endian
+	binmesh_t binHeaderEndian = binHeader;
+	binHeaderEndian.vcount = EndianFixInt(binHeader.vcount);
+	binHeaderEndian.ncount = EndianFixInt(binHeader.ncount);
+	binHeaderEndian.vtcount = EndianFixInt(binHeader.vtcount);
+	binHeaderEndian.fcount = EndianFixInt(binHeader.fcount);
+	binHeaderEndian.material = EndianFixShort(binHeader.material);
+	bmbpayload_t info = { BMB_SECTION_MESH, submesh };
+	const unsigned char* header = (const unsigned char*)&binHeaderEndian;
+	info.data.assign(header, header + sizeof(binmesh_t));
+
+	out.push_back(info);
+	out.push_back(positions);
+	out.push_back(normals);
+	out.push_back(texcoords);
+	out.push_back(boundsSection);
+	out.push_back(displayList);
+	return true;
+}
+
+// Merge every mesh of a material into one mesh
+static void gatherMaterial(const sourcescene_t& scene, unsigned int material, meshdata_t& mesh, const convopts_t& opts) {
+	vector<float> meshPositions, meshNormals, meshTexcoords;
+	mesh.vertexCount = 0;
+	mesh.triangles.clear();
+
+	for (size_t mi = 0; mi < scene.meshes.size(); mi++) {
+		const sourcemesh_t& part = scene.meshes[mi];
+		if (part.material != material) {
+			continue;
+		}
+
+		// Gather streams as plain floats, one entry per mesh vertex
+		meshPositions.insert(meshPositions.end(), part.positions.begin(), part.positions.end());
+		meshNormals.insert(meshNormals.end(), part.normals.begin(), part.normals.end());
+		for (size_t ti = 0; ti < part.texcoords.size(); ti += 2) {
+			meshTexcoords.push_back(part.texcoords[ti]);
+			meshTexcoords.push_back(1.0f - part.texcoords[ti + 1]);
+		}
+
+		// Triangle list
+		for (size_t ii = 0; ii < part.triangles.size(); ii++) {
+			mesh.triangles.push_back(mesh.vertexCount + part.triangles[ii]);
+		}
+		mesh.vertexCount += part.positions.size() / 3;
+	}
+
+	// Each attribute gets its own array and index
+	mesh.positionOf = dedupeStream(meshPositions, 3, 0, mesh.positions);
+	mesh.normalOf = dedupeStream(meshNormals, 3, opts.nrmMerge, mesh.normals);
+	mesh.texcoordOf = dedupeStream(meshTexcoords, 2, 0, mesh.texcoords);
+}
+
+bool saveBinfile(string file, const sourcescene_t& scene, const convopts_t& opts, ostream& log) {
+	vector<bmbpayload_t> sections;
+	bmbpayload_t materials = { BMB_SECTION_MATERIALS, 0 };
+	unsigned int submeshCount = 0;
+
+	// One batch per material, submeshes stay grouped by material so the game binds each texture once
+	for (unsigned int material = 0; material < scene.materials.size(); material++) {
+		meshdata_t mesh;
+		gatherMaterial(scene, material, mesh, opts);
+		if (mesh.triangles.empty()) {
+			continue;
+		}
+
+		const unsigned short tableIndex = materials.data.size() / sizeof(binmaterial_t);
+		const binmaterial_t& entry = scene.materials[material];
+		const unsigned char* entryBytes = (const unsigned char*)&entry;
+		materials.data.insert(materials.data.end(), entryBytes, entryBytes + sizeof(binmaterial_t));
+
+		const unsigned int triCount = mesh.triangles.size() / 3;
+		log << "== material " << tableIndex << " '" << entry.name << "' (" << (entry.texture[0] ? entry.texture : "no texture")
+			 << "): " << triCount << " triangles\n";
+
+		log << "ACMR (cache " << opts.cacheSize << "): " << measureACMR(mesh.triangles, triCount, opts.cacheSize) << " original";
+		if (opts.vcache) {
+			mesh.triangles = optimizeVertexCache(mesh.triangles, mesh.vertexCount, opts.cacheSize);
+			log << ", " << measureACMR(mesh.triangles, triCount, opts.cacheSize) << " optimized";
+		}
+		log << "\n";
+
+		// Keep every index in u16 range, following the (cache) order so submeshes stay local
+		vector<meshdata_t> submeshes = splitMesh(mesh, opts.maxIndex);
+		log << "submeshes: " << submeshes.size() << "\n";
+
+		for (unsigned int si = 0; si < submeshes.size(); si++) {
+			if (submeshes.size() > 1) {
+				log << "-- submesh " << submeshCount << "\n";
+			}
+			if (!writeSubmesh(sections, submeshCount++, tableIndex, submeshes[si], opts, log)) {
+				return false;
+			}
+		}
+	}
+
+	if (submeshCount == 0) {
+		log << "Error, nothing to write\n";
+		return false;
+	}
+	sections.push_back(materials);
+	log << "materials: " << materials.data.size() / sizeof(binmaterial_t) << ", meshes: " << scene.meshes.size()
+		 << ", display lists: " << submeshCount << "\n";
+
+	// Dump file
+	if (!writeBmb(file, submeshCount, sections)) {
+		log << "Error, unable to write output file\n";
+		return false;
+	}
+
+	// Read it back the way tools and the game see it
+	return checkBinfile(file, false, log);
+}
+
+// Validate a written file: container, mesh info against array sizes, and display lists
+bool checkBinfile(string file, bool verbose, ostream& log) {
+	bmbfile_t bmb;
+	string error;
+	if (!readBmb(file, bmb, error)) {
+		log << "Error, " << file << ": " << error << "\n";
+		return false;
+	}
+
+	if (verbose) {
+		log << file << ": version " << bmb.header.version << ", " << bmb.header.submeshCount << " submeshes, "
+			 << bmb.header.size << " bytes\n";
+		for (size_t i = 0; i < bmb.sections.size(); i++) {
+			const binsection_t& section = bmb.sections[i];
+			log << "  [" << section.submesh << "] " << bmbSectionName(section.type)
+				 << " @" << section.offset << " " << section.size << " bytes\n";
+		}
+	}
+
+	unsigned int materialSize = 0;
+	const binmaterial_t* materials = (const binmaterial_t*)bmbSection(bmb, BMB_SECTION_MATERIALS, 0, &materialSize);
+	const unsigned int materialCount = materials != NULL ? materialSize / sizeof(binmaterial_t) : 1;
+	if (verbose && materials != NULL) {
+		for (unsigned int mi = 0; mi < materialCount; mi++) {
+			log << "material " << mi << ": " << string(materials[mi].name, strnlen(materials[mi].name, sizeof(materials[mi].name)))
+				 << " (" << string(materials[mi].texture, strnlen(materials[mi].texture, sizeof(materials[mi].texture))) << ")\n";
+		}
+	}
+
+	for (unsigned int si = 0; si < bmb.header.submeshCount; si++) {
+		binmesh_t info;
+		if (!bmbMeshInfo(bmb, si, info)) {
+			log << "Error, submesh " << si << " has no mesh info\n";
+			return false;
+		}
+
+		if (info.material >= materialCount) {
+			log << "Error, submesh " << si << " uses a missing material\n";
+			return false;
+		}
+
+		unsigned int posSize = 0, nrmSize = 0, texSize = 0, dlSize = 0;
+		bmbSection(bmb, BMB_SECTION_POSITIONS, si, &posSize);
+		bmbSection(bmb, BMB_SECTION_NORMALS, si, &nrmSize);
+		bmbSection(bmb, BMB_SECTION_TEXCOORDS, si, &texSize);
+		const unsigned char* dl = bmbSection(bmb, BMB_SECTION_DISPLAYLIST, si, &dlSize);
+		if (posSize != componentSize(info.posType) * info.vcount * 3 ||
+			nrmSize != componentSize(info.nrmType) * info.ncount * 3 ||
+			texSize != componentSize(info.texType) * info.vtcount * 2) {
+			log << "Error, submesh " << si << " arrays don't match its mesh info\n";
+			return false;
+		}
+
+		vector<dlindex_t> triangles;
+		if (dl == NULL || !decodeDisplayList(dl, dlSize, triangles) || triangles.size() != info.fcount * 3) {
+			log << "Error, submesh " << si << " display list is invalid\n";
+			return false;
+		}
+		for (size_t i = 0; i < triangles.size(); i++) {
+			if (triangles[i].position >= info.vcount || triangles[i].normal >= info.ncount || triangles[i].texcoord >= info.vtcount) {
+				log << "Error, submesh " << si << " display list indexes past its arrays\n";
+				return false;
+			}
+		}
+
+		if (verbose) {
+			log << "submesh " << si << ": material " << info.material << ", " << info.fcount << " triangles, " << componentName(info.posType) << " positions, "
+				 << componentName(info.nrmType) << " normals, " << componentName(info.texType) << " texcoords\n";
+		}
+	}
+
+	if (verbose) {
+		log << "ok\n";
+	}
+	return true;
+}
@@ -0,0 +1,179 @@
+// bmbfile.cpp : Reading and writing the sectioned .bmb container
+//
+
+#include "obj2bin.h"
+
+#include <cstdio>
+#include <cstring>
+using namespace std;
+
+static unsigned int alignUp(unsigned int value) {
+	return (value + BMB_ALIGN - 1) & ~(BMB_ALIGN - 1);
+}
+
+bool writeBmb(const string& file, unsigned int submeshCount, const vector<bmbpayload_t>& payloads) {
+	// Lay out the payloads after the table
+	const unsigned int tableEnd = sizeof(binheader_t) + payloads.size() * sizeof(binsection_t);
+	vector<binsection_t> table(payloads.size());
+	unsigned int offset = alignUp(tableEnd);
+	for (size_t i = 0; i < payloads.size(); i++) {
+		table[i].type = payloads[i].type;
+		table[i].submesh = payloads[i].submesh;
+		table[i].offset = offset;
+		table[i].size = payloads[i].data.size();
+		offset = alignUp(offset + table[i].size);
+	}
+
+	binheader_t header;
+	memset(&header, 0, sizeof(binheader_t));
+	header.magic = EndianFixInt(BMB_MAGIC);
+	header.version = EndianFixShort(BMB_VERSION);
+	header.sectionCount = EndianFixShort((unsigned short)payloads.size());
+	header.submeshCount = EndianFixInt(submeshCount);
+	header.size = EndianFixInt(offset);
+
+	vector<unsigned char> data(offset, 0);
+	memcpy(&data[0], &header, sizeof(binheader_t));
+	for (size_t i = 0; i < table.size(); i++) {
+		binsection_t entry;
+		entry.type = EndianFixInt(table[i].type);
+		entry.submesh = EndianFixInt(table[i].submesh);
+		entry.offset = EndianFixInt(table[i].offset);
+		entry.size = EndianFixInt(table[i].size);
+		memcpy(&data[sizeof(binheader_t) + i * sizeof(binsection_t)], &entry, sizeof(binsection_t));
+		if (!payloads[i].data.empty()) {
+			memcpy(&data[table[i].offset], payloads[i].data.data(), table[i].size);
+		}
+	}
+
+	FILE *outFile = fopen(file.c_str(), "wb");
+	if (outFile == NULL) {
+		return false;
+	}
+	const bool written = fwrite(data.data(), 1, data.size(), outFile) == data.size();
+	fclose(outFile);
+	return written;
+}
+
+bool readBmb(const string& file, bmbfile_t& bmb, string& error) {
+	FILE *inFile = fopen(file.c_str(), "rb");
+	if (inFile == NULL) {
+		error = "unable to open file";
+		return false;
+	}
+	fseek(inFile, 0, SEEK_END);
+	const long length = ftell(inFile);
+	fseek(inFile, 0, SEEK_SET);
+	bmb.data.resize(length > 0 ? length : 0);
+	const bool read = bmb.data.empty() || fread(&bmb.data[0], 1, bmb.data.size(), inFile) == bmb.data.size();
+	fclose(inFile);
+	if (!read) {
+		error = "read failed";
+		return false;
+	}
+
+	if (bmb.data.size() < sizeof(binheader_t)) {
+		error = "file too small";
+		return false;
+	}
+	memcpy(&bmb.header, &bmb.data[0], sizeof(binheader_t));
+	bmb.header.magic = EndianFixInt(bmb.header.magic);
+	bmb.header.version = EndianFixShort(bmb.header.version);
+	bmb.header.sectionCount = EndianFixShort(bmb.header.sectionCount);
+	bmb.header.submeshCount = EndianFixInt(bmb.header.submeshCount);
+	bmb.header.size = EndianFixInt(bmb.header.size);
+
+	if (bmb.header.magic != BMB_MAGIC) {
+		error = "not a .bmb file (bad magic)";
+		return false;
+	}
+	if (bmb.header.version != BMB_VERSION) {
+		error = "unsupported version";
+		return false;
+	}
+	if (bmb.header.size != bmb.data.size() ||
+		sizeof(binheader_t) + bmb.header.sectionCount * sizeof(binsection_t) > bmb.data.size()) {
+		error = "truncated file";
+		return false;
+	}
+
+	bmb.sections.resize(bmb.header.sectionCount);
+	for (unsigned int i = 0; i < bmb.header.sectionCount; i++) {
+		binsection_t& entry = bmb.sections[i];
+		memcpy(&entry, &bmb.data[sizeof(binheader_t) + i * sizeof(binsection_t)], sizeof(binsection_t));
+		entry.type = EndianFixInt(entry.type);
+		entry.submesh = EndianFixInt(entry.submesh);
+		entry.offset = EndianFixInt(entry.offset);
+		entry.size = EndianFixInt(entry.size);
+
+		if (entry.offset % BMB_ALIGN != 0) {
+			error = "misaligned section";
+			return false;
+		}
+		if (entry.offset > bmb.data.size() || entry.size > bmb.data.size() - entry.offset) {
+			error = "section out of bounds";
+			return false;
+		}
+		if (entry.submesh >= bmb.header.submeshCount) {
+			error = "section of a missing submesh";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+const unsigned char* bmbSection(const bmbfile_t& bmb, unsigned int type, unsigned int submesh, unsigned int* size) {
+	for (size_t i = 0; i < bmb.sections.size(); i++) {
+		if (bmb.sections[i].type == type && bmb.sections[i].submesh == submesh) {
+			if (size != NULL) {
+				*size = bmb.sections[i].size;
+			}
+			return &bmb.data[bmb.sections[i].offset];
+		}
+	}
+	return NULL;
+}
+
+bool bmbMeshInfo(const bmbfile_t& bmb, unsigned int submesh, binmesh_t& info) {
+	unsigned int size;
+	const unsigned char* data = bmbSection(bmb, BMB_SECTION_MESH, submesh, &size);
+	if (data == NULL || size < sizeof(binmesh_t)) {
+		return false;
+	}
+	memcpy(&info, data, sizeof(binmesh_t));
+	info.vcount = EndianFixInt(info.vcount);
+	info.ncount = EndianFixInt(info.ncount);
+	info.vtcount = EndianFixInt(info.vtcount);
+	info.fcount = EndianFixInt(info.fcount);
+	info.material = EndianFixShort(info.material);
+	return true;
+}
+
+binmaterial_t makeMaterial(const string& name, const string& texture) {
+	binmaterial_t entry;
+	memset(&entry, 0, sizeof(binmaterial_t));
+	strncpy(entry.name, name.c_str(), sizeof(entry.name) - 1);
+
+	// Just the file name, the game picks textures by name
+	const size_t slash = texture.find_last_of("/\\");
+	const string file = slash != string::npos ? texture.substr(slash + 1) : texture;
+	strncpy(entry.texture, file.c_str(), sizeof(entry.texture) - 1);
+	return entry;
+}
+
+const char* bmbSectionName(unsigned int type) {
+	switch (type) {
+	case BMB_SECTION_MESH:			return "mesh";
+	case BMB_SECTION_POSITIONS:		return "positions";
+	case BMB_SECTION_NORMALS:		return "normals";
+	case BMB_SECTION_TEXCOORDS:		return "texcoords";
+	case BMB_SECTION_INDICES:		return "indices";
+	case BMB_SECTION_BOUNDS:		return "bounds";
+	case BMB_SECTION_BVH:			return "bvh";
+	case BMB_SECTION_DISPLAYLIST:	return "displaylist";
+	case BMB_SECTION_LOD:			return "lod";
+	case BMB_SECTION_MATERIALS:		return "materials";
+	default:						return "unknown";
+	}
+}
@@ -0,0 +1,101 @@
+#ifndef _BMBFILE_H
+#define _BMBFILE_H
+
+#include <vector>
+#include <string>
+
+// Container layout, everything big endian:
+//   binheader_t, binsection_t[sectionCount], payloads (each 32 byte aligned)
+// Unknown section types are skipped by readers, so new data doesn't break old code.
+
+#define BMB_MAGIC		0x424D4246	// "BMBF"
+#define BMB_VERSION		1
+#define BMB_ALIGN		32
+
+// Section types
+enum {
+	BMB_SECTION_MESH		= 1,	// binmesh_t, counts and vertex formats of a submesh
+	BMB_SECTION_POSITIONS	= 2,	// Position array
+	BMB_SECTION_NORMALS		= 3,	// Normal array
+	BMB_SECTION_TEXCOORDS	= 4,	// Texture coordinate array
+	BMB_SECTION_INDICES		= 5,	// Reserved: index lists for CPU side use
+	BMB_SECTION_BOUNDS		= 6,	// binbounds_t, axis aligned box of the positions
+	BMB_SECTION_BVH			= 7,	// Reserved: raycast acceleration
+	BMB_SECTION_DISPLAYLIST	= 8,	// GX display list drawing the submesh
+	BMB_SECTION_LOD			= 9,	// Reserved: lower detail display lists
+	BMB_SECTION_MATERIALS	= 10	// binmaterial_t table (submesh 0), indexed by binmesh_t.material
+};
+
+typedef struct {
+	unsigned int	magic;			// BMB_MAGIC
+	unsigned short	version;		// BMB_VERSION
+	unsigned short	sectionCount;	// Entries in the section table
+	unsigned int	submeshCount;	// Submeshes, each with its own arrays
+	unsigned int	size;			// Whole file size
+	unsigned int	reserved[4];
+} binheader_t;
+
+typedef struct {
+	unsigned int	type;			// BMB_SECTION_*
+	unsigned int	submesh;		// Submesh the section belongs to
+	unsigned int	offset;			// From the start of the file, BMB_ALIGN aligned
+	unsigned int	size;			// Payload size in bytes
+} binsection_t;
+
+typedef struct {
+	unsigned int	vcount;
+	unsigned int	ncount;
+	unsigned int	vtcount;
+	unsigned int	fcount;
+	unsigned char	posType;	// COMP_* of positions
+	unsigned char	posFrac;	// Fractional bits of positions
+	unsigned char	nrmType;	// COMP_* of normals
+	unsigned char	nrmFrac;	// Fractional bits of normals (6 for S8, 14 for S16)
+	unsigned char	texType;	// COMP_* of texture coordinates
+	unsigned char	texFrac;	// Fractional bits of texture coordinates
+	unsigned short	material;	// Entry in the material table
+} binmesh_t;
+
+typedef struct {
+	char			name[32];		// Material name, zero padded
+	char			texture[32];	// Diffuse texture file name (no path), empty if none
+} binmaterial_t;
+
+typedef struct {
+	float			min[3];
+	float			max[3];
+} binbounds_t;
+
+// A section to write, data in file (big endian) order
+typedef struct {
+	unsigned int				type;
+	unsigned int				submesh;
+	std::vector<unsigned char>	data;
+} bmbpayload_t;
+
+// A .bmb loaded in memory, header and table converted to host order
+typedef struct {
+	std::vector<unsigned char>	data;
+	binheader_t					header;
+	std::vector<binsection_t>	sections;
+} bmbfile_t;
+
+// Write a container with the given sections
+bool writeBmb(const std::string& file, unsigned int submeshCount, const std::vector<bmbpayload_t>& payloads);
+
+// Load and validate a container (magic, version, section bounds and alignment)
+bool readBmb(const std::string& file, bmbfile_t& bmb, std::string& error);
+
+// Find a section's payload, returns NULL if the file doesn't have it
+const unsigned char* bmbSection(const bmbfile_t& bmb, unsigned int type, unsigned int submesh, unsigned int* size);
+
+// Mesh info of a submesh in host order, false if missing
+bool bmbMeshInfo(const bmbfile_t& bmb, unsigned int submesh, binmesh_t& info);
+
+// Material table entry, names cut to fit and the texture stripped of its path
+binmaterial_t makeMaterial(const std::string& name, const std::string& texture);
+
+// Section name (for reports)
+const char* bmbSectionName(unsigned int type);
+
+#endif
@@ -0,0 +1,45 @@
+// dedupe.cpp : Per-attribute stream deduplication
+//
+
+#include "obj2bin.h"
+
+#include <map>
+#include <cmath>
+#include <cstring>
+using namespace std;
+
+vector<unsigned int> dedupeStream(const vector<float>& values, unsigned int components, float epsilon, vector<float>& unique) {
+	const unsigned int count = values.size() / components;
+	vector<unsigned int> remap(count);
+	map<vector<long long>, unsigned int> seen;
+	vector<long long> key(components);
+
+	unique.clear();
+	for (unsigned int i = 0; i < count; i++) {
+		const float* v = &values[i * components];
+		for (unsigned int c = 0; c < components; c++) {
+			if (epsilon > 0) {
+				// Snap to an epsilon grid, anything in the same cell is merged
+				key[c] = (long long)floor(v[c] / epsilon);
+			} else {
+				// Exact match on the bit pattern (-0 and 0 still differ, like the source data)
+				unsigned int bits;
+				memcpy(&bits, &v[c], sizeof(bits));
+				key[c] = bits;
+			}
+		}
+
+		map<vector<long long>, unsigned int>::iterator it = seen.find(key);
+		if (it != seen.end()) {
+			remap[i] = it->second;
+			continue;
+		}
+
+		const unsigned int id = unique.size() / components;
+		seen.insert(make_pair(key, id));
+		unique.insert(unique.end(), v, v + components);
+		remap[i] = id;
+	}
+
+	return remap;
+}
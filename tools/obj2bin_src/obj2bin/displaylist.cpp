@@ -0,0 +1,101 @@
+// displaylist.cpp : GX display list encoding and decoding
+//
+
+#include "obj2bin.h"
+
+#include <algorithm>
+using namespace std;
+
+static void putShort(vector<unsigned char>& out, unsigned short value) {
+	out.push_back(HIBYTE(value));
+	out.push_back(LOBYTE(value));
+}
+
+static void putVertex(vector<unsigned char>& out, const dlindex_t& index) {
+	// Same order GX reads them with GX_INDEX16 descriptors: position, normal, texcoord
+	putShort(out, (unsigned short)index.position);
+	putShort(out, (unsigned short)index.normal);
+	putShort(out, (unsigned short)index.texcoord);
+}
+
+void encodeDisplayList(vector<unsigned char>& out, const vector<unsigned int>& stripLengths,
+					   unsigned int looseCount, const vector<dlindex_t>& corners) {
+	size_t corner = 0;
+	for (size_t s = 0; s < stripLengths.size(); s++) {
+		out.push_back(DL_TRIANGLESTRIP | DL_VTXFMT0);
+		putShort(out, (unsigned short)stripLengths[s]);
+		for (unsigned int i = 0; i < stripLengths[s]; i++) {
+			putVertex(out, corners[corner++]);
+		}
+	}
+
+	// Loose triangles, split when over the 16-bit vertex count
+	unsigned int remaining = looseCount * 3;
+	while (remaining > 0) {
+		const unsigned int count = min(remaining, (unsigned int)DL_LIST_MAX);
+		out.push_back(DL_TRIANGLES | DL_VTXFMT0);
+		putShort(out, (unsigned short)count);
+		for (unsigned int i = 0; i < count; i++) {
+			putVertex(out, corners[corner++]);
+		}
+		remaining -= count;
+	}
+
+	// GX_CallDispList wants a multiple of 32 bytes, fill with NOPs
+	while (out.size() % 32 != 0) {
+		out.push_back(DL_NOP);
+	}
+}
+
+bool decodeDisplayList(const unsigned char* data, size_t size, vector<dlindex_t>& triangles) {
+	triangles.clear();
+	if (size % 32 != 0) {
+		return false;
+	}
+
+	size_t pos = 0;
+	while (pos < size) {
+		const unsigned char command = data[pos++];
+		if (command == DL_NOP) {
+			continue;
+		}
+
+		const unsigned char primitive = command & ~DL_VTXFMT_MASK;
+		if ((command & DL_VTXFMT_MASK) != DL_VTXFMT0 ||
+			(primitive != DL_TRIANGLES && primitive != DL_TRIANGLESTRIP) ||
+			pos + 2 > size) {
+			return false;
+		}
+
+		const unsigned int count = (data[pos] << 8) | data[pos + 1];
+		pos += 2;
+		if (pos + count * 6 > size) {
+			return false;
+		}
+
+		vector<dlindex_t> vertices(count);
+		for (unsigned int i = 0; i < count; i++) {
+			const unsigned char* v = &data[pos + i * 6];
+			vertices[i].position = (v[0] << 8) | v[1];
+			vertices[i].normal = (v[2] << 8) | v[3];
+			vertices[i].texcoord = (v[4] << 8) | v[5];
+		}
+		pos += count * 6;
+
+		if (primitive == DL_TRIANGLES) {
+			if (count % 3 != 0) {
+				return false;
+			}
+			triangles.insert(triangles.end(), vertices.begin(), vertices.end());
+		} else {
+			// Odd triangles in a strip are wound backwards
+			for (unsigned int k = 0; k + 2 < count; k++) {
+				triangles.push_back(vertices[k % 2 == 0 ? k : k + 1]);
+				triangles.push_back(vertices[k % 2 == 0 ? k + 1 : k]);
+				triangles.push_back(vertices[k + 2]);
+			}
+		}
+	}
+
+	return true;
+}
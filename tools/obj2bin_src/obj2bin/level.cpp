@@ -0,0 +1,762 @@
+// level.cpp : Level compiler (.lvl description to .blv)
+//
+// A .lvl lists what makes up a level, one keyword per line ('#' starts a comment):
+//   terrain <model> [position x y z] [scale x y z] [spin s]   ground, drawn lit
+//   water <model> [position x y z] [scale x y z]              its height is the water level
+//   prop <model> [position x y z] [scale x y z] [spin s]      drawn lit
+//   checkpoint <model> [offset x y z] [scale x y z] [spin s]  follows the checkpoint
+//   pickups <model> [spin s]                                  model of every pickup
+//   pickup x y z                                              a pickup position
+//   spawn x0 y0 z0 x1 y1 z1                                   area players can start in
+//   checkpoints x0 z0 x1 z1 spacing s depth d                 grid of checkpoint candidates,
+//                                                             kept where the ground is d under water
+//   camera x y z tx ty tz                                     spectator camera and target
+//   heightfield cells                                         ground samples along the longest side
+//   tiles count                                               tiles along the longest side (default 1)
+//   stream radius r budget bytes slots count                  what the game keeps loaded around players
+// Everything the game would work out at load time (ground heights, where the
+// checkpoint can go) is computed here, so loading a level is a pointer fixup.
+// The terrain and props are cut in tiles written next to the level, the game
+// streams them in and out around the players.
+
+#include "obj2bin.h"
+#include "levelfile.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <ostream>
+#include <algorithm>
+using namespace std;
+
+typedef struct {
+	string			model;
+	unsigned int	role;
+	float			position[3];
+	float			scale[3];
+	float			spin;
+} objectdesc_t;
+
+typedef struct {
+	vector<objectdesc_t>	objects;
+	string					pickupModel;
+	float					pickupSpin;
+	vector<float>			pickups;		// 3 floats each
+	vector<levelarea_t>		spawns;
+	float					area[4];		// Checkpoint grid x0 z0 x1 z1
+	float					spacing;
+	float					depth;
+	float					camera[6];
+	unsigned int			cells;
+	unsigned int			tiles;
+	float					streamRadius;
+	unsigned int			streamBudget;
+	unsigned int			streamSlots;
+} leveldesc_t;
+
+// World space terrain triangles, 3 corners each
+typedef struct {
+	vector<float>			positions;	// 9 floats per triangle
+	vector<float>			normals;	// 9 floats per triangle
+	vector<float>			texcoords;	// 6 floats per triangle, v up as in sourcemesh_t
+	vector<unsigned int>	materials;	// Per triangle, index in materialTable
+	vector<binmaterial_t>	materialTable;
+	string					model;		// First terrain model
+	float					min[3];
+	float					max[3];
+} terrain_t;
+
+typedef struct {
+	levelground_t			info;
+	vector<float>			heights;
+	vector<signed char>		normals;
+} ground_t;
+
+static bool parseObject(istringstream& fields, unsigned int role, objectdesc_t& object) {
+	object.role = role;
+	object.position[0] = object.position[1] = object.position[2] = 0;
+	object.scale[0] = object.scale[1] = object.scale[2] = 1;
+	object.spin = 0;
+	if (!(fields >> object.model) || object.model.size() >= LEVEL_NAME_LENGTH) {
+		return false;
+	}
+	string key;
+	while (fields >> key) {
+		if (key == "position" || key == "offset") {
+			if (!(fields >> object.position[0] >> object.position[1] >> object.position[2])) return false;
+		} else if (key == "scale") {
+			if (!(fields >> object.scale[0] >> object.scale[1] >> object.scale[2])) return false;
+		} else if (key == "spin") {
+			if (!(fields >> object.spin)) return false;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool readLevel(const string& file, leveldesc_t& level, string& error) {
+	ifstream in(file.c_str());
+	if (!in) {
+		error = "unable to open " + file;
+		return false;
+	}
+	level.pickupSpin = 0;
+	level.area[0] = level.area[1] = level.area[2] = level.area[3] = 0;
+	level.spacing = 0;
+	level.depth = 0;
+	memset(level.camera, 0, sizeof(level.camera));
+	level.cells = 128;
+	level.tiles = 1;
+	level.streamRadius = 0;
+	level.streamBudget = 0;
+	level.streamSlots = 0;
+
+	string line;
+	unsigned int number = 0;
+	while (getline(in, line)) {
+		number++;
+		const size_t comment = line.find('#');
+		if (comment != string::npos) {
+			line.erase(comment);
+		}
+		istringstream fields(line);
+		string keyword, key;
+		if (!(fields >> keyword)) {
+			continue;
+		}
+
+		bool ok = true;
+		if (keyword == "terrain" || keyword == "water" || keyword == "prop" || keyword == "checkpoint") {
+			objectdesc_t object;
+			const unsigned int role = keyword == "terrain" ? LEVEL_ROLE_TERRAIN
+				: keyword == "water" ? LEVEL_ROLE_WATER
+				: keyword == "prop" ? LEVEL_ROLE_PROP : LEVEL_ROLE_CHECKPOINT;
+			ok = parseObject(fields, role, object);
+			level.objects.push_back(object);
+		} else if (keyword == "pickups") {
+			ok = (fields >> level.pickupModel) && level.pickupModel.size() < LEVEL_NAME_LENGTH;
+			if (ok && fields >> key) {
+				ok = key == "spin" && (fields >> level.pickupSpin);
+			}
+		} else if (keyword == "pickup") {
+			float position[3];
+			ok = (bool)(fields >> position[0] >> position[1] >> position[2]);
+			level.pickups.insert(level.pickups.end(), position, position + 3);
+		} else if (keyword == "spawn") {
+			levelarea_t area;
+			ok = (bool)(fields >> area.min[0] >> area.min[1] >> area.min[2] >> area.max[0] >> area.max[1] >> area.max[2]);
+			level.spawns.push_back(area);
+		} else if (keyword == "checkpoints") {
+			string depthKey;
+			ok = (fields >> level.area[0] >> level.area[1] >> level.area[2] >> level.area[3] >> key >> level.spacing >> depthKey >> level.depth)
+				&& key == "spacing" && depthKey == "depth" && level.spacing > 0;
+		} else if (keyword == "camera") {
+			ok = (bool)(fields >> level.camera[0] >> level.camera[1] >> level.camera[2] >> level.camera[3] >> level.camera[4] >> level.camera[5]);
+		} else if (keyword == "heightfield") {
+			ok = (fields >> level.cells) && level.cells > 0;
+		} else if (keyword == "tiles") {
+			ok = (fields >> level.tiles) && level.tiles > 0;
+		} else if (keyword == "stream") {
+			string budgetKey, slotsKey;
+			ok = (fields >> key >> level.streamRadius >> budgetKey >> level.streamBudget >> slotsKey >> level.streamSlots)
+				&& key == "radius" && budgetKey == "budget" && slotsKey == "slots" && level.streamSlots > 0;
+		} else {
+			ok = false;
+		}
+		if (ok && fields >> key) {
+			ok = false;
+		}
+		if (!ok) {
+			ostringstream where;
+			where << file << ":" << number << ": bad " << keyword << " line";
+			error = where.str();
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool loadTerrain(const string& file, const objectdesc_t& object, terrain_t& terrain, string& error) {
+	bmbfile_t bmb;
+	if (!readBmb(file, bmb, error)) {
+		error = file + ": " + error;
+		return false;
+	}
+	// Materials keep their names and textures in the tiles
+	unsigned int tableSize = 0;
+	const unsigned char* table = bmbSection(bmb, BMB_SECTION_MATERIALS, 0, &tableSize);
+	const unsigned int materialBase = terrain.materialTable.size();
+	const unsigned int materialCount = table != NULL ? tableSize / sizeof(binmaterial_t) : 0;
+	for (unsigned int i = 0; i < materialCount; i++) {
+		binmaterial_t material;
+		memcpy(&material, table + i * sizeof(binmaterial_t), sizeof(binmaterial_t));
+		terrain.materialTable.push_back(material);
+	}
+	if (materialCount == 0) {
+		terrain.materialTable.push_back(makeMaterial("terrain", ""));
+	}
+	if (terrain.model.empty()) {
+		terrain.model = object.model;
+	}
+
+	for (unsigned int submesh = 0; submesh < bmb.header.submeshCount; submesh++) {
+		binmesh_t info;
+		unsigned int positionSize, normalSize, listSize, texcoordSize = 0;
+		const unsigned char* positionData = bmbSection(bmb, BMB_SECTION_POSITIONS, submesh, &positionSize);
+		const unsigned char* normalData = bmbSection(bmb, BMB_SECTION_NORMALS, submesh, &normalSize);
+		const unsigned char* list = bmbSection(bmb, BMB_SECTION_DISPLAYLIST, submesh, &listSize);
+		const unsigned char* texcoordData = bmbSection(bmb, BMB_SECTION_TEXCOORDS, submesh, &texcoordSize);
+		vector<dlindex_t> corners;
+		if (!bmbMeshInfo(bmb, submesh, info) || positionData == NULL || normalData == NULL || list == NULL
+			|| positionSize < info.vcount * 3 * componentSize(info.posType)
+			|| normalSize < info.ncount * 3 * componentSize(info.nrmType)
+			|| (info.vtcount > 0 && (texcoordData == NULL || texcoordSize < info.vtcount * 2 * componentSize(info.texType)))
+			|| !decodeDisplayList(list, listSize, corners)) {
+			error = file + ": unsupported mesh data";
+			return false;
+		}
+		vector<float> positions, normals, texcoords;
+		readQuantized(positionData, info.vcount * 3, info.posType, info.posFrac, positions);
+		readQuantized(normalData, info.ncount * 3, info.nrmType, info.nrmFrac, normals);
+		if (info.vtcount > 0) {
+			readQuantized(texcoordData, info.vtcount * 2, info.texType, info.texFrac, texcoords);
+		}
+
+		for (size_t i = 0; i < corners.size(); i++) {
+			if (corners[i].position >= info.vcount || corners[i].normal >= info.ncount
+				|| (info.vtcount > 0 && corners[i].texcoord >= info.vtcount)) {
+				error = file + ": index out of range";
+				return false;
+			}
+			if (i % 3 == 0) {
+				terrain.materials.push_back(materialBase + (info.material < materialCount ? info.material : 0));
+			}
+			// Texture coordinates go back to v up, the way obj2bin reads models
+			const float u = info.vtcount > 0 ? texcoords[corners[i].texcoord * 2] : 0;
+			const float t = info.vtcount > 0 ? texcoords[corners[i].texcoord * 2 + 1] : 0;
+			terrain.texcoords.push_back(u);
+			terrain.texcoords.push_back(1.0f - t);
+			// Normals go through the inverse scale so they stay perpendicular
+			float normal[3], length = 0;
+			for (int c = 0; c < 3; c++) {
+				const float value = object.position[c] + object.scale[c] * positions[corners[i].position * 3 + c];
+				terrain.positions.push_back(value);
+				terrain.min[c] = min(terrain.min[c], value);
+				terrain.max[c] = max(terrain.max[c], value);
+				normal[c] = normals[corners[i].normal * 3 + c] / object.scale[c];
+				length += normal[c] * normal[c];
+			}
+			length = length > 0 ? sqrt(length) : 1;
+			for (int c = 0; c < 3; c++) {
+				terrain.normals.push_back(normal[c] / length);
+			}
+		}
+	}
+	return true;
+}
+
+// Barycentric weights of (x, z) in the triangle seen from above, false if outside
+static bool triangleWeights(const float* p, float x, float z, float weights[3]) {
+	const float d = (p[5] - p[8]) * (p[0] - p[6]) + (p[6] - p[3]) * (p[2] - p[8]);
+	if (fabs(d) < 1e-12f) {
+		return false;
+	}
+	weights[0] = ((p[5] - p[8]) * (x - p[6]) + (p[6] - p[3]) * (z - p[8])) / d;
+	weights[1] = ((p[8] - p[2]) * (x - p[6]) + (p[0] - p[6]) * (z - p[8])) / d;
+	weights[2] = 1 - weights[0] - weights[1];
+	const float epsilon = -1e-5f;
+	return weights[0] >= epsilon && weights[1] >= epsilon && weights[2] >= epsilon;
+}
+
+// Highest terrain point under (x, z), the exact answer the heightfield approximates
+static bool terrainHeight(const terrain_t& terrain, float x, float z, float& height) {
+	bool hit = false;
+	for (size_t t = 0; t < terrain.positions.size(); t += 9) {
+		const float* p = &terrain.positions[t];
+		float weights[3];
+		if (!triangleWeights(p, x, z, weights)) {
+			continue;
+		}
+		const float y = weights[0] * p[1] + weights[1] * p[4] + weights[2] * p[7];
+		if (!hit || y > height) {
+			height = y;
+			hit = true;
+		}
+	}
+	return hit;
+}
+
+// Highest terrain height (and its normal) at every point of a grid, LEVEL_NO_GROUND where there is none
+static void rasterize(const terrain_t& terrain, float originX, float originZ, float cellSize, unsigned int width, unsigned int depth,
+					  vector<float>& heights, vector<signed char>* normals) {
+	heights.assign(width * depth, LEVEL_NO_GROUND);
+	if (normals != NULL) {
+		normals->assign(width * depth * 4, 0);
+	}
+
+	// Every triangle from above, the highest one wins each sample
+	for (size_t t = 0; t < terrain.positions.size(); t += 9) {
+		const float* p = &terrain.positions[t];
+		const float* n = &terrain.normals[t];
+		const float minX = min(p[0], min(p[3], p[6])), maxX = max(p[0], max(p[3], p[6]));
+		const float minZ = min(p[2], min(p[5], p[8])), maxZ = max(p[2], max(p[5], p[8]));
+		const int x0 = max(0, (int)ceil((minX - originX) / cellSize - 1e-4f));
+		const int x1 = min((int)width - 1, (int)floor((maxX - originX) / cellSize + 1e-4f));
+		const int z0 = max(0, (int)ceil((minZ - originZ) / cellSize - 1e-4f));
+		const int z1 = min((int)depth - 1, (int)floor((maxZ - originZ) / cellSize + 1e-4f));
+		for (int sz = z0; sz <= z1; sz++) {
+			for (int sx = x0; sx <= x1; sx++) {
+				float weights[3];
+				if (!triangleWeights(p, originX + sx * cellSize, originZ + sz * cellSize, weights)) {
+					continue;
+				}
+				const unsigned int sample = sz * width + sx;
+				const float y = weights[0] * p[1] + weights[1] * p[4] + weights[2] * p[7];
+				if (y <= heights[sample]) {
+					continue;
+				}
+				heights[sample] = y;
+				if (normals == NULL) {
+					continue;
+				}
+
+				float normal[3], length = 0;
+				for (int c = 0; c < 3; c++) {
+					normal[c] = weights[0] * n[c] + weights[1] * n[3 + c] + weights[2] * n[6 + c];
+					length += normal[c] * normal[c];
+				}
+				length = length > 0 ? sqrt(length) : 1;
+				for (int c = 0; c < 3; c++) {
+					(*normals)[sample * 4 + c] = (signed char)floor(normal[c] / length * 127 + 0.5f);
+				}
+			}
+		}
+	}
+}
+
+static void buildGround(const terrain_t& terrain, unsigned int cells, ground_t& ground) {
+	const float extentX = terrain.max[0] - terrain.min[0], extentZ = terrain.max[2] - terrain.min[2];
+	levelground_t& info = ground.info;
+	info.originX = terrain.min[0];
+	info.originZ = terrain.min[2];
+	info.cellSize = max(extentX, extentZ) / cells;
+	info.width = max(2u, (unsigned int)ceil(extentX / info.cellSize - 1e-4f) + 1);
+	info.depth = max(2u, (unsigned int)ceil(extentZ / info.cellSize - 1e-4f) + 1);
+	rasterize(terrain, info.originX, info.originZ, info.cellSize, info.width, info.depth, ground.heights, &ground.normals);
+
+	// Each cell is two triangles, split along the diagonal closest to the terrain
+	// at the cell centre (a grid lined up with a grid terrain is then exact)
+	vector<float> centres;
+	const float half = info.cellSize / 2;
+	rasterize(terrain, info.originX + half, info.originZ + half, info.cellSize, info.width - 1, info.depth - 1, centres, NULL);
+	for (unsigned int z = 0; z + 1 < info.depth; z++) {
+		for (unsigned int x = 0; x + 1 < info.width; x++) {
+			const float* row = &ground.heights[z * info.width + x];
+			const float centre = centres[z * (info.width - 1) + x];
+			const float falling = (row[0] + row[info.width + 1]) / 2, rising = (row[1] + row[info.width]) / 2;
+			if (fabs(rising - centre) < fabs(falling - centre)) {
+				ground.normals[(z * info.width + x) * 4 + 3] = LEVEL_SPLIT_RISING;
+			}
+		}
+	}
+}
+
+// Ground height, the same as LEVEL_ground in the game
+static bool groundHeight(const ground_t& ground, float x, float z, float& height) {
+	const levelground_t& info = ground.info;
+	const float fx = (x - info.originX) / info.cellSize, fz = (z - info.originZ) / info.cellSize;
+	if (fx < 0 || fz < 0 || fx > info.width - 1 || fz > info.depth - 1) {
+		return false;
+	}
+	const unsigned int ix = min((unsigned int)fx, info.width - 2), iz = min((unsigned int)fz, info.depth - 2);
+	const float tx = fx - ix, tz = fz - iz;
+	const unsigned int sample = iz * info.width + ix;
+	const float* row = &ground.heights[sample];
+	const float h00 = row[0], h10 = row[1], h01 = row[info.width], h11 = row[info.width + 1];
+	if (h00 == LEVEL_NO_GROUND || h10 == LEVEL_NO_GROUND || h01 == LEVEL_NO_GROUND || h11 == LEVEL_NO_GROUND) {
+		return false;
+	}
+	if (ground.normals[sample * 4 + 3] == LEVEL_SPLIT_RISING) {
+		height = tx + tz <= 1 ? h00 + (h10 - h00) * tx + (h01 - h00) * tz
+			: h11 + (h01 - h11) * (1 - tx) + (h10 - h11) * (1 - tz);
+	} else {
+		height = tx >= tz ? h00 + (h10 - h00) * tx + (h11 - h10) * tz
+			: h00 + (h11 - h01) * tx + (h01 - h00) * tz;
+	}
+	return true;
+}
+
+static unsigned int alignUp(unsigned int value) {
+	return (value + LEVEL_ALIGN - 1) & ~(LEVEL_ALIGN - 1);
+}
+
+// Append a big endian array, returns its offset
+static unsigned int appendArray(vector<unsigned char>& file, const void* data, size_t size) {
+	const unsigned int offset = alignUp(file.size());
+	file.resize(offset + size, 0);
+	if (size > 0) {
+		memcpy(&file[offset], data, size);
+	}
+	return offset;
+}
+
+static void swapFloats(float* values, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		values[i] = EndianFixFloat(values[i]);
+	}
+}
+
+static void copyName(char* name, const string& value) {
+	memset(name, 0, LEVEL_NAME_LENGTH);
+	strncpy(name, value.c_str(), LEVEL_NAME_LENGTH - 1);
+}
+
+static void packObjects(const vector<objectdesc_t>& list, vector<levelobject_t>& out) {
+	out.resize(list.size());
+	for (size_t i = 0; i < list.size(); i++) {
+		const objectdesc_t& object = list[i];
+		levelobject_t& entry = out[i];
+		copyName(entry.model, object.model);
+		entry.role = EndianFixInt(object.role);
+		for (int c = 0; c < 3; c++) {
+			entry.position[c] = EndianFixFloat(object.position[c]);
+			entry.scale[c] = EndianFixFloat(object.scale[c]);
+		}
+		entry.spin = EndianFixFloat(object.spin);
+	}
+}
+
+// Heightfield info in file order, heights and normals hold their offsets
+static void packGround(const levelground_t& info, levelground_t& out) {
+	out.originX = EndianFixFloat(info.originX);
+	out.originZ = EndianFixFloat(info.originZ);
+	out.cellSize = EndianFixFloat(info.cellSize);
+	out.width = EndianFixInt(info.width);
+	out.depth = EndianFixInt(info.depth);
+	out.heights = EndianFixInt(info.heights);
+	out.normals = EndianFixInt(info.normals);
+}
+
+static bool writeFile(const string& path, const vector<unsigned char>& data, ostream& log) {
+	FILE* outFile = fopen(path.c_str(), "wb");
+	if (outFile == NULL) {
+		log << "Error, unable to open " << path << "\n";
+		return false;
+	}
+	const bool written = fwrite(&data[0], 1, data.size(), outFile) == data.size();
+	fclose(outFile);
+	if (!written) {
+		log << "Error, unable to write " << path << "\n";
+	}
+	return written;
+}
+
+// Tile a point is on (clamped to the grid)
+static unsigned int tileAt(const levelground_t& info, float tileSize, unsigned int tilesX, unsigned int tilesZ, float x, float z) {
+	const int tx = (int)floor((x - info.originX) / tileSize), tz = (int)floor((z - info.originZ) / tileSize);
+	return min(max(tz, 0), (int)tilesZ - 1) * tilesX + min(max(tx, 0), (int)tilesX - 1);
+}
+
+// Convert some terrain triangles (moved so origin is 0) to .bmb like any model
+static bool buildTileMesh(const terrain_t& terrain, const vector<unsigned int>& triangles, float originX, float originZ,
+						  const convopts_t& opts, const string& tempFile, vector<unsigned char>& bmb, ostream& log) {
+	sourcescene_t scene;
+	scene.materials = terrain.materialTable;
+	scene.meshes.resize(terrain.materialTable.size());
+	for (size_t m = 0; m < scene.meshes.size(); m++) {
+		scene.meshes[m].material = m;
+	}
+	for (size_t i = 0; i < triangles.size(); i++) {
+		const unsigned int t = triangles[i];
+		sourcemesh_t& mesh = scene.meshes[terrain.materials[t]];
+		for (int corner = 0; corner < 3; corner++) {
+			const float* p = &terrain.positions[t * 9 + corner * 3];
+			mesh.triangles.push_back(mesh.positions.size() / 3);
+			mesh.positions.push_back(p[0] - originX);
+			mesh.positions.push_back(p[1]);
+			mesh.positions.push_back(p[2] - originZ);
+			mesh.normals.insert(mesh.normals.end(), &terrain.normals[t * 9 + corner * 3], &terrain.normals[t * 9 + corner * 3 + 3]);
+			mesh.texcoords.insert(mesh.texcoords.end(), &terrain.texcoords[t * 6 + corner * 2], &terrain.texcoords[t * 6 + corner * 2 + 2]);
+		}
+	}
+
+	// saveBinfile reports every step, only show it when something goes wrong
+	ostringstream report;
+	bmbfile_t file;
+	string error;
+	const bool saved = saveBinfile(tempFile, scene, opts, report) && readBmb(tempFile, file, error);
+	remove(tempFile.c_str());
+	if (!saved) {
+		log << report.str() << "Error, unable to convert a terrain tile " << error << "\n";
+		return false;
+	}
+	bmb.swap(file.data);
+	return true;
+}
+
+bool compileLevel(const string& input, const string& output, const string& modelDir, const convopts_t& opts, ostream& log) {
+	leveldesc_t level;
+	string error;
+	if (!readLevel(input, level, error)) {
+		log << "Error, " << error << "\n";
+		return false;
+	}
+
+	// Ground and water
+	terrain_t terrain;
+	for (int c = 0; c < 3; c++) {
+		terrain.min[c] = 1e30f;
+		terrain.max[c] = -1e30f;
+	}
+	float waterLevel = LEVEL_NO_GROUND;
+	for (size_t i = 0; i < level.objects.size(); i++) {
+		const objectdesc_t& object = level.objects[i];
+		if (object.role == LEVEL_ROLE_TERRAIN) {
+			const string file = modelDir.empty() ? object.model : modelDir + "/" + object.model;
+			if (!loadTerrain(file, object, terrain, error)) {
+				log << "Error, " << error << "\n";
+				return false;
+			}
+		} else if (object.role == LEVEL_ROLE_WATER) {
+			waterLevel = object.position[1];
+		}
+	}
+	if (terrain.positions.empty()) {
+		log << "Error, " << input << " has no terrain\n";
+		return false;
+	}
+	if (level.pickupModel.empty() && !level.pickups.empty()) {
+		log << "Error, " << input << " has pickups but no pickup model\n";
+		return false;
+	}
+	if (level.spawns.empty()) {
+		log << "Error, " << input << " has no spawn area\n";
+		return false;
+	}
+
+	ground_t ground;
+	buildGround(terrain, level.cells, ground);
+
+	// Checkpoints go where the ground is far enough under water
+	vector<levelpoint_t> checkpoints;
+	if (level.spacing > 0) {
+		for (float z = level.area[1]; z <= level.area[3]; z += level.spacing) {
+			for (float x = level.area[0]; x <= level.area[2]; x += level.spacing) {
+				float height;
+				if (groundHeight(ground, x, z, height) && height <= waterLevel - level.depth) {
+					const levelpoint_t point = { x, z };
+					checkpoints.push_back(point);
+				}
+			}
+		}
+		if (checkpoints.empty()) {
+			log << "Error, " << input << " has no ground " << level.depth << " under water in the checkpoint area\n";
+			return false;
+		}
+	}
+
+	// How far the heightfield is from the triangles
+	float worstError = 0;
+	srand(1);
+	for (unsigned int i = 0; i < 4096; i++) {
+		const float x = terrain.min[0] + (terrain.max[0] - terrain.min[0]) * rand() / RAND_MAX;
+		const float z = terrain.min[2] + (terrain.max[2] - terrain.min[2]) * rand() / RAND_MAX;
+		float exact, sampled;
+		if (terrainHeight(terrain, x, z, exact) && groundHeight(ground, x, z, sampled)) {
+			worstError = max(worstError, fabs(exact - sampled));
+		}
+	}
+
+	// Tiles, a whole number of heightfield cells each
+	const unsigned int cellsX = ground.info.width - 1, cellsZ = ground.info.depth - 1;
+	const unsigned int tileCells = (max(cellsX, cellsZ) + level.tiles - 1) / level.tiles;
+	const unsigned int tilesX = (cellsX + tileCells - 1) / tileCells, tilesZ = (cellsZ + tileCells - 1) / tileCells;
+	const float tileSize = tileCells * ground.info.cellSize;
+
+	// Triangles and props go to the tile under their centre, the rest stays in the level
+	vector<vector<unsigned int> > tileTriangles(tilesX * tilesZ);
+	for (unsigned int t = 0; t < terrain.positions.size() / 9; t++) {
+		const float* p = &terrain.positions[t * 9];
+		const unsigned int tile = tileAt(ground.info, tileSize, tilesX, tilesZ, (p[0] + p[3] + p[6]) / 3, (p[2] + p[5] + p[8]) / 3);
+		tileTriangles[tile].push_back(t);
+	}
+	vector<vector<objectdesc_t> > tileProps(tilesX * tilesZ);
+	vector<objectdesc_t> globalObjects;
+	for (size_t i = 0; i < level.objects.size(); i++) {
+		const objectdesc_t& object = level.objects[i];
+		if (object.role == LEVEL_ROLE_PROP) {
+			tileProps[tileAt(ground.info, tileSize, tilesX, tilesZ, object.position[0], object.position[2])].push_back(object);
+		} else if (object.role != LEVEL_ROLE_TERRAIN) {
+			globalObjects.push_back(object);
+		}
+	}
+
+	// Tiles are written next to the level and named after it
+	const size_t extension = output.find_last_of('.');
+	const size_t slash = output.find_last_of("/\\");
+	const string stem = output.substr(0, extension != string::npos && (slash == string::npos || extension > slash) ? extension : string::npos);
+	const string tileName = stem.substr(slash == string::npos ? 0 : slash + 1);
+	if (tileName.size() + strlen("_9999_9999.btl") >= LEVEL_NAME_LENGTH) {
+		log << "Error, level name " << tileName << " is too long for its tiles\n";
+		return false;
+	}
+
+	vector<unsigned int> tileSizes(tilesX * tilesZ, 0);
+	unsigned int tileCount = 0, biggestTile = 0, tileBytes = 0;
+	for (unsigned int tz = 0; tz < tilesZ; tz++) {
+		for (unsigned int tx = 0; tx < tilesX; tx++) {
+			const unsigned int tile = tz * tilesX + tx;
+
+			// The tile's piece of the heightfield, edge samples are shared with the neighbours
+			const unsigned int x0 = tx * tileCells, x1 = min(x0 + tileCells, cellsX);
+			const unsigned int z0 = tz * tileCells, z1 = min(z0 + tileCells, cellsZ);
+			levelground_t piece = ground.info;
+			piece.originX = ground.info.originX + x0 * ground.info.cellSize;
+			piece.originZ = ground.info.originZ + z0 * ground.info.cellSize;
+			piece.width = x1 - x0 + 1;
+			piece.depth = z1 - z0 + 1;
+			vector<float> heights;
+			vector<signed char> normals;
+			bool hasGround = false;
+			for (unsigned int z = z0; z <= z1; z++) {
+				for (unsigned int x = x0; x <= x1; x++) {
+					const unsigned int sample = z * ground.info.width + x;
+					heights.push_back(EndianFixFloat(ground.heights[sample]));
+					normals.insert(normals.end(), &ground.normals[sample * 4], &ground.normals[sample * 4 + 4]);
+					hasGround |= ground.heights[sample] != LEVEL_NO_GROUND;
+				}
+			}
+			if (!hasGround && tileTriangles[tile].empty() && tileProps[tile].empty()) {
+				continue;
+			}
+
+			vector<unsigned char> mesh;
+			if (!tileTriangles[tile].empty()) {
+				if (!buildTileMesh(terrain, tileTriangles[tile], piece.originX, piece.originZ, opts, stem + ".tile.bmb", mesh, log)) {
+					return false;
+				}
+			}
+
+			vector<unsigned char> file(sizeof(tileheader_t), 0);
+			tileheader_t header;
+			memset(&header, 0, sizeof(tileheader_t));
+			vector<levelobject_t> objects;
+			packObjects(tileProps[tile], objects);
+			header.objects = appendArray(file, objects.empty() ? NULL : &objects[0], objects.size() * sizeof(levelobject_t));
+			piece.heights = appendArray(file, &heights[0], heights.size() * sizeof(float));
+			piece.normals = appendArray(file, &normals[0], normals.size());
+			header.mesh = mesh.empty() ? 0 : appendArray(file, &mesh[0], mesh.size());
+			file.resize(alignUp(file.size()), 0);
+
+			header.magic = EndianFixInt(TILE_MAGIC);
+			header.version = EndianFixShort(TILE_VERSION);
+			header.objectCount = EndianFixShort((unsigned short)objects.size());
+			header.size = EndianFixInt((unsigned int)file.size());
+			header.objects = EndianFixInt(header.objects);
+			header.mesh = EndianFixInt(header.mesh);
+			header.meshSize = EndianFixInt((unsigned int)mesh.size());
+			copyName(header.terrain, terrain.model);
+			packGround(piece, header.ground);
+			memcpy(&file[0], &header, sizeof(tileheader_t));
+
+			ostringstream name;
+			name << stem << "_" << tx << "_" << tz << ".btl";
+			if (!writeFile(name.str(), file, log)) {
+				return false;
+			}
+			tileSizes[tile] = file.size();
+			tileCount++;
+			tileBytes += file.size();
+			biggestTile = max(biggestTile, (unsigned int)file.size());
+		}
+	}
+
+	// Without a stream line everything stays loaded (the budget leaves room for unpacking)
+	if (level.streamSlots == 0) {
+		level.streamRadius = sqrt((float)(tilesX * tilesX + tilesZ * tilesZ)) * tileSize;
+		level.streamBudget = tileBytes + tileBytes / 4;
+		level.streamSlots = tileCount;
+	}
+	if (level.streamBudget < biggestTile) {
+		log << "Error, a " << biggestTile << " byte tile doesn't fit the " << level.streamBudget << " byte stream budget\n";
+		return false;
+	}
+
+	// Arrays in file order after the header
+	vector<unsigned char> file(sizeof(levelheader_t), 0);
+	levelheader_t header;
+	memset(&header, 0, sizeof(levelheader_t));
+
+	vector<levelobject_t> objects;
+	packObjects(globalObjects, objects);
+	header.objects = appendArray(file, objects.empty() ? NULL : &objects[0], objects.size() * sizeof(levelobject_t));
+
+	vector<float> pickups(level.pickups);
+	swapFloats(pickups.empty() ? NULL : &pickups[0], pickups.size());
+	header.pickups = appendArray(file, pickups.empty() ? NULL : &pickups[0], pickups.size() * sizeof(float));
+
+	vector<levelarea_t> spawns(level.spawns);
+	for (size_t i = 0; i < spawns.size(); i++) {
+		swapFloats(spawns[i].min, 3);
+		swapFloats(spawns[i].max, 3);
+	}
+	header.spawns = appendArray(file, &spawns[0], spawns.size() * sizeof(levelarea_t));
+
+	const size_t checkpointCount = checkpoints.size();
+	for (size_t i = 0; i < checkpointCount; i++) {
+		checkpoints[i].x = EndianFixFloat(checkpoints[i].x);
+		checkpoints[i].z = EndianFixFloat(checkpoints[i].z);
+	}
+	header.checkpoints = appendArray(file, checkpointCount > 0 ? &checkpoints[0] : NULL, checkpointCount * sizeof(levelpoint_t));
+
+	for (size_t i = 0; i < tileSizes.size(); i++) {
+		tileSizes[i] = EndianFixInt(tileSizes[i]);
+	}
+	header.tileSizes = appendArray(file, &tileSizes[0], tileSizes.size() * sizeof(unsigned int));
+	file.resize(alignUp(file.size()), 0);
+
+	header.magic = EndianFixInt(LEVEL_MAGIC);
+	header.version = EndianFixShort(LEVEL_VERSION);
+	header.objectCount = EndianFixShort((unsigned short)objects.size());
+	header.size = EndianFixInt((unsigned int)file.size());
+	header.objects = EndianFixInt(header.objects);
+	header.pickupCount = EndianFixInt((unsigned int)level.pickups.size() / 3);
+	header.pickups = EndianFixInt(header.pickups);
+	header.spawnCount = EndianFixInt((unsigned int)level.spawns.size());
+	header.spawns = EndianFixInt(header.spawns);
+	header.checkpointCount = EndianFixInt((unsigned int)checkpointCount);
+	header.checkpoints = EndianFixInt(header.checkpoints);
+	copyName(header.pickupModel, level.pickupModel);
+	header.pickupSpin = EndianFixFloat(level.pickupSpin);
+	header.waterLevel = EndianFixFloat(waterLevel);
+	for (int c = 0; c < 3; c++) {
+		header.camera[c] = EndianFixFloat(level.camera[c]);
+		header.cameraTarget[c] = EndianFixFloat(level.camera[3 + c]);
+	}
+	header.streamRadius = EndianFixFloat(level.streamRadius);
+	header.streamBudget = EndianFixInt(level.streamBudget);
+	header.streamSlots = EndianFixInt(level.streamSlots);
+	copyName(header.tileName, tileName);
+	header.tileOriginX = EndianFixFloat(ground.info.originX);
+	header.tileOriginZ = EndianFixFloat(ground.info.originZ);
+	header.tileSize = EndianFixFloat(tileSize);
+	header.tilesX = EndianFixInt(tilesX);
+	header.tilesZ = EndianFixInt(tilesZ);
+	header.tileSizes = EndianFixInt(header.tileSizes);
+	memcpy(&file[0], &header, sizeof(levelheader_t));
+	if (!writeFile(output, file, log)) {
+		return false;
+	}
+
+	log << output << ": " << objects.size() << " objects, " << level.pickups.size() / 3 << " pickups, "
+		<< level.spawns.size() << " spawn areas, " << checkpointCount << " checkpoint spots, "
+		<< ground.info.width << "x" << ground.info.depth << " heightfield (" << ground.info.cellSize << " cells, "
+		<< terrain.positions.size() / 9 << " triangles, max error " << worstError << "), " << file.size() << " bytes\n";
+	log << tileCount << " of " << tilesX << "x" << tilesZ << " tiles (" << tileSize << " wide), " << tileBytes << " bytes, biggest "
+		<< biggestTile << ", streaming radius " << level.streamRadius << " budget " << level.streamBudget << " slots " << level.streamSlots << "\n";
+	return true;
+}
@@ -0,0 +1,104 @@
+#ifndef _LEVELFILE_H
+#define _LEVELFILE_H
+
+// Level layout, everything big endian:
+//   levelheader_t, then the arrays it points to (each LEVEL_ALIGN aligned)
+// The terrain is cut in a grid of tiles, each in its own file the game streams:
+//   tileheader_t, its props, its piece of the terrain (a .bmb)
+// Array fields hold offsets from the start of the file, the game adds the
+// address it loaded the file at and uses it as is (see level.c).
+
+#define LEVEL_MAGIC			0x424C564C	// "BLVL"
+#define LEVEL_VERSION		2
+#define TILE_MAGIC			0x4254494C	// "BTIL"
+#define TILE_VERSION		1
+#define LEVEL_ALIGN			32
+#define LEVEL_NAME_LENGTH	32
+
+// Ground height of heightfield samples with no terrain under them
+#define LEVEL_NO_GROUND		-1e30f
+
+// How a heightfield cell is split in two triangles (4th byte of its first sample's normal)
+#define LEVEL_SPLIT_FALLING	0	// Diagonal from sample (x, z) to (x + 1, z + 1)
+#define LEVEL_SPLIT_RISING	1	// Diagonal from sample (x + 1, z) to (x, z + 1)
+
+// Object roles, they decide how the game draws and uses an object
+enum {
+	LEVEL_ROLE_TERRAIN		= 0,	// Cut into the tiles, the heightfield is made from it
+	LEVEL_ROLE_WATER		= 1,	// Drawn unlit, its height is the water level
+	LEVEL_ROLE_PROP			= 2,	// Drawn lit, stored with the tile it stands on
+	LEVEL_ROLE_CHECKPOINT	= 3		// Drawn additive, follows the checkpoint (position is an offset)
+};
+
+typedef struct {
+	char			model[LEVEL_NAME_LENGTH];	// Model entry name, zero padded
+	unsigned int	role;						// LEVEL_ROLE_*
+	float			position[3];				// World position (checkpoint objects: offset from the checkpoint at water level)
+	float			scale[3];
+	float			spin;						// Rotation around Y per second (radians)
+} levelobject_t;
+
+typedef struct {
+	float			min[3];
+	float			max[3];
+} levelarea_t;
+
+typedef struct {
+	float			x;
+	float			z;
+} levelpoint_t;
+
+// Ground heights on a regular grid over the terrain, with a normal per sample,
+// heights between samples come from the two triangles of each cell
+typedef struct {
+	float			originX;	// World position of sample 0
+	float			originZ;
+	float			cellSize;	// World distance between samples
+	unsigned int	width;		// Samples along X
+	unsigned int	depth;		// Samples along Z
+	unsigned int	heights;	// float[depth][width], LEVEL_NO_GROUND where there is no terrain
+	unsigned int	normals;	// signed char[depth][width][4], x y z (scaled by 127) and the cell's LEVEL_SPLIT_*
+} levelground_t;
+
+typedef struct {
+	unsigned int	magic;			// LEVEL_MAGIC
+	unsigned short	version;		// LEVEL_VERSION
+	unsigned short	objectCount;
+	unsigned int	size;			// Whole file size
+	unsigned int	objects;		// levelobject_t[objectCount]
+	unsigned int	pickupCount;
+	unsigned int	pickups;		// float[pickupCount][3], pickup positions
+	unsigned int	spawnCount;
+	unsigned int	spawns;			// levelarea_t[spawnCount], players start at random in one
+	unsigned int	checkpointCount;
+	unsigned int	checkpoints;	// levelpoint_t[checkpointCount], where the checkpoint can go
+	char			pickupModel[LEVEL_NAME_LENGTH];
+	float			pickupSpin;		// Pickup rotation around Y per second (radians)
+	float			waterLevel;		// Players don't go below it
+	float			camera[3];		// Spectator camera position
+	float			cameraTarget[3];
+	float			streamRadius;	// Tiles this close to a player are loaded
+	unsigned int	streamBudget;	// Most bytes of tiles loaded at once
+	unsigned int	streamSlots;	// Most tiles loaded at once
+	char			tileName[LEVEL_NAME_LENGTH];	// Tile (x, z) is the entry "<tileName>_<x>_<z>.btl"
+	float			tileOriginX;	// Tile (x, z) covers origin + [x, x + 1) * tileSize
+	float			tileOriginZ;
+	float			tileSize;
+	unsigned int	tilesX;
+	unsigned int	tilesZ;
+	unsigned int	tileSizes;		// unsigned int[tilesZ][tilesX], tile file size, 0 where there is no tile
+} levelheader_t;
+
+typedef struct {
+	unsigned int	magic;			// TILE_MAGIC
+	unsigned short	version;		// TILE_VERSION
+	unsigned short	objectCount;
+	unsigned int	size;			// Whole file size
+	unsigned int	objects;		// levelobject_t[objectCount], props standing on the tile
+	unsigned int	mesh;			// .bmb of the terrain on the tile (positions from the ground origin), 0 if none
+	unsigned int	meshSize;
+	char			terrain[LEVEL_NAME_LENGTH];	// Terrain model the mesh was cut from (its texture is used)
+	levelground_t	ground;			// The heightfield under the tile, samples on the edges are in both tiles
+} tileheader_t;
+
+#endif
@@ -12,24 +12,49 @@ namespace po = boost::program_options;
 
 #include <iostream>
 #include <cstdio>
+#include <cstring>
 #include <iterator>
+#include <algorithm>
+#include <chrono>
 using namespace std;
 
-Assimp::Importer importer;
-aiScene* scene = NULL;
-
 // Prototyping
-bool loadObjmodel(string file);
-bool saveBinfile(string file);
+bool loadObjmodel(string file, sourcescene_t& scene, ostream& log);
+bool loadObjfast(string file, sourcescene_t& scene, ostream& log);
+bool benchParse(unsigned int faces);
 
 int main(int argc, char* argv[]) {
 	string inFilePath, outFilePath;
+	convopts_t opts;
+	batchopts_t batch;
+	vector<string> atlasMaps;
+	string modelDir;
 	try {
 		po::options_description desc("Valid arguments");
 		desc.add_options()
 			("help", "produce help message")
 			("input,i", po::value<string>(), "input obj file")
 			("output,o", po::value<string>(), "output bin file")
+			("info", "check and describe the input .bmb instead of converting")
+			("batch", po::value<vector<string> >(&batch.sources), "convert every model of a manifest or directory (repeatable)")
+			("out-dir", po::value<string>(&batch.outDir), "batch output directory (default: next to each model)")
+			("jobs,j", po::value<unsigned int>(&batch.jobs)->default_value(0), "batch worker threads (0 for one per core)")
+			("cache", po::value<string>(&batch.cacheFile), "batch cache file (default: obj2bin.cache in --out-dir or the working directory)")
+			("force", "convert every batch model even if the cache says it is up to date")
+			("atlas", po::value<vector<string> >(&atlasMaps), "move UVs into the atlas slots of a png2tpl atlas map (repeatable)")
+			("level", po::value<string>(), "compile a level description (.lvl) to --output instead of converting a model")
+			("model-dir", po::value<string>(&modelDir), "where --level finds the .bmb terrain models (default: working directory)")
+			("fast-obj", "read .obj input with the built in parser instead of assimp")
+			("bench-parse", po::value<unsigned int>(), "time both OBJ readers on a synthetic triangle grid with this many triangles")
+			("float", "keep all vertex data as 32-bit floats")
+			("pos-error", po::value<float>(&opts.posError)->default_value(0.0005f), "max position error when quantizing (model units)")
+			("nrm-error", po::value<float>(&opts.nrmError)->default_value(0.008f), "max normal component error when quantizing")
+			("uv-error", po::value<float>(&opts.uvError)->default_value(0.0005f), "max texture coordinate error when quantizing")
+			("no-strips", "keep plain triangle lists instead of triangle strips")
+			("no-vcache", "keep the original triangle and vertex order")
+			("cache-size", po::value<unsigned int>(&opts.cacheSize)->default_value(16), "vertex cache entries to optimize for")
+			("nrm-merge", po::value<float>(&opts.nrmMerge)->default_value(0.001f), "merge normals within this distance per component (0 for exact)")
+			("max-index", po::value<unsigned int>(&opts.maxIndex)->default_value(MAX_INDEX), "split meshes so no vertex index goes over this")
 			;
 
 		po::variables_map vm;
@@ -42,6 +67,39 @@ int main(int argc, char* argv[]) {
 			return 0;
 		}
 
+		opts.quantize = vm.count("float") == 0;
+		opts.strips = vm.count("no-strips") == 0;
+		opts.vcache = vm.count("no-vcache") == 0;
+		if (opts.maxIndex > MAX_INDEX || opts.maxIndex < 2) {
+			opts.maxIndex = MAX_INDEX;
+		}
+
+		if (vm.count("bench-parse")) {
+			return benchParse(vm["bench-parse"].as<unsigned int>()) ? 0 : 1;
+		}
+		opts.fastObj = vm.count("fast-obj") > 0;
+		for (size_t i = 0; i < atlasMaps.size(); i++) {
+			string error;
+			if (!readAtlasMap(atlasMaps[i], opts.atlas, error)) {
+				cout << "Error, " << error << "\n";
+				return 1;
+			}
+		}
+
+		if (vm.count("level")) {
+			if (!vm.count("output")) {
+				cout << "ERROR:\n  Missing output argument.\n";
+				cout << desc << "\n";
+				return 1;
+			}
+			return compileLevel(vm["level"].as<string>(), vm["output"].as<string>(), modelDir, opts, cout) ? 0 : 1;
+		}
+
+		if (!batch.sources.empty()) {
+			batch.force = vm.count("force") > 0;
+			return convertBatch(batch, opts) ? 0 : 1;
+		}
+
 		// Arguments
 		if (vm.count("input")) {
 			inFilePath = vm["input"].as<string>();
@@ -51,6 +109,10 @@ int main(int argc, char* argv[]) {
 			return 1;
 		}
 
+		if (vm.count("info")) {
+			return checkBinfile(inFilePath, true, cout) ? 0 : 1;
+		}
+
 		if (vm.count("output")) {
 			outFilePath = vm["output"].as<string>();
 		} else {
@@ -65,122 +127,169 @@ int main(int argc, char* argv[]) {
 	}
 	catch (...) {
 		cerr << "Exception of unknown type!\n";
+		return 1;
 	}
 
-	if (!loadObjmodel(inFilePath))
-		return 1;
-	if (!saveBinfile(outFilePath))
+	if (!convertModel(inFilePath, outFilePath, opts, cout))
 		return 1;
 
 
 	return 0;
 }
 
-bool loadObjmodel(string file) {
-	scene = (aiScene*)importer.ReadFile(file,
-										aiProcess_Triangulate |
-										aiProcess_JoinIdenticalVertices
-										);
+// Read with assimp and copy into our own scene
+static bool importAssimp(string file, sourcescene_t& out) {
+	// One importer per call, batch conversions load models on several threads
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(file,
+											 aiProcess_Triangulate |
+											 aiProcess_JoinIdenticalVertices
+											 );
 
-	if (scene == NULL || scene->mNumMeshes != 1) {
-		cerr << "Error reading file, might have more then 1 mesh?" << std::endl;
+	if (scene == NULL || scene->mNumMeshes == 0) {
 		return false;
 	}
 
-	cout << "loaded " << file << "\n";
-	cout << "meshes: " << scene->mNumMeshes << "\n";
+	out.meshes.resize(scene->mNumMeshes);
+	for (unsigned int mi = 0; mi < scene->mNumMeshes; mi++) {
+		const aiMesh* aimesh = scene->mMeshes[mi];
+		sourcemesh_t& mesh = out.meshes[mi];
+		mesh.material = aimesh->mMaterialIndex;
+		mesh.positions.clear();
+		mesh.normals.clear();
+		mesh.texcoords.clear();
+		mesh.triangles.clear();
+
+		// Missing normals or texcoords are zeros, as parseObj gives them
+		const bool hasNormals = aimesh->HasNormals(), hasTexcoords = aimesh->HasTextureCoords(0);
+		const aiVector3D zero(0.0f, 0.0f, 0.0f);
+		for (unsigned int vi = 0; vi < aimesh->mNumVertices; vi++) {
+			const aiVector3D& p = aimesh->mVertices[vi];
+			const aiVector3D& n = hasNormals ? aimesh->mNormals[vi] : zero;
+			const aiVector3D& t = hasTexcoords ? aimesh->mTextureCoords[0][vi] : zero;
+			mesh.positions.push_back(p.x);
+			mesh.positions.push_back(p.y);
+			mesh.positions.push_back(p.z);
+			mesh.normals.push_back(n.x);
+			mesh.normals.push_back(n.y);
+			mesh.normals.push_back(n.z);
+			mesh.texcoords.push_back(t.x);
+			mesh.texcoords.push_back(t.y);
+		}
+		for (unsigned int ii = 0; ii < aimesh->mNumFaces; ii++) {
+			const aiFace& f = aimesh->mFaces[ii];
+			// Points and lines are left as they are by Triangulate
+			if (f.mNumIndices != 3) {
+				continue;
+			}
+			mesh.triangles.push_back(f.mIndices[0]);
+			mesh.triangles.push_back(f.mIndices[1]);
+			mesh.triangles.push_back(f.mIndices[2]);
+		}
+	}
+
+	out.materials.clear();
+	for (unsigned int mi = 0; mi < scene->mNumMaterials; mi++) {
+		const aiMaterial* material = scene->mMaterials[mi];
+		aiString name, path;
+		material->Get(AI_MATKEY_NAME, name);
+		if (material->GetTextureCount(aiTextureType_DIFFUSE) == 0 ||
+			material->GetTexture(aiTextureType_DIFFUSE, 0, &path) != aiReturn_SUCCESS) {
+			path = aiString();
+		}
+		out.materials.push_back(makeMaterial(name.C_Str(), path.C_Str()));
+	}
 
 	return true;
 }
 
-bool saveBinfile(string file) {
-	// Make object to save
-	binheader_t		binHeader;
-	bindata_t		bindData;
-
-	aiMesh* mesh = scene->mMeshes[0];
+static void printLoaded(string file, const sourcescene_t& scene, ostream& log) {
+	log << "loaded " << file << "\n";
+	log << "meshes: " << scene.meshes.size() << "\n";
+	log << "materials: " << scene.materials.size() << "\n";
+}
 
-	// Counting time
-	memset(&binHeader, 0, sizeof(binheader_t));
-	binHeader.vcount = mesh->mNumVertices;
-	binHeader.ncount = mesh->mNumVertices;
-	binHeader.vtcount = mesh->mNumVertices;
-	binHeader.fcount = mesh->mNumFaces;
+bool loadObjmodel(string file, sourcescene_t& scene, ostream& log) {
+	if (!importAssimp(file, scene)) {
+		log << "Error reading file, no meshes found" << std::endl;
+		return false;
+	}
 
-	// Allocate memory
-	bindData.positions = new float[binHeader.vcount * 3];
-	bindData.normals = new float[binHeader.ncount * 3];
-	bindData.texcoords = new float[binHeader.vtcount * 2];
-	bindData.indices = new unsigned short[binHeader.fcount * 3];
+	printLoaded(file, scene, log);
+	return true;
+}
 
-	cout << "positions: " << binHeader.vcount << "\n";
-	cout << "normals: " << binHeader.ncount << "\n";
-	cout << "texcoords: " << binHeader.vtcount << "\n";
-	cout << "faces: " << binHeader.fcount << "\n";
+bool loadObjfast(string file, sourcescene_t& scene, ostream& log) {
+	string error;
+	if (!parseObj(file, scene, error)) {
+		log << "Error reading file, " << error << std::endl;
+		return false;
+	}
+	if (scene.meshes.empty()) {
+		log << "Error reading file, no meshes found" << std::endl;
+		return false;
+	}
 
+	printLoaded(file, scene, log);
+	return true;
+}
 
-		// Fix endian
-	binheader_t binHeaderEndian;
-	binHeaderEndian.vcount = EndianFixInt(binHeader.vcount);
-	binHeaderEndian.ncount = EndianFixInt(binHeader.ncount);
-	binHeaderEndian.vtcount = EndianFixInt(binHeader.vtcount);
-	binHeaderEndian.fcount = EndianFixInt(binHeader.fcount);
+bool convertModel(const string& input, const string& output, const convopts_t& opts, ostream& log) {
+	sourcescene_t scene;
+	if (!(opts.fastObj ? loadObjfast(input, scene, log) : loadObjmodel(input, scene, log)))
+		return false;
+	if (!applyAtlas(scene, opts.atlas, log))
+		return false;
+	return saveBinfile(output, scene, opts, log);
+}
 
-	// Dump file
-	FILE *outFile = fopen(file.c_str(), "wb");
+static double secondsSince(const chrono::steady_clock::time_point& start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
 
-	if (outFile == NULL) {
-		cout << "Error, unable to open output file\n";
-		return 1;
+// Parse throughput of both readers on the same synthetic file
+bool benchParse(unsigned int faces) {
+	const string file = "obj2bin_bench.obj";
+	cout << "writing " << faces << " triangles to " << file << "\n";
+	if (!writeSyntheticObj(file, faces)) {
+		cerr << "Error, unable to write " << file << "\n";
+		return false;
 	}
 
-	fwrite(&binHeaderEndian, sizeof(binheader_t), 1, outFile);
-
-	// Vertices
-	for (unsigned int vi = 0; vi < binHeader.vcount; vi++) {
-		aiVector3D& v = mesh->mVertices[vi];
-		const unsigned int fi = vi * 3;
-		bindData.positions[fi + 0] = EndianFixFloat(v.x);
-		bindData.positions[fi + 1] = EndianFixFloat(v.y);
-		bindData.positions[fi + 2] = EndianFixFloat(v.z);
-	}
-	// Normals
-	for (unsigned int ni = 0; ni < binHeader.ncount; ni++) {
-		aiVector3D& v = mesh->mNormals[ni];
-		const unsigned int fi = ni * 3;
-		bindData.normals[fi + 0] = EndianFixFloat(v.x);
-		bindData.normals[fi + 1] = EndianFixFloat(v.y);
-		bindData.normals[fi + 2] = EndianFixFloat(v.z);
-	}
-	// Texture Coordinates
-	for (unsigned int ti = 0; ti < binHeader.vtcount; ti++) {
-		aiVector3D& v = mesh->mTextureCoords[0][ti];
-		const unsigned int fi = ti * 2;
-		bindData.texcoords[fi + 0] = EndianFixFloat(v.x);
-		bindData.texcoords[fi + 1] = EndianFixFloat((1.0f - v.y));
-	}
-	// Indices
-	for (unsigned int ii = 0; ii < mesh->mNumFaces; ii++) {
-		aiFace& f = mesh->mFaces[ii];
-		const unsigned int si = ii * 3;
-		bindData.indices[si + 0] = EndianFixShort((unsigned short)f.mIndices[0]);
-		bindData.indices[si + 1] = EndianFixShort((unsigned short)f.mIndices[1]);
-		bindData.indices[si + 2] = EndianFixShort((unsigned short)f.mIndices[2]);
+	FILE* in = fopen(file.c_str(), "rb");
+	fseek(in, 0, SEEK_END);
+	const double megabytes = ftell(in) / (1024.0 * 1024.0);
+	fclose(in);
+	cout << "file: " << megabytes << " MB\n";
+
+	sourcescene_t fast, reference;
+	string error;
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	const bool fastOk = parseObj(file, fast, error);
+	const double fastTime = secondsSince(start);
+
+	start = chrono::steady_clock::now();
+	const bool assimpOk = importAssimp(file, reference);
+	const double assimpTime = secondsSince(start);
+	remove(file.c_str());
+
+	if (!fastOk || !assimpOk) {
+		cerr << "Error, parsing failed\n";
+		return false;
 	}
 
-	fwrite(bindData.positions, sizeof(float), binHeader.vcount * 3, outFile);
-	fwrite(bindData.normals, sizeof(float), binHeader.ncount * 3, outFile);
-	fwrite(bindData.texcoords, sizeof(float), binHeader.vtcount * 2, outFile);
-	fwrite(bindData.indices, sizeof(unsigned short), binHeader.fcount * 3, outFile);
-
-	// Close file
-	fclose(outFile);
-
-	// Destroy memory
-	delete[] bindData.positions;
-	delete[] bindData.normals;
-	delete[] bindData.texcoords;
-	delete[] bindData.indices;
-
-	return true;
+	cout << "fast parser: " << fastTime << " s, " << megabytes / fastTime << " MB/s\n";
+	cout << "assimp:      " << assimpTime << " s, " << megabytes / assimpTime << " MB/s\n";
+
+	// A sanity check on this one grid (a single mesh, no materials, every
+	// attribute given), not on what either reader does with other files
+	bool same = fast.meshes.size() == reference.meshes.size();
+	for (size_t mi = 0; same && mi < fast.meshes.size(); mi++) {
+		same = fast.meshes[mi].positions == reference.meshes[mi].positions &&
+			   fast.meshes[mi].normals == reference.meshes[mi].normals &&
+			   fast.meshes[mi].texcoords == reference.meshes[mi].texcoords &&
+			   fast.meshes[mi].triangles == reference.meshes[mi].triangles;
+	}
+	cout << "grid geometry " << (same ? "matches" : "DIFFERS") << "\n";
+	return same;
 }
@@ -1,6 +1,14 @@
 #ifndef _OBJ2BIN_H
 #define _OBJ2BIN_H
 
+#include <vector>
+#include <map>
+#include <cstddef>
+#include <string>
+#include <iosfwd>
+
+#include "bmbfile.h"
+
 // Endian magic below
 #ifndef LITTLE_ENDIAN
 #define LITTLE_ENDIAN  3412
@@ -61,17 +69,188 @@ static inline float SwapFloat(const float n) {
 #endif
 
 
+// GX vertex component types (same values as GX_U8 .. GX_F32)
+enum {
+	COMP_U8  = 0,
+	COMP_S8  = 1,
+	COMP_U16 = 2,
+	COMP_S16 = 3,
+	COMP_F32 = 4
+};
+
+// Vertex stream kinds, each has its own quantization rules
+enum {
+	STREAM_POSITION = 0,
+	STREAM_NORMAL   = 1,
+	STREAM_TEXCOORD = 2
+};
+
+// Largest index a submesh may use (16-bit indices)
+#define MAX_INDEX 0xFFFF
+
+// GX display list opcodes
+#define DL_NOP				0x00
+#define DL_TRIANGLES		0x90
+#define DL_TRIANGLESTRIP	0x98
+#define DL_VTXFMT0			0x00
+#define DL_VTXFMT_MASK		0x07
+
+// Vertices per GX_Begin (16-bit count, multiple of 3)
+#define DL_LIST_MAX			0xFFFF
+
+typedef struct {
+	unsigned int	position;
+	unsigned int	normal;
+	unsigned int	texcoord;
+} dlindex_t;
+
 typedef struct {
-	unsigned int	vcount;
-	unsigned int	ncount;
-	unsigned int	vtcount;
-	unsigned int	fcount;
-} binheader_t;
+	unsigned char	type;		// COMP_*
+	unsigned char	frac;		// Fractional bits, GX scales by 2^-frac
+	float			error;		// Worst error measured over the stream
+} quantization_t;
 
 typedef struct {
-	float*			positions;
-	float*			normals;
-	float*			texcoords;
-	unsigned short*	indices;
-} bindata_t;
+	std::vector<std::vector<unsigned int> >	strips;		// Vertex ids, 4 or more per strip
+	std::vector<unsigned int>				triangles;	// Loose triangles, 3 ids each
+} striplist_t;
+
+typedef struct {
+	std::vector<float>			positions;	// Unique positions, 3 floats each
+	std::vector<float>			normals;	// Unique normals, 3 floats each
+	std::vector<float>			texcoords;	// Unique texture coordinates, 2 floats each
+	std::vector<unsigned int>	positionOf;	// Vertex id -> position id
+	std::vector<unsigned int>	normalOf;	// Vertex id -> normal id
+	std::vector<unsigned int>	texcoordOf;	// Vertex id -> texcoord id
+	std::vector<unsigned int>	triangles;	// Vertex ids, 3 per triangle
+	unsigned int				vertexCount;
+} meshdata_t;
+
+// A mesh as loaded, before any processing
+typedef struct {
+	std::vector<float>			positions;	// 3 floats per vertex
+	std::vector<float>			normals;	// 3 floats per vertex
+	std::vector<float>			texcoords;	// 2 floats per vertex, as in the file (v up)
+	std::vector<unsigned int>	triangles;	// Vertex ids, 3 per triangle
+	unsigned int				material;	// Index in sourcescene_t.materials
+} sourcemesh_t;
+
+typedef struct {
+	std::vector<sourcemesh_t>	meshes;
+	std::vector<binmaterial_t>	materials;
+} sourcescene_t;
+
+// Where png2tpl put a texture in an atlas page (texels)
+typedef struct {
+	std::string		page;		// Atlas name, becomes the material texture
+	unsigned int	x, y;		// Top left corner
+	unsigned int	width;		// Texture size
+	unsigned int	height;
+	unsigned int	pageWidth;
+	unsigned int	pageHeight;
+} atlasslot_t;
+
+// Atlas slots by texture file name
+typedef std::map<std::string, atlasslot_t> atlasmap_t;
+
+typedef struct {
+	bool			quantize;	// Allow non-float vertex formats
+	float			posError;	// Max position error (model units)
+	float			nrmError;	// Max normal component error
+	float			uvError;	// Max texture coordinate error (UV units)
+	bool			strips;		// Convert triangle lists to strips
+	bool			vcache;		// Reorder triangles for the vertex cache
+	unsigned int	cacheSize;	// Vertex cache entries to optimize for
+	float			nrmMerge;	// Normals closer than this (per component) share an index
+	unsigned int	maxIndex;	// Split meshes so no index goes over this
+	bool			fastObj;	// Read .obj files with parseObj instead of assimp
+	atlasmap_t		atlas;		// Textures packed in atlases, their UVs are moved into the slot
+} convopts_t;
+
+typedef struct {
+	std::vector<std::string>	sources;	// Manifests or directories of models
+	std::string					outDir;		// Output directory, empty for next to each model
+	std::string					cacheFile;	// Cache of converted models, empty for the default
+	unsigned int				jobs;		// Worker threads, 0 for one per core
+	bool						force;		// Ignore the cache
+} batchopts_t;
+
+// Size in bytes of a single component
+unsigned int componentSize(unsigned char type);
+
+// Name of a component type (for reports)
+const char* componentName(unsigned char type);
+
+// Pick the smallest format for a stream that stays within maxError
+quantization_t chooseQuantization(const float* values, unsigned int count, int stream, float maxError);
+
+// Append a stream to a buffer in the chosen (big endian) format
+void writeQuantized(std::vector<unsigned char>& out, const float* values, unsigned int count, const quantization_t& q);
+
+// Read count values of a (big endian) stream written by writeQuantized back as floats
+void readQuantized(const unsigned char* data, unsigned int count, unsigned char type, unsigned char frac, std::vector<float>& out);
+
+// Split a triangle list (3 ids per triangle) into strips and loose triangles,
+// keeping the original winding. With a window, strips follow the triangle order
+// and only reach that many triangles ahead, 0 builds the longest strips it can
+striplist_t stripify(const std::vector<unsigned int>& tris, unsigned int window);
+
+// Average cache miss ratio (misses per triangle) of an index stream through a FIFO cache
+float measureACMR(const std::vector<unsigned int>& sequence, unsigned int triangleCount, unsigned int cacheSize);
+
+// Reorder a triangle list (3 ids per triangle) for a cache of cacheSize vertices,
+// keeping each triangle's winding
+std::vector<unsigned int> optimizeVertexCache(const std::vector<unsigned int>& tris, unsigned int vertexCount, unsigned int cacheSize);
+
+// Old vertex id -> new vertex id, numbered by first use in sequence
+std::vector<unsigned int> firstUseOrder(const std::vector<unsigned int>& sequence, unsigned int vertexCount);
+
+// Merge equal entries of a stream (within epsilon, 0 for exact), returns old id -> new id
+std::vector<unsigned int> dedupeStream(const std::vector<float>& values, unsigned int components, float epsilon, std::vector<float>& unique);
+
+// Split a mesh into submeshes (keeping triangle order) whose vertices and
+// attributes can all be indexed with values up to maxIndex
+std::vector<meshdata_t> splitMesh(const meshdata_t& mesh, unsigned int maxIndex);
+
+// Append GX display list commands drawing the strips then the loose triangles,
+// corners holds the indices of every strip followed by the triangle list
+void encodeDisplayList(std::vector<unsigned char>& out, const std::vector<unsigned int>& stripLengths,
+					   unsigned int looseCount, const std::vector<dlindex_t>& corners);
+
+// Decode a display list made by encodeDisplayList into a triangle list (3 corners
+// each, strip winding resolved), returns false if it holds anything else
+bool decodeDisplayList(const unsigned char* data, size_t size, std::vector<dlindex_t>& triangles);
+
+// Read an OBJ file without assimp (memory mapped): one mesh per object/group
+// and material, vertices numbered by first use, polygons split as fans
+bool parseObj(const std::string& file, sourcescene_t& scene, std::string& error);
+
+// Add the slots of an atlas map written by png2tpl
+bool readAtlasMap(const std::string& file, atlasmap_t& atlas, std::string& error);
+
+// Move the UVs of every material whose texture is in an atlas into its slot,
+// and point the material at the page
+bool applyAtlas(sourcescene_t& scene, const atlasmap_t& atlas, std::ostream& log);
+
+// Write a scene as .bmb (quantized, stripped and checked), progress and errors go to log
+bool saveBinfile(std::string file, const sourcescene_t& scene, const convopts_t& opts, std::ostream& log);
+
+// Validate a .bmb: container, mesh info against array sizes, and display lists,
+// verbose lists the sections, materials and submeshes
+bool checkBinfile(std::string file, bool verbose, std::ostream& log);
+
+// Load a model and write it as .bmb, progress and errors go to log
+bool convertModel(const std::string& input, const std::string& output, const convopts_t& opts, std::ostream& log);
+
+// Convert a set of models on a thread pool, skipping the ones the cache has
+// seen with the same content and options
+bool convertBatch(const batchopts_t& batch, const convopts_t& opts);
+
+// Compile a level description (.lvl) into a .blv, terrain models are read
+// (as .bmb) from modelDir for the ground heightfield and cut in tiles written next to it
+bool compileLevel(const std::string& input, const std::string& output, const std::string& modelDir, const convopts_t& opts, std::ostream& log);
+
+// Write a grid OBJ with the given number of triangles (for benchmarks)
+bool writeSyntheticObj(const std::string& file, unsigned int faces);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,553 @@
+// objparse.cpp : Memory mapped Wavefront OBJ reader
+//
+// Builds one mesh per object/group and material, vertices numbered by first
+// use, polygons split as fans, DefaultMaterial before any usemtl. The host
+// tests (objreader) check these rules on small files.
+
+#include "obj2bin.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+using namespace std;
+
+// Read only view of a whole file
+typedef struct {
+	const char*	data;
+	size_t		size;
+#ifdef _WIN32
+	HANDLE		file;
+	HANDLE		mapping;
+#else
+	int			file;
+#endif
+} mappedfile_t;
+
+static bool mapFile(const string& path, mappedfile_t& map) {
+	map.data = NULL;
+	map.size = 0;
+#ifdef _WIN32
+	map.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (map.file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(map.file, &size);
+	map.size = (size_t)size.QuadPart;
+	map.mapping = NULL;
+	if (map.size > 0) {
+		map.mapping = CreateFileMappingA(map.file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (map.mapping == NULL) {
+			CloseHandle(map.file);
+			return false;
+		}
+		map.data = (const char*)MapViewOfFile(map.mapping, FILE_MAP_READ, 0, 0, 0);
+	}
+#else
+	map.file = open(path.c_str(), O_RDONLY);
+	if (map.file < 0) {
+		return false;
+	}
+	struct stat st;
+	fstat(map.file, &st);
+	map.size = st.st_size;
+	if (map.size > 0) {
+		void* data = mmap(NULL, map.size, PROT_READ, MAP_PRIVATE, map.file, 0);
+		if (data == MAP_FAILED) {
+			close(map.file);
+			return false;
+		}
+		madvise(data, map.size, MADV_SEQUENTIAL);
+		map.data = (const char*)data;
+	}
+#endif
+	return map.size == 0 || map.data != NULL;
+}
+
+static void unmapFile(mappedfile_t& map) {
+#ifdef _WIN32
+	if (map.data != NULL) {
+		UnmapViewOfFile(map.data);
+	}
+	if (map.mapping != NULL) {
+		CloseHandle(map.mapping);
+	}
+	CloseHandle(map.file);
+#else
+	if (map.data != NULL) {
+		munmap((void*)map.data, map.size);
+	}
+	close(map.file);
+#endif
+	map.data = NULL;
+}
+
+// Cursor over one line, never reads past end
+typedef struct {
+	const char*	p;
+	const char*	end;
+} cursor_t;
+
+static inline void skipSpaces(cursor_t& c) {
+	while (c.p < c.end && (*c.p == ' ' || *c.p == '\t')) {
+		c.p++;
+	}
+}
+
+static inline bool isDigit(char ch) {
+	return ch >= '0' && ch <= '9';
+}
+
+// Exact powers of ten a double can hold
+static const double powersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Parse a float. Up to 15 significant digits with a small exponent is exact in a
+// double (one rounding, like strtod); anything else goes through strtof.
+static float parseFloat(cursor_t& c) {
+	skipSpaces(c);
+	const char* start = c.p;
+	const char* p = c.p;
+
+	bool negative = false;
+	if (p < c.end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		p++;
+	}
+
+	unsigned long long mantissa = 0;
+	int digits = 0, exponent = 0;
+	while (p < c.end && isDigit(*p)) {
+		if (digits < 19) {
+			mantissa = mantissa * 10 + (*p - '0');
+			if (mantissa != 0) {
+				digits++;
+			}
+		} else {
+			exponent++;
+		}
+		p++;
+	}
+	if (p < c.end && *p == '.') {
+		p++;
+		while (p < c.end && isDigit(*p)) {
+			if (digits < 19) {
+				mantissa = mantissa * 10 + (*p - '0');
+				if (mantissa != 0) {
+					digits++;
+				}
+				exponent--;
+			}
+			p++;
+		}
+	}
+	bool slow = digits > 15;
+	if (p < c.end && (*p == 'e' || *p == 'E')) {
+		const char* e = p + 1;
+		bool expNegative = false;
+		if (e < c.end && (*e == '-' || *e == '+')) {
+			expNegative = *e == '-';
+			e++;
+		}
+		if (e < c.end && isDigit(*e)) {
+			int value = 0;
+			while (e < c.end && isDigit(*e)) {
+				if (value < 10000) {
+					value = value * 10 + (*e - '0');
+				}
+				e++;
+			}
+			exponent += expNegative ? -value : value;
+			p = e;
+		}
+	}
+	if (p < c.end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') {
+		slow = true;	// nan, inf, hex floats...
+	}
+
+	if (!slow && exponent >= -22 && exponent <= 22) {
+		c.p = p;
+		double value = (double)mantissa;
+		value = exponent < 0 ? value / powersOfTen[-exponent] : value * powersOfTen[exponent];
+		return (float)(negative ? -value : value);
+	}
+
+	// Rare cases, copy the token so strtof can't run past the mapping
+	char token[64];
+	size_t length = 0;
+	while (start + length < c.end && length < sizeof(token) - 1 &&
+		   start[length] != ' ' && start[length] != '\t' && start[length] != '\r' && start[length] != '\n') {
+		length++;
+	}
+	memcpy(token, start, length);
+	token[length] = 0;
+	c.p = start + length;
+	return strtof(token, NULL);
+}
+
+static inline bool parseInt(cursor_t& c, int& value) {
+	bool negative = false;
+	if (c.p < c.end && *c.p == '-') {
+		negative = true;
+		c.p++;
+	}
+	if (c.p >= c.end || !isDigit(*c.p)) {
+		return false;
+	}
+	int result = 0;
+	while (c.p < c.end && isDigit(*c.p)) {
+		result = result * 10 + (*c.p - '0');
+		c.p++;
+	}
+	value = negative ? -result : result;
+	return true;
+}
+
+static string parseName(cursor_t& c) {
+	skipSpaces(c);
+	const char* end = c.end;
+	while (end > c.p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+		end--;
+	}
+	return string(c.p, end);
+}
+
+static bool keyword(const cursor_t& c, const char* word, size_t length) {
+	return (size_t)(c.end - c.p) > length && memcmp(c.p, word, length) == 0 && (c.p[length] == ' ' || c.p[length] == '\t');
+}
+
+// Open addressing table: (position, texcoord, normal) -> vertex id of one mesh
+typedef struct {
+	vector<int>				keys;		// 3 per slot
+	vector<unsigned int>	values;		// ~0 when empty
+	unsigned int			used;
+} cornertable_t;
+
+static inline unsigned int hashCorner(const int* key) {
+	unsigned int h = (unsigned int)key[0] * 73856093u;
+	h ^= (unsigned int)key[1] * 19349663u;
+	h ^= (unsigned int)key[2] * 83492791u;
+	return h ^ (h >> 15);
+}
+
+static void growTable(cornertable_t& table) {
+	cornertable_t bigger;
+	const size_t slots = table.values.empty() ? 1024 : table.values.size() * 2;
+	bigger.keys.resize(slots * 3);
+	bigger.values.assign(slots, ~0u);
+	bigger.used = table.used;
+	for (size_t i = 0; i < table.values.size(); i++) {
+		if (table.values[i] == ~0u) {
+			continue;
+		}
+		size_t slot = hashCorner(&table.keys[i * 3]) & (slots - 1);
+		while (bigger.values[slot] != ~0u) {
+			slot = (slot + 1) & (slots - 1);
+		}
+		memcpy(&bigger.keys[slot * 3], &table.keys[i * 3], 3 * sizeof(int));
+		bigger.values[slot] = table.values[i];
+	}
+	table.keys.swap(bigger.keys);
+	table.values.swap(bigger.values);
+}
+
+// Mesh being built, with its corner table
+typedef struct {
+	string			object;
+	unsigned int	material;
+	cornertable_t	corners;
+} openmesh_t;
+
+typedef struct {
+	vector<float>			positions, normals, texcoords;	// Pools from v, vn and vt lines
+	vector<openmesh_t>		open;
+	vector<string>			materialNames;
+	vector<string>			libraries;
+	string					object;
+	unsigned int			material;
+	int						current;						// Mesh faces go to, -1 before the first face
+	vector<unsigned int>	polygon;						// Reused for every face
+} objstate_t;
+
+static unsigned int findMaterial(objstate_t& state, const string& name) {
+	for (size_t i = 0; i < state.materialNames.size(); i++) {
+		if (state.materialNames[i] == name) {
+			return i;
+		}
+	}
+	state.materialNames.push_back(name);
+	return state.materialNames.size() - 1;
+}
+
+// Vertex id of a corner in the current mesh, adding it on first use
+static unsigned int addCorner(objstate_t& state, sourcescene_t& scene, const int* key) {
+	openmesh_t& open = state.open[state.current];
+	sourcemesh_t& mesh = scene.meshes[state.current];
+	cornertable_t& table = open.corners;
+	if ((table.used + 1) * 2 > table.values.size()) {
+		growTable(table);
+	}
+
+	const size_t mask = table.values.size() - 1;
+	size_t slot = hashCorner(key) & mask;
+	while (table.values[slot] != ~0u) {
+		const int* k = &table.keys[slot * 3];
+		if (k[0] == key[0] && k[1] == key[1] && k[2] == key[2]) {
+			return table.values[slot];
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	const unsigned int id = mesh.positions.size() / 3;
+	memcpy(&table.keys[slot * 3], key, 3 * sizeof(int));
+	table.values[slot] = id;
+	table.used++;
+
+	mesh.positions.insert(mesh.positions.end(), &state.positions[key[0] * 3], &state.positions[key[0] * 3] + 3);
+	if (key[2] >= 0) {
+		mesh.normals.insert(mesh.normals.end(), &state.normals[key[2] * 3], &state.normals[key[2] * 3] + 3);
+	} else {
+		mesh.normals.insert(mesh.normals.end(), 3, 0.0f);
+	}
+	if (key[1] >= 0) {
+		mesh.texcoords.insert(mesh.texcoords.end(), &state.texcoords[key[1] * 2], &state.texcoords[key[1] * 2] + 2);
+	} else {
+		mesh.texcoords.insert(mesh.texcoords.end(), 2, 0.0f);
+	}
+	return id;
+}
+
+// Resolve a 1 based or negative (relative) index, -1 if missing or out of range
+static inline int resolveIndex(int index, size_t count) {
+	if (index > 0 && (size_t)index <= count) {
+		return index - 1;
+	}
+	if (index < 0 && (size_t)-index <= count) {
+		return (int)count + index;
+	}
+	return -1;
+}
+
+static bool parseFace(objstate_t& state, sourcescene_t& scene, cursor_t& c) {
+	// Pick the mesh for the current object and material
+	if (state.current < 0 || state.open[state.current].object != state.object || state.open[state.current].material != state.material) {
+		state.current = -1;
+		for (size_t i = 0; i < state.open.size(); i++) {
+			if (state.open[i].object == state.object && state.open[i].material == state.material) {
+				state.current = i;
+				break;
+			}
+		}
+		if (state.current < 0) {
+			openmesh_t open;
+			open.object = state.object;
+			open.material = state.material;
+			open.corners.used = 0;
+			state.open.push_back(open);
+			sourcemesh_t mesh;
+			mesh.material = state.material;
+			scene.meshes.push_back(mesh);
+			state.current = state.open.size() - 1;
+		}
+	}
+
+	state.polygon.clear();
+	while (true) {
+		skipSpaces(c);
+		if (c.p >= c.end || *c.p == '\r') {
+			break;
+		}
+
+		int v = 0, t = 0, n = 0;
+		if (!parseInt(c, v)) {
+			return false;
+		}
+		if (c.p < c.end && *c.p == '/') {
+			c.p++;
+			if (c.p < c.end && *c.p != '/') {
+				parseInt(c, t);
+			}
+			if (c.p < c.end && *c.p == '/') {
+				c.p++;
+				parseInt(c, n);
+			}
+		}
+
+		int key[3];
+		key[0] = resolveIndex(v, state.positions.size() / 3);
+		key[1] = resolveIndex(t, state.texcoords.size() / 2);
+		key[2] = resolveIndex(n, state.normals.size() / 3);
+		if (key[0] < 0) {
+			return false;
+		}
+		state.polygon.push_back(addCorner(state, scene, key));
+	}
+
+	// Fan triangulation
+	vector<unsigned int>& triangles = scene.meshes[state.current].triangles;
+	for (size_t i = 2; i < state.polygon.size(); i++) {
+		triangles.push_back(state.polygon[0]);
+		triangles.push_back(state.polygon[i - 1]);
+		triangles.push_back(state.polygon[i]);
+	}
+	return true;
+}
+
+// Diffuse textures from a .mtl file
+static void parseMaterialLibrary(const string& path, const vector<string>& names, vector<string>& textures) {
+	mappedfile_t map;
+	if (!mapFile(path, map)) {
+		return;
+	}
+
+	int material = -1;
+	const char* p = map.data;
+	const char* end = map.data + map.size;
+	while (p < end) {
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		cursor_t c = { p, eol != NULL ? eol : end };
+		p = eol != NULL ? eol + 1 : end;
+		skipSpaces(c);
+
+		if (keyword(c, "newmtl", 6)) {
+			c.p += 6;
+			const string name = parseName(c);
+			material = -1;
+			for (size_t i = 0; i < names.size(); i++) {
+				if (names[i] == name) {
+					material = i;
+				}
+			}
+		} else if (keyword(c, "map_Kd", 6) && material >= 0) {
+			c.p += 6;
+			textures[material] = parseName(c);
+		}
+	}
+	unmapFile(map);
+}
+
+bool parseObj(const string& file, sourcescene_t& scene, string& error) {
+	mappedfile_t map;
+	if (!mapFile(file, map)) {
+		error = "unable to open file";
+		return false;
+	}
+
+	objstate_t state;
+	state.material = findMaterial(state, "DefaultMaterial");
+	state.current = -1;
+	scene.meshes.clear();
+	scene.materials.clear();
+
+	unsigned int line = 0;
+	const char* p = map.data;
+	const char* end = map.data + map.size;
+	while (p < end) {
+		const char* eol = (const char*)memchr(p, '\n', end - p);
+		cursor_t c = { p, eol != NULL ? eol : end };
+		p = eol != NULL ? eol + 1 : end;
+		line++;
+		skipSpaces(c);
+		if (c.end - c.p < 2) {
+			continue;
+		}
+
+		bool ok = true;
+		if (c.p[0] == 'v' && (c.p[1] == ' ' || c.p[1] == '\t')) {
+			c.p += 1;
+			for (unsigned int k = 0; k < 3; k++) {
+				state.positions.push_back(parseFloat(c));
+			}
+		} else if (c.p[0] == 'v' && c.p[1] == 'n') {
+			c.p += 2;
+			for (unsigned int k = 0; k < 3; k++) {
+				state.normals.push_back(parseFloat(c));
+			}
+		} else if (c.p[0] == 'v' && c.p[1] == 't') {
+			c.p += 2;
+			state.texcoords.push_back(parseFloat(c));
+			state.texcoords.push_back(parseFloat(c));
+		} else if (c.p[0] == 'f' && (c.p[1] == ' ' || c.p[1] == '\t')) {
+			c.p += 1;
+			ok = parseFace(state, scene, c);
+		} else if ((c.p[0] == 'o' || c.p[0] == 'g') && (c.p[1] == ' ' || c.p[1] == '\t')) {
+			c.p += 1;
+			state.object = parseName(c);
+		} else if (keyword(c, "usemtl", 6)) {
+			c.p += 6;
+			state.material = findMaterial(state, parseName(c));
+		} else if (keyword(c, "mtllib", 6)) {
+			c.p += 6;
+			state.libraries.push_back(parseName(c));
+		}
+
+		if (!ok) {
+			char message[64];
+			sprintf(message, "bad face on line %u", line);
+			error = message;
+			unmapFile(map);
+			return false;
+		}
+	}
+	unmapFile(map);
+
+	// Material table, in order of first use
+	vector<string> textures(state.materialNames.size());
+	const size_t slash = file.find_last_of("/\\");
+	const string directory = slash != string::npos ? file.substr(0, slash + 1) : "";
+	for (size_t i = 0; i < state.libraries.size(); i++) {
+		parseMaterialLibrary(directory + state.libraries[i], state.materialNames, textures);
+	}
+	for (size_t i = 0; i < state.materialNames.size(); i++) {
+		scene.materials.push_back(makeMaterial(state.materialNames[i], textures[i]));
+	}
+
+	return true;
+}
+
+bool writeSyntheticObj(const string& file, unsigned int faces) {
+	FILE* out = fopen(file.c_str(), "wb");
+	if (out == NULL) {
+		return false;
+	}
+
+	// Square grid with 2 triangles per cell, a bit of height so floats vary
+	unsigned int side = 1;
+	while (side * side * 2 < faces) {
+		side++;
+	}
+	const unsigned int row = side + 1;
+	for (unsigned int y = 0; y <= side; y++) {
+		for (unsigned int x = 0; x <= side; x++) {
+			fprintf(out, "v %f %f %f\n", x * 0.25f, ((x * 7 + y * 13) % 17) * 0.01f, y * 0.25f);
+			fprintf(out, "vt %f %f\n", (float)x / side, (float)y / side);
+			fprintf(out, "vn %f %f %f\n", 0.0f, 1.0f, 0.0f);
+		}
+	}
+	unsigned int written = 0;
+	for (unsigned int y = 0; y < side && written < faces; y++) {
+		for (unsigned int x = 0; x < side && written < faces; x++) {
+			const unsigned int a = y * row + x + 1, b = a + 1, c = a + row, d = c + 1;
+			fprintf(out, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, c, c, c, b, b, b);
+			written++;
+			if (written < faces) {
+				fprintf(out, "f %u/%u/%u %u/%u/%u %u/%u/%u\n", b, b, b, c, c, c, d, d, d);
+				written++;
+			}
+		}
+	}
+	fclose(out);
+	return true;
+}
@@ -0,0 +1,147 @@
+// quantize.cpp : Fixed point vertex formats for GX
+//
+
+#include "obj2bin.h"
+
+#include <cmath>
+#include <cstring>
+using namespace std;
+
+unsigned int componentSize(unsigned char type) {
+	switch (type) {
+	case COMP_U8:
+	case COMP_S8:
+		return 1;
+	case COMP_U16:
+	case COMP_S16:
+		return 2;
+	default:
+		return 4;
+	}
+}
+
+const char* componentName(unsigned char type) {
+	static const char* names[] = { "u8", "s8", "u16", "s16", "f32" };
+	return type <= COMP_F32 ? names[type] : "?";
+}
+
+// Largest number of fractional bits that still fits the range
+static unsigned char fitFrac(float maxAbs, float limit, unsigned char maxFrac) {
+	unsigned char frac = maxFrac;
+	while (frac > 0 && floor(maxAbs * (1 << frac) + 0.5f) > limit) {
+		frac--;
+	}
+	return frac;
+}
+
+static float measureError(const float* values, unsigned int count, const quantization_t& q, float minValue, float maxValue) {
+	const float scale = (float)(1 << q.frac);
+	float worst = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		float fixed = floor(values[i] * scale + 0.5f);
+		// Out of range values can't be stored at all
+		if (fixed < minValue || fixed > maxValue) {
+			return INFINITY;
+		}
+		float error = fabs(fixed / scale - values[i]);
+		if (error > worst) {
+			worst = error;
+		}
+	}
+	return worst;
+}
+
+quantization_t chooseQuantization(const float* values, unsigned int count, int stream, float maxError) {
+	float minV = 0, maxAbs = 0;
+	for (unsigned int i = 0; i < count; i++) {
+		if (values[i] < minV) minV = values[i];
+		if (fabs(values[i]) > maxAbs) maxAbs = fabs(values[i]);
+	}
+
+	// Candidates, smallest first
+	quantization_t candidates[2];
+	unsigned int candidateCount = 0;
+	switch (stream) {
+	case STREAM_NORMAL:
+		// GX requires fixed scales for normals
+		candidates[candidateCount++] = { COMP_S8, 6, 0 };
+		candidates[candidateCount++] = { COMP_S16, 14, 0 };
+		break;
+	case STREAM_TEXCOORD:
+		if (minV >= 0) {
+			candidates[candidateCount++] = { COMP_U16, fitFrac(maxAbs, 65535, 15), 0 };
+		} else {
+			candidates[candidateCount++] = { COMP_S16, fitFrac(maxAbs, 32767, 15), 0 };
+		}
+		break;
+	default:
+		candidates[candidateCount++] = { COMP_S16, fitFrac(maxAbs, 32767, 15), 0 };
+		break;
+	}
+
+	for (unsigned int c = 0; c < candidateCount; c++) {
+		quantization_t& q = candidates[c];
+		float minValue, maxValue;
+		switch (q.type) {
+		case COMP_S8:  minValue = -128;   maxValue = 127;   break;
+		case COMP_U16: minValue = 0;      maxValue = 65535; break;
+		default:       minValue = -32768; maxValue = 32767; break;
+		}
+		q.error = measureError(values, count, q, minValue, maxValue);
+		if (q.error <= maxError) {
+			return q;
+		}
+	}
+
+	// Nothing fits, keep floats
+	quantization_t q = { COMP_F32, 0, 0 };
+	return q;
+}
+
+void writeQuantized(vector<unsigned char>& out, const float* values, unsigned int count, const quantization_t& q) {
+	const float scale = (float)(1 << q.frac);
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int bits;
+		switch (q.type) {
+		case COMP_F32: {
+			float v = values[i];
+			memcpy(&bits, &v, sizeof(float));
+			break;
+		}
+		default:
+			bits = (unsigned int)(int)floor(values[i] * scale + 0.5f);
+			break;
+		}
+
+		// Big endian, only the low bytes of fixed point values
+		for (int b = componentSize(q.type) - 1; b >= 0; b--) {
+			out.push_back((unsigned char)(bits >> (b * 8)));
+		}
+	}
+}
+
+void readQuantized(const unsigned char* data, unsigned int count, unsigned char type, unsigned char frac, vector<float>& out) {
+	const unsigned int size = componentSize(type);
+	const float scale = 1.0f / (float)(1 << frac);
+	out.resize(count);
+	for (unsigned int i = 0; i < count; i++) {
+		unsigned int bits = 0;
+		for (unsigned int b = 0; b < size; b++) {
+			bits = (bits << 8) | data[i * size + b];
+		}
+		switch (type) {
+		case COMP_F32:
+			memcpy(&out[i], &bits, sizeof(float));
+			break;
+		case COMP_S8:
+			out[i] = (signed char)bits * scale;
+			break;
+		case COMP_S16:
+			out[i] = (short)bits * scale;
+			break;
+		default:
+			out[i] = bits * scale;
+			break;
+		}
+	}
+}
@@ -0,0 +1,69 @@
+// split.cpp : Split meshes so every attribute fits 16-bit indices
+//
+
+#include "obj2bin.h"
+
+using namespace std;
+
+// Copy the attribute entries a submesh uses, returns the global -> local table
+static unsigned int localAttribute(vector<unsigned int>& local, const vector<float>& values, unsigned int components,
+								   unsigned int global, vector<float>& out) {
+	if (local[global] == ~0u) {
+		local[global] = out.size() / components;
+		out.insert(out.end(), values.begin() + global * components, values.begin() + (global + 1) * components);
+	}
+	return local[global];
+}
+
+vector<meshdata_t> splitMesh(const meshdata_t& mesh, unsigned int maxIndex) {
+	vector<meshdata_t> result;
+	const unsigned int triCount = mesh.triangles.size() / 3;
+
+	vector<unsigned int> localVertex(mesh.vertexCount, ~0u);
+	vector<unsigned int> localPosition(mesh.positions.size() / 3, ~0u);
+	vector<unsigned int> localNormal(mesh.normals.size() / 3, ~0u);
+	vector<unsigned int> localTexcoord(mesh.texcoords.size() / 2, ~0u);
+	vector<unsigned int> touched;
+
+	unsigned int tri = 0;
+	while (tri < triCount) {
+		meshdata_t sub;
+		sub.vertexCount = 0;
+		touched.clear();
+
+		// Take triangles in order until one more could overflow an index
+		for (; tri < triCount; tri++) {
+			if (sub.vertexCount + 3 > maxIndex + 1 ||
+				sub.positions.size() / 3 + 3 > maxIndex + 1 ||
+				sub.normals.size() / 3 + 3 > maxIndex + 1 ||
+				sub.texcoords.size() / 2 + 3 > maxIndex + 1) {
+				break;
+			}
+
+			for (unsigned int c = 0; c < 3; c++) {
+				const unsigned int v = mesh.triangles[tri * 3 + c];
+				if (localVertex[v] == ~0u) {
+					localVertex[v] = sub.vertexCount++;
+					touched.push_back(v);
+					sub.positionOf.push_back(localAttribute(localPosition, mesh.positions, 3, mesh.positionOf[v], sub.positions));
+					sub.normalOf.push_back(localAttribute(localNormal, mesh.normals, 3, mesh.normalOf[v], sub.normals));
+					sub.texcoordOf.push_back(localAttribute(localTexcoord, mesh.texcoords, 2, mesh.texcoordOf[v], sub.texcoords));
+				}
+				sub.triangles.push_back(localVertex[v]);
+			}
+		}
+
+		// Reset the tables for the next window
+		for (size_t i = 0; i < touched.size(); i++) {
+			const unsigned int v = touched[i];
+			localVertex[v] = ~0u;
+			localPosition[mesh.positionOf[v]] = ~0u;
+			localNormal[mesh.normalOf[v]] = ~0u;
+			localTexcoord[mesh.texcoordOf[v]] = ~0u;
+		}
+
+		result.push_back(sub);
+	}
+
+	return result;
+}
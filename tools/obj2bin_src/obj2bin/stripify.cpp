@@ -0,0 +1,207 @@
+// stripify.cpp : Greedy triangle strip builder
+//
+// Strips either grow from the least connected triangles (longest strips), or
+// follow the triangle order within a window, so a vertex cache order from
+// optimizeVertexCache survives into the strips.
+
+#include "obj2bin.h"
+
+#include <map>
+#include <utility>
+using namespace std;
+
+// Strip starts evaluated per strip
+#define STRIP_CANDIDATES 4
+
+// GX_Begin takes a 16-bit vertex count
+#define STRIP_MAX_LENGTH 0xFFFF
+
+typedef pair<unsigned int, unsigned int> edge_t;
+
+// Triangles owning a directed edge (a -> b in their winding)
+typedef multimap<edge_t, unsigned int> edgemap_t;
+
+// Find an unused triangle below limit that has the directed edge a -> b, returns its third vertex
+static bool findTriangle(const edgemap_t& edges, const vector<bool>& used, const vector<unsigned int>& tris, unsigned int limit,
+						 unsigned int a, unsigned int b, unsigned int& triangle, unsigned int& third) {
+	pair<edgemap_t::const_iterator, edgemap_t::const_iterator> range = edges.equal_range(edge_t(a, b));
+	for (edgemap_t::const_iterator it = range.first; it != range.second; ++it) {
+		if (used[it->second] || it->second >= limit) {
+			continue;
+		}
+		const unsigned int* t = &tris[it->second * 3];
+		for (unsigned int c = 0; c < 3; c++) {
+			if (t[c] == a && t[(c + 1) % 3] == b) {
+				triangle = it->second;
+				third = t[(c + 2) % 3];
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Grow a strip from a triangle, starting at one of its 3 rotations
+static void growStrip(const edgemap_t& edges, vector<bool>& used, const vector<unsigned int>& tris, unsigned int limit,
+					  unsigned int start, unsigned int rotation,
+					  vector<unsigned int>& strip, vector<unsigned int>& stripTris) {
+	const unsigned int* t = &tris[start * 3];
+	strip.clear();
+	stripTris.clear();
+	strip.push_back(t[rotation]);
+	strip.push_back(t[(rotation + 1) % 3]);
+	strip.push_back(t[(rotation + 2) % 3]);
+	stripTris.push_back(start);
+	used[start] = true;
+
+	// Forward
+	while (strip.size() < STRIP_MAX_LENGTH) {
+		const size_t n = strip.size();
+		// Odd triangles in a strip are wound backwards
+		const bool odd = ((n - 2) % 2) == 1;
+		const unsigned int a = odd ? strip[n - 1] : strip[n - 2];
+		const unsigned int b = odd ? strip[n - 2] : strip[n - 1];
+
+		unsigned int next, third;
+		if (!findTriangle(edges, used, tris, limit, a, b, next, third)) {
+			break;
+		}
+		strip.push_back(third);
+		stripTris.push_back(next);
+		used[next] = true;
+	}
+
+	// Backward, two triangles at a time so the parity of the rest holds
+	vector<unsigned int> front, frontTris;
+	while (strip.size() + front.size() + 2 <= STRIP_MAX_LENGTH) {
+		const unsigned int s0 = front.empty() ? strip[0] : front[front.size() - 1];
+		const unsigned int s1 = front.empty() ? strip[1] : (front.size() > 1 ? front[front.size() - 2] : strip[0]);
+
+		unsigned int first, w1;
+		if (!findTriangle(edges, used, tris, limit, s1, s0, first, w1)) {
+			break;
+		}
+		used[first] = true;
+
+		unsigned int second, w2;
+		if (!findTriangle(edges, used, tris, limit, w1, s0, second, w2)) {
+			used[first] = false;
+			break;
+		}
+		used[second] = true;
+
+		front.push_back(w1);
+		front.push_back(w2);
+		frontTris.push_back(first);
+		frontTris.push_back(second);
+	}
+	strip.insert(strip.begin(), front.rbegin(), front.rend());
+	stripTris.insert(stripTris.begin(), frontTris.rbegin(), frontTris.rend());
+
+	// Give the triangles back, the caller decides which strip to keep
+	for (size_t i = 0; i < stripTris.size(); i++) {
+		used[stripTris[i]] = false;
+	}
+}
+
+striplist_t stripify(const vector<unsigned int>& tris, unsigned int window) {
+	striplist_t result;
+	const unsigned int triCount = tris.size() / 3;
+
+	edgemap_t edges;
+	for (unsigned int i = 0; i < triCount; i++) {
+		const unsigned int* t = &tris[i * 3];
+		for (unsigned int c = 0; c < 3; c++) {
+			edges.insert(make_pair(edge_t(t[c], t[(c + 1) % 3]), i));
+		}
+	}
+
+	// Neighbours across each edge (any winding), used to pick strip starts
+	vector<vector<unsigned int> > neighbours(triCount);
+	for (unsigned int i = 0; i < triCount; i++) {
+		const unsigned int* t = &tris[i * 3];
+		for (unsigned int c = 0; c < 3; c++) {
+			pair<edgemap_t::const_iterator, edgemap_t::const_iterator> range = edges.equal_range(edge_t(t[(c + 1) % 3], t[c]));
+			for (edgemap_t::const_iterator it = range.first; it != range.second; ++it) {
+				if (it->second != i) {
+					neighbours[i].push_back(it->second);
+				}
+			}
+		}
+	}
+
+	// Buckets of triangles by unused neighbour count (stale entries are skipped)
+	vector<unsigned int> degree(triCount);
+	vector<vector<unsigned int> > buckets(4);
+	for (unsigned int i = 0; i < triCount; i++) {
+		degree[i] = neighbours[i].size() < 3 ? neighbours[i].size() : 3;
+		buckets[degree[i]].push_back(i);
+	}
+
+	vector<bool> used(triCount, false);
+	vector<unsigned int> strip, stripTris, best, bestTris;
+	unsigned int remaining = triCount, next = 0, limit = triCount;
+
+	while (remaining > 0) {
+		vector<unsigned int> starts;
+		if (window > 0) {
+			// Follow the triangle order: start at the first triangle left and
+			// only take the next few, so strips don't run away from the cache
+			while (used[next]) next++;
+			starts.push_back(next);
+			limit = next + window < triCount ? next + window : triCount;
+		}
+
+		// Otherwise look at a few of the least connected triangles, strips then sweep across the mesh
+		for (unsigned int b = 0; b < buckets.size() && starts.size() < STRIP_CANDIDATES && window == 0; b++) {
+			while (!buckets[b].empty() && starts.size() < STRIP_CANDIDATES) {
+				unsigned int candidate = buckets[b].back();
+				buckets[b].pop_back();
+				if (!used[candidate] && degree[candidate] == b) {
+					starts.push_back(candidate);
+				}
+			}
+		}
+
+		// Try every rotation of each start and keep the longest strip
+		best.clear();
+		bestTris.clear();
+		for (size_t c = 0; c < starts.size(); c++) {
+			for (unsigned int r = 0; r < 3; r++) {
+				growStrip(edges, used, tris, limit, starts[c], r, strip, stripTris);
+				if (strip.size() > best.size()) {
+					best.swap(strip);
+					bestTris.swap(stripTris);
+				}
+			}
+		}
+
+		// Candidates that didn't make it go back to their buckets
+		for (size_t c = 0; c < starts.size() && window == 0; c++) {
+			buckets[degree[starts[c]]].push_back(starts[c]);
+		}
+
+		for (size_t t = 0; t < bestTris.size(); t++) {
+			const unsigned int tri = bestTris[t];
+			used[tri] = true;
+			remaining--;
+
+			for (size_t n = 0; n < neighbours[tri].size(); n++) {
+				const unsigned int other = neighbours[tri][n];
+				if (!used[other] && degree[other] > 0) {
+					degree[other]--;
+					buckets[degree[other]].push_back(other);
+				}
+			}
+		}
+
+		// Single triangles are cheaper in the shared triangle list
+		if (bestTris.size() == 1) {
+			result.triangles.insert(result.triangles.end(), best.begin(), best.end());
+		} else {
+			result.strips.push_back(best);
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,192 @@
+// vcache.cpp : Vertex cache aware triangle ordering (Forsyth's linear-speed optimizer)
+//
+
+#include "obj2bin.h"
+
+#include <cmath>
+#include <deque>
+#include <algorithm>
+using namespace std;
+
+// Scoring constants, from "Linear-Speed Vertex Cache Optimisation" (Tom Forsyth)
+static const float cacheDecayPower = 1.5f;
+static const float lastTriScore = 0.75f;
+static const float valenceBoostScale = 2.0f;
+static const float valenceBoostPower = 0.5f;
+
+typedef struct {
+	int							cachePosition;	// -1 when not in the cache
+	float						score;
+	unsigned int				remaining;		// Triangles not emitted yet
+	std::vector<unsigned int>	triangles;		// Triangles using this vertex
+} vcvertex_t;
+
+static float vertexScore(const vcvertex_t& v, unsigned int cacheSize) {
+	if (v.remaining == 0) {
+		return -1.0f;
+	}
+
+	float score = 0.0f;
+	if (v.cachePosition >= 0) {
+		if (v.cachePosition < 3) {
+			// The last triangle's vertices get a fixed score, so they aren't
+			// favoured just for having been used
+			score = lastTriScore;
+		} else {
+			const float scaler = 1.0f / (cacheSize - 3);
+			score = pow(1.0f - (v.cachePosition - 3) * scaler, cacheDecayPower);
+		}
+	}
+
+	// Boost vertices with few triangles left, so we don't leave lone triangles behind
+	score += valenceBoostScale * pow((float)v.remaining, -valenceBoostPower);
+	return score;
+}
+
+float measureACMR(const vector<unsigned int>& sequence, unsigned int triangleCount, unsigned int cacheSize) {
+	if (triangleCount == 0) {
+		return 0.0f;
+	}
+
+	// FIFO cache, like the GX vertex cache
+	deque<unsigned int> cache;
+	unsigned int misses = 0;
+	for (size_t i = 0; i < sequence.size(); i++) {
+		if (find(cache.begin(), cache.end(), sequence[i]) != cache.end()) {
+			continue;
+		}
+		misses++;
+		cache.push_back(sequence[i]);
+		if (cache.size() > cacheSize) {
+			cache.pop_front();
+		}
+	}
+
+	return (float)misses / triangleCount;
+}
+
+vector<unsigned int> optimizeVertexCache(const vector<unsigned int>& tris, unsigned int vertexCount, unsigned int cacheSize) {
+	const unsigned int triCount = tris.size() / 3;
+	vector<unsigned int> result;
+	result.reserve(tris.size());
+
+	if (cacheSize < 4 || triCount == 0) {
+		return tris;
+	}
+
+	vector<vcvertex_t> vertices(vertexCount);
+	for (unsigned int i = 0; i < triCount; i++) {
+		for (unsigned int c = 0; c < 3; c++) {
+			vertices[tris[i * 3 + c]].triangles.push_back(i);
+		}
+	}
+	for (unsigned int v = 0; v < vertexCount; v++) {
+		vertices[v].cachePosition = -1;
+		vertices[v].remaining = vertices[v].triangles.size();
+		vertices[v].score = vertexScore(vertices[v], cacheSize);
+	}
+
+	vector<float> triScore(triCount);
+	vector<bool> emitted(triCount, false);
+	for (unsigned int i = 0; i < triCount; i++) {
+		triScore[i] = vertices[tris[i * 3]].score + vertices[tris[i * 3 + 1]].score + vertices[tris[i * 3 + 2]].score;
+	}
+
+	// LRU cache, with room for the 3 vertices being added
+	vector<unsigned int> cache, newCache;
+	unsigned int scanStart = 0;
+
+	// Best triangle to begin with
+	int best = -1;
+	for (unsigned int i = 0; i < triCount; i++) {
+		if (best < 0 || triScore[i] > triScore[best]) {
+			best = i;
+		}
+	}
+
+	while (best >= 0) {
+		const unsigned int* t = &tris[best * 3];
+		result.push_back(t[0]);
+		result.push_back(t[1]);
+		result.push_back(t[2]);
+		emitted[best] = true;
+
+		// Update valences
+		for (unsigned int c = 0; c < 3; c++) {
+			vcvertex_t& v = vertices[t[c]];
+			v.remaining--;
+			vector<unsigned int>::iterator it = find(v.triangles.begin(), v.triangles.end(), (unsigned int)best);
+			if (it != v.triangles.end()) {
+				v.triangles.erase(it);
+			}
+		}
+
+		// Move the triangle's vertices to the front of the cache
+		newCache.clear();
+		newCache.push_back(t[0]);
+		newCache.push_back(t[1]);
+		newCache.push_back(t[2]);
+		for (size_t i = 0; i < cache.size(); i++) {
+			if (cache[i] != t[0] && cache[i] != t[1] && cache[i] != t[2]) {
+				newCache.push_back(cache[i]);
+			}
+		}
+		cache.swap(newCache);
+
+		// Rescore everything that was or is in the cache
+		for (size_t i = 0; i < cache.size(); i++) {
+			vcvertex_t& v = vertices[cache[i]];
+			v.cachePosition = i < cacheSize ? (int)i : -1;
+			v.score = vertexScore(v, cacheSize);
+		}
+		if (cache.size() > cacheSize) {
+			cache.resize(cacheSize);
+		}
+
+		// Pick the best triangle touching the cache
+		best = -1;
+		float bestScore = -1.0f;
+		for (size_t i = 0; i < cache.size(); i++) {
+			const vcvertex_t& v = vertices[cache[i]];
+			for (size_t k = 0; k < v.triangles.size(); k++) {
+				const unsigned int tri = v.triangles[k];
+				const unsigned int* tv = &tris[tri * 3];
+				triScore[tri] = vertices[tv[0]].score + vertices[tv[1]].score + vertices[tv[2]].score;
+				if (triScore[tri] > bestScore) {
+					bestScore = triScore[tri];
+					best = tri;
+				}
+			}
+		}
+
+		// Nothing in the cache can continue, take the next triangle left
+		if (best < 0) {
+			while (scanStart < triCount && emitted[scanStart]) {
+				scanStart++;
+			}
+			if (scanStart < triCount) {
+				best = scanStart;
+			}
+		}
+	}
+
+	return result;
+}
+
+vector<unsigned int> firstUseOrder(const vector<unsigned int>& sequence, unsigned int vertexCount) {
+	vector<unsigned int> remap(vertexCount, ~0u);
+	unsigned int next = 0;
+	for (size_t i = 0; i < sequence.size(); i++) {
+		if (remap[sequence[i]] == ~0u) {
+			remap[sequence[i]] = next++;
+		}
+	}
+
+	// Unused vertices go at the end
+	for (unsigned int v = 0; v < vertexCount; v++) {
+		if (remap[v] == ~0u) {
+			remap[v] = next++;
+		}
+	}
+	return remap;
+}
@@ -0,0 +1,164 @@
+// atlas.cpp : Texture atlas packing
+//
+// Slots are placed with a skyline packer (lowest spot first, tallest images
+// first) on every page width that could work, the page with the smallest area
+// wins. GX takes any size up to 1024 for clamped, unmipmapped textures, so
+// pages don't have to be powers of two.
+
+#include "png2tpl.h"
+
+#include <algorithm>
+using namespace std;
+
+typedef struct {
+	unsigned int	x;
+	unsigned int	y;		// Top of the used space
+	unsigned int	width;
+} skyline_t;
+
+static unsigned int alignTo(unsigned int value, unsigned int step) {
+	return (value + step - 1) / step * step;
+}
+
+// Lowest y a width x height box can go at segment first (~0u if it doesn't fit)
+static unsigned int fitAt(const vector<skyline_t>& skyline, size_t first, unsigned int width, unsigned int pageWidth) {
+	const unsigned int x = skyline[first].x;
+	if (x + width > pageWidth) {
+		return ~0u;
+	}
+	unsigned int y = 0;
+	for (size_t i = first; i < skyline.size() && skyline[i].x < x + width; i++) {
+		y = max(y, skyline[i].y);
+	}
+	return y;
+}
+
+static void addBox(vector<skyline_t>& skyline, unsigned int x, unsigned int y, unsigned int width) {
+	skyline_t top = { x, y, width };
+
+	// Cut what the box covers, then merge neighbours at the same height
+	vector<skyline_t> next;
+	for (size_t i = 0; i < skyline.size(); i++) {
+		const skyline_t& s = skyline[i];
+		const unsigned int end = s.x + s.width;
+		if (end <= x || s.x >= x + width) {
+			next.push_back(s);
+			continue;
+		}
+		if (s.x < x) {
+			skyline_t left = { s.x, s.y, x - s.x };
+			next.push_back(left);
+		}
+		if (end > x + width) {
+			skyline_t right = { x + width, s.y, end - x - width };
+			next.push_back(right);
+		}
+	}
+	next.push_back(top);
+	sort(next.begin(), next.end(), [](const skyline_t& a, const skyline_t& b) { return a.x < b.x; });
+
+	skyline.clear();
+	for (size_t i = 0; i < next.size(); i++) {
+		if (!skyline.empty() && skyline.back().y == next[i].y) {
+			skyline.back().width += next[i].width;
+		} else {
+			skyline.push_back(next[i]);
+		}
+	}
+}
+
+// Pack boxes (in order) on a page of the given width, returns the page height
+static unsigned int packWidth(const vector<unsigned int>& order, const vector<unsigned int>& widths, const vector<unsigned int>& heights,
+							  unsigned int pageWidth, vector<unsigned int>& xs, vector<unsigned int>& ys) {
+	vector<skyline_t> skyline;
+	skyline_t floor = { 0, 0, pageWidth };
+	skyline.push_back(floor);
+
+	unsigned int pageHeight = 0;
+	for (size_t n = 0; n < order.size(); n++) {
+		const unsigned int box = order[n];
+		unsigned int bestY = ~0u, bestX = 0;
+		for (size_t i = 0; i < skyline.size(); i++) {
+			const unsigned int y = fitAt(skyline, i, widths[box], pageWidth);
+			if (y < bestY) {
+				bestY = y;
+				bestX = skyline[i].x;
+			}
+		}
+		if (bestY == ~0u) {
+			return ~0u;
+		}
+		xs[box] = bestX;
+		ys[box] = bestY;
+		addBox(skyline, bestX, bestY + heights[box], widths[box]);
+		pageHeight = max(pageHeight, bestY + heights[box]);
+	}
+	return pageHeight;
+}
+
+bool packAtlas(vector<atlasslot_t>& slots, unsigned int padding, unsigned int tileWidth, unsigned int tileHeight,
+			   unsigned int maxSize, unsigned int& pageWidth, unsigned int& pageHeight) {
+	if (slots.empty()) {
+		return false;
+	}
+
+	// Each box is its image rounded up to whole tiles plus a gutter on the right
+	// and bottom wide enough for both neighbours' padding, so images start on a
+	// tile and no tile (or CMPR block) mixes two textures
+	const unsigned int gutterX = alignTo(padding * 2, tileWidth), gutterY = alignTo(padding * 2, tileHeight);
+	vector<unsigned int> widths(slots.size()), heights(slots.size()), order(slots.size());
+	unsigned int widest = 0;
+	for (size_t i = 0; i < slots.size(); i++) {
+		widths[i] = alignTo(slots[i].width, tileWidth) + gutterX;
+		heights[i] = alignTo(slots[i].height, tileHeight) + gutterY;
+		widest = max(widest, widths[i]);
+		order[i] = i;
+	}
+	stable_sort(order.begin(), order.end(), [&](unsigned int a, unsigned int b) {
+		return heights[a] != heights[b] ? heights[a] > heights[b] : widths[a] > widths[b];
+	});
+
+	// The gutters along the right and bottom edges aren't needed, the page edge clamps
+	unsigned long long bestArea = ~0ull;
+	vector<unsigned int> xs(slots.size()), ys(slots.size());
+	for (unsigned int width = widest; width <= maxSize + gutterX; width += tileWidth) {
+		const unsigned int height = packWidth(order, widths, heights, width, xs, ys);
+		if (height == ~0u || height > maxSize + gutterY) {
+			continue;
+		}
+		const unsigned int w = width - gutterX, h = height - gutterY;
+		const unsigned long long pageArea = (unsigned long long)w * h;
+		// Smallest area, the squarer page on ties
+		if (pageArea < bestArea || (pageArea == bestArea && max(w, h) < max(pageWidth, pageHeight))) {
+			bestArea = pageArea;
+			pageWidth = w;
+			pageHeight = h;
+			for (size_t i = 0; i < slots.size(); i++) {
+				slots[i].x = xs[i];
+				slots[i].y = ys[i];
+			}
+		}
+		// No page is lower than the tallest box, wider ones only get emptier
+		if (height == heights[order[0]]) {
+			break;
+		}
+	}
+	return bestArea != ~0ull;
+}
+
+void blitPadded(image_t& page, const image_t& image, unsigned int x, unsigned int y, unsigned int padding) {
+	const int left = (int)x - (int)padding, top = (int)y - (int)padding;
+	const int right = (int)(x + image.width + padding), bottom = (int)(y + image.height + padding);
+	for (int py = max(top, 0); py < min(bottom, (int)page.height); py++) {
+		const int sy = min(max(py - (int)y, 0), (int)image.height - 1);
+		for (int px = max(left, 0); px < min(right, (int)page.width); px++) {
+			const int sx = min(max(px - (int)x, 0), (int)image.width - 1);
+			const unsigned char* from = &image.pixels[(sy * image.width + sx) * 4];
+			unsigned char* to = &page.pixels[(py * page.width + px) * 4];
+			to[0] = from[0];
+			to[1] = from[1];
+			to[2] = from[2];
+			to[3] = from[3];
+		}
+	}
+}
@@ -0,0 +1,308 @@
+// cmpr.cpp : CMPR (DXT1-style) block encoder and decoder
+//
+// GX differs from DXT1 in two places: the 2-bit indices of a row start at the
+// high bits, and the two interpolated colors are 5/8 + 3/8 blends instead of
+// thirds. The encoder fits its endpoints against that palette.
+
+#include "png2tpl.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+using namespace std;
+
+// Least squares + greedy endpoint passes in high quality mode
+#define REFINE_PASSES 4
+#define NUDGE_PASSES  8
+
+// Alpha below this is stored as the transparent palette entry
+#define ALPHA_CUTOFF 128
+
+typedef struct {
+	int rgb[4][3];		// Palette
+	bool opaque;		// 4 color mode (color0 > color1)
+} palette_t;
+
+static unsigned short pack565(const float* rgb) {
+	int c[3];
+	const int limits[3] = { 31, 63, 31 };
+	for (unsigned int i = 0; i < 3; i++) {
+		const float v = rgb[i] < 0 ? 0 : (rgb[i] > 255 ? 255 : rgb[i]);
+		c[i] = (int)(v * limits[i] / 255.0f + 0.5f);
+	}
+	return (unsigned short)((c[0] << 11) | (c[1] << 5) | c[2]);
+}
+
+static void unpack565(unsigned short color, int* rgb) {
+	const int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+static void makePalette(unsigned short color0, unsigned short color1, palette_t& palette) {
+	unpack565(color0, palette.rgb[0]);
+	unpack565(color1, palette.rgb[1]);
+	palette.opaque = color0 > color1;
+	for (unsigned int c = 0; c < 3; c++) {
+		const int a = palette.rgb[0][c], b = palette.rgb[1][c];
+		if (palette.opaque) {
+			palette.rgb[2][c] = (a * 5 + b * 3) >> 3;
+			palette.rgb[3][c] = (a * 3 + b * 5) >> 3;
+		} else {
+			palette.rgb[2][c] = (a + b) >> 1;
+			palette.rgb[3][c] = b;
+		}
+	}
+}
+
+// Where each palette entry sits between the endpoints
+static const float opaqueWeights[4] = { 0.0f, 1.0f, 3.0f / 8.0f, 5.0f / 8.0f };
+static const float alphaWeights[3] = { 0.0f, 1.0f, 0.5f };
+
+// Best index of each pixel, returns the total squared error (transparent pixels get index 3)
+static int assignIndices(const unsigned char* rgba, const bool* transparent, const palette_t& palette, unsigned char* indices) {
+	const unsigned int entries = palette.opaque ? 4 : 3;
+	int total = 0;
+	for (unsigned int i = 0; i < 16; i++) {
+		if (transparent[i]) {
+			indices[i] = 3;
+			continue;
+		}
+		int best = 0x7FFFFFFF;
+		for (unsigned int e = 0; e < entries; e++) {
+			int error = 0;
+			for (unsigned int c = 0; c < 3; c++) {
+				const int d = rgba[i * 4 + c] - palette.rgb[e][c];
+				error += d * d;
+			}
+			if (error < best) {
+				best = error;
+				indices[i] = e;
+			}
+		}
+		total += best;
+	}
+	return total;
+}
+
+typedef struct {
+	unsigned short	color0;
+	unsigned short	color1;
+	unsigned char	indices[16];
+	int				error;
+} cmprfit_t;
+
+// Evaluate an endpoint pair, ordered for the block's mode
+static void tryEndpoints(const unsigned char* rgba, const bool* transparent, bool hasAlpha,
+						 unsigned short a, unsigned short b, cmprfit_t& best) {
+	cmprfit_t fit;
+	// 4 colors need color0 > color1, 3 colors + transparent need color0 <= color1
+	if (hasAlpha ? a > b : a < b) {
+		const unsigned short t = a;
+		a = b;
+		b = t;
+	}
+	fit.color0 = a;
+	fit.color1 = b;
+
+	palette_t palette;
+	makePalette(a, b, palette);
+	fit.error = assignIndices(rgba, transparent, palette, fit.indices);
+	if (fit.error < best.error) {
+		best = fit;
+	}
+}
+
+// Endpoints that best reproduce the pixels for a given index assignment
+static bool leastSquares(const unsigned char* rgba, const bool* transparent, const cmprfit_t& fit, bool hasAlpha,
+						 float* endpoint0, float* endpoint1) {
+	float aa = 0, ab = 0, bb = 0;
+	float ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+	for (unsigned int i = 0; i < 16; i++) {
+		if (transparent[i]) {
+			continue;
+		}
+		const float t = hasAlpha ? alphaWeights[fit.indices[i]] : opaqueWeights[fit.indices[i]];
+		const float s = 1.0f - t;
+		aa += s * s;
+		ab += s * t;
+		bb += t * t;
+		for (unsigned int c = 0; c < 3; c++) {
+			ax[c] += s * rgba[i * 4 + c];
+			bx[c] += t * rgba[i * 4 + c];
+		}
+	}
+	const float det = aa * bb - ab * ab;
+	if (fabs(det) < 1e-6f) {
+		return false;
+	}
+	for (unsigned int c = 0; c < 3; c++) {
+		endpoint0[c] = (bb * ax[c] - ab * bx[c]) / det;
+		endpoint1[c] = (aa * bx[c] - ab * ax[c]) / det;
+	}
+	return true;
+}
+
+void encodeCmprBlock(const unsigned char* rgba, bool high, unsigned char* out) {
+	bool transparent[16];
+	bool hasAlpha = false;
+	unsigned int opaqueCount = 0;
+	float mean[3] = { 0, 0, 0 };
+	float lo[3] = { 255, 255, 255 }, hi[3] = { 0, 0, 0 };
+	for (unsigned int i = 0; i < 16; i++) {
+		transparent[i] = rgba[i * 4 + 3] < ALPHA_CUTOFF;
+		hasAlpha = hasAlpha || transparent[i];
+		if (transparent[i]) {
+			continue;
+		}
+		opaqueCount++;
+		for (unsigned int c = 0; c < 3; c++) {
+			const float v = rgba[i * 4 + c];
+			mean[c] += v;
+			lo[c] = v < lo[c] ? v : lo[c];
+			hi[c] = v > hi[c] ? v : hi[c];
+		}
+	}
+
+	cmprfit_t best;
+	best.error = 0x7FFFFFFF;
+	if (opaqueCount == 0) {
+		// Fully transparent
+		tryEndpoints(rgba, transparent, true, 0, 0, best);
+	} else {
+		for (unsigned int c = 0; c < 3; c++) {
+			mean[c] /= opaqueCount;
+		}
+
+		float start0[3], start1[3];
+		if (high) {
+			// Principal axis of the colors (power iteration on the covariance)
+			float cov[6] = { 0, 0, 0, 0, 0, 0 };
+			for (unsigned int i = 0; i < 16; i++) {
+				if (transparent[i]) {
+					continue;
+				}
+				const float r = rgba[i * 4] - mean[0], g = rgba[i * 4 + 1] - mean[1], b = rgba[i * 4 + 2] - mean[2];
+				cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+				cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+			}
+			float axis[3] = { hi[0] - lo[0], hi[1] - lo[1], hi[2] - lo[2] };
+			for (unsigned int it = 0; it < 8; it++) {
+				const float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+				const float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+				const float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+				const float length = max(max(fabs(x), fabs(y)), fabs(z));
+				if (length < 1e-6f) {
+					break;
+				}
+				axis[0] = x / length;
+				axis[1] = y / length;
+				axis[2] = z / length;
+			}
+
+			// Extremes along the axis
+			float minT = 1e30f, maxT = -1e30f;
+			for (unsigned int i = 0; i < 16; i++) {
+				if (transparent[i]) {
+					continue;
+				}
+				const float t = (rgba[i * 4] - mean[0]) * axis[0] + (rgba[i * 4 + 1] - mean[1]) * axis[1] + (rgba[i * 4 + 2] - mean[2]) * axis[2];
+				minT = t < minT ? t : minT;
+				maxT = t > maxT ? t : maxT;
+			}
+			const float norm = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+			for (unsigned int c = 0; c < 3; c++) {
+				const float scale = norm > 0 ? axis[c] / norm : 0;
+				start0[c] = mean[c] + minT * scale;
+				start1[c] = mean[c] + maxT * scale;
+			}
+		} else {
+			// Bounding box, with the diagonal picked from the sign of the covariance with red
+			float covRG = 0, covRB = 0;
+			for (unsigned int i = 0; i < 16; i++) {
+				if (transparent[i]) {
+					continue;
+				}
+				const float r = rgba[i * 4] - mean[0];
+				covRG += r * (rgba[i * 4 + 1] - mean[1]);
+				covRB += r * (rgba[i * 4 + 2] - mean[2]);
+			}
+			for (unsigned int c = 0; c < 3; c++) {
+				// Inset by 1/16 of the range, the extremes are rarely worth a palette entry
+				const float inset = (hi[c] - lo[c]) / 16.0f;
+				start0[c] = lo[c] + inset;
+				start1[c] = hi[c] - inset;
+			}
+			if (covRG < 0) {
+				swap(start0[1], start1[1]);
+			}
+			if (covRB < 0) {
+				swap(start0[2], start1[2]);
+			}
+		}
+		tryEndpoints(rgba, transparent, hasAlpha, pack565(start0), pack565(start1), best);
+
+		if (high) {
+			// Refit the endpoints to the assignment until it stops improving
+			for (unsigned int pass = 0; pass < REFINE_PASSES; pass++) {
+				float e0[3], e1[3];
+				const int before = best.error;
+				if (!leastSquares(rgba, transparent, best, hasAlpha, e0, e1)) {
+					break;
+				}
+				tryEndpoints(rgba, transparent, hasAlpha, pack565(e0), pack565(e1), best);
+				if (best.error >= before) {
+					break;
+				}
+			}
+
+			// Greedy single step changes of each 565 channel
+			const unsigned short steps[3] = { 1 << 11, 1 << 5, 1 };
+			const unsigned short masks[3] = { 31 << 11, 63 << 5, 31 };
+			for (unsigned int pass = 0; pass < NUDGE_PASSES && best.error > 0; pass++) {
+				const int before = best.error;
+				const cmprfit_t current = best;
+				for (unsigned int e = 0; e < 2; e++) {
+					for (unsigned int c = 0; c < 3; c++) {
+						const unsigned short value = e == 0 ? current.color0 : current.color1;
+						const unsigned short other = e == 0 ? current.color1 : current.color0;
+						if ((value & masks[c]) != masks[c]) {
+							tryEndpoints(rgba, transparent, hasAlpha, value + steps[c], other, best);
+						}
+						if ((value & masks[c]) != 0) {
+							tryEndpoints(rgba, transparent, hasAlpha, value - steps[c], other, best);
+						}
+					}
+				}
+				if (best.error >= before) {
+					break;
+				}
+			}
+		}
+	}
+
+	out[0] = best.color0 >> 8;
+	out[1] = best.color0 & 0xFF;
+	out[2] = best.color1 >> 8;
+	out[3] = best.color1 & 0xFF;
+	for (unsigned int y = 0; y < 4; y++) {
+		const unsigned char* row = &best.indices[y * 4];
+		out[4 + y] = (row[0] << 6) | (row[1] << 4) | (row[2] << 2) | row[3];
+	}
+}
+
+void decodeCmprBlock(const unsigned char* in, unsigned char* rgba) {
+	const unsigned short color0 = (in[0] << 8) | in[1];
+	const unsigned short color1 = (in[2] << 8) | in[3];
+	palette_t palette;
+	makePalette(color0, color1, palette);
+
+	for (unsigned int i = 0; i < 16; i++) {
+		const unsigned int index = (in[4 + i / 4] >> (6 - (i % 4) * 2)) & 3;
+		for (unsigned int c = 0; c < 3; c++) {
+			rgba[i * 4 + c] = (unsigned char)palette.rgb[index][c];
+		}
+		rgba[i * 4 + 3] = (!palette.opaque && index == 3) ? 0 : 255;
+	}
+}
@@ -0,0 +1,288 @@
+// encode.cpp : GX texture tiling for every supported format
+//
+// Textures are stored in tiles of 32 bytes (64 for RGBA8, split in an AR and a
+// GB half), tiles left to right then top to bottom, pixels in rows inside a tile.
+// CMPR tiles are 8x8 and hold four 4x4 blocks in Z order.
+
+#include "png2tpl.h"
+
+#include <atomic>
+#include <thread>
+#include <functional>
+using namespace std;
+
+typedef struct {
+	unsigned int	format;
+	const char*		name;
+	unsigned int	tileWidth;
+	unsigned int	tileHeight;
+	unsigned int	tileBytes;
+} formatinfo_t;
+
+static const formatinfo_t formats[] = {
+	{ TF_I4,		"I4",		8, 8, 32 },
+	{ TF_I8,		"I8",		8, 4, 32 },
+	{ TF_IA4,		"IA4",		8, 4, 32 },
+	{ TF_IA8,		"IA8",		4, 4, 32 },
+	{ TF_RGB565,	"RGB565",	4, 4, 32 },
+	{ TF_RGB5A3,	"RGB5A3",	4, 4, 32 },
+	{ TF_RGBA8,		"RGBA8",	4, 4, 64 },
+	{ TF_CMPR,		"CMPR",		8, 8, 32 },
+};
+
+static const formatinfo_t* findFormat(unsigned int format) {
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]); i++) {
+		if (formats[i].format == format) {
+			return &formats[i];
+		}
+	}
+	return NULL;
+}
+
+const char* formatName(unsigned int format) {
+	const formatinfo_t* info = findFormat(format);
+	return info != NULL ? info->name : NULL;
+}
+
+void formatTile(unsigned int format, unsigned int& width, unsigned int& height) {
+	const formatinfo_t* info = findFormat(format);
+	width = info != NULL ? info->tileWidth : 1;
+	height = info != NULL ? info->tileHeight : 1;
+}
+
+size_t textureSize(unsigned int format, unsigned int width, unsigned int height) {
+	const formatinfo_t* info = findFormat(format);
+	if (info == NULL) {
+		return 0;
+	}
+	const size_t tilesX = (width + info->tileWidth - 1) / info->tileWidth;
+	const size_t tilesY = (height + info->tileHeight - 1) / info->tileHeight;
+	return tilesX * tilesY * info->tileBytes;
+}
+
+// Pixel with the coordinates clamped, tiles past the edge repeat the border
+static inline const unsigned char* pixelAt(const image_t& image, unsigned int x, unsigned int y) {
+	x = x < image.width ? x : image.width - 1;
+	y = y < image.height ? y : image.height - 1;
+	return &image.pixels[(y * image.width + x) * 4];
+}
+
+static inline unsigned char intensity(const unsigned char* p) {
+	return (unsigned char)((p[0] * 77 + p[1] * 150 + p[2] * 29 + 128) >> 8);
+}
+
+static inline unsigned int quantize(unsigned int value, unsigned int bits) {
+	const unsigned int top = (1 << bits) - 1;
+	return (value * top + 127) / 255;
+}
+
+static inline unsigned char expand(unsigned int value, unsigned int bits) {
+	return (unsigned char)((value * 255 + ((1 << bits) - 1) / 2) / ((1 << bits) - 1));
+}
+
+static void encodeTile(const image_t& image, unsigned int format, unsigned int x0, unsigned int y0, const encodeopts_t& opts, unsigned char* out) {
+	switch (format) {
+	case TF_I4:
+		for (unsigned int i = 0; i < 64; i += 2) {
+			const unsigned int a = quantize(intensity(pixelAt(image, x0 + i % 8, y0 + i / 8)), 4);
+			const unsigned int b = quantize(intensity(pixelAt(image, x0 + (i + 1) % 8, y0 + (i + 1) / 8)), 4);
+			*out++ = (unsigned char)((a << 4) | b);
+		}
+		break;
+	case TF_I8:
+		for (unsigned int i = 0; i < 32; i++) {
+			*out++ = intensity(pixelAt(image, x0 + i % 8, y0 + i / 8));
+		}
+		break;
+	case TF_IA4:
+		for (unsigned int i = 0; i < 32; i++) {
+			const unsigned char* p = pixelAt(image, x0 + i % 8, y0 + i / 8);
+			*out++ = (unsigned char)((quantize(p[3], 4) << 4) | quantize(intensity(p), 4));
+		}
+		break;
+	case TF_IA8:
+		for (unsigned int i = 0; i < 16; i++) {
+			const unsigned char* p = pixelAt(image, x0 + i % 4, y0 + i / 4);
+			*out++ = p[3];
+			*out++ = intensity(p);
+		}
+		break;
+	case TF_RGB565:
+		for (unsigned int i = 0; i < 16; i++) {
+			const unsigned char* p = pixelAt(image, x0 + i % 4, y0 + i / 4);
+			const unsigned int c = (quantize(p[0], 5) << 11) | (quantize(p[1], 6) << 5) | quantize(p[2], 5);
+			*out++ = c >> 8;
+			*out++ = c & 0xFF;
+		}
+		break;
+	case TF_RGB5A3:
+		for (unsigned int i = 0; i < 16; i++) {
+			const unsigned char* p = pixelAt(image, x0 + i % 4, y0 + i / 4);
+			const unsigned int alpha = quantize(p[3], 3);
+			unsigned int c;
+			if (alpha == 7) {
+				// Opaque: 1 RRRRR GGGGG BBBBB
+				c = 0x8000 | (quantize(p[0], 5) << 10) | (quantize(p[1], 5) << 5) | quantize(p[2], 5);
+			} else {
+				// 0 AAA RRRR GGGG BBBB
+				c = (alpha << 12) | (quantize(p[0], 4) << 8) | (quantize(p[1], 4) << 4) | quantize(p[2], 4);
+			}
+			*out++ = c >> 8;
+			*out++ = c & 0xFF;
+		}
+		break;
+	case TF_RGBA8:
+		for (unsigned int i = 0; i < 16; i++) {
+			const unsigned char* p = pixelAt(image, x0 + i % 4, y0 + i / 4);
+			out[i * 2] = p[3];
+			out[i * 2 + 1] = p[0];
+			out[32 + i * 2] = p[1];
+			out[32 + i * 2 + 1] = p[2];
+		}
+		break;
+	case TF_CMPR:
+		for (unsigned int block = 0; block < 4; block++) {
+			unsigned char rgba[64];
+			const unsigned int bx = x0 + (block % 2) * 4, by = y0 + (block / 2) * 4;
+			for (unsigned int i = 0; i < 16; i++) {
+				const unsigned char* p = pixelAt(image, bx + i % 4, by + i / 4);
+				rgba[i * 4] = p[0];
+				rgba[i * 4 + 1] = p[1];
+				rgba[i * 4 + 2] = p[2];
+				rgba[i * 4 + 3] = p[3];
+			}
+			encodeCmprBlock(rgba, opts.cmprHigh, out + block * 8);
+		}
+		break;
+	}
+}
+
+// Run work(i) for every i < count on a pool of threads
+static void runParallel(size_t count, unsigned int threads, const function<void(size_t)>& work) {
+	if (threads <= 1 || count <= 1) {
+		for (size_t i = 0; i < count; i++) {
+			work(i);
+		}
+		return;
+	}
+	atomic<size_t> next(0);
+	vector<thread> pool;
+	for (unsigned int t = 0; t < threads; t++) {
+		pool.push_back(thread([&]() {
+			for (size_t i = next++; i < count; i = next++) {
+				work(i);
+			}
+		}));
+	}
+	for (size_t t = 0; t < pool.size(); t++) {
+		pool[t].join();
+	}
+}
+
+void encodeTexture(vector<unsigned char>& out, const image_t& image, unsigned int format, const encodeopts_t& opts) {
+	const formatinfo_t* info = findFormat(format);
+	if (info == NULL) {
+		return;
+	}
+	const unsigned int tilesX = (image.width + info->tileWidth - 1) / info->tileWidth;
+	const unsigned int tilesY = (image.height + info->tileHeight - 1) / info->tileHeight;
+	const size_t start = out.size();
+	out.resize(start + textureSize(format, image.width, image.height));
+
+	// A row of tiles per work item, tiles don't share any output
+	unsigned char* data = out.data() + start;
+	runParallel(tilesY, opts.threads, [&](size_t ty) {
+		for (unsigned int tx = 0; tx < tilesX; tx++) {
+			encodeTile(image, format, tx * info->tileWidth, ty * info->tileHeight, opts,
+					   data + (ty * tilesX + tx) * info->tileBytes);
+		}
+	});
+}
+
+static inline void putPixel(image_t& image, unsigned int x, unsigned int y, unsigned char r, unsigned char g, unsigned char b, unsigned char a) {
+	if (x >= image.width || y >= image.height) {
+		return;
+	}
+	unsigned char* p = &image.pixels[(y * image.width + x) * 4];
+	p[0] = r;
+	p[1] = g;
+	p[2] = b;
+	p[3] = a;
+}
+
+void decodeTexture(const unsigned char* data, unsigned int width, unsigned int height, unsigned int format, image_t& image) {
+	image.width = width;
+	image.height = height;
+	image.pixels.assign(width * height * 4, 0);
+	const formatinfo_t* info = findFormat(format);
+	if (info == NULL) {
+		return;
+	}
+
+	const unsigned int tilesX = (width + info->tileWidth - 1) / info->tileWidth;
+	const unsigned int tilesY = (height + info->tileHeight - 1) / info->tileHeight;
+	for (unsigned int ty = 0; ty < tilesY; ty++) {
+		for (unsigned int tx = 0; tx < tilesX; tx++) {
+			const unsigned char* in = data + (ty * tilesX + tx) * info->tileBytes;
+			const unsigned int x0 = tx * info->tileWidth, y0 = ty * info->tileHeight;
+			const unsigned int w = info->tileWidth;
+
+			switch (format) {
+			case TF_I4:
+				for (unsigned int i = 0; i < 64; i++) {
+					const unsigned char v = expand((in[i / 2] >> ((i % 2) ? 0 : 4)) & 15, 4);
+					putPixel(image, x0 + i % w, y0 + i / w, v, v, v, 255);
+				}
+				break;
+			case TF_I8:
+				for (unsigned int i = 0; i < 32; i++) {
+					putPixel(image, x0 + i % w, y0 + i / w, in[i], in[i], in[i], 255);
+				}
+				break;
+			case TF_IA4:
+				for (unsigned int i = 0; i < 32; i++) {
+					const unsigned char v = expand(in[i] & 15, 4);
+					putPixel(image, x0 + i % w, y0 + i / w, v, v, v, expand(in[i] >> 4, 4));
+				}
+				break;
+			case TF_IA8:
+				for (unsigned int i = 0; i < 16; i++) {
+					const unsigned char v = in[i * 2 + 1];
+					putPixel(image, x0 + i % w, y0 + i / w, v, v, v, in[i * 2]);
+				}
+				break;
+			case TF_RGB565:
+				for (unsigned int i = 0; i < 16; i++) {
+					const unsigned int c = (in[i * 2] << 8) | in[i * 2 + 1];
+					putPixel(image, x0 + i % w, y0 + i / w, expand(c >> 11, 5), expand((c >> 5) & 63, 6), expand(c & 31, 5), 255);
+				}
+				break;
+			case TF_RGB5A3:
+				for (unsigned int i = 0; i < 16; i++) {
+					const unsigned int c = (in[i * 2] << 8) | in[i * 2 + 1];
+					if (c & 0x8000) {
+						putPixel(image, x0 + i % w, y0 + i / w, expand((c >> 10) & 31, 5), expand((c >> 5) & 31, 5), expand(c & 31, 5), 255);
+					} else {
+						putPixel(image, x0 + i % w, y0 + i / w, expand((c >> 8) & 15, 4), expand((c >> 4) & 15, 4), expand(c & 15, 4), expand((c >> 12) & 7, 3));
+					}
+				}
+				break;
+			case TF_RGBA8:
+				for (unsigned int i = 0; i < 16; i++) {
+					putPixel(image, x0 + i % w, y0 + i / w, in[i * 2 + 1], in[32 + i * 2], in[32 + i * 2 + 1], in[i * 2]);
+				}
+				break;
+			case TF_CMPR:
+				for (unsigned int block = 0; block < 4; block++) {
+					unsigned char rgba[64];
+					decodeCmprBlock(in + block * 8, rgba);
+					for (unsigned int i = 0; i < 16; i++) {
+						const unsigned char* p = &rgba[i * 4];
+						putPixel(image, x0 + (block % 2) * 4 + i % 4, y0 + (block / 2) * 4 + i / 4, p[0], p[1], p[2], p[3]);
+					}
+				}
+				break;
+			}
+		}
+	}
+}
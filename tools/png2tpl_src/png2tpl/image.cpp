@@ -0,0 +1,74 @@
+// image.cpp : PNG loading and mip level generation
+//
+
+#include "png2tpl.h"
+
+#include <png.h>
+#include <cmath>
+#include <cstring>
+using namespace std;
+
+bool loadPng(const string& file, image_t& image, string& error) {
+	png_image png;
+	memset(&png, 0, sizeof(png));
+	png.version = PNG_IMAGE_VERSION;
+
+	if (!png_image_begin_read_from_file(&png, file.c_str())) {
+		error = png.message;
+		return false;
+	}
+
+	// libpng converts grey, palettes and 16-bit channels for us
+	png.format = PNG_FORMAT_RGBA;
+	image.width = png.width;
+	image.height = png.height;
+	image.pixels.resize(PNG_IMAGE_SIZE(png));
+	if (!png_image_finish_read(&png, NULL, image.pixels.data(), 0, NULL)) {
+		error = png.message;
+		png_image_free(&png);
+		return false;
+	}
+	return true;
+}
+
+image_t downsample(const image_t& image) {
+	image_t half;
+	half.width = image.width > 1 ? image.width / 2 : 1;
+	half.height = image.height > 1 ? image.height / 2 : 1;
+	half.pixels.resize(half.width * half.height * 4);
+
+	// Average each 2x2 footprint (1x2 or 2x1 once a side is down to one pixel)
+	const unsigned int stepX = image.width > 1 ? 2 : 1;
+	const unsigned int stepY = image.height > 1 ? 2 : 1;
+	for (unsigned int y = 0; y < half.height; y++) {
+		for (unsigned int x = 0; x < half.width; x++) {
+			for (unsigned int c = 0; c < 4; c++) {
+				unsigned int sum = 0;
+				for (unsigned int dy = 0; dy < stepY; dy++) {
+					for (unsigned int dx = 0; dx < stepX; dx++) {
+						sum += image.pixels[((y * stepY + dy) * image.width + x * stepX + dx) * 4 + c];
+					}
+				}
+				const unsigned int count = stepX * stepY;
+				half.pixels[(y * half.width + x) * 4 + c] = (unsigned char)((sum + count / 2) / count);
+			}
+		}
+	}
+	return half;
+}
+
+double imagePsnr(const image_t& a, const image_t& b) {
+	if (a.width != b.width || a.height != b.height || a.pixels.empty()) {
+		return 0;
+	}
+	double sum = 0;
+	for (size_t i = 0; i < a.pixels.size(); i++) {
+		const double d = (double)a.pixels[i] - b.pixels[i];
+		sum += d * d;
+	}
+	if (sum == 0) {
+		return 100;
+	}
+	const double mse = sum / a.pixels.size();
+	return 10 * log10(255.0 * 255.0 / mse);
+}
@@ -0,0 +1,557 @@
+// png2tpl.cpp : Defines the entry point for the console application.
+//
+// Compiles PNGs into a TPL texture file (and a header with the texture ids),
+// from an .scf descriptor or a single image. Textures of the same atlas are
+// packed into one page, the atlas map tells obj2bin where they went.
+
+#include "png2tpl.h"
+
+#include <boost/program_options.hpp>
+namespace po = boost::program_options;
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <chrono>
+#include <thread>
+#include <algorithm>
+#include <iomanip>
+using namespace std;
+
+#define TPL_MAGIC		0x0020AF30
+#define TPL_HEADER_SIZE	0x0C
+#define TPL_IMAGE_SIZE	0x24
+
+// Texture data has to be 32 byte aligned for GX
+#define TPL_ALIGN		32
+
+// Largest texture GX can sample
+#define MAX_TEXTURE_SIZE	1024
+
+// A texture with its source and all its levels
+typedef struct {
+	texturedesc_t		desc;
+	vector<image_t>		levels;
+	vector<atlasslot_t>	slots;		// Textures packed in this atlas page, empty for plain textures
+} texture_t;
+
+// Prototyping
+bool loadTextures(const vector<texturedesc_t>& descs, const string& base, vector<texture_t>& textures);
+bool buildAtlases(vector<texture_t>& textures, unsigned int padding);
+bool writeTpl(string file, vector<texture_t>& textures, const encodeopts_t& opts);
+bool writeHeader(string file, const vector<texture_t>& textures);
+bool writeAtlasMap(string file, const vector<texture_t>& textures);
+bool writeDeps(string file, string target, string header, string atlasMap, const vector<texture_t>& textures, const string& base);
+bool checkTpl(string file, const vector<texture_t>* sources);
+bool benchCmpr(string file, unsigned int threads);
+
+int main(int argc, char* argv[]) {
+	string scfPath, inFilePath, outFilePath, depsPath, headerPath, atlasMapPath, checkPath, formatArg = "CMPR";
+	unsigned int maxLod = 0, padding = 2;
+	encodeopts_t opts;
+
+	try {
+		po::options_description desc("Valid arguments");
+		desc.add_options()
+			("help", "produce help message")
+			("scf,s", po::value<string>(&scfPath), "texture descriptor (.scf)")
+			("input,i", po::value<string>(&inFilePath), "single input png (instead of --scf)")
+			("format,f", po::value<string>(&formatArg), "format for --input: I4, I8, IA4, IA8, RGB565, RGB5A3, RGBA8 or CMPR")
+			("maxlod", po::value<unsigned int>(&maxLod), "mip levels below the base for --input")
+			("output,o", po::value<string>(&outFilePath), "output tpl file")
+			("header", po::value<string>(&headerPath), "output header with the texture ids (default: next to the tpl)")
+			("atlas-map", po::value<string>(&atlasMapPath), "output atlas slot list for obj2bin --atlas (default: next to the tpl)")
+			("padding", po::value<unsigned int>(&padding)->default_value(2), "texels of repeated border around each atlas slot")
+			("deps,d", po::value<string>(&depsPath), "write a make dependency file")
+			("fast", "bounding box CMPR endpoints instead of the (slower, better) fitted ones")
+			("jobs,j", po::value<unsigned int>(&opts.threads)->default_value(0), "encoder threads (0 for one per core)")
+			("check", po::value<string>(&checkPath), "decode and describe a tpl, with --scf compare it to the sources")
+			("bench", po::value<string>(), "time and compare the CMPR encoders on a png")
+			;
+
+		po::variables_map vm;
+		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::notify(vm);
+
+		// Help
+		if (vm.count("help")) {
+			cout << desc << "\n";
+			return 0;
+		}
+
+		opts.cmprHigh = vm.count("fast") == 0;
+		if (opts.threads == 0) {
+			opts.threads = max(1u, thread::hardware_concurrency());
+		}
+
+		if (vm.count("bench")) {
+			return benchCmpr(vm["bench"].as<string>(), opts.threads) ? 0 : 1;
+		}
+
+		// Arguments
+		if (scfPath.empty() && inFilePath.empty() && checkPath.empty()) {
+			cout << "ERROR:\n  Missing scf or input argument.\n";
+			cout << desc << "\n";
+			return 1;
+		}
+		if (outFilePath.empty() && checkPath.empty()) {
+			cout << "ERROR:\n  Missing output argument.\n";
+			cout << desc << "\n";
+			return 1;
+		}
+	}
+	catch (exception& e) {
+		cerr << "error: " << e.what() << "\n";
+		return 1;
+	}
+	catch (...) {
+		cerr << "Exception of unknown type!\n";
+		return 1;
+	}
+
+	// Texture list
+	vector<texturedesc_t> descs;
+	string base;
+	if (!scfPath.empty()) {
+		string error;
+		if (!readScf(scfPath, descs, error)) {
+			cout << "Error, " << scfPath << ": " << error << "\n";
+			return 1;
+		}
+		const size_t slash = scfPath.find_last_of("/\\");
+		base = slash != string::npos ? scfPath.substr(0, slash + 1) : "";
+	} else if (!inFilePath.empty()) {
+		texturedesc_t single;
+		single.file = inFilePath;
+		const size_t slash = inFilePath.find_last_of("/\\"), dot = inFilePath.find_last_of('.');
+		const size_t start = slash != string::npos ? slash + 1 : 0;
+		single.id = inFilePath.substr(start, (dot != string::npos && dot > start ? dot : inFilePath.size()) - start);
+		single.format = ~0u;
+		transform(formatArg.begin(), formatArg.end(), formatArg.begin(), ::toupper);
+		for (unsigned int f = 0; f <= TF_CMPR; f++) {
+			if (formatName(f) != NULL && formatArg == formatName(f)) {
+				single.format = f;
+			}
+		}
+		if (single.format == ~0u) {
+			cout << "ERROR:\n  Unknown format " << formatArg << ".\n";
+			return 1;
+		}
+		single.mipmap = maxLod > 0;
+		single.minLod = 0;
+		single.maxLod = maxLod;
+		single.wrapS = single.wrapT = WRAP_REPEAT;
+		descs.push_back(single);
+	}
+
+	vector<texture_t> textures;
+	if (!loadTextures(descs, base, textures)) {
+		return 1;
+	}
+
+	if (!buildAtlases(textures, padding)) {
+		return 1;
+	}
+
+	if (!checkPath.empty()) {
+		return checkTpl(checkPath, textures.empty() ? NULL : &textures) ? 0 : 1;
+	}
+
+	const size_t dot = outFilePath.find_last_of('.');
+	const size_t slash = outFilePath.find_last_of("/\\");
+	const string stem = dot != string::npos && (slash == string::npos || dot > slash) ? outFilePath.substr(0, dot) : outFilePath;
+	if (headerPath.empty()) {
+		headerPath = stem + ".h";
+	}
+	// Always written for descriptors (even without atlases) so builds can depend on it
+	if (atlasMapPath.empty() && !scfPath.empty()) {
+		atlasMapPath = stem + ".atlas";
+	}
+
+	if (!writeTpl(outFilePath, textures, opts))
+		return 1;
+	if (!writeHeader(headerPath, textures))
+		return 1;
+	if (!atlasMapPath.empty() && !writeAtlasMap(atlasMapPath, textures))
+		return 1;
+	if (!depsPath.empty() && !writeDeps(depsPath, outFilePath, headerPath, atlasMapPath, textures, base))
+		return 1;
+
+	return 0;
+}
+
+bool loadTextures(const vector<texturedesc_t>& descs, const string& base, vector<texture_t>& textures) {
+	for (size_t i = 0; i < descs.size(); i++) {
+		texture_t texture;
+		texture.desc = descs[i];
+
+		image_t image;
+		string error;
+		const string path = base + descs[i].file;
+		if (!loadPng(path, image, error)) {
+			cout << "Error, " << path << ": " << error << "\n";
+			return false;
+		}
+
+		// Level 0 up to maxLod, each half the size of the one before
+		texture.levels.push_back(image);
+		for (unsigned int lod = 1; lod <= texture.desc.maxLod; lod++) {
+			const image_t& last = texture.levels.back();
+			if (last.width == 1 && last.height == 1) {
+				cout << "Warning: " << path << " has no level " << lod << ", maxlod lowered to " << lod - 1 << "\n";
+				texture.desc.maxLod = lod - 1;
+				break;
+			}
+			texture.levels.push_back(downsample(last));
+		}
+		if (texture.desc.mipmap && ((image.width & (image.width - 1)) != 0 || (image.height & (image.height - 1)) != 0)) {
+			cout << "Warning: " << path << " is mipmapped but not a power of two\n";
+		}
+		textures.push_back(texture);
+	}
+	return true;
+}
+
+// Replace the textures of each atlas with one page, where its first texture was
+bool buildAtlases(vector<texture_t>& textures, unsigned int padding) {
+	vector<texture_t> result;
+	for (size_t i = 0; i < textures.size(); i++) {
+		const texturedesc_t& first = textures[i].desc;
+		if (first.atlas.empty()) {
+			result.push_back(textures[i]);
+			continue;
+		}
+		bool placed = false;
+		for (size_t r = 0; r < result.size() && !placed; r++) {
+			placed = !result[r].slots.empty() && result[r].desc.id == first.atlas;
+		}
+		if (placed) {
+			continue;
+		}
+
+		// Gather the page, every texture has to be stored the same way
+		texture_t page;
+		page.desc.id = first.atlas;
+		page.desc.format = first.format;
+		page.desc.mipmap = false;
+		page.desc.minLod = page.desc.maxLod = 0;
+		page.desc.wrapS = page.desc.wrapT = WRAP_CLAMP;
+		vector<const image_t*> images;
+		for (size_t t = i; t < textures.size(); t++) {
+			const texturedesc_t& desc = textures[t].desc;
+			if (desc.atlas != first.atlas) {
+				continue;
+			}
+			if (desc.format != first.format) {
+				cout << "Error, atlas " << first.atlas << ": " << desc.id << " is " << formatName(desc.format)
+					 << ", " << first.id << " " << formatName(first.format) << "\n";
+				return false;
+			}
+			if (desc.maxLod > 0) {
+				cout << "Error, atlas " << first.atlas << ": " << desc.id << " is mipmapped\n";
+				return false;
+			}
+			atlasslot_t slot;
+			slot.id = desc.id;
+			slot.file = desc.file;
+			slot.x = slot.y = 0;
+			slot.width = textures[t].levels[0].width;
+			slot.height = textures[t].levels[0].height;
+			page.slots.push_back(slot);
+			images.push_back(&textures[t].levels[0]);
+		}
+
+		unsigned int tileWidth, tileHeight, width = 0, height = 0;
+		formatTile(first.format, tileWidth, tileHeight);
+		if (!packAtlas(page.slots, padding, tileWidth, tileHeight, MAX_TEXTURE_SIZE, width, height)) {
+			cout << "Error, atlas " << first.atlas << " doesn't fit in " << MAX_TEXTURE_SIZE << "x" << MAX_TEXTURE_SIZE << "\n";
+			return false;
+		}
+
+		// Unused space stays transparent black
+		image_t pixels;
+		pixels.width = width;
+		pixels.height = height;
+		pixels.pixels.assign(width * height * 4, 0);
+		unsigned int used = 0;
+		for (size_t s = 0; s < page.slots.size(); s++) {
+			blitPadded(pixels, *images[s], page.slots[s].x, page.slots[s].y, padding);
+			used += page.slots[s].width * page.slots[s].height;
+		}
+		page.levels.push_back(pixels);
+
+		cout << "atlas " << first.atlas << ": " << page.slots.size() << " textures on " << width << "x" << height
+			 << ", " << used * 100 / (width * height) << "% used\n";
+		result.push_back(page);
+	}
+	textures.swap(result);
+	return true;
+}
+
+static void put16(vector<unsigned char>& out, size_t offset, unsigned int value) {
+	out[offset] = (value >> 8) & 0xFF;
+	out[offset + 1] = value & 0xFF;
+}
+
+static void put32(vector<unsigned char>& out, size_t offset, unsigned int value) {
+	put16(out, offset, value >> 16);
+	put16(out, offset + 2, value & 0xFFFF);
+}
+
+static unsigned int get16(const unsigned char* p) {
+	return (p[0] << 8) | p[1];
+}
+
+static unsigned int get32(const unsigned char* p) {
+	return (get16(p) << 16) | get16(p + 2);
+}
+
+static size_t alignUp(size_t value) {
+	return (value + TPL_ALIGN - 1) & ~(size_t)(TPL_ALIGN - 1);
+}
+
+bool writeTpl(string file, vector<texture_t>& textures, const encodeopts_t& opts) {
+	const unsigned int count = textures.size();
+	const size_t tableOffset = TPL_HEADER_SIZE;
+	const size_t headersOffset = tableOffset + count * 8;
+
+	vector<unsigned char> out(alignUp(headersOffset + count * TPL_IMAGE_SIZE), 0);
+	put32(out, 0, TPL_MAGIC);
+	put32(out, 4, count);
+	put32(out, 8, tableOffset);
+
+	for (unsigned int i = 0; i < count; i++) {
+		const texture_t& texture = textures[i];
+		const texturedesc_t& desc = texture.desc;
+		const size_t header = headersOffset + i * TPL_IMAGE_SIZE;
+		const size_t dataOffset = out.size();
+
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (size_t lod = 0; lod < texture.levels.size(); lod++) {
+			encodeTexture(out, texture.levels[lod], desc.format, opts);
+		}
+		const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		out.resize(alignUp(out.size()), 0);
+
+		// Image table entry (no palettes)
+		put32(out, tableOffset + i * 8, header);
+		put32(out, tableOffset + i * 8 + 4, 0);
+
+		// Image header
+		put16(out, header + 0x00, texture.levels[0].height);
+		put16(out, header + 0x02, texture.levels[0].width);
+		put32(out, header + 0x04, desc.format);
+		put32(out, header + 0x08, dataOffset);
+		put32(out, header + 0x0C, desc.wrapS);
+		put32(out, header + 0x10, desc.wrapT);
+		put32(out, header + 0x14, desc.maxLod > 0 ? FILTER_LIN_MIP_LIN : FILTER_LINEAR);
+		put32(out, header + 0x18, FILTER_LINEAR);
+		put32(out, header + 0x1C, 0);	// LOD bias 0.0f
+		out[header + 0x20] = 0;			// Edge LOD
+		out[header + 0x21] = desc.minLod;
+		out[header + 0x22] = desc.maxLod;
+		out[header + 0x23] = 0;
+
+		cout << desc.id << ": " << texture.levels[0].width << "x" << texture.levels[0].height << " " << formatName(desc.format)
+			 << ", " << texture.levels.size() << " level(s), " << out.size() - dataOffset << " bytes, " << seconds * 1000 << " ms\n";
+	}
+
+	FILE* handle = fopen(file.c_str(), "wb");
+	if (handle == NULL || fwrite(out.data(), 1, out.size(), handle) != out.size()) {
+		cout << "Error, unable to write " << file << "\n";
+		if (handle != NULL) fclose(handle);
+		return false;
+	}
+	fclose(handle);
+	cout << file << ": " << count << " textures, " << out.size() << " bytes\n";
+	return true;
+}
+
+bool writeHeader(string file, const vector<texture_t>& textures) {
+	// Guard from the file name, like _TEXTURES_H_
+	const size_t slash = file.find_last_of("/\\");
+	string guard = file.substr(slash != string::npos ? slash + 1 : 0);
+	for (size_t i = 0; i < guard.size(); i++) {
+		guard[i] = isalnum((unsigned char)guard[i]) ? toupper((unsigned char)guard[i]) : '_';
+	}
+	guard = "_" + guard + "_";
+
+	ofstream out(file.c_str());
+	out << "#ifndef " << guard << "\n#define " << guard << "\n\n";
+	out << fixed << setprecision(7);
+	for (size_t i = 0; i < textures.size(); i++) {
+		const texture_t& texture = textures[i];
+		out << "#define " << texture.desc.id << " " << i << "\n";
+
+		// Atlas textures load their page, <id>Rect maps their UVs into it (u, v, width, height)
+		const image_t& page = texture.levels[0];
+		for (size_t s = 0; s < texture.slots.size(); s++) {
+			const atlasslot_t& slot = texture.slots[s];
+			out << "#define " << slot.id << " " << i << "\n";
+			out << "#define " << slot.id << "Rect " << (double)slot.x / page.width << "f, " << (double)slot.y / page.height << "f, "
+				<< (double)slot.width / page.width << "f, " << (double)slot.height / page.height << "f\n";
+		}
+	}
+	out << "\n#endif\n";
+	if (!out) {
+		cout << "Error, unable to write " << file << "\n";
+		return false;
+	}
+	return true;
+}
+
+// One line per atlas slot: file page x y width height pageWidth pageHeight
+bool writeAtlasMap(string file, const vector<texture_t>& textures) {
+	ofstream out(file.c_str());
+	out << "# png2tpl atlas slots: file page x y width height pageWidth pageHeight\n";
+	for (size_t i = 0; i < textures.size(); i++) {
+		const texture_t& texture = textures[i];
+		for (size_t s = 0; s < texture.slots.size(); s++) {
+			const atlasslot_t& slot = texture.slots[s];
+			const size_t slash = slot.file.find_last_of("/\\");
+			out << slot.file.substr(slash != string::npos ? slash + 1 : 0) << " " << texture.desc.id << " " << slot.x << " " << slot.y
+				<< " " << slot.width << " " << slot.height << " " << texture.levels[0].width << " " << texture.levels[0].height << "\n";
+		}
+	}
+	if (!out) {
+		cout << "Error, unable to write " << file << "\n";
+		return false;
+	}
+	return true;
+}
+
+bool writeDeps(string file, string target, string header, string atlasMap, const vector<texture_t>& textures, const string& base) {
+	ofstream out(file.c_str());
+	out << target << " " << header << (atlasMap.empty() ? "" : " " + atlasMap) << ":";
+	for (size_t i = 0; i < textures.size(); i++) {
+		if (textures[i].slots.empty()) {
+			out << " \\\n  " << base << textures[i].desc.file;
+		}
+		for (size_t s = 0; s < textures[i].slots.size(); s++) {
+			out << " \\\n  " << base << textures[i].slots[s].file;
+		}
+	}
+	out << "\n";
+	if (!out) {
+		cout << "Error, unable to write " << file << "\n";
+		return false;
+	}
+	return true;
+}
+
+// Read a tpl back: describe every image and level, compare to the sources if given
+bool checkTpl(string file, const vector<texture_t>* sources) {
+	vector<unsigned char> data;
+	FILE* handle = fopen(file.c_str(), "rb");
+	if (handle == NULL) {
+		cout << "Error, unable to open " << file << "\n";
+		return false;
+	}
+	fseek(handle, 0, SEEK_END);
+	data.resize(ftell(handle));
+	fseek(handle, 0, SEEK_SET);
+	data.resize(fread(data.data(), 1, data.size(), handle));
+	fclose(handle);
+
+	if (data.size() < TPL_HEADER_SIZE || get32(&data[0]) != TPL_MAGIC) {
+		cout << "Error, " << file << " is not a tpl\n";
+		return false;
+	}
+	const unsigned int count = get32(&data[4]);
+	const unsigned int table = get32(&data[8]);
+	if (sources != NULL && sources->size() != count) {
+		cout << "Error, " << file << " has " << count << " textures, the descriptor " << sources->size() << "\n";
+		return false;
+	}
+
+	bool ok = true;
+	for (unsigned int i = 0; i < count; i++) {
+		if (table + i * 8 + 8 > data.size()) {
+			cout << "Error, image table past the end\n";
+			return false;
+		}
+		const unsigned int header = get32(&data[table + i * 8]);
+		if (header + TPL_IMAGE_SIZE > data.size()) {
+			cout << "Error, image header past the end\n";
+			return false;
+		}
+		const unsigned char* h = &data[header];
+		unsigned int height = get16(h), width = get16(h + 2);
+		const unsigned int format = get32(h + 4);
+		unsigned int offset = get32(h + 8);
+		const unsigned int maxLod = h[0x22];
+		cout << "texture " << i << ": " << width << "x" << height << " " << (formatName(format) ? formatName(format) : "?")
+			 << " @" << offset << ", lod " << (unsigned int)h[0x21] << "-" << maxLod << "\n";
+		if (formatName(format) == NULL || offset % TPL_ALIGN != 0) {
+			cout << "Error, unsupported format or unaligned data\n";
+			return false;
+		}
+
+		for (unsigned int lod = 0; lod <= maxLod; lod++) {
+			const size_t size = textureSize(format, width, height);
+			if (offset + size > data.size()) {
+				cout << "Error, level " << lod << " past the end\n";
+				return false;
+			}
+			if (sources != NULL) {
+				const texture_t& source = (*sources)[i];
+				if (lod >= source.levels.size() || source.levels[lod].width != width || source.levels[lod].height != height) {
+					cout << "Error, level " << lod << " doesn't match the source size\n";
+					ok = false;
+				} else {
+					image_t decoded;
+					decodeTexture(&data[offset], width, height, format, decoded);
+					cout << "  level " << lod << ": " << width << "x" << height << ", PSNR " << imagePsnr(decoded, source.levels[lod]) << " dB\n";
+				}
+			}
+			offset += size;
+			width = width > 1 ? width / 2 : 1;
+			height = height > 1 ? height / 2 : 1;
+		}
+	}
+	if (ok) {
+		cout << "ok\n";
+	}
+	return ok;
+}
+
+// Speed and quality of both CMPR encoders, on one and on all threads
+bool benchCmpr(string file, unsigned int threads) {
+	image_t image;
+	string error;
+	if (!loadPng(file, image, error)) {
+		cout << "Error, " << file << ": " << error << "\n";
+		return false;
+	}
+	const double megapixels = image.width * image.height / 1e6;
+	cout << file << ": " << image.width << "x" << image.height << "\n";
+
+	for (int high = 0; high < 2; high++) {
+		for (int parallel = 0; parallel < 2; parallel++) {
+			encodeopts_t opts;
+			opts.cmprHigh = high != 0;
+			opts.threads = parallel ? threads : 1;
+
+			// Repeat small images so the timing means something
+			vector<unsigned char> out;
+			unsigned int runs = 0;
+			chrono::steady_clock::time_point start = chrono::steady_clock::now();
+			double seconds = 0;
+			do {
+				out.clear();
+				encodeTexture(out, image, TF_CMPR, opts);
+				runs++;
+				seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			} while (seconds < 0.5);
+
+			image_t decoded;
+			decodeTexture(out.data(), image.width, image.height, TF_CMPR, decoded);
+			cout << (high ? "fitted" : "bounding box") << ", " << opts.threads << " thread(s): "
+				 << seconds * 1000 / runs << " ms, " << megapixels * runs / seconds << " MP/s, PSNR "
+				 << imagePsnr(decoded, image) << " dB\n";
+		}
+	}
+	return true;
+}
@@ -0,0 +1,103 @@
+#ifndef _PNG2TPL_H
+#define _PNG2TPL_H
+
+#include <vector>
+#include <string>
+#include <cstddef>
+
+// GX texture formats
+#define TF_I4		0x0
+#define TF_I8		0x1
+#define TF_IA4		0x2
+#define TF_IA8		0x3
+#define TF_RGB565	0x4
+#define TF_RGB5A3	0x5
+#define TF_RGBA8	0x6
+#define TF_CMPR		0xE
+
+// GX wrap modes and filters, as stored in the TPL
+#define WRAP_CLAMP		0
+#define WRAP_REPEAT		1
+#define WRAP_MIRROR		2
+#define FILTER_NEAR		0
+#define FILTER_LINEAR	1
+#define FILTER_LIN_MIP_LIN	5
+
+// RGBA, 8 bits per channel, rows top to bottom
+typedef struct {
+	unsigned int				width;
+	unsigned int				height;
+	std::vector<unsigned char>	pixels;
+} image_t;
+
+// One texture of an .scf descriptor
+typedef struct {
+	std::string		file;		// PNG, relative to the .scf
+	std::string		id;			// Define in the generated header
+	unsigned int	format;		// TF_*
+	bool			mipmap;		// Store mip levels down to maxLod
+	unsigned int	minLod;
+	unsigned int	maxLod;
+	unsigned int	wrapS;		// WRAP_*
+	unsigned int	wrapT;
+	std::string		atlas;		// Page to pack the texture in, empty for its own image
+} texturedesc_t;
+
+// Where a texture went in an atlas page
+typedef struct {
+	std::string		id;			// Texture id
+	std::string		file;		// Source PNG
+	unsigned int	x, y;		// Top left corner in the page (texels)
+	unsigned int	width;		// Source size (texels)
+	unsigned int	height;
+} atlasslot_t;
+
+typedef struct {
+	bool			cmprHigh;	// Principal axis + least squares CMPR endpoints instead of the bounding box
+	unsigned int	threads;	// Encoder threads
+} encodeopts_t;
+
+// image.cpp
+bool loadPng(const std::string& file, image_t& image, std::string& error);
+
+// Half size (box filter), dimensions don't go below 1
+image_t downsample(const image_t& image);
+
+// Peak signal to noise ratio over RGBA, in dB (100 for identical images)
+double imagePsnr(const image_t& a, const image_t& b);
+
+// encode.cpp
+// Name of a format (for reports), NULL if not supported
+const char* formatName(unsigned int format);
+
+// Bytes a level of this size takes, padded to whole tiles
+size_t textureSize(unsigned int format, unsigned int width, unsigned int height);
+
+// Texels per tile of a format, atlas slots are kept tile aligned
+void formatTile(unsigned int format, unsigned int& width, unsigned int& height);
+
+// Encode one level into GX tiles
+void encodeTexture(std::vector<unsigned char>& out, const image_t& image, unsigned int format, const encodeopts_t& opts);
+
+// Decode one level back to RGBA (for checks and benchmarks)
+void decodeTexture(const unsigned char* data, unsigned int width, unsigned int height, unsigned int format, image_t& image);
+
+// atlas.cpp
+// Place the images of slots (x and y are filled in) on the smallest page that
+// holds them all, each slot tile aligned with at least padding texels around it
+bool packAtlas(std::vector<atlasslot_t>& slots, unsigned int padding, unsigned int tileWidth, unsigned int tileHeight,
+			   unsigned int maxSize, unsigned int& pageWidth, unsigned int& pageHeight);
+
+// Copy an image into a page, repeating its border padding texels outwards
+void blitPadded(image_t& page, const image_t& image, unsigned int x, unsigned int y, unsigned int padding);
+
+// cmpr.cpp
+// One 4x4 DXT1-style block, rgba holds 16 pixels in rows
+void encodeCmprBlock(const unsigned char* rgba, bool high, unsigned char* out);
+void decodeCmprBlock(const unsigned char* in, unsigned char* rgba);
+
+// scf.cpp
+// Read the texture list of an .scf descriptor
+bool readScf(const std::string& file, std::vector<texturedesc_t>& textures, std::string& error);
+
+#endif
@@ -0,0 +1,138 @@
+// scf.cpp : Texture descriptor (.scf) reader
+//
+// One texture per tag, as written for gxtexconv:
+//   <filepath="terrain.png" id="terrainTex" colfmt=14 mipmap=yes minlod=0 maxlod=3 />
+// png2tpl also reads atlas="page", textures with the same page share one image.
+
+#include "png2tpl.h"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+using namespace std;
+
+// Split a tag into key=value pairs, values may be quoted
+static bool parseTag(const string& tag, vector<pair<string, string> >& attributes) {
+	size_t p = 0;
+	while (p < tag.size()) {
+		while (p < tag.size() && isspace((unsigned char)tag[p])) {
+			p++;
+		}
+		if (p >= tag.size()) {
+			break;
+		}
+		const size_t equals = tag.find('=', p);
+		if (equals == string::npos) {
+			return false;
+		}
+		string key = tag.substr(p, equals - p);
+		while (!key.empty() && isspace((unsigned char)key[key.size() - 1])) {
+			key.erase(key.size() - 1);
+		}
+		p = equals + 1;
+
+		string value;
+		if (p < tag.size() && tag[p] == '"') {
+			const size_t close = tag.find('"', p + 1);
+			if (close == string::npos) {
+				return false;
+			}
+			value = tag.substr(p + 1, close - p - 1);
+			p = close + 1;
+		} else {
+			const size_t start = p;
+			while (p < tag.size() && !isspace((unsigned char)tag[p])) {
+				p++;
+			}
+			value = tag.substr(start, p - start);
+		}
+		attributes.push_back(make_pair(key, value));
+	}
+	return true;
+}
+
+static bool parseNumber(const string& text, unsigned int& value) {
+	char* end = NULL;
+	const unsigned long number = strtoul(text.c_str(), &end, 0);
+	if (text.empty() || *end != '\0') {
+		return false;
+	}
+	value = (unsigned int)number;
+	return true;
+}
+
+bool readScf(const string& file, vector<texturedesc_t>& textures, string& error) {
+	ifstream in(file.c_str());
+	if (!in) {
+		error = "unable to open " + file;
+		return false;
+	}
+	stringstream content;
+	content << in.rdbuf();
+	const string text = content.str();
+
+	size_t p = 0;
+	while ((p = text.find('<', p)) != string::npos) {
+		const size_t close = text.find('>', p);
+		if (close == string::npos) {
+			error = "unterminated tag";
+			return false;
+		}
+		string tag = text.substr(p + 1, close - p - 1);
+		p = close + 1;
+		if (!tag.empty() && tag[tag.size() - 1] == '/') {
+			tag.erase(tag.size() - 1);
+		}
+
+		vector<pair<string, string> > attributes;
+		if (!parseTag(tag, attributes)) {
+			error = "bad tag <" + tag + ">";
+			return false;
+		}
+
+		texturedesc_t texture;
+		texture.format = TF_RGBA8;
+		texture.mipmap = false;
+		texture.minLod = 0;
+		texture.maxLod = 0;
+		texture.wrapS = WRAP_REPEAT;
+		texture.wrapT = WRAP_REPEAT;
+		for (size_t i = 0; i < attributes.size(); i++) {
+			const string& key = attributes[i].first;
+			const string& value = attributes[i].second;
+			bool ok = true;
+			if (key == "filepath") {
+				texture.file = value;
+			} else if (key == "id") {
+				texture.id = value;
+			} else if (key == "colfmt") {
+				ok = parseNumber(value, texture.format) && formatName(texture.format) != NULL;
+			} else if (key == "mipmap") {
+				texture.mipmap = value == "yes" || value == "true" || value == "1";
+			} else if (key == "minlod") {
+				ok = parseNumber(value, texture.minLod);
+			} else if (key == "maxlod") {
+				ok = parseNumber(value, texture.maxLod);
+			} else if (key == "atlas") {
+				texture.atlas = value;
+			} else {
+				cout << "Warning: " << file << ": ignoring " << key << "=" << value << "\n";
+			}
+			if (!ok) {
+				error = "bad value " + key + "=" + value;
+				return false;
+			}
+		}
+		if (texture.file.empty() || texture.id.empty()) {
+			error = "texture without filepath or id";
+			return false;
+		}
+		if (!texture.mipmap) {
+			texture.minLod = texture.maxLod = 0;
+		}
+		textures.push_back(texture);
+	}
+	return true;
+}
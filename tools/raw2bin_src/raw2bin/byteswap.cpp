@@ -0,0 +1,93 @@
+// byteswap.cpp : Bulk endian swapping
+//
+
+#include "raw2bin.h"
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RAW2BIN_SSE2
+#include <emmintrin.h>
+#endif
+
+// Plain loops, for tails and machines without SSE2
+static void swap16Scalar(unsigned char* data, size_t count) {
+	for (size_t i = 0; i < count; i++, data += 2) {
+		const unsigned char b0 = data[0];
+		data[0] = data[1];
+		data[1] = b0;
+	}
+}
+
+static void swap32Scalar(unsigned char* data, size_t count) {
+	for (size_t i = 0; i < count; i++, data += 4) {
+		const unsigned char b0 = data[0], b1 = data[1];
+		data[0] = data[3];
+		data[1] = data[2];
+		data[2] = b1;
+		data[3] = b0;
+	}
+}
+
+#ifdef RAW2BIN_SSE2
+// 16 bytes per step: swap the bytes of each 16-bit lane
+static inline __m128i swapLanes16(__m128i v) {
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+// Swap the 16-bit halves of each 32-bit lane, then the bytes in each half
+static inline __m128i swapLanes32(__m128i v) {
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	return swapLanes16(v);
+}
+#endif
+
+void swapBuffer(void* data, size_t count, unsigned int size, bool simd) {
+	unsigned char* bytes = (unsigned char*)data;
+	if (size != 2 && size != 4) {
+		return;
+	}
+
+	size_t done = 0;
+#ifdef RAW2BIN_SSE2
+	if (simd) {
+		// Four vectors per iteration, unaligned loads are as fast as aligned ones on anything recent
+		const size_t perVector = 16 / size;
+		const size_t blocks = count / (perVector * 4);
+		__m128i* p = (__m128i*)bytes;
+		for (size_t b = 0; b < blocks; b++, p += 4) {
+			__m128i v0 = _mm_loadu_si128(p);
+			__m128i v1 = _mm_loadu_si128(p + 1);
+			__m128i v2 = _mm_loadu_si128(p + 2);
+			__m128i v3 = _mm_loadu_si128(p + 3);
+			if (size == 2) {
+				v0 = swapLanes16(v0); v1 = swapLanes16(v1); v2 = swapLanes16(v2); v3 = swapLanes16(v3);
+			} else {
+				v0 = swapLanes32(v0); v1 = swapLanes32(v1); v2 = swapLanes32(v2); v3 = swapLanes32(v3);
+			}
+			_mm_storeu_si128(p, v0);
+			_mm_storeu_si128(p + 1, v1);
+			_mm_storeu_si128(p + 2, v2);
+			_mm_storeu_si128(p + 3, v3);
+		}
+		done = blocks * perVector * 4;
+	}
+#else
+	(void)simd;
+#endif
+
+	if (size == 2) {
+		swap16Scalar(bytes + done * 2, count - done);
+	} else {
+		swap32Scalar(bytes + done * 4, count - done);
+	}
+}
+
+bool swapBufferIsSimd() {
+#ifdef RAW2BIN_SSE2
+	return true;
+#else
+	return false;
+#endif
+}
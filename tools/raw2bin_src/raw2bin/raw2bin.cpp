@@ -1,4 +1,4 @@
-// obj2bin.cpp : Defines the entry point for the console application.
+// raw2bin.cpp : Defines the entry point for the console application.
 //
 
 #include "raw2bin.h"
@@ -8,15 +8,28 @@ namespace po = boost::program_options;
 
 #include <iostream>
 #include <iterator>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
 using namespace std;
 
+// Bytes moved per read/write, a multiple of every element size
+#define CHUNK_SIZE (1 << 20)
+
+// Timed runs of each benchmark pass
+#define BENCH_RUNS 3
+
 // Prototyping
-template<typename T>
-bool convertRaw(string inFile, string outFile);
+bool convertRaw(string inFile, string outFile, unsigned int size, vector<unsigned char>& buffer);
+bool benchRaw(unsigned int megabytes, unsigned int size);
 
 int main(int argc, char* argv[]) {
-	string inFilePath, outFilePath;
-	unsigned char bpp = 16;
+	string inFilePath, outFilePath, outDir;
+	vector<string> batchFiles;
+	unsigned int bpp = 16;
 
 	try {
 		po::options_description desc("Valid arguments");
@@ -24,11 +37,16 @@ int main(int argc, char* argv[]) {
 			("help", "produce help message")
 			("input,i", po::value<string>(), "input raw file")
 			("output,o", po::value<string>(), "output raw file")
-			("bits,b", po::value<unsigned char>(), "bits per pixel")
+			("bits,b", po::value<unsigned int>(&bpp), "bits per pixel")
+			("files", po::value<vector<string> >(&batchFiles), "input raw files to convert in one run (needs --out-dir)")
+			("out-dir", po::value<string>(&outDir), "output directory for --files, names are kept")
+			("bench", po::value<unsigned int>(), "time conversion of a file of this many MB")
 			;
+		po::positional_options_description positional;
+		positional.add("files", -1);
 
 		po::variables_map vm;
-		po::store(po::parse_command_line(argc, argv, desc), vm);
+		po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
 		po::notify(vm);
 
 		// Help
@@ -38,12 +56,32 @@ int main(int argc, char* argv[]) {
 		}
 
 		// BBP
-		if (vm.count("bits")) {
-			bpp = vm["bits"].as<unsigned char>();
-			if (bpp != 8 && bpp != 16 && bpp != 32) {
-				cout << "ERROR:\n  Wrong number used for bits.\nPlease use either 8, 16 or 32.\n";
+		if (bpp != 8 && bpp != 16 && bpp != 32) {
+			cout << "ERROR:\n  Wrong number used for bits.\nPlease use either 8, 16 or 32.\n";
+			return 1;
+		}
+
+		if (vm.count("bench")) {
+			return benchRaw(vm["bench"].as<unsigned int>(), bpp / 8) ? 0 : 1;
+		}
+
+		// Batch
+		if (!batchFiles.empty()) {
+			if (outDir.empty()) {
+				cout << "ERROR:\n  Converting several files needs --out-dir.\n";
 				return 1;
 			}
+			vector<unsigned char> buffer(CHUNK_SIZE);
+			unsigned int failed = 0;
+			for (size_t i = 0; i < batchFiles.size(); i++) {
+				const size_t slash = batchFiles[i].find_last_of("/\\");
+				const string name = slash != string::npos ? batchFiles[i].substr(slash + 1) : batchFiles[i];
+				if (!convertRaw(batchFiles[i], outDir + "/" + name, bpp / 8, buffer)) {
+					failed++;
+				}
+			}
+			cout << batchFiles.size() - failed << " converted, " << failed << " failed\n";
+			return failed == 0 ? 0 : 1;
 		}
 
 		// Arguments
@@ -69,79 +107,192 @@ int main(int argc, char* argv[]) {
 	}
 	catch (...) {
 		cerr << "Exception of unknown type!\n";
+		return 1;
 	}
 
-	bool result = false;
-	switch (bpp) {
-	case 8:
-		result = convertRaw<unsigned char>(inFilePath, outFilePath);
-		break;
-	case 16:
-		result = convertRaw<unsigned short>(inFilePath, outFilePath);
-		break;
-	case 32:
-		result = convertRaw<unsigned int>(inFilePath, outFilePath);
-		break;
-
-	}
-
-	if (!result)
+	vector<unsigned char> buffer(CHUNK_SIZE);
+	if (!convertRaw(inFilePath, outFilePath, bpp / 8, buffer))
 		return 1;
 
 	return 0;
 }
 
-template<typename T>
-bool convertRaw(string inFile, string outFile) {
+// Swap every element of a file in big chunks (buffer is reused between files).
+// The output is written next to its final name and moved there at the end, so
+// converting a file onto itself (eg. --out-dir set to the input directory) works.
+bool convertRaw(string inFile, string outFile, unsigned int size, vector<unsigned char>& buffer) {
 	FILE *outFileHandle = NULL, *inFileHandle = NULL;
+	const string tempFile = outFile + ".tmp";
 
 	// Open and check
-	fopen_s(&inFileHandle, inFile.c_str(), "rb");
+	inFileHandle = fopen(inFile.c_str(), "rb");
 	if (inFileHandle == NULL) {
 		cout << "Error input file [" << inFile << "] could not be opened\n";
 		return false;
 	}
-	fopen_s(&outFileHandle, outFile.c_str(), "wb");
+	outFileHandle = fopen(tempFile.c_str(), "wb");
 	if (outFileHandle == NULL) {
-		cout << "Error output file [" << outFile << "] could not be opened\n";
+		cout << "Error output file [" << tempFile << "] could not be opened\n";
 		fclose(inFileHandle);
 		return false;
 	}
 
-	T readBuffer, writeBuffer;
-	while (!feof(inFileHandle)) {
-		if (fread(&readBuffer, sizeof(T), 1, inFileHandle) == 1) {
-			writeBuffer = swapEndian<T>(readBuffer);
+	// Chunks are bigger than any stdio buffer, skip the extra copy
+	setvbuf(inFileHandle, NULL, _IONBF, 0);
+	setvbuf(outFileHandle, NULL, _IONBF, 0);
 
-			fwrite(&writeBuffer, sizeof(T), 1, outFileHandle);
-		} else {
+	bool result = true;
+	size_t read;
+	while ((read = fread(buffer.data(), 1, buffer.size(), inFileHandle)) > 0) {
+		// Only the last chunk can be short, a trailing partial element is dropped
+		const size_t whole = read - read % size;
+		if (whole != read) {
+			cout << "Warning: [" << inFile << "] ends with " << read - whole << " bytes that don't make an element\n";
+		}
+
+		swapBuffer(buffer.data(), whole / size, size, true);
+		if (fwrite(buffer.data(), 1, whole, outFileHandle) != whole) {
+			cout << "Error output file [" << outFile << "] could not be written\n";
+			result = false;
 			break;
 		}
 	}
+	if (ferror(inFileHandle)) {
+		cout << "Error input file [" << inFile << "] could not be read\n";
+		result = false;
+	}
 
 	// Close file
 	fclose(inFileHandle);
-	fclose(outFileHandle);
-	return true;
+	if (fclose(outFileHandle) != 0) {
+		result = false;
+	}
+
+	// Replace the output only once it's complete (rename doesn't overwrite on Windows)
+	if (result) {
+		remove(outFile.c_str());
+		if (rename(tempFile.c_str(), outFile.c_str()) != 0) {
+			cout << "Error output file [" << outFile << "] could not be written\n";
+			result = false;
+		}
+	}
+	if (!result) {
+		remove(tempFile.c_str());
+	}
+	return result;
 }
 
-template<class T>
-inline T swapEndian(T input);
+static double secondsSince(const chrono::steady_clock::time_point& start) {
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
 
-// BPP 8
-template<>
-inline unsigned char swapEndian(unsigned char input) {
-	return input;
+// Copy a file with the same chunked I/O but no swapping, the I/O bound
+static bool copyRaw(string inFile, string outFile, vector<unsigned char>& buffer) {
+	FILE* in = fopen(inFile.c_str(), "rb");
+	FILE* out = fopen(outFile.c_str(), "wb");
+	if (in == NULL || out == NULL) {
+		if (in != NULL) fclose(in);
+		if (out != NULL) fclose(out);
+		return false;
+	}
+	setvbuf(in, NULL, _IONBF, 0);
+	setvbuf(out, NULL, _IONBF, 0);
+	size_t read;
+	while ((read = fread(buffer.data(), 1, buffer.size(), in)) > 0) {
+		fwrite(buffer.data(), 1, read, out);
+	}
+	fclose(in);
+	fclose(out);
+	return true;
 }
 
-// BPP 16
-template<>
-inline unsigned short swapEndian(unsigned short input) {
-	return SwapShort(input);
+// The previous converter: one fread and fwrite per element
+static bool convertPerElement(string inFile, string outFile, unsigned int size) {
+	FILE* in = fopen(inFile.c_str(), "rb");
+	FILE* out = fopen(outFile.c_str(), "wb");
+	if (in == NULL || out == NULL) {
+		if (in != NULL) fclose(in);
+		if (out != NULL) fclose(out);
+		return false;
+	}
+	unsigned char element[4];
+	while (fread(element, size, 1, in) == 1) {
+		swapBuffer(element, 1, size, false);
+		fwrite(element, size, 1, out);
+	}
+	fclose(in);
+	fclose(out);
+	return true;
 }
 
-// BPP 32
-template<>
-inline unsigned int swapEndian(unsigned int input) {
-	return SwapInt(input);
-}
\ No newline at end of file
+bool benchRaw(unsigned int megabytes, unsigned int size) {
+	const size_t bytes = (size_t)megabytes << 20;
+	const string inFile = "raw2bin_bench.raw", outFile = "raw2bin_bench.bin";
+	cout << megabytes << " MB, " << size * 8 << " bits per element, SSE2 " << (swapBufferIsSimd() ? "on" : "off") << "\n";
+
+	vector<unsigned char> source(bytes);
+	unsigned int seed = 12345;
+	for (size_t i = 0; i < bytes; i++) {
+		seed = seed * 1103515245 + 12345;
+		source[i] = (unsigned char)(seed >> 16);
+	}
+
+	// Swap alone, in memory
+	vector<unsigned char> work(source);
+	for (int simd = 0; simd < 2 && size > 1; simd++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		swapBuffer(work.data(), bytes / size, size, simd != 0);
+		const double seconds = secondsSince(start);
+		cout << (simd ? "swap simd:      " : "swap scalar:    ") << megabytes / seconds << " MB/s\n";
+	}
+
+	FILE* out = fopen(inFile.c_str(), "wb");
+	if (out == NULL || fwrite(source.data(), 1, bytes, out) != bytes) {
+		cout << "Error, unable to write " << inFile << "\n";
+		if (out != NULL) fclose(out);
+		return false;
+	}
+	fclose(out);
+
+	// Best of a few runs, the first ones also pay for allocating the output file
+	vector<unsigned char> buffer(CHUNK_SIZE);
+	double copyTime = 0, convertTime = 0;
+	bool converted = true;
+	for (int run = 0; run < BENCH_RUNS; run++) {
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		copyRaw(inFile, outFile, buffer);
+		const double copy = secondsSince(start);
+
+		start = chrono::steady_clock::now();
+		converted = convertRaw(inFile, outFile, size, buffer) && converted;
+		const double convert = secondsSince(start);
+
+		copyTime = run == 0 ? copy : min(copyTime, copy);
+		convertTime = run == 0 ? convert : min(convertTime, convert);
+	}
+
+	// The result has to match a plain swap of the source
+	vector<unsigned char> expected(source);
+	swapBuffer(expected.data(), bytes / size, size, false);
+	vector<unsigned char> written;
+	FILE* in = fopen(outFile.c_str(), "rb");
+	if (in != NULL) {
+		written.resize(bytes);
+		written.resize(fread(written.data(), 1, bytes, in));
+		fclose(in);
+	}
+	const bool same = converted && written == expected;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	convertPerElement(inFile, outFile, size);
+	const double perElementTime = secondsSince(start);
+
+	remove(inFile.c_str());
+	remove(outFile.c_str());
+
+	cout << "file copy:      " << megabytes / copyTime << " MB/s (no swapping, the I/O limit)\n";
+	cout << "convert:        " << megabytes / convertTime << " MB/s\n";
+	cout << "per element:    " << megabytes / perElementTime << " MB/s (one fread/fwrite per element)\n";
+	cout << "output " << (same ? "matches" : "DIFFERS") << "\n";
+	return same;
+}
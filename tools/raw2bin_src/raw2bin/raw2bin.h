@@ -1,6 +1,8 @@
 #ifndef _RAW2BIN_H
 #define _RAW2BIN_H
 
+#include <cstddef>
+
 // Endian magic below
 #ifndef LITTLE_ENDIAN
 #define LITTLE_ENDIAN  3412
@@ -49,4 +51,11 @@ static inline float SwapFloat(const float n) {
 #define EndianFixFloat(x) (x)
 #endif
 
+// Swap the endian of count elements of size bytes (2 or 4, others are left alone)
+// in place, with SSE2 when simd is set and the build has it
+void swapBuffer(void* data, size_t count, unsigned int size, bool simd);
+
+// Whether swapBuffer was built with SSE2
+bool swapBufferIsSimd();
+
 #endif
\ No newline at end of file